@@ -11,10 +11,12 @@
 #include <cpu_func.h>
 #include <hang.h>
 #include <log.h>
+#include <smp_job.h>
 #include <asm/cache.h>
 #include <asm/global_data.h>
 #include <asm/system.h>
 #include <asm/armv8/mmu.h>
+#include <linux/sizes.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -378,9 +380,9 @@ __weak u64 get_page_table_size(void)
 
 	/*
 	 * We may need to split page tables later on if dcache settings change,
-	 * so reserve up to 4 (random pick) page tables for that.
+	 * so reserve some page tables for that.
 	 */
-	size += one_pt * 4;
+	size += one_pt * CONFIG_ARMV8_SPARE_PAGE_TABLES;
 
 	return size;
 }
@@ -484,6 +486,35 @@ void flush_dcache_range(unsigned long start, unsigned long stop)
 {
 	__asm_flush_dcache_range(start, stop);
 }
+
+/*
+ * Copy and flush in aligned chunks small enough to stay in the L1 cache,
+ * so that the flush writes back lines which are still there instead of
+ * looking them up again after the whole buffer went through the cache.
+ * The chunks are also below CONFIG_ARM64_MEMCPY_NT_THRESHOLD, so that
+ * memcpy() does use the cache.
+ */
+#define COPY_FLUSH_CHUNK	SZ_8K
+
+void memcpy_flush_dcache(void *dst, const void *src, size_t len)
+{
+	ulong start = (ulong)dst;
+	ulong end = start + len;
+	ulong next;
+
+	if (!dcache_status()) {
+		memcpy(dst, src, len);
+		return;
+	}
+
+	while (start < end) {
+		next = min(ALIGN(start + 1, COPY_FLUSH_CHUNK), end);
+		memcpy((void *)start, src, next - start);
+		__asm_flush_dcache_range(start, next);
+		src += next - start;
+		start = next;
+	}
+}
 #else
 void invalidate_dcache_range(unsigned long start, unsigned long stop)
 {
@@ -587,6 +618,12 @@ void mmu_set_region_dcache_behaviour(phys_addr_t start, size_t size,
 	if (!gd->arch.tlb_emerg)
 		panic("Emergency page table not setup.");
 
+	/*
+	 * The secondary CPUs run on the same tables, but the TLB invalidation
+	 * done when switching back only covers this CPU
+	 */
+	smp_job_park();
+
 	/*
 	 * We can not modify page tables that we're currently running on,
 	 * so we first need to switch to the "emergency" page tables where
@@ -635,6 +672,9 @@ void mmu_change_region_attr(phys_addr_t addr, size_t siz, u64 attrs)
 	int level;
 	u64 r, size, start;
 
+	/* As above, the secondary CPUs must not see the tables change */
+	smp_job_park();
+
 	start = addr;
 	size = siz;
 	/*
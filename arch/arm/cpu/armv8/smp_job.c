@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SMP job pool backend: secondary CPUs are turned on and off through PSCI
+ * and run with the boot CPU's translation tables, so all handoffs go
+ * through coherent, cacheable memory.
+ */
+
+#define LOG_CATEGORY LOGC_ARCH
+
+#include <common.h>
+#include <cpu_func.h>
+#include <log.h>
+#include <malloc.h>
+#include <smp_job.h>
+#include <time.h>
+#include <asm/barriers.h>
+#include <asm/global_data.h>
+#include <asm/psci.h>
+#include <asm/ptrace.h>
+#include <asm/system.h>
+#include <linux/errno.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define MPIDR_MT		BIT(24)
+#define MPIDR_AFFINITY_MASK	0xff00ffffffUL
+
+#define SMP_JOB_OFF_TIMEOUT_MS	100
+
+/*
+ * Read by smp_job_secondary_entry() with the MMU off: keep the layout in
+ * sync with it
+ */
+struct smp_job_boot {
+	u64 sp;
+	u64 gd;
+	u64 vbar;
+	u64 mair;
+	u64 tcr;
+	u64 ttbr0;
+	u64 sctlr;
+	/* Not used by the entry code */
+	struct smp_job_cpu *cpu;
+	u64 mpidr;
+	void *stack;
+};
+
+void smp_job_secondary_entry(void);
+
+#define read_el_reg(reg, el, val) do {					\
+	if ((el) == 3)							\
+		asm volatile("mrs %0, " #reg "_el3" : "=r" (val));	\
+	else if ((el) == 2)						\
+		asm volatile("mrs %0, " #reg "_el2" : "=r" (val));	\
+	else								\
+		asm volatile("mrs %0, " #reg "_el1" : "=r" (val));	\
+} while (0)
+
+static long smp_job_psci(ulong fn, ulong arg0, ulong arg1, ulong arg2)
+{
+	struct pt_regs regs;
+
+	regs.regs[0] = fn;
+	regs.regs[1] = arg0;
+	regs.regs[2] = arg1;
+	regs.regs[3] = arg2;
+	smc_call(&regs);
+
+	return regs.regs[0];
+}
+
+/*
+ * Secondary CPUs follow the boot CPU in MPIDR order, skipping the boot
+ * CPU itself. DynamIQ cores (e.g. A55) report MT and number cores in Aff1.
+ */
+static u64 smp_job_mpidr(uint index)
+{
+	u64 self, mpidr;
+	uint shift, core;
+
+	asm volatile("mrs %0, mpidr_el1" : "=r" (self));
+	shift = self & MPIDR_MT ? 8 : 0;
+	core = (self >> shift) & 0xff;
+	if (index <= core)
+		index--;
+
+	mpidr = self & MPIDR_AFFINITY_MASK;
+	mpidr &= ~(0xffUL << shift);
+
+	return mpidr | ((u64)index << shift);
+}
+
+void __noreturn smp_job_secondary_main(struct smp_job_boot *boot)
+{
+	smp_job_worker(boot->cpu);
+
+	/* Parked: power down so that the OS can turn the CPU on again */
+	smp_job_psci(ARM_PSCI_0_2_FN_CPU_OFF, 0, 0, 0);
+	for (;;)
+		wfi();
+}
+
+int arch_smp_job_cpu_on(struct smp_job_cpu *cpu)
+{
+	struct smp_job_boot *boot;
+	uint el = current_el();
+	long ret;
+
+	/* Mailboxes rely on the secondary CPUs snooping our caches */
+	if (!dcache_status())
+		return -EOPNOTSUPP;
+
+	boot = cpu->arch;
+	if (!boot) {
+		boot = memalign(ARCH_DMA_MINALIGN, sizeof(*boot));
+		if (!boot)
+			return -ENOMEM;
+		boot->stack = memalign(16, CONFIG_SMP_JOB_STACK_SIZE);
+		if (!boot->stack) {
+			free(boot);
+			return -ENOMEM;
+		}
+		cpu->arch = boot;
+	}
+
+	boot->sp = (ulong)boot->stack + CONFIG_SMP_JOB_STACK_SIZE;
+	boot->gd = (ulong)gd;
+	read_el_reg(vbar, el, boot->vbar);
+	read_el_reg(mair, el, boot->mair);
+	read_el_reg(tcr, el, boot->tcr);
+	read_el_reg(ttbr0, el, boot->ttbr0);
+	boot->sctlr = get_sctlr();
+	boot->cpu = cpu;
+	boot->mpidr = smp_job_mpidr(cpu->index);
+
+	flush_dcache_range((ulong)boot, (ulong)boot + ALIGN(sizeof(*boot),
+							    ARCH_DMA_MINALIGN));
+
+	ret = smp_job_psci(ARM_PSCI_0_2_FN64_CPU_ON, boot->mpidr,
+			   (ulong)smp_job_secondary_entry, (ulong)boot);
+	if (ret != ARM_PSCI_RET_SUCCESS) {
+		log_debug("CPU_ON %llx: %ld\n", boot->mpidr, ret);
+		return ret == ARM_PSCI_RET_INVAL ? -ENODEV : -EIO;
+	}
+
+	return 0;
+}
+
+int arch_smp_job_cpu_off(struct smp_job_cpu *cpu)
+{
+	struct smp_job_boot *boot = cpu->arch;
+	ulong start = get_timer(0);
+
+	while (smp_job_psci(ARM_PSCI_0_2_FN64_AFFINITY_INFO, boot->mpidr, 0,
+			    0) != PSCI_AFFINITY_LEVEL_OFF) {
+		if (get_timer(start) > SMP_JOB_OFF_TIMEOUT_MS)
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+void arch_smp_job_wait(void)
+{
+	asm volatile("wfe" : : : "memory");
+}
+
+void arch_smp_job_notify(void)
+{
+	dsb();
+	asm volatile("sev" : : : "memory");
+}
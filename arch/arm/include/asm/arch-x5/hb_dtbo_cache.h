@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright(C) 2024, D-Robotics Co., Ltd. All rights reserved
+ */
+
+#ifndef __HB_DTBO_CACHE_H__
+#define __HB_DTBO_CACHE_H__
+
+#include <linux/types.h>
+#include <u-boot/sha256.h>
+
+/**
+ * struct hb_dtbo_key - What a cached FDT was built from
+ *
+ * @base_hash:	SHA-256 of the FDT before the overlay, and of its address
+ * @src_hash:	SHA-256 of the dtbo_* variables saying where the overlay is
+ * @dtbo_hash:	SHA-256 of the overlay file
+ * @dtbo_size:	Size of the overlay file
+ */
+struct hb_dtbo_key {
+	u8 base_hash[SHA256_SUM_LEN];
+	u8 src_hash[SHA256_SUM_LEN];
+	u8 dtbo_hash[SHA256_SUM_LEN];
+	u64 dtbo_size;
+};
+
+/**
+ * struct hb_dtbo_cache - State of one cache lookup
+ *
+ * @key:	Key of the FDT being built
+ * @dev:	Interface of the cache storage, "ubi" for a UBI volume
+ * @part:	Partition ("0#name", "0:1") or UBI volume of the cache
+ * @dtbo_read:	@key.dtbo_hash and @key.dtbo_size are set
+ */
+struct hb_dtbo_cache {
+	struct hb_dtbo_key key;
+	const char *dev;
+	const char *part;
+	bool dtbo_read;
+};
+
+/**
+ * hb_dtbo_cache_init() - Set up a lookup for an FDT and an overlay
+ *
+ * The cache is only used if the dtbo_cache_dev and dtbo_cache_part
+ * variables name its storage.
+ *
+ * @cache:	Lookup to set up
+ * @blob:	FDT the overlay is to be applied to
+ * @fs:		Filesystem type of the overlay, e.g. "ext4"
+ * @dev:	Interface of the overlay's device, e.g. "mmc"
+ * @part:	Partition of the overlay, e.g. "0:c"
+ * @path:	Path of the overlay
+ * Return: 0 if OK, -ENOENT if there is no cache
+ */
+int hb_dtbo_cache_init(struct hb_dtbo_cache *cache, const void *blob,
+		       const char *fs, const char *dev, const char *part,
+		       const char *path);
+
+/**
+ * hb_dtbo_cache_load() - Replace an FDT with its cached merged copy
+ *
+ * This hits if the overlay is the one the cache was built from. The cache
+ * storage is only read, a hit never writes to it.
+ *
+ * @cache:	Lookup from hb_dtbo_cache_init()
+ * @blob:	FDT to replace, in a buffer as large as the overlay needs
+ * @dtbo:	Overlay as read from the filesystem
+ * @dtbo_size:	Size of @dtbo
+ * Return: 0 on a hit, -ve on a miss, @blob is then unchanged
+ */
+int hb_dtbo_cache_load(struct hb_dtbo_cache *cache, void *blob,
+		       const void *dtbo, loff_t dtbo_size);
+
+/**
+ * hb_dtbo_cache_store() - Store an FDT with the overlay applied
+ *
+ * @cache:	Lookup which missed, after a call with the overlay
+ * @blob:	FDT with the overlay applied
+ * Return: 0 if OK, -ve on error
+ */
+int hb_dtbo_cache_store(struct hb_dtbo_cache *cache, const void *blob);
+
+#endif /* __HB_DTBO_CACHE_H__ */
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright(C) 2024, D-Robotics Co., Ltd. All rights reserved
+ */
+
+#ifndef __HB_SDHCI_H__
+#define __HB_SDHCI_H__
+
+struct udevice;
+
+/**
+ * x5_sdhci_tuning_get() - Get the tuning result of an X5 SDHCI device
+ *
+ * A device initialised before the environment was loaded skipped the
+ * tuned bus modes, it is initialised again first so that it uses them.
+ *
+ * @dev:	MMC device
+ * @val:	Returns the value to keep in "mmc<N>_tuning"
+ * @len:	Size of @val
+ * Return: 0 if OK, -ENODEV if @dev is not an X5 SDHCI device, -ENOENT if
+ * it has not been tuned, other -ve on error
+ */
+int x5_sdhci_tuning_get(struct udevice *dev, char *val, int len);
+
+#endif /* __HB_SDHCI_H__ */
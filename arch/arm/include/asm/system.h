@@ -84,6 +84,13 @@
 #define HCR_EL2_HCD_DIS		(1 << 29) /* Hypervisor Call disabled         */
 #define HCR_EL2_AMO_EL2		(1 <<  5) /* Route SErrors to EL2             */
 
+/*
+ * ID_AA64ISAR0_EL1 bits definitions
+ */
+#define ID_AA64ISAR0_EL1_SHA2	(0xF << 12) /* SHA256 instructions            */
+#define ID_AA64ISAR0_EL1_SHA1	(0xF << 8)  /* SHA1 instructions              */
+#define ID_AA64ISAR0_EL1_AES	(0xF << 4)  /* AES instructions               */
+
 /*
  * ID_AA64ISAR1_EL1 bits definitions
  */
@@ -201,6 +208,15 @@ static inline unsigned long read_mpidr(void)
 	return val;
 }
 
+static inline unsigned long read_id_aa64isar0(void)
+{
+	unsigned long val;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (val));
+
+	return val;
+}
+
 #define BSP_COREID	0
 
 void __asm_flush_dcache_all(void);
@@ -650,6 +666,86 @@ int noncached_init(void);
 phys_addr_t noncached_alloc(size_t size, size_t align);
 #endif /* CONFIG_SYS_NONCACHED_MEMORY */
 
+#if defined(CONFIG_SYS_NONCACHED_MEMORY) || defined(CONFIG_SYS_NONCACHED_POOLS)
+/**
+ * enum noncached_type - Memory type of a non-cached pool
+ *
+ * @NONCACHED_UNCACHED:	Strongly ordered, as the region set up at init; only
+ *			naturally aligned accesses are allowed
+ * @NONCACHED_WC:	Write-combining (Normal non-cacheable on ARMv8), which
+ *			memcpy() and memset() can be used on
+ */
+enum noncached_type {
+	NONCACHED_UNCACHED,
+	NONCACHED_WC,
+};
+#endif
+
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+
+/**
+ * noncached_carve() - Add a non-cached pool at run time
+ *
+ * Take @size bytes, rounded up to whole pages, from the malloc() area and
+ * map them with the memory type @type. The page tables are split as needed
+ * and the board's mem_map is updated through mem_map_set_dcache().
+ *
+ * This is done by noncached_alloc_type() when it runs out of memory, so it
+ * is only needed to set up a pool of a known size ahead of time.
+ *
+ * @size:	Size of the pool in bytes
+ * @type:	Memory type of the pool
+ * Return: 0 if OK, -ENOMEM if the malloc() area is exhausted, -ENOSPC if
+ * there are too many pools
+ */
+int noncached_carve(size_t size, enum noncached_type type);
+
+/**
+ * noncached_alloc_type() - Allocate from the non-cached pools
+ *
+ * @size:	Size in bytes, rounded up to ARCH_DMA_MINALIGN
+ * @align:	Alignment of the returned address
+ * @type:	Memory type wanted
+ * Return: address of the memory, or 0 if there is none left
+ */
+phys_addr_t noncached_alloc_type(size_t size, size_t align,
+				 enum noncached_type type);
+
+/**
+ * noncached_free() - Give back memory from noncached_alloc_type()
+ *
+ * @addr:	Address returned by the allocation, may be 0
+ * @size:	Size passed to the allocation
+ */
+void noncached_free(phys_addr_t addr, size_t size);
+
+/**
+ * noncached_range() - Check if a buffer lies in a non-cached pool
+ *
+ * Drivers use this to skip cache maintenance for such buffers.
+ *
+ * @addr:	Start of the buffer
+ * @size:	Size of the buffer in bytes
+ * Return: true if the whole buffer is in one non-cached pool
+ */
+bool noncached_range(phys_addr_t addr, size_t size);
+
+/**
+ * mem_map_set_dcache() - Record a change of memory type in the mem_map
+ *
+ * Called when a non-cached pool is mapped, so that the board's list of
+ * memory regions matches the page tables. The default does nothing.
+ * Implementations must call smp_job_park() before changing the map.
+ *
+ * @start:	Start of the region
+ * @size:	Size of the region in bytes
+ * @option:	New dcache option of the region
+ * Return: 0 if OK, -ve on error
+ */
+int mem_map_set_dcache(phys_addr_t start, size_t size,
+		       enum dcache_option option);
+#endif /* CONFIG_SYS_NONCACHED_POOLS */
+
 #endif /* __ASSEMBLY__ */
 
 #endif
@@ -15,6 +15,7 @@
 #include <bootstage.h>
 #include <command.h>
 #include <cpu_func.h>
+#include <deferred.h>
 #include <dm.h>
 #include <log.h>
 #include <asm/global_data.h>
@@ -25,6 +26,7 @@
 #include <asm/byteorder.h>
 #include <linux/libfdt.h>
 #include <mapmem.h>
+#include <smp_job.h>
 #include <fdt_support.h>
 #include <asm/bootm.h>
 #include <asm/secure.h>
@@ -53,6 +55,11 @@ __weak void board_quiesce_devices(void)
  */
 static void announce_and_cleanup(int fake)
 {
+	/* Nothing queued by board code may outlive U-Boot */
+	deferred_flush();
+	/* The OS brings up the secondary CPUs itself */
+	smp_job_park();
+
 	bootstage_mark_name(BOOTSTAGE_ID_BOOTM_HANDOFF, "start_kernel");
 #ifdef CONFIG_BOOTSTAGE_FDT
 	bootstage_fdt_add_report();
@@ -414,6 +421,8 @@ void boot_prep_vxworks(bootm_headers_t *images)
 		}
 	}
 #endif
+	deferred_flush();
+	smp_job_park();
 	cleanup_before_linux();
 }
 void boot_jump_vxworks(bootm_headers_t *images)
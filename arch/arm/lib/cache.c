@@ -8,10 +8,12 @@
 
 #include <common.h>
 #include <cpu_func.h>
+#include <errno.h>
 #include <log.h>
 #include <malloc.h>
 #include <asm/cache.h>
 #include <asm/global_data.h>
+#include <linux/sizes.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -51,6 +53,12 @@ __weak void flush_dcache_range(unsigned long start, unsigned long stop)
 	/* An empty stub, real implementation should be in platform code */
 }
 
+__weak void memcpy_flush_dcache(void *dst, const void *src, size_t len)
+{
+	memcpy(dst, src, len);
+	flush_dcache_range((ulong)dst, (ulong)dst + len);
+}
+
 int check_cache_range(unsigned long start, unsigned long stop)
 {
 	int ok = 1;
@@ -69,24 +77,170 @@ int check_cache_range(unsigned long start, unsigned long stop)
 	return ok;
 }
 
-#ifdef CONFIG_SYS_NONCACHED_MEMORY
+#if defined(CONFIG_SYS_NONCACHED_MEMORY) || defined(CONFIG_SYS_NONCACHED_POOLS)
+/* Most pools noncached_carve() can add at run time, after the first one */
+#define NONCACHED_POOLS_MAX	16
+/* Free extents kept, a freed block which does not fit is leaked */
+#define NONCACHED_FREE_MAX	32
+/* Smallest pool carved from the malloc() area, in MMU pages */
+#define NONCACHED_CARVE_MIN	SZ_256K
+#define NONCACHED_PAGE_SIZE	SZ_4K
+
+struct noncached_region {
+	phys_addr_t start;
+	phys_addr_t end;
+	enum noncached_type type;
+};
+
 /*
- * Reserve one MMU section worth of address space below the malloc() area that
- * will be mapped uncached.
+ * With CONFIG_SYS_NONCACHED_MEMORY the first pool is one MMU section worth
+ * of address space below the malloc() area, mapped uncached. With
+ * CONFIG_SYS_NONCACHED_POOLS the others are carved from the malloc() area
+ * at run time.
  */
-static unsigned long noncached_start;
-static unsigned long noncached_end;
-static unsigned long noncached_next;
+static struct noncached_region noncached_pools[NONCACHED_POOLS_MAX + 1];
+static int noncached_pool_count;
+/* Free extents, sorted by address */
+static struct noncached_region noncached_free_list[NONCACHED_FREE_MAX];
+static int noncached_free_count;
 
-void noncached_set_region(void)
+static enum dcache_option noncached_option(enum noncached_type type)
+{
+	/*
+	 * Write-combining pools only exist on ARMv8, where DCACHE_OFF is
+	 * Device-nGnRnE and DCACHE_WRITETHROUGH is Normal non-cacheable
+	 */
+	if (IS_ENABLED(CONFIG_SYS_NONCACHED_POOLS) && type == NONCACHED_WC)
+		return DCACHE_WRITETHROUGH;
+
+	return DCACHE_OFF;
+}
+
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+__weak int mem_map_set_dcache(phys_addr_t start, size_t size,
+			      enum dcache_option option)
+{
+	return 0;
+}
+#endif
+
+static void noncached_map(struct noncached_region *pool)
 {
 #if !CONFIG_IS_ENABLED(SYS_DCACHE_OFF)
-	mmu_set_region_dcache_behaviour(noncached_start,
-					noncached_end - noncached_start,
-					DCACHE_OFF);
+	enum dcache_option option = noncached_option(pool->type);
+	size_t size = pool->end - pool->start;
+
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+	if (mem_map_set_dcache(pool->start, size, option))
+		debug("mem_map has no room for %pa\n", &pool->start);
+#endif
+	mmu_set_region_dcache_behaviour(pool->start, size, option);
 #endif
 }
 
+static void noncached_free_del(int i)
+{
+	noncached_free_count--;
+	memmove(&noncached_free_list[i], &noncached_free_list[i + 1],
+		(noncached_free_count - i) * sizeof(noncached_free_list[0]));
+}
+
+static void noncached_free_add(phys_addr_t start, phys_addr_t end,
+			       enum noncached_type type)
+{
+	struct noncached_region *ext;
+	int i;
+
+	for (i = 0; i < noncached_free_count; i++) {
+		if (noncached_free_list[i].start >= end)
+			break;
+	}
+
+	/* Merge with the neighbours where the memory type allows */
+	if (i && noncached_free_list[i - 1].end == start &&
+	    noncached_free_list[i - 1].type == type) {
+		ext = &noncached_free_list[i - 1];
+		ext->end = end;
+		if (i < noncached_free_count &&
+		    noncached_free_list[i].start == end &&
+		    noncached_free_list[i].type == type) {
+			ext->end = noncached_free_list[i].end;
+			noncached_free_del(i);
+		}
+		return;
+	}
+	if (i < noncached_free_count && noncached_free_list[i].start == end &&
+	    noncached_free_list[i].type == type) {
+		noncached_free_list[i].start = start;
+		return;
+	}
+
+	if (noncached_free_count == NONCACHED_FREE_MAX) {
+		debug("leaking %pa of non-cached memory\n", &start);
+		return;
+	}
+	memmove(&noncached_free_list[i + 1], &noncached_free_list[i],
+		(noncached_free_count - i) * sizeof(noncached_free_list[0]));
+	noncached_free_count++;
+	ext = &noncached_free_list[i];
+	ext->start = start;
+	ext->end = end;
+	ext->type = type;
+}
+
+static struct noncached_region *noncached_add_pool(phys_addr_t start,
+						   size_t size,
+						   enum noncached_type type)
+{
+	struct noncached_region *pool;
+
+	pool = &noncached_pools[noncached_pool_count++];
+	pool->start = start;
+	pool->end = start + size;
+	pool->type = type;
+	noncached_map(pool);
+	noncached_free_add(pool->start, pool->end, type);
+
+	return pool;
+}
+
+void noncached_set_region(void)
+{
+	int i;
+
+	for (i = 0; i < noncached_pool_count; i++)
+		noncached_map(&noncached_pools[i]);
+}
+
+static phys_addr_t noncached_take(size_t size, size_t align,
+				  enum noncached_type type)
+{
+	struct noncached_region *ext;
+	phys_addr_t next, end;
+	int i;
+
+	for (i = 0; i < noncached_free_count; i++) {
+		ext = &noncached_free_list[i];
+		next = ALIGN(ext->start, align);
+		if (ext->type != type || next >= ext->end ||
+		    ext->end - next < size)
+			continue;
+
+		end = ext->end;
+		if (next == ext->start)
+			noncached_free_del(i);
+		else
+			ext->end = next;
+		if (next + size < end)
+			noncached_free_add(next + size, end, type);
+
+		return next;
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_SYS_NONCACHED_MEMORY
 int noncached_init(void)
 {
 	phys_addr_t start, end;
@@ -99,28 +253,99 @@ int noncached_init(void)
 
 	debug("mapping memory %pa-%pa non-cached\n", &start, &end);
 
-	noncached_start = start;
-	noncached_end = end;
-	noncached_next = start;
-
-	noncached_set_region();
+	noncached_add_pool(start, size, NONCACHED_UNCACHED);
 
 	return 0;
 }
 
 phys_addr_t noncached_alloc(size_t size, size_t align)
 {
-	phys_addr_t next = ALIGN(noncached_next, align);
+	phys_addr_t next;
+
+	next = noncached_take(ALIGN(size, ARCH_DMA_MINALIGN), align,
+			      NONCACHED_UNCACHED);
+	if (next)
+		debug("allocated %zu bytes of uncached memory @%pa\n", size,
+		      &next);
+
+	return next;
+}
+#endif /* CONFIG_SYS_NONCACHED_MEMORY */
+
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+int noncached_carve(size_t size, enum noncached_type type)
+{
+	void *buf;
+
+	if (noncached_pool_count > NONCACHED_POOLS_MAX)
+		return -ENOSPC;
 
-	if (next >= noncached_end || (noncached_end - next) < size)
+	/*
+	 * Whole pages, so that no cached data, e.g. a malloc() header, shares
+	 * a mapping with the pool
+	 */
+	size = ALIGN(size, NONCACHED_PAGE_SIZE);
+	buf = memalign(NONCACHED_PAGE_SIZE, size);
+	if (!buf)
+		return -ENOMEM;
+
+	debug("carving %zu bytes of %s memory @%p\n", size,
+	      type == NONCACHED_WC ? "write-combining" : "uncached", buf);
+	noncached_add_pool((phys_addr_t)buf, size, type);
+
+	return 0;
+}
+
+phys_addr_t noncached_alloc_type(size_t size, size_t align,
+				 enum noncached_type type)
+{
+	phys_addr_t next;
+
+	size = ALIGN(size, ARCH_DMA_MINALIGN);
+	next = noncached_take(size, align, type);
+	if (!next && !noncached_carve(max_t(size_t, size + align,
+					    NONCACHED_CARVE_MIN), type))
+		next = noncached_take(size, align, type);
+	if (!next)
 		return 0;
 
-	debug("allocated %zu bytes of uncached memory @%pa\n", size, &next);
-	noncached_next = next + size;
+	debug("allocated %zu bytes of non-cached memory @%pa\n", size, &next);
 
 	return next;
 }
-#endif /* CONFIG_SYS_NONCACHED_MEMORY */
+
+void noncached_free(phys_addr_t addr, size_t size)
+{
+	int i;
+
+	if (!addr)
+		return;
+
+	size = ALIGN(size, ARCH_DMA_MINALIGN);
+	for (i = 0; i < noncached_pool_count; i++) {
+		if (addr >= noncached_pools[i].start &&
+		    addr < noncached_pools[i].end) {
+			noncached_free_add(addr, addr + size,
+					   noncached_pools[i].type);
+			return;
+		}
+	}
+}
+
+bool noncached_range(phys_addr_t addr, size_t size)
+{
+	int i;
+
+	for (i = 0; i < noncached_pool_count; i++) {
+		if (addr >= noncached_pools[i].start &&
+		    addr + size <= noncached_pools[i].end)
+			return true;
+	}
+
+	return false;
+}
+#endif /* CONFIG_SYS_NONCACHED_POOLS */
+#endif /* CONFIG_SYS_NONCACHED_MEMORY || CONFIG_SYS_NONCACHED_POOLS */
 
 #if CONFIG_IS_ENABLED(SYS_THUMB_BUILD)
 void invalidate_l2_cache(void)
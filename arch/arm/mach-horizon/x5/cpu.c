@@ -4,12 +4,18 @@
  */
 
 #include <common.h>
+#include <errno.h>
+#include <smp_job.h>
 #include <asm/io.h>
+#include <asm/system.h>
 #include <asm/armv8/mmu.h>
 #include <asm/arch/hardware.h>
 #include <asm/arch/hb_aon.h>
 
-static struct mm_region x5_mem_map[] = {
+/* Entries left for non-cached pools, each one may split a region in three */
+#define X5_MEM_MAP_SPARE	(2 * 8)
+
+static struct mm_region x5_mem_map[4 + X5_MEM_MAP_SPARE] = {
 	{
 		.virt = PHYS_SDRAM_1,
 		.phys = PHYS_SDRAM_1,
@@ -42,6 +48,56 @@ static struct mm_region x5_mem_map[] = {
 
 struct mm_region *mem_map = x5_mem_map;
 
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+int mem_map_set_dcache(phys_addr_t start, size_t size,
+		       enum dcache_option option)
+{
+	struct mm_region *map, *end;
+	u64 attrs, head, tail;
+	int n;
+
+	/* Secondary CPUs must not run while the memory map changes */
+	smp_job_park();
+
+	for (map = x5_mem_map; map->size; map++) {
+		if (start >= map->phys && start + size <= map->phys + map->size)
+			break;
+	}
+	if (!map->size)
+		return -ENOENT;
+
+	attrs = (map->attrs & ~PMD_ATTRINDX_MASK) |
+		PMD_ATTRINDX(option >> 2);
+	head = start - map->phys;
+	tail = map->phys + map->size - (start + size);
+	n = !!head + !!tail;
+
+	/* Keep the terminator */
+	for (end = map; end->size; end++)
+		;
+	if (end + n >= x5_mem_map + ARRAY_SIZE(x5_mem_map))
+		return -ENOSPC;
+
+	memmove(map + n, map, (end + 1 - map) * sizeof(*map));
+	if (head) {
+		map->size = head;
+		map++;
+	}
+	map->virt = start;
+	map->phys = start;
+	map->size = size;
+	map->attrs = attrs;
+	if (tail) {
+		map++;
+		map->virt = start + size;
+		map->phys = start + size;
+		map->size = tail;
+	}
+
+	return 0;
+}
+#endif
+
 int arch_cpu_init(void)
 {
 	/* Nothing to do */
@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Copyright(C) 2024, D-Robotics Co., Ltd. All rights reserved
+ *
+ * On-flash cache of the FDT with the dtbo overlay applied.
+ *
+ * The cache storage holds a header in its first HB_DTBO_CACHE_HDR_SIZE bytes
+ * followed by the merged FDT. It is always read and written from offset 0 so
+ * that a raw partition and a UBI volume can be handled the same way.
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <env.h>
+#include <errno.h>
+#include <fdt_support.h>
+#include <log.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <part.h>
+#include <ubi_uboot.h>
+#include <asm/cache.h>
+#include <asm/arch/hb_dtbo_cache.h>
+#include <linux/libfdt.h>
+#include <linux/sizes.h>
+
+#define HB_DTBO_CACHE_MAGIC	0x48424443	/* "HBDC" */
+#define HB_DTBO_CACHE_VERSION	2
+#define HB_DTBO_CACHE_HDR_SIZE	SZ_4K
+#define HB_DTBO_CACHE_MAX	SZ_1M
+
+struct hb_dtbo_cache_hdr {
+	u32 magic;
+	u32 version;
+	u32 fdt_size;
+	u32 reserved;
+	struct hb_dtbo_key key;
+	u8 fdt_hash[SHA256_SUM_LEN];
+};
+
+static bool hb_dtbo_cache_is_ubi(struct hb_dtbo_cache *cache)
+{
+	return IS_ENABLED(CONFIG_CMD_UBI) && !strcmp(cache->dev, "ubi");
+}
+
+static int hb_dtbo_cache_blk(struct hb_dtbo_cache *cache,
+			     struct blk_desc **desc, struct disk_partition *info)
+{
+	int ret;
+
+	ret = part_get_info_by_dev_and_name_or_num(cache->dev, cache->part,
+						   desc, info, 0);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+/* Read @size bytes from the start of the cache storage */
+static int hb_dtbo_cache_read(struct hb_dtbo_cache *cache, void *buf,
+			      size_t size)
+{
+	struct disk_partition info;
+	struct blk_desc *desc;
+	lbaint_t cnt;
+	int ret;
+
+	if (hb_dtbo_cache_is_ubi(cache))
+		return ubi_volume_read((char *)cache->part, buf, size) ?
+			-EIO : 0;
+
+	ret = hb_dtbo_cache_blk(cache, &desc, &info);
+	if (ret)
+		return ret;
+
+	cnt = DIV_ROUND_UP(size, desc->blksz);
+	if (cnt > info.size)
+		return -ENOSPC;
+	if (blk_dread(desc, info.start, cnt, buf) != cnt)
+		return -EIO;
+
+	return 0;
+}
+
+/* Write @size bytes to the start of the cache storage */
+static int hb_dtbo_cache_write(struct hb_dtbo_cache *cache, void *buf,
+			       size_t size)
+{
+	struct disk_partition info;
+	struct blk_desc *desc;
+	lbaint_t cnt;
+	int ret;
+
+	if (hb_dtbo_cache_is_ubi(cache))
+		return ubi_volume_write((char *)cache->part, buf, size) ?
+			-EIO : 0;
+
+	ret = hb_dtbo_cache_blk(cache, &desc, &info);
+	if (ret)
+		return ret;
+
+	cnt = DIV_ROUND_UP(size, desc->blksz);
+	if (cnt > info.size)
+		return -ENOSPC;
+	if (blk_dwrite(desc, info.start, cnt, buf) != cnt)
+		return -EIO;
+
+	return 0;
+}
+
+/* Buffer for @size bytes, padded to whole blocks of the cache storage */
+static void *hb_dtbo_cache_buf(struct hb_dtbo_cache *cache, size_t size)
+{
+	struct disk_partition info;
+	struct blk_desc *desc;
+
+	if (!hb_dtbo_cache_is_ubi(cache)) {
+		if (hb_dtbo_cache_blk(cache, &desc, &info))
+			return NULL;
+		size = roundup(size, desc->blksz);
+	}
+
+	return memalign(ARCH_DMA_MINALIGN, size);
+}
+
+int hb_dtbo_cache_init(struct hb_dtbo_cache *cache, const void *blob,
+		       const char *fs, const char *dev, const char *part,
+		       const char *path)
+{
+	struct fdt_header fh;
+	sha256_context ctx;
+	ulong addr;
+
+	memset(cache, 0, sizeof(*cache));
+
+	cache->dev = env_get("dtbo_cache_dev");
+	cache->part = env_get("dtbo_cache_part");
+	if (!cache->dev || !cache->part)
+		return -ENOENT;
+
+	/*
+	 * The size is left out since fdt_shrink_to_minimum() replaces it, the
+	 * address is in since the reserved-memory entry of the FDT follows it.
+	 */
+	memcpy(&fh, blob, sizeof(fh));
+	fh.totalsize = 0;
+	addr = map_to_sysmem(blob);
+
+	sha256_starts(&ctx);
+	sha256_update(&ctx, (const u8 *)&fh, sizeof(fh));
+	sha256_update(&ctx, (const u8 *)blob + sizeof(fh),
+		      fdt_off_dt_strings(blob) + fdt_size_dt_strings(blob) -
+		      sizeof(fh));
+	sha256_update(&ctx, (const u8 *)&addr, sizeof(addr));
+	sha256_finish(&ctx, cache->key.base_hash);
+
+	sha256_starts(&ctx);
+	sha256_update(&ctx, (const u8 *)fs, strlen(fs) + 1);
+	sha256_update(&ctx, (const u8 *)dev, strlen(dev) + 1);
+	sha256_update(&ctx, (const u8 *)part, strlen(part) + 1);
+	sha256_update(&ctx, (const u8 *)path, strlen(path) + 1);
+	sha256_finish(&ctx, cache->key.src_hash);
+
+	return 0;
+}
+
+static bool hb_dtbo_cache_match(struct hb_dtbo_cache *cache,
+				struct hb_dtbo_cache_hdr *hdr)
+{
+	struct hb_dtbo_key *key = &cache->key;
+
+	if (hdr->magic != HB_DTBO_CACHE_MAGIC ||
+	    hdr->version != HB_DTBO_CACHE_VERSION ||
+	    hdr->fdt_size > HB_DTBO_CACHE_MAX)
+		return false;
+
+	return !memcmp(hdr->key.base_hash, key->base_hash, SHA256_SUM_LEN) &&
+	       !memcmp(hdr->key.src_hash, key->src_hash, SHA256_SUM_LEN) &&
+	       hdr->key.dtbo_size == key->dtbo_size &&
+	       !memcmp(hdr->key.dtbo_hash, key->dtbo_hash, SHA256_SUM_LEN);
+}
+
+int hb_dtbo_cache_load(struct hb_dtbo_cache *cache, void *blob,
+		       const void *dtbo, loff_t dtbo_size)
+{
+	struct hb_dtbo_cache_hdr hdr;
+	u8 hash[SHA256_SUM_LEN];
+	size_t size;
+	void *fdt;
+	void *buf;
+	int ret;
+
+	sha256_csum_wd(dtbo, dtbo_size, cache->key.dtbo_hash, CHUNKSZ_SHA256);
+	cache->key.dtbo_size = dtbo_size;
+	cache->dtbo_read = true;
+
+	buf = hb_dtbo_cache_buf(cache, HB_DTBO_CACHE_HDR_SIZE);
+	if (!buf)
+		return -ENOMEM;
+	ret = hb_dtbo_cache_read(cache, buf, HB_DTBO_CACHE_HDR_SIZE);
+	memcpy(&hdr, buf, sizeof(hdr));
+	free(buf);
+	if (ret)
+		return ret;
+	if (!hb_dtbo_cache_match(cache, &hdr))
+		return -ESTALE;
+
+	size = HB_DTBO_CACHE_HDR_SIZE + hdr.fdt_size;
+	buf = hb_dtbo_cache_buf(cache, size);
+	if (!buf)
+		return -ENOMEM;
+	ret = hb_dtbo_cache_read(cache, buf, size);
+	if (ret)
+		goto out;
+
+	fdt = buf + HB_DTBO_CACHE_HDR_SIZE;
+	sha256_csum_wd(fdt, hdr.fdt_size, hash, CHUNKSZ_SHA256);
+	if (memcmp(hash, hdr.fdt_hash, SHA256_SUM_LEN) ||
+	    fdt_check_header(fdt) || fdt_totalsize(fdt) != hdr.fdt_size) {
+		ret = -EILSEQ;
+		goto out;
+	}
+
+	/* Same base FDT and overlay size, so the same size as when stored */
+	if (fdt_shrink_to_minimum(blob, hdr.key.dtbo_size) != hdr.fdt_size) {
+		ret = -ESTALE;
+		goto out;
+	}
+	memcpy(blob, fdt, hdr.fdt_size);
+
+out:
+	free(buf);
+
+	return ret;
+}
+
+int hb_dtbo_cache_store(struct hb_dtbo_cache *cache, const void *blob)
+{
+	struct hb_dtbo_cache_hdr hdr;
+	size_t size;
+	void *buf;
+	int ret;
+
+	if (!cache->dtbo_read)
+		return -EINVAL;
+	if (fdt_totalsize(blob) > HB_DTBO_CACHE_MAX)
+		return -E2BIG;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = HB_DTBO_CACHE_MAGIC;
+	hdr.version = HB_DTBO_CACHE_VERSION;
+	hdr.fdt_size = fdt_totalsize(blob);
+	hdr.key = cache->key;
+	sha256_csum_wd(blob, hdr.fdt_size, hdr.fdt_hash, CHUNKSZ_SHA256);
+
+	size = HB_DTBO_CACHE_HDR_SIZE + hdr.fdt_size;
+	buf = hb_dtbo_cache_buf(cache, size);
+	if (!buf)
+		return -ENOMEM;
+
+	memset(buf, 0, HB_DTBO_CACHE_HDR_SIZE);
+	memcpy(buf, &hdr, sizeof(hdr));
+	memcpy(buf + HB_DTBO_CACHE_HDR_SIZE, blob, hdr.fdt_size);
+	ret = hb_dtbo_cache_write(cache, buf, size);
+	free(buf);
+
+	return ret;
+}
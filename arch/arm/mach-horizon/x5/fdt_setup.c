@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  */
 #include <common.h>
+#include <bootstage.h>
 #include <dm.h>
 #include <errno.h>
 #include <malloc.h>
@@ -41,6 +42,7 @@
 #include <asm/arch/hb_strappin.h>
 #ifdef CONFIG_OF_LIBFDT_OVERLAY
 #include <fs.h>
+#include <asm/arch/hb_dtbo_cache.h>
 #endif
 
 #ifdef CONFIG_CONSOLE_RECORD
@@ -114,426 +116,338 @@ static void fdt_set_status_by_env(void *fdt_blob)
 	}
 }
 
-static void check_cpu_1_8g_support(void *fdt)
+#define DDR_SIZE_2GB ((uint64_t)2 * SZ_1G)
+#define ION_MIN_SIZE (0x4000000)  /* 64 MiB */
+/* Every ION region gives up this much at a time when DDR is too small */
+#define ION_SHRINK_STEP (100 * SZ_1M)
+
+#define HB_HPS_CLK_PATH "/soc/hps-clock-controller@34210000"
+
+enum hb_ion_kind {
+	HB_ION_RESERVED,
+	HB_ION_CARVEOUT,
+	HB_ION_CMA,
+	HB_ION_COUNT,
+};
+
+static const struct {
+	const char *name;
+	const char *env;
+	const char *compatible;
+	const char *what;
+	uint64_t def_size;
+} hb_ion_regions[HB_ION_COUNT] = {
+	[HB_ION_RESERVED] = { ION_RESERVED_NAME, "ion_reserved_size", "ion-pool",
+			      "Reserved carveout", RDK_DEFAULT_ION_RESERVED_SIZE },
+	[HB_ION_CARVEOUT] = { ION_CARVEOUT_NAME, "ion_carveout_size",
+			      "ion-carveout", "Carveout",
+			      RDK_DEFAULT_ION_CARVEOUT_SIZE },
+	[HB_ION_CMA] = { ION_CMA_NAME, "ion_cma_size", "ion-cma", "Reserve",
+			 RDK_DEFAULT_ION_CMA_SIZE },
+};
+
+/*
+ * Everything ft_board_setup() works out from the DDR size, the environment
+ * and the efuse, so that the blob is patched in a single pass.
+ */
+struct hb_fdt_plan {
+	u64 ion_start[HB_ION_COUNT];
+	u64 ion_size[HB_ION_COUNT];
+	/* cpu-opp-table-N to enable, -1 if the efuse could not be read */
+	int opp_table;
+	u32 pll_table;
+	/* Point every CPU at opp_table */
+	bool opp_cpus;
+	bool qspi_boot;
+};
+
+static int hb_opp_efuse(u32 *efuse)
 {
-        int offs, ret;
-        int enable;
-        int efuse;
-        int i;
-        char node[128] = {0};
-
-        enable = env_get_yesno("enable_cpu_18g");
-
-        /* enable opp table according to efuse info */
-        ret = hb_read_efuse(EFUSE_CPU_OPPTABLE_OFFSET, 4, (char *)&efuse);
-        if (ret) {
-            printf("read efuse cpu type failed\n");
-            return;
-        }
-        efuse &= EFUSE_CPU_OPPTABLE_MASK;
-        efuse = (efuse >> EFUSE_CPU_OPPTABLE_BIT);
-
-        /* update pll table if 1.8G supported */
-        if (enable && efuse == 0) {
-                /* enable corresponding opp table */
-                memset(node, 0, sizeof(node));
-                sprintf(node, "/cpu-opp-table-%d/", efuse);
-                offs = fdt_path_offset(fdt, node);
-                if (offs < 0) {
-                        printf("failed to get sub_node!");
-                        return;
-                }
-
-                ret = fdt_setprop_string(fdt, offs, "status", "okay");
-                if (ret < 0) {
-                        printf("failed to update cpu opp node status!");
-                        return;
-                }
-
-                /* enable pll table for 1.8G support */
-                offs = fdt_path_offset(fdt, "/soc/hps-clock-controller@34210000");
-                if (offs < 0) {
-                        printf("failed to get hps clock node!");
-                        return;
-                }
-                ret = fdt_setprop_u32(fdt, offs, "pll-table", 1);
-                if (ret < 0) {
-                        printf("failed to update cpu opp node status!");
-                        return;
-                }
-                printf("%s CPU 1.8G!\n", enable ? "enable" : "disable");
-        } else {
-                char opp_node[128] = {0};
-                int opp_offs;
-                u32 phandle;
-
-                // TODO: remove hardcode after efuse burned
-                efuse = 1;
-                /* enable pll table for 1.8G support */
-                opp_offs = fdt_path_offset(fdt, "/soc/hps-clock-controller@34210000");
-                if (opp_offs < 0) {
-                        printf("failed to get hps clock node!");
-                        return;
-                }
-                ret = fdt_setprop_u32(fdt, opp_offs, "pll-table", 0);
-                if (ret < 0) {
-                        printf("failed to update cpu opp node status!");
-                        return;
-                }
-                /* enable corresponding opp table */
-                memset(opp_node, 0, sizeof(opp_node));
-                sprintf(opp_node, "/cpu-opp-table-%d/", efuse);
-                //printf("opp_node: %s\n", opp_node);
-
-                opp_offs = fdt_path_offset(fdt, opp_node);
-                if (opp_offs < 0) {
-                        printf("failed to get opp_node!");
-                        return;
-                }
-
-                ret = fdt_setprop_string(fdt, opp_offs, "status", "okay");
-                if (ret < 0) {
-                        printf("failed to update cpu opp node status!");
-                        return;
-                }
-
-                /* create phandle */
-                phandle = fdt_get_phandle(fdt, opp_offs);
-                if (phandle == 0) {
-                        int ret;
-
-                        ret = fdt_generate_phandle(fdt, &phandle);
-                        if (ret < 0) {
-                                printf("Can't generate phandle: %s\n", fdt_strerror(ret));
-                                return;
-                        }
-
-                        ret = fdt_set_phandle(fdt, opp_offs, phandle);
-                        if (ret < 0) {
-                                printf("Can't set phandle %u: %s\n", phandle, fdt_strerror(ret));
-                                return;
-                        }
-                }
-                /* update each cpu opp with new phandle */
-                for (i = 0; i < MAX_CPU; i++) {
-                        memset(node, 0, sizeof(node));
-                        sprintf(node, "/cpus/cpu@%d", i);
-                        //printf("node: %s\n", node);
-
-                        offs = fdt_path_offset(fdt, node);
-                        if (offs < 0) {
-                                printf("failed to get cpu opp node!");
-                                return;
-                        }
-
-                        ret = fdt_setprop_u32(fdt, offs, "operating-points-v2", phandle);
-                        if (ret < 0) {
-                                printf("failed to update cpu opp node status!");
-                                return;
-                        }
-                }
-        }
+	int ret;
+
+	ret = hb_read_efuse(EFUSE_CPU_OPPTABLE_OFFSET, 4, (char *)efuse);
+	if (ret)
+		printf("read efuse cpu type failed\n");
+
+	return ret;
 }
 
-int hb_set_ion_cma_size(void *blob, u64 size, const char *name, u64 start, u64 range_size)
+static uint64_t hb_ion_size_validate(uint64_t val, uint64_t max)
 {
-	int rsv_offset, nodeoffset;
-	u32 dma_ranges[4];
-	int ret;
+	/*
+	 * The ion heap size should be ION_MIN_SIZE at least,
+	 * also it should be the multiple of ION_MIN_SIZE.
+	 */
+	val = (val > 0) ? roundup(val, ION_MIN_SIZE) : ION_MIN_SIZE;
 
-	rsv_offset = fdt_find_or_add_subnode(blob, 0, "reserved-memory");
-	if (rsv_offset < 0) {
-		/*
-		 * Not found or something else bad happened.
-		 */
-		log_err("%s: libfdt fdt_find_or_add_subnode() returned %s\n", __func__,
-			fdt_strerror(rsv_offset));
-		return 1;
-	}
-	nodeoffset = fdt_find_or_add_subnode(blob, rsv_offset, name);
-	if (nodeoffset < 0) {
-		/*
-		 * Not found or something else bad happened.
-		 */
-		log_err("%s: libfdt fdt_find_or_add_subnode() returned %s\n", __func__,
-			fdt_strerror(nodeoffset));
-		return 1;
-	}
+	//if (val > max)
+		//pr_alert("CAUTION: Expanding ION region to larger than default!\n");
 
-	ret = fdt_setprop_u64(blob, nodeoffset, "size", size);
-	if (ret < 0) {
-		log_err("%s: setup ion_cma memory_size(): %s\n", __func__,
-			fdt_strerror(ret));
-		return 1;
-	}
+	return val;
+}
 
-	if (size == 0) {
-		ret = fdt_setprop_string(blob, nodeoffset, "status", "disabled");
-		if (ret < 0) {
-			log_err("%s: setup status failed: %s\n", __func__,
-				fdt_strerror(ret));
-			return 1;
+/*
+ * Take whole ION_SHRINK_STEPs off every region that is left until the
+ * total fits, working out the number of steps rather than trying each one
+ */
+static void hb_ion_shrink(uint64_t *size, const uint64_t ddr_size)
+{
+	uint64_t limit = ddr_size - DEFAULT_ION_REGION_START -
+			 DEFAULT_KERNEL_MIN_HEAP;
+	uint64_t total, excess, steps;
+	bool printed = false;
+	int i, left;
+
+	for (;;) {
+		total = 0;
+		left = 0;
+		for (i = 0; i < HB_ION_COUNT; i++) {
+			total += size[i];
+			left += !!size[i];
 		}
-	}
+		if (total <= limit || !left)
+			return;
 
-	ret = fdt_setprop_string(blob, nodeoffset, "compatible", "ion-cma");
-	if (ret < 0) {
-		log_err("%s: setup compatible failed: %s\n", __func__,
-			fdt_strerror(ret));
-		return 1;
+		if (!printed) {
+			pr_err("ION Total size exceeds DDR total size, shrinking!\n");
+			printed = true;
+		}
+		excess = total - limit;
+		steps = DIV_ROUND_UP(excess, left * ION_SHRINK_STEP);
+		for (i = 0; i < HB_ION_COUNT; i++)
+			size[i] -= min(size[i], steps * ION_SHRINK_STEP);
 	}
+}
 
-	ret = fdt_setprop_u64(blob, nodeoffset, "alignment", 0x2000);
-	if (ret < 0) {
-		log_err("%s: setup alignment failed: %s\n", __func__,
-			fdt_strerror(ret));
-		return 1;
-	}
+static uint64_t hb_ddr_size(void)
+{
+	uint64_t ddr_size = ((uint64_t)4 * SZ_1G);
 
-	ret = fdt_setprop_empty(blob, nodeoffset, "reusable");
-	if (ret < 0) {
-		log_err("%s: setup reusable failed: %s\n", __func__,
-			fdt_strerror(ret));
-		return 1;
-	}
+#ifdef CONFIG_NR_DRAM_BANKS
+	{
+		int i;
+		phys_size_t size = 0;
 
-	dma_ranges[0] =	cpu_to_fdt32((start >> 32) & 0xffffffff);
-	dma_ranges[1] =	cpu_to_fdt32(start & 0xffffffff);
-	dma_ranges[2] =	cpu_to_fdt32((size >> 32) & 0xffffffff);
-	dma_ranges[3] =	cpu_to_fdt32(size & 0xffffffff);
-	ret = fdt_setprop(blob, nodeoffset, "reg", &dma_ranges[0],
-			sizeof(dma_ranges));
-	if (ret < 0) {
-		log_err("%s: setup reusable failed: %s\n", __func__,
-			fdt_strerror(ret));
-		return 1;
+		for (i = 0; i < CONFIG_NR_DRAM_BANKS; ++i)
+			size += gd->bd->bi_dram[i].size;
+
+		/* X5 stores bi_dram[x].size with reserved_size removed */
+		ddr_size = (size + DDR_RESERVED_SIZE);
 	}
+#endif
+	/* TODO: Handle the case where ECC is enabled
+	 * and ion regions must be shrinked.
+	 */
 
-	log_info("Set Reserve Mem [%s] Size to 0x%016llx @0x%llx\n", name, size, start);
+	return ddr_size;
+}
 
-	return 0;
+static unsigned int get_boot_src(void)
+{
+	unsigned int ustrap_pin_info = readl(BOOT_STRAP_PIN_REG);
+        return ((ustrap_pin_info & BOOT_MODE_MASK) >> BOOT_MODE_SHIFT);
 }
 
-int hb_set_ion_reserved_size(void *blob, u64 size, const char *name, u64 start, u64 range_size)
+static void hb_fdt_plan_build(struct hb_fdt_plan *plan, uint64_t ddr_size,
+			      int efuse_ret, u32 efuse)
 {
-	int rsv_offset, nodeoffset;
-	u32 dma_ranges[4];
-	int ret;
+	unsigned int boot_src = get_boot_src();
+	uint64_t offset;
+	int i;
 
-	rsv_offset = fdt_find_or_add_subnode(blob, 0, "reserved-memory");
-	if (rsv_offset < 0) {
-		/*
-		 * Not found or something else bad happened.
-		 */
-		log_err("%s: libfdt fdt_find_or_add_subnode() returned %s\n", __func__,
-			fdt_strerror(rsv_offset));
-		return 1;
+	log_debug("%s: Get ddr_size:%lld\n", __func__, ddr_size);
+	for (i = 0; i < HB_ION_COUNT; i++) {
+		plan->ion_size[i] = env_get_ulong(hb_ion_regions[i].env, 16,
+						  hb_ion_regions[i].def_size);
+		log_debug("Get %s, env:%#llx, default:%#llx\n",
+			  hb_ion_regions[i].env, plan->ion_size[i],
+			  hb_ion_regions[i].def_size);
+		plan->ion_size[i] = hb_ion_size_validate(plan->ion_size[i],
+						hb_ion_regions[i].def_size);
 	}
+	hb_ion_shrink(plan->ion_size, ddr_size);
 
-	nodeoffset = fdt_find_or_add_subnode(blob, rsv_offset, name);
-	if (nodeoffset < 0) {
-		/*
-		 * Not found or something else bad happened.
-		 */
-		log_err("%s: libfdt fdt_find_or_add_subnode() returned %s\n", __func__,
-			fdt_strerror(nodeoffset));
-		return 1;
+	offset = DEFAULT_ION_REGION_START;
+	for (i = 0; i < HB_ION_COUNT; i++) {
+		plan->ion_start[i] = gd->bd->bi_dram[0].start + offset;
+		offset += plan->ion_size[i];
 	}
 
-	ret = fdt_setprop_u64(blob, nodeoffset, "size", size);
-	if (ret < 0) {
-		log_err("%s: setup ion_reserved memory_size(): %s\n", __func__,
-			fdt_strerror(ret));
-		return 1;
-	}
+	plan->qspi_boot = boot_src == BOOT_SRC_QSPI_NOR ||
+			  boot_src == BOOT_SRC_QSPI_NAND;
 
-	ret = fdt_setprop_string(blob, nodeoffset, "compatible", "ion-pool");
-	if (ret < 0) {
-		log_err("%s: setup compatible failed: %s\n", __func__,
-			fdt_strerror(ret));
-		return 1;
+	/* enable opp table according to efuse info */
+	if (efuse_ret) {
+		plan->opp_table = -1;
+	} else {
+		efuse &= EFUSE_CPU_OPPTABLE_MASK;
+		efuse >>= EFUSE_CPU_OPPTABLE_BIT;
+		/* Enabled unless set to no, env_get_yesno() is -1 when unset */
+		if (env_get_yesno("enable_cpu_18g") && efuse == 0) {
+			/* pll table for 1.8G support */
+			plan->opp_table = efuse;
+			plan->pll_table = 1;
+			plan->opp_cpus = false;
+		} else {
+			// TODO: remove hardcode after efuse burned
+			plan->opp_table = 1;
+			plan->pll_table = 0;
+			plan->opp_cpus = true;
+		}
 	}
+}
 
-	dma_ranges[0] =	cpu_to_fdt32((start >> 32) & 0xffffffff);
-	dma_ranges[1] =	cpu_to_fdt32(start & 0xffffffff);
-	dma_ranges[2] =	cpu_to_fdt32((size >> 32) & 0xffffffff);
-	dma_ranges[3] =	cpu_to_fdt32(size & 0xffffffff);
-	ret = fdt_setprop(blob, nodeoffset, "reg", &dma_ranges[0],
-			sizeof(dma_ranges));
-	if (ret < 0) {
-		log_err("%s: setup reusable failed: %s\n", __func__,
-			fdt_strerror(ret));
-		return 1;
-	}
+static int hb_fdt_set_reg(void *blob, int node, u64 start, u64 size)
+{
+	fdt32_t reg[4];
 
-	log_info("Set Reserved carveout Mem [%s] Size to 0x%016llx @0x%llx\n", name, size, start);
+	reg[0] = cpu_to_fdt32(upper_32_bits(start));
+	reg[1] = cpu_to_fdt32(lower_32_bits(start));
+	reg[2] = cpu_to_fdt32(upper_32_bits(size));
+	reg[3] = cpu_to_fdt32(lower_32_bits(size));
 
-	return 0;
+	return fdt_setprop(blob, node, "reg", reg, sizeof(reg));
 }
 
-int hb_set_ion_carveout_size(void *blob, u64 size, const char *name, u64 start, u64 range_size)
+static int hb_fdt_apply_ion(void *blob, const struct hb_fdt_plan *plan)
 {
 	int rsv_offset, nodeoffset;
-	u32 dma_ranges[4];
-	int ret;
+	int i, ret;
 
+	/* Nodes are only added below, so this offset stays valid */
 	rsv_offset = fdt_find_or_add_subnode(blob, 0, "reserved-memory");
 	if (rsv_offset < 0) {
-		/*
-		 * Not found or something else bad happened.
-		 */
 		log_err("%s: libfdt fdt_find_or_add_subnode() returned %s\n", __func__,
 			fdt_strerror(rsv_offset));
-		return 1;
-	}
-	nodeoffset = fdt_find_or_add_subnode(blob, rsv_offset, name);
-	if (nodeoffset < 0) {
-		/*
-		 * Not found or something else bad happened.
-		 */
-		log_err("%s: libfdt fdt_find_or_add_subnode() returned %s\n", __func__,
-			fdt_strerror(nodeoffset));
-		return 1;
+		return rsv_offset;
 	}
 
-	ret = fdt_setprop_u64(blob, nodeoffset, "size", size);
-	if (ret < 0) {
-		log_err("%s: setup ion_cma memory_size(): %s\n", __func__,
-			fdt_strerror(ret));
-		return 1;
-	}
+	for (i = 0; i < HB_ION_COUNT; i++) {
+		const char *name = hb_ion_regions[i].name;
+		u64 start = plan->ion_start[i];
+		u64 size = plan->ion_size[i];
 
-	ret = fdt_setprop_string(blob, nodeoffset, "compatible", "ion-carveout");
-	if (ret < 0) {
-		log_err("%s: setup compatible failed: %s\n", __func__,
-			fdt_strerror(ret));
-		return 1;
-	}
+		nodeoffset = fdt_find_or_add_subnode(blob, rsv_offset, name);
+		if (nodeoffset < 0) {
+			ret = nodeoffset;
+			break;
+		}
+		ret = fdt_setprop_u64(blob, nodeoffset, "size", size);
+		if (!ret && i == HB_ION_CMA && !size)
+			ret = fdt_setprop_string(blob, nodeoffset, "status",
+						 "disabled");
+		if (!ret)
+			ret = fdt_setprop_string(blob, nodeoffset, "compatible",
+						 hb_ion_regions[i].compatible);
+		if (!ret && i == HB_ION_CMA)
+			ret = fdt_setprop_u64(blob, nodeoffset, "alignment",
+					      0x2000);
+		if (!ret && i == HB_ION_CMA)
+			ret = fdt_setprop_empty(blob, nodeoffset, "reusable");
+		if (!ret)
+			ret = hb_fdt_set_reg(blob, nodeoffset, start, size);
+		if (ret)
+			break;
 
-	dma_ranges[0] =	cpu_to_fdt32((start >> 32) & 0xffffffff);
-	dma_ranges[1] =	cpu_to_fdt32(start & 0xffffffff);
-	dma_ranges[2] =	cpu_to_fdt32((size >> 32) & 0xffffffff);
-	dma_ranges[3] =	cpu_to_fdt32(size & 0xffffffff);
-	ret = fdt_setprop(blob, nodeoffset, "reg", &dma_ranges[0],
-			sizeof(dma_ranges));
-	if (ret < 0) {
-		log_err("%s: setup reusable failed: %s\n", __func__,
-		fdt_strerror(ret));
-		return 1;
+		log_info("Set %s Mem [%s] Size to 0x%016llx @0x%llx\n",
+			 hb_ion_regions[i].what, name, size, start);
 	}
+	if (ret)
+		log_err("%s: setup %s failed: %s\n", __func__,
+			hb_ion_regions[i].name, fdt_strerror(ret));
 
-	log_info("Set Carveout Mem [%s] Size to 0x%016llx @0x%llx\n", name, size, start);
-
-	return 0;
+	return ret;
 }
 
-#define DDR_SIZE_2GB ((uint64_t)2 * SZ_1G)
-#define ION_MIN_SIZE (0x4000000)  /* 64 MiB */
-
-static uint64_t hb_ion_size_validate(uint64_t val, uint64_t max)
+static int hb_fdt_apply_opp(void *fdt, const struct hb_fdt_plan *plan)
 {
-	/*
-	 * The ion heap size should be ION_MIN_SIZE at least,
-	 * also it should be the multiple of ION_MIN_SIZE.
-	 */
-	val = (val > 0) ? roundup(val, ION_MIN_SIZE) : ION_MIN_SIZE;
+	char node[32];
+	u32 phandle;
+	int offs, ret, i;
+
+	offs = fdt_path_offset(fdt, HB_HPS_CLK_PATH);
+	if (offs < 0) {
+		printf("failed to get hps clock node!");
+		return offs;
+	}
+	if (plan->qspi_boot) {
+		/* enable qspi boot in clock node */
+		ret = fdt_setprop_u32(fdt, offs, "qspi-boot", 1);
+		if (ret < 0) {
+			printf("failed to update hps clock node status!");
+			return ret;
+		}
+		printf("enable qspi boot!\n");
+	}
+	if (plan->opp_table < 0)
+		return 0;
 
-	//if (val > max)
-		//pr_alert("CAUTION: Expanding ION region to larger than default!\n");
+	ret = fdt_setprop_u32(fdt, offs, "pll-table", plan->pll_table);
+	if (ret < 0) {
+		printf("failed to update cpu opp node status!");
+		return ret;
+	}
 
-	return val;
-}
+	/* enable corresponding opp table */
+	snprintf(node, sizeof(node), "/cpu-opp-table-%d/", plan->opp_table);
+	offs = fdt_path_offset(fdt, node);
+	if (offs < 0) {
+		printf("failed to get opp_node!");
+		return offs;
+	}
+	ret = fdt_setprop_string(fdt, offs, "status", "okay");
+	if (ret < 0) {
+		printf("failed to update cpu opp node status!");
+		return ret;
+	}
+	if (!plan->opp_cpus) {
+		printf("enable CPU 1.8G!\n");
+		return 0;
+	}
 
-static inline void hb_ion_set_region_size(uint64_t *ion_reserved_size, uint64_t ion_reserved_default,
-							  uint64_t *ion_carveout_size, uint64_t ion_carveout_default,
-							  uint64_t *ion_cma_size, uint64_t ion_cma_default, const uint64_t ddr_size)
-{
-	uint64_t ion_total = 0;
-	bool printed = false;
+	/* create phandle */
+	phandle = fdt_get_phandle(fdt, offs);
+	if (!phandle) {
+		ret = fdt_generate_phandle(fdt, &phandle);
+		if (!ret)
+			ret = fdt_set_phandle(fdt, offs, phandle);
+		if (ret < 0) {
+			printf("Can't set phandle %u: %s\n", phandle,
+			       fdt_strerror(ret));
+			return ret;
+		}
+	}
 
-	*ion_reserved_size = env_get_ulong("ion_reserved_size", 16, \
-		ion_reserved_default);
-	log_debug("Get ion reserved size, env:%#llx, default:%#llx\n",
-			  *ion_reserved_size, ion_reserved_default);
-	*ion_reserved_size = hb_ion_size_validate(*ion_reserved_size, \
-		ion_reserved_default);
-
-	*ion_carveout_size = env_get_ulong("ion_carveout_size", 16, \
-		ion_carveout_default);
-	log_debug("Get ion reserved size, env:%#llx, default:%#llx\n",
-			  *ion_carveout_size, ion_carveout_default);
-	*ion_carveout_size = hb_ion_size_validate(*ion_carveout_size, \
-		ion_carveout_default);
-
-	*ion_cma_size = env_get_ulong("ion_cma_size", 16, \
-		ion_cma_default);
-	log_debug("Get ion reserved size, env:%#llx, default:%#llx\n",
-			  *ion_cma_size, ion_cma_default);
-	*ion_cma_size = hb_ion_size_validate(*ion_cma_size, \
-		ion_cma_default);
-
-	do {
-		ion_total = (*ion_reserved_size) + (*ion_carveout_size) + (*ion_cma_size);
-		if ((ion_total + DEFAULT_ION_REGION_START + DEFAULT_KERNEL_MIN_HEAP) <= ((ddr_size))) {
-			break;
+	/* update each cpu opp with new phandle */
+	for (i = 0; i < MAX_CPU; i++) {
+		snprintf(node, sizeof(node), "/cpus/cpu@%d", i);
+		offs = fdt_path_offset(fdt, node);
+		if (offs < 0) {
+			printf("failed to get cpu opp node!");
+			return offs;
 		}
-		*ion_reserved_size -= (100 * SZ_1M);
-		*ion_carveout_size -= (100 * SZ_1M);
-		*ion_cma_size -= (100 * SZ_1M);
-		if (!printed) {
-			pr_err("ION Total size exceeds DDR total size, shrinking!\n");
-			printed = true;
+
+		ret = fdt_setprop_u32(fdt, offs, "operating-points-v2", phandle);
+		if (ret < 0) {
+			printf("failed to update cpu opp node status!");
+			return ret;
 		}
-	} while (true);
+	}
 
-	return;
+	return 0;
 }
 
-static int hb_setup_ion_size(void *blob)
+static void hb_fdt_apply_plan(void *blob)
 {
-	uint64_t ddr_size = ((uint64_t)4 * SZ_1G);
-	uint32_t num_banks = 0;
-	uint64_t cma_size, reserved_size, carveout_size, offset_size; // in byte
-
-#ifdef CONFIG_NR_DRAM_BANKS
-	{
-		int i;
-		phys_size_t size = 0;
+	struct hb_fdt_plan plan = {};
+	int efuse_ret;
+	u32 efuse = 0;
 
-		for (i = 0; i < CONFIG_NR_DRAM_BANKS; ++i) {
-			if (gd->bd->bi_dram[i].size) {
-				size += gd->bd->bi_dram[i].size;
-				num_banks++;
-			}
-		}
+	efuse_ret = hb_opp_efuse(&efuse);
+	hb_fdt_plan_build(&plan, hb_ddr_size(), efuse_ret, efuse);
 
-		/* X5 stores bi_dram[x].size with reserved_size removed */
-		ddr_size = (size + DDR_RESERVED_SIZE);
-	}
-#endif
-	/* TODO: Handle the case where ECC is enabled
-	 * and ion regions must be shrinked.
-	 */
-
-	log_debug("%s: Get ddr_size:%lld\n", __func__, ddr_size);
-	hb_ion_set_region_size(&reserved_size, RDK_DEFAULT_ION_RESERVED_SIZE,
-						&carveout_size, RDK_DEFAULT_ION_CARVEOUT_SIZE,
-						&cma_size, RDK_DEFAULT_ION_CMA_SIZE, ddr_size);
-
-	offset_size = DEFAULT_ION_REGION_START;
-	(void) hb_set_ion_reserved_size(blob, reserved_size, ION_RESERVED_NAME,
-				gd->bd->bi_dram[0].start + offset_size,
-				gd->bd->bi_dram[0].size - offset_size);
-	offset_size = offset_size + reserved_size;
-	(void) hb_set_ion_carveout_size(blob, carveout_size, ION_CARVEOUT_NAME,
-				gd->bd->bi_dram[0].start + offset_size,
-				gd->bd->bi_dram[0].size - offset_size);
-	offset_size = offset_size + carveout_size;
-	(void) hb_set_ion_cma_size(blob, cma_size, ION_CMA_NAME,
-				gd->bd->bi_dram[0].start + offset_size,
-				gd->bd->bi_dram[0].size - offset_size);
-
-	return 0;
+	hb_fdt_apply_ion(blob, &plan);
+	hb_fdt_apply_opp(blob, &plan);
 }
 
 #ifdef CONFIG_OF_LIBFDT_OVERLAY
@@ -545,6 +459,8 @@ static void hb_do_fdt_overlay(void *blob)
 	char *dtbo_file_path;
 	ulong dtbo_load_addr;
 	loff_t loaded_file_size = 0;
+	struct hb_dtbo_cache cache;
+	bool cached;
 
 	dtbo_file_path = env_get("dtbo_file_path");
 	if (dtbo_file_path == NULL)
@@ -567,15 +483,30 @@ static void hb_do_fdt_overlay(void *blob)
 
 	dtbo_load_addr = env_get_hex("dtbo_load_addr", 0x90000000);
 
-	if (!strncmp("ext", dtbo_fs, strlen("ext"))) {
-		fs_set_blk_dev(dtbo_dev, dtbo_part, FS_TYPE_EXT);
-		fs_read(dtbo_file_path, dtbo_load_addr, 0x0, 0x0, &loaded_file_size);
-		log_info("Applying %s from %s %s in fs %s\n", dtbo_file_path, dtbo_dev, dtbo_part, dtbo_fs);
-	} else {
+	if (strncmp("ext", dtbo_fs, strlen("ext"))) {
 		log_info("Filesystem %s not supported!\n", dtbo_fs);
 		return;
 	}
 
+	cached = IS_ENABLED(CONFIG_HB_DTBO_CACHE) &&
+		 !hb_dtbo_cache_init(&cache, blob, dtbo_fs, dtbo_dev,
+				     dtbo_part, dtbo_file_path);
+
+	if (fs_set_blk_dev(dtbo_dev, dtbo_part, FS_TYPE_EXT) ||
+	    fs_read(dtbo_file_path, dtbo_load_addr, 0x0, 0x0,
+		    &loaded_file_size) || !loaded_file_size) {
+		log_err("ERROR: cannot read %s from %s %s\n", dtbo_file_path,
+			dtbo_dev, dtbo_part);
+		return;
+	}
+
+	if (cached && !hb_dtbo_cache_load(&cache, blob, (void *)dtbo_load_addr,
+					  loaded_file_size)) {
+		log_info("Applying %s from cache\n", dtbo_file_path);
+		return;
+	}
+	log_info("Applying %s from %s %s in fs %s\n", dtbo_file_path, dtbo_dev, dtbo_part, dtbo_fs);
+
 	fdt_shrink_to_minimum(working_fdt, loaded_file_size);
 
 	if (fdt_overlay_apply_verbose(blob, (void *)dtbo_load_addr)) {
@@ -583,37 +514,52 @@ static void hb_do_fdt_overlay(void *blob)
 		return;
 	}
 
+	if (cached && hb_dtbo_cache_store(&cache, blob))
+		log_warning("Cannot store %s in the dtbo cache\n", dtbo_file_path);
+
 	return;
 }
 #endif
 
-static unsigned int get_boot_src(void)
-{
-	unsigned int ustrap_pin_info = readl(BOOT_STRAP_PIN_REG);
-        return ((ustrap_pin_info & BOOT_MODE_MASK) >> BOOT_MODE_SHIFT);
-}
+#ifdef ENABLE_BOOTSTAGE_TIMELINE
+/* Room for the marks made between here and starting the kernel */
+#define HB_TIMELINE_SLACK	SZ_1K
 
-static void update_boot_mode(void *fdt)
+/*
+ * Reserve the binary boot timeline under /soc, next to the console log
+ * buffer, where the kernel already looks for what U-Boot leaves behind.
+ * The tree can still grow here, within the room boot_relocate_fdt() set
+ * aside; ft_board_bootstage() fills the timeline in at the very end.
+ */
+static void hb_fdt_reserve_timeline(void *blob)
 {
-	int offs, ret;
-	unsigned int boot_src = get_boot_src();
+	int len, node, ret;
+	void *prop;
 
-        if(boot_src == BOOT_SRC_QSPI_NOR ||
-		boot_src == BOOT_SRC_QSPI_NAND ) {
-		/* enable qspi boot in clock node */
-		offs = fdt_path_offset(fdt, "/soc/hps-clock-controller@34210000");
-		if (offs < 0) {
-			printf("failed to get hps clock node!");
-			return;
-		}
-		ret = fdt_setprop_u32(fdt, offs, "qspi-boot", 1);
-		if (ret < 0) {
-			printf("failed to update hps clock node status!");
-			return;
-		}
-		printf("enable qspi boot!\n");
+	len = bootstage_timeline(NULL, 0);
+	if (len < 0)
+		return;
+	len += HB_TIMELINE_SLACK;
+
+	node = fdt_path_offset(blob, "/soc");
+	if (node >= 0)
+		node = fdt_add_subnode(blob, node, "boot-timeline");
+	if (node < 0) {
+		log_warning("boot-timeline: %s\n", fdt_strerror(node));
+		return;
 	}
+	ret = fdt_setprop_string(blob, node, "compatible",
+				 "hobot,uboot-timeline");
+	if (!ret)
+		ret = fdt_setprop_placeholder(blob, node, "timeline", len, &prop);
+	if (ret) {
+		log_warning("boot-timeline: %s\n", fdt_strerror(ret));
+		fdt_del_node(blob, node);
+		return;
+	}
+	memset(prop, '\0', len);
 }
+#endif
 
 int ft_board_setup(void *blob, struct bd_info *bd)
 {
@@ -630,10 +576,49 @@ int ft_board_setup(void *blob, struct bd_info *bd)
 	hb_fdt_set_board_info(blob);
 #endif
 	fdt_set_status_by_env(blob);
-	hb_setup_ion_size(blob);
-	update_boot_mode(blob);
-	check_cpu_1_8g_support(blob);
+	hb_fdt_apply_plan(blob);
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "ft_board_plan");
 	hb_do_fdt_overlay(blob);
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "ft_board_overlay");
+#ifdef ENABLE_BOOTSTAGE_TIMELINE
+	hb_fdt_reserve_timeline(blob);
+#endif
 	return 0;
 }
 #endif
+
+#ifdef ENABLE_BOOTSTAGE_TIMELINE
+/*
+ * Fill in the timeline reserved by hb_fdt_reserve_timeline(). This runs
+ * after image_setup_libfdt() has shrunk the tree and reserved what is left,
+ * so it must not grow the tree: below it sits the hobot,uboot-log buffer.
+ */
+int ft_board_bootstage(void *blob)
+{
+	int len, room, node, ret;
+	void *buf;
+
+	node = fdt_path_offset(blob, "/soc/boot-timeline");
+	if (node < 0 || !fdt_getprop(blob, node, "timeline", &room))
+		return -FDT_ERR_NOTFOUND;
+
+	len = bootstage_timeline(NULL, 0);
+	if (len < 0)
+		return len;
+	if (len > room) {
+		/* Do not leave a timeline of zeroes for the OS */
+		fdt_del_node(blob, node);
+		return -FDT_ERR_NOSPACE;
+	}
+	buf = malloc(len);
+	if (!buf)
+		return -ENOMEM;
+	bootstage_timeline(buf, len);
+
+	/* Shrinking a property needs no free space */
+	ret = fdt_setprop(blob, node, "timeline", buf, len);
+	free(buf);
+
+	return ret;
+}
+#endif
@@ -6,7 +6,10 @@
  */
 
 #include <common.h>
+#include <bootstage.h>
 #include <command.h>
+#include <deferred.h>
+#include <dm.h>
 #include <init.h>
 #include <fdt_support.h>
 #include <asm/sections.h>
@@ -17,9 +20,11 @@
 #include <search.h>
 #include <dm/ofnode.h>
 #include <rand.h>
+#include <tee/efuse_shadow.h>
 #include <asm/io.h>
 #include <asm/arch/hb_strappin.h>
 #include <asm/arch/hb_aon.h>
+#include <asm/arch/hb_sdhci.h>
 #include <hb_info.h>
 #include <wdt.h>
 
@@ -186,10 +191,28 @@ static char *hb_bootmedium_for_udev(void)
 #define HSIO_SD_CMD_Pinctrl 0x35050034
 #define HSIO_SD_DATA_Pinctrl 0x35050030
 
-void tf_power(void)
+static struct deferred_work tf_power_work;
+
+/*
+ * Power cycle the TF slot: hold the supply off for 50 ms, then give the
+ * card 100 ms to settle. The SD host waits for this in mmc_start_init().
+ */
+static int tf_power_step(struct deferred_work *work)
 {
 	unsigned int value=0;
 
+	switch (work->step) {
+	case 0:
+		break;
+	case 1:
+		value = readl((void *)HSIO_GPIO_26_IO);
+		value = value | (0x01 << HSIO_GPIO_26);
+		writel(value, (void *)HSIO_GPIO_26_IO);
+		return 100 * 1000;
+	default:
+		return 0;
+	}
+
 	writel(0x46484646, (void *)HSIO_SD_CMD_Pinctrl);
 	writel(0x46464646, (void *)HSIO_SD_DATA_Pinctrl);
 
@@ -206,13 +229,22 @@ void tf_power(void)
 	value = value & (~(0x01 << HSIO_GPIO_26));
 	writel(value, (void *)HSIO_GPIO_26_IO);
 
-	udelay(50*1000);
+	return 50 * 1000;
+}
 
-	value = readl((void *)HSIO_GPIO_26_IO);
-	value = value | (0x01 << HSIO_GPIO_26);
-	writel(value, (void *)HSIO_GPIO_26_IO);
+void tf_power(void)
+{
+	struct udevice *dev;
+	struct uclass *uc;
 
-	udelay(100*1000);
+	deferred_init(&tf_power_work, "tf_power", tf_power_step, NULL);
+	uclass_id_foreach_dev(UCLASS_MMC, dev, uc) {
+		if (dev_read_bool(dev, "sd-socrst")) {
+			tf_power_work.dev = dev;
+			break;
+		}
+	}
+	deferred_schedule(&tf_power_work, 0);
 }
 
 static void board_env_setup(void)
@@ -225,6 +257,7 @@ static void board_env_setup(void)
 		"run ab_select_cmd;"
 		"run avb_boot;");*/
 	set_bootdev();
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "set_bootdev");
 
 	hb_board_id_get(&board_id);
 
@@ -240,8 +273,45 @@ static void board_env_setup(void)
 	tf_power();
 }
 
+#if CONFIG_IS_ENABLED(MMC_SDHCI_X5_TUNING_CACHE)
+/*
+ * Keep the sample phases tuned by the SDHCI driver in the saved
+ * environment, so that the next boot only has to check them. This runs
+ * before the boot time variables are set, which must not be saved.
+ */
+static void board_mmc_tuning_save(void)
+{
+	struct udevice *dev;
+	struct uclass *uc;
+	char name[16], val[64];
+	const char *old;
+	bool changed = false;
+
+	uclass_id_foreach_dev(UCLASS_MMC, dev, uc) {
+		if (x5_sdhci_tuning_get(dev, val, sizeof(val)))
+			continue;
+
+		snprintf(name, sizeof(name), "mmc%d_tuning", dev_seq(dev));
+		old = env_get(name);
+		if (old && !strcmp(old, val))
+			continue;
+
+		env_set(name, val);
+		changed = true;
+	}
+
+	if (changed && env_save())
+		printf("Failed to save the MMC tuning\n");
+}
+#else
+static inline void board_mmc_tuning_save(void)
+{
+}
+#endif
+
 int last_stage_init(void)
 {
+	board_mmc_tuning_save();
 	chip_last_stage_init();
 	set_panic_action();
 	board_env_setup();
@@ -369,6 +439,7 @@ void board_bootargs_setup(void)
 		pr_err("%s setup bootargs environment failed, ret:%d\n",
 		       __func__, ret);
 	}
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "board_bootargs_setup");
 }
 
 void board_lmb_reserve(struct lmb *lmb)
@@ -377,3 +448,9 @@ void board_lmb_reserve(struct lmb *lmb)
 	lmb_add(lmb, X5_DTB_LMB_START, X5_DTB_LMB_SIZE);
 	//lmb_dump_all_force(lmb);
 }
+
+void board_quiesce_devices(void)
+{
+	/* The OS does not know about the efuse PTA session kept open */
+	efuse_shadow_release();
+}
@@ -4,32 +4,25 @@
 #include <asm/io.h>
 #include <errno.h>
 #include <tee.h>
+#include <tee/efuse_shadow.h>
+#include <tee/optee_ta_efuse.h>
 #include <linux/delay.h>
 #include <display_options.h>
 #include <asm/arch/hb_efuse.h>
 
-#define PTA_EFUSE                                          \
-	{                                                      \
-		0x16c83a2b, 0xaae3, 0x4542,                        \
-		{                                                  \
-			0x9d, 0xdd, 0x40, 0x46, 0x51, 0xe0, 0x1e, 0xa2 \
-		}                                                  \
-	}
-
-#define PTA_EFUSE_READ          0
-#define PTA_EFUSE_WRITE         1
-#define TEE_ERROR_ACCESS_DENIED 0xffff0001
-
 int hb_read_efuse(uint32_t offset, uint32_t size, char *output_buffer)
 {
 	int rc = CMD_RET_SUCCESS;
-	const struct tee_optee_ta_uuid uuid = PTA_EFUSE;
+	const struct tee_optee_ta_uuid uuid = PTA_EFUSE_UUID;
 	struct tee_open_session_arg session;
 	struct tee_invoke_arg invoke;
 	struct tee_param param[2];
 	struct udevice *tee_dev = NULL;
 	struct tee_shm *shm_val;
 
+	if (IS_ENABLED(CONFIG_TEE_EFUSE_SHADOW))
+		return efuse_shadow_read(offset, size, output_buffer);
+
 	tee_dev = tee_find_device(NULL, NULL, NULL, NULL);
 	if (!tee_dev) {
 		rc = -ENODEV;
@@ -196,13 +189,17 @@ static int hb_read_efuse_and_lock(struct efuse_info *efuse)
 static int hb_write_efuse(u32 offset, u32 value)
 {
 	int rc = CMD_RET_SUCCESS;
-	const struct tee_optee_ta_uuid uuid = PTA_EFUSE;
+	const struct tee_optee_ta_uuid uuid = PTA_EFUSE_UUID;
 	struct tee_open_session_arg session;
 	struct tee_invoke_arg invoke;
 	struct tee_param param[2];
 	struct udevice *tee_dev = NULL;
 	struct tee_shm *shm_val;
 
+	/* Also drops the mirror, so the lock check sees the new value */
+	if (IS_ENABLED(CONFIG_TEE_EFUSE_SHADOW))
+		return efuse_shadow_write(offset, value);
+
 	tee_dev = tee_find_device(NULL, NULL, NULL, NULL);
 	if (!tee_dev) {
 		rc = -ENODEV;
@@ -4,6 +4,9 @@
 PLATFORM_CPPFLAGS += -D__SANDBOX__ -U_FORTIFY_SOURCE
 PLATFORM_CPPFLAGS += -fPIC
 PLATFORM_LIBS += -lrt
+ifdef CONFIG_SMP_JOB
+PLATFORM_LIBS += -lpthread
+endif
 SDL_CONFIG ?= sdl2-config
 
 # Define this to avoid linking with SDL, which requires SDL libraries
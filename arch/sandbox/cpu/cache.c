@@ -13,6 +13,11 @@ void flush_cache(unsigned long addr, unsigned long size)
 	__builtin___clear_cache((void *)addr, (void *)(addr + size));
 }
 
+void memcpy_flush_dcache(void *dst, const void *src, size_t len)
+{
+	memcpy(dst, src, len);
+}
+
 void invalidate_icache_all(void)
 {
 	struct sandbox_state *state = state_get_current();
@@ -10,6 +10,7 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <getopt.h>
+#include <sched.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdarg.h>
@@ -416,6 +417,54 @@ void os_usleep(unsigned long usec)
 	usleep(usec);
 }
 
+struct os_thread {
+	pthread_t tid;
+	void (*func)(void *arg);
+	void *arg;
+};
+
+static void *os_thread_start(void *data)
+{
+	struct os_thread *thread = data;
+
+	thread->func(thread->arg);
+
+	return NULL;
+}
+
+void *os_thread_create(void (*func)(void *arg), void *arg)
+{
+	struct os_thread *thread;
+
+	thread = os_malloc(sizeof(*thread));
+	if (!thread)
+		return NULL;
+	thread->func = func;
+	thread->arg = arg;
+	if (pthread_create(&thread->tid, NULL, os_thread_start, thread)) {
+		os_free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+int os_thread_join(void *thread)
+{
+	struct os_thread *t = thread;
+	int ret;
+
+	ret = pthread_join(t->tid, NULL);
+	os_free(t);
+
+	return ret;
+}
+
+void os_thread_yield(void)
+{
+	sched_yield();
+}
+
 uint64_t __attribute__((no_instrument_function)) os_get_nsec(void)
 {
 #if defined(CLOCK_MONOTONIC) && defined(_POSIX_MONOTONIC_CLOCK)
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SMP job pool backend: secondary CPUs are host threads
+ */
+
+#include <common.h>
+#include <os.h>
+#include <smp_job.h>
+#include <linux/errno.h>
+
+static void sandbox_smp_job_thread(void *arg)
+{
+	smp_job_worker(arg);
+}
+
+int arch_smp_job_cpu_on(struct smp_job_cpu *cpu)
+{
+	cpu->arch = os_thread_create(sandbox_smp_job_thread, cpu);
+
+	return cpu->arch ? 0 : -EAGAIN;
+}
+
+int arch_smp_job_cpu_off(struct smp_job_cpu *cpu)
+{
+	int ret;
+
+	ret = os_thread_join(cpu->arch);
+	cpu->arch = NULL;
+
+	return ret ? -EIO : 0;
+}
+
+void arch_smp_job_wait(void)
+{
+	os_thread_yield();
+}
+
+void arch_smp_job_notify(void)
+{
+}
@@ -61,6 +61,13 @@ void sandbox_write(void *addr, unsigned int val, enum sandboxio_size_t size);
 #define writeq(v, addr) sandbox_write((void *)addr, v, SB_SIZE_64)
 #endif
 
+#define __raw_readb(addr)	readb(addr)
+#define __raw_readw(addr)	readw(addr)
+#define __raw_readl(addr)	readl(addr)
+#define __raw_writeb(v, addr)	writeb(v, addr)
+#define __raw_writew(v, addr)	writew(v, addr)
+#define __raw_writel(v, addr)	writel(v, addr)
+
 /*
  * Clear and set bits in one shot. These macros can be used to clear and
  * set multiple bits in a register using a single call. These macros can
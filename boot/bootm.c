@@ -409,13 +409,22 @@ static int bootm_load_os(bootm_headers_t *images, int boot_progress)
 	ulong flush_start = ALIGN_DOWN(load, ARCH_DMA_MINALIGN);
 	bool no_overlap;
 	void *load_buf, *image_buf;
+	enum bootstage_id stage;
 	int err;
 
 	load_buf = map_sysmem(load, 0);
 	image_buf = map_sysmem(os.image_start, image_len);
+	/* Copying an uncompressed kernel counts as relocation */
+	if (os.comp == IH_COMP_NONE)
+		stage = BOOTSTAGE_ID_ACCUM_BOOT_RELOC;
+	else
+		stage = BOOTSTAGE_ID_ACCUM_DECOMP;
+	bootstage_start(stage, stage == BOOTSTAGE_ID_ACCUM_DECOMP ?
+			"kernel_decomp" : "kernel_reloc");
 	err = image_decomp(os.comp, load, os.image_start, os.type,
 			   load_buf, image_buf, image_len,
 			   CONFIG_SYS_BOOTM_LEN, &load_end);
+	bootstage_accum(stage);
 	if (err) {
 		err = handle_decomp_error(os.comp, load_end - load,
 					  CONFIG_SYS_BOOTM_LEN, err);
@@ -425,7 +434,9 @@ static int bootm_load_os(bootm_headers_t *images, int boot_progress)
 	/* We need the decompressed image size in the next steps */
 	images->os.image_len = load_end - load;
 
+	bootstage_start(BOOTSTAGE_ID_ACCUM_BOOT_RELOC, "kernel_reloc");
 	flush_cache(flush_start, ALIGN(load_end, ARCH_DMA_MINALIGN) - flush_start);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_BOOT_RELOC);
 
 	debug("   kernel loaded at 0x%08lx, end = 0x%08lx\n", load, load_end);
 	bootstage_mark(BOOTSTAGE_ID_KERNEL_LOADED);
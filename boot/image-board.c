@@ -922,19 +922,20 @@ int image_setup_linux(bootm_headers_t *images)
 		}
 	}
 
+	ret = 0;
+	bootstage_start(BOOTSTAGE_ID_ACCUM_FDT, "fdt_setup");
 	if (CONFIG_IS_ENABLED(OF_LIBFDT)) {
 		ret = boot_relocate_fdt(lmb, of_flat_tree, &of_size);
 		if (ret)
-			return ret;
+			goto out;
 	}
 
-	if (CONFIG_IS_ENABLED(OF_LIBFDT) && of_size) {
+	if (CONFIG_IS_ENABLED(OF_LIBFDT) && of_size)
 		ret = image_setup_libfdt(images, *of_flat_tree, of_size, lmb);
-		if (ret)
-			return ret;
-	}
+out:
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_FDT);
 
-	return 0;
+	return ret;
 }
 #endif
 
@@ -9,6 +9,7 @@
  */
 
 #include <common.h>
+#include <bootstage.h>
 #include <fdt_support.h>
 #include <fdtdec.h>
 #include <env.h>
@@ -649,7 +650,10 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 		if (skip_board_fixup && ((int)simple_strtol(skip_board_fixup, NULL, 10) == 1)) {
 			printf("skip board fdt fixup\n");
 		} else {
+			bootstage_start(BOOTSTAGE_ID_ACCUM_FDT_BOARD,
+					"fdt_board");
 			fdt_ret = ft_board_setup(blob, gd->bd);
+			bootstage_accum(BOOTSTAGE_ID_ACCUM_FDT_BOARD);
 			if (fdt_ret) {
 				printf("ERROR: board-specific fdt fixup failed: %s\n",
 				       fdt_strerror(fdt_ret));
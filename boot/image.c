@@ -10,6 +10,7 @@
 #include <common.h>
 #include <env.h>
 #include <display_options.h>
+#include <frame_decomp.h>
 #include <init.h>
 #include <lmb.h>
 #include <log.h>
@@ -430,6 +431,36 @@ int image_decomp_type(const unsigned char *buf, ulong len)
 	return cmagic->comp_id;
 }
 
+/*
+ * Decompress LZ4 or zstd data on all CPUs, or pick up the output of a loader
+ * which decompressed it while reading it. This returns -EPROTONOSUPPORT if
+ * the data must be decompressed serially.
+ */
+static int image_decomp_frames(int comp, void *load_buf, void *image_buf,
+			       ulong image_len, uint unc_len, ulong *out_len)
+{
+#if !defined(USE_HOSTCC) && CONFIG_IS_ENABLED(FRAME_DECOMP)
+	size_t size = unc_len;
+	int ret;
+
+	if (frame_decomp_lookup(comp, image_buf, image_len, load_buf, unc_len,
+				&size)) {
+		*out_len = size;
+		return 0;
+	}
+	ret = frame_decomp(comp, image_buf, image_len, load_buf, &size);
+	if (ret) {
+		log_debug("Parallel decompression failed (err=%d)\n", ret);
+		return -EPROTONOSUPPORT;
+	}
+	*out_len = size;
+
+	return 0;
+#else
+	return -EPROTONOSUPPORT;
+#endif
+}
+
 int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end)
@@ -493,6 +524,10 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		if (!tools_build() && CONFIG_IS_ENABLED(LZ4)) {
 			size_t size = unc_len;
 
+			ret = image_decomp_frames(comp, load_buf, image_buf,
+						  image_len, unc_len, &image_len);
+			if (ret != -EPROTONOSUPPORT)
+				break;
 			ret = ulz4fn(image_buf, image_len, load_buf, &size);
 			image_len = size;
 		}
@@ -501,6 +536,11 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		if (!tools_build() && CONFIG_IS_ENABLED(ZSTD)) {
 			struct abuf in, out;
 
+			ret = image_decomp_frames(comp, load_buf, image_buf,
+						  image_len, unc_len, &image_len);
+			if (ret != -EPROTONOSUPPORT)
+				break;
+
 			abuf_init_set(&in, image_buf, image_len);
 			abuf_init_set(&out, load_buf, unc_len);
 			ret = zstd_decompress(&in, &out);
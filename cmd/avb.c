@@ -8,6 +8,7 @@
 #include <avb_verify.h>
 #include <command.h>
 #include <env.h>
+#include <errno.h>
 #include <image.h>
 #include <malloc.h>
 #include <mmc.h>
@@ -190,7 +191,7 @@ int do_avb_write_rb(struct cmd_tbl *cmdtp, int flag, int argc,
 	rb_idx = hextoul(argv[2], NULL);
 
 	if (avb_ops->write_rollback_index(avb_ops, index, rb_idx) ==
-	    AVB_IO_RESULT_OK)
+	    AVB_IO_RESULT_OK && !avb_ops_commit(avb_ops))
 		return CMD_RET_SUCCESS;
 
 	printf("Failed to write rollback index\n");
@@ -226,6 +227,39 @@ int do_avb_get_uuid(struct cmd_tbl *cmdtp, int flag,
 	return CMD_RET_FAILURE;
 }
 
+/*
+ * The boot image is normally preloaded to kernel_addr by the AVB ops, so the
+ * verified buffer is booted in place. If libavb had to allocate its own
+ * buffer, move the verified data there before it is freed.
+ */
+static int avb_handoff_boot_image(AvbSlotVerifyData *data)
+{
+	AvbPartitionData *part;
+	void *kernel_addr;
+	size_t i;
+
+	kernel_addr = (void *)env_get_ulong("kernel_addr", 16, 0);
+	for (i = 0; i < data->num_loaded_partitions; i++) {
+		part = &data->loaded_partitions[i];
+		if (strcmp(part->partition_name, "boot"))
+			continue;
+
+		if (part->preloaded && part->data == kernel_addr)
+			return 0;
+
+		if (!kernel_addr) {
+			printf("env kernel_addr is not set\n");
+			return -EINVAL;
+		}
+		debug("Moving verified boot image to %p\n", kernel_addr);
+		memmove(kernel_addr, part->data, part->data_size);
+		return 0;
+	}
+
+	printf("No verified boot image loaded\n");
+	return -ENOENT;
+}
+
 int do_avb_verify_part(struct cmd_tbl *cmdtp, int flag,
 		       int argc, char *const argv[])
 {
@@ -275,6 +309,8 @@ int do_avb_verify_part(struct cmd_tbl *cmdtp, int flag,
 				flags,
 				AVB_HASHTREE_ERROR_MODE_RESTART_AND_INVALIDATE,
 				&out_data);
+	if (avb_ops_commit(avb_ops))
+		printf("Failed to write rollback indexes\n");
 
 	switch (slot_result) {
 	case AVB_SLOT_VERIFY_RESULT_OK:
@@ -283,7 +319,11 @@ int do_avb_verify_part(struct cmd_tbl *cmdtp, int flag,
 		 * So in this case we can boot only when verification is
 		 * successful; we also supply in cmdline GREEN boot state
 		 */
-		printf("Verification passed successfully\n");
+		if (avb_check_hashtrees(avb_ops, out_data))
+			break;
+
+		if (avb_handoff_boot_image(out_data))
+			break;
 
 		/* export additional bootargs to AVB_BOOTARGS env var */
 
@@ -309,6 +349,7 @@ int do_avb_verify_part(struct cmd_tbl *cmdtp, int flag,
 					cmdline);
 			env_set("bootargs", cmd);
 		}
+		printf("Verification passed successfully\n");
 		res = CMD_RET_SUCCESS;
 		break;
 	case AVB_SLOT_VERIFY_RESULT_ERROR_VERIFICATION:
@@ -457,6 +498,7 @@ static struct cmd_tbl cmd_avb[] = {
 static int do_avb(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 {
 	struct cmd_tbl *cp;
+	int ret;
 
 	cp = find_cmd_tbl(argv[1], cmd_avb, ARRAY_SIZE(cmd_avb));
 
@@ -469,7 +511,11 @@ static int do_avb(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 	if (flag == CMD_FLAG_REPEAT)
 		return CMD_RET_FAILURE;
 
-	return cp->cmd(cmdtp, flag, argc, argv);
+	ret = cp->cmd(cmdtp, flag, argc, argv);
+	/* optee_rpmb may change persistent values before the next command */
+	avb_ops_drop_values(avb_ops);
+
+	return ret;
 }
 
 U_BOOT_CMD(
@@ -25,13 +25,26 @@
 #include <command.h>
 #include <cli.h>
 #include <avb_verify.h>
+#include <bootstage.h>
 #include <env.h>
+#include <frame_decomp.h>
+#include <image.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <linux/libfdt.h>
+#include <linux/sizes.h>
 #include <linux/string.h>
 #include <asm/arch/hb_efuse.h>
 #include <asm/arch/hb_board.h>
 
 extern struct AvbOps *avb_ops;
 
+/* Enough for a legacy/Android header and the FDT header of a FIT */
+#define HB_BOOT_HDR_READ_SIZE	SZ_4K
+
+/* Read size while the kernel is decompressed behind the reads */
+#define HB_BOOT_READ_CHUNK	SZ_2M
+
 const char *golden_partition_list[] = {
 	"system",
 	"app",
@@ -131,6 +144,254 @@ static int replace_dm_part(char *system_part)
 	return 0;
 }
 
+/*
+ * A FIT built with "mkimage -E" keeps its image data after the FDT
+ * structure, so the image ends with the last external data blob.
+ */
+static u64 hb_fit_image_size(const void *fit)
+{
+	u64 size = fdt_totalsize(fit);
+	u64 end;
+	int images, node;
+	int offset, len;
+
+	images = fdt_path_offset(fit, FIT_IMAGES_PATH);
+	if (images < 0)
+		return size;
+
+	fdt_for_each_subnode(node, fit, images) {
+		if (fit_image_get_data_size(fit, node, &len))
+			continue;
+		if (!fit_image_get_data_position(fit, node, &offset))
+			end = (u64)offset + len;
+		else if (!fit_image_get_data_offset(fit, node, &offset))
+			end = ALIGN(fdt_totalsize(fit), 4) + (u64)offset + len;
+		else
+			continue;
+		if (end > size)
+			size = end;
+	}
+
+	return size;
+}
+
+/* The image given to "bootm", whose FIT configuration follows the board id */
+static void hb_bootm_image(char *buf, size_t size, ulong addr)
+{
+	const char *board_id = env_get("hb_board_id");
+
+	if (board_id)
+		snprintf(buf, size, "%lx#boardid-%s", addr, board_id);
+	else
+		snprintf(buf, size, "%lx", addr);
+}
+
+#if CONFIG_IS_ENABLED(FRAME_DECOMP) && CONFIG_IS_ENABLED(FIT)
+/*
+ * Start decompressing the kernel which "bootm" will pick from the FIT at
+ * @fit, so that it is decompressed on the other CPUs while the rest of the
+ * FIT is read. On success, @start and @end give the position of the
+ * compressed data in the FIT.
+ */
+static int hb_fit_kernel_decomp(const void *fit, u64 fit_size,
+				struct frame_decomp *fd, u64 *start, u64 *end)
+{
+	const char *conf_name = NULL, *kernel_name = NULL;
+	char image[64];
+	int conf, node, offset, len;
+	ulong load;
+	u8 comp;
+
+	/* Pick the configuration the way "bootm" will */
+	hb_bootm_image(image, sizeof(image), map_to_sysmem(fit));
+	genimg_get_kernel_addr_fit(image, &conf_name, &kernel_name);
+	if (kernel_name)
+		return -ENOENT;
+	conf = fit_conf_get_node(fit, conf_name);
+	if (conf < 0)
+		return -ENOENT;
+	node = fit_conf_get_prop_node(fit, conf, FIT_KERNEL_PROP);
+	if (node < 0)
+		return -ENOENT;
+
+	if (fit_image_get_comp(fit, node, &comp) ||
+	    (comp != IH_COMP_LZ4 && comp != IH_COMP_ZSTD))
+		return -EPROTONOSUPPORT;
+	if (fit_image_get_data_size(fit, node, &len) ||
+	    fit_image_get_load(fit, node, &load))
+		return -ENOENT;
+	if (!fit_image_get_data_position(fit, node, &offset))
+		*start = offset;
+	else if (!fit_image_get_data_offset(fit, node, &offset))
+		*start = ALIGN(fdt_totalsize(fit), 4) + (u64)offset;
+	else
+		return -ENOENT;	/* embedded data is already loaded */
+	*end = *start + len;
+	if (*end > fit_size)
+		return -EINVAL;
+
+	/* The output must not land on the FIT still being read */
+	if (load < map_to_sysmem(fit) + fit_size &&
+	    load + CONFIG_SYS_BOOTM_LEN > map_to_sysmem(fit))
+		return -EPROTONOSUPPORT;
+
+	return frame_decomp_start(fd, comp, fit + *start, len,
+				  map_sysmem(load, CONFIG_SYS_BOOTM_LEN),
+				  CONFIG_SYS_BOOTM_LEN, FRAME_DECOMP_KEEP);
+}
+
+/*
+ * Read the rest of a FIT, decompressing its kernel meanwhile. The result is
+ * picked up by image_decomp() when "bootm" loads the kernel.
+ */
+static int hb_read_fit_decomp(const char *partition, void *load_addr,
+			      u64 from, u64 image_size)
+{
+	struct frame_decomp fd;
+	u64 start, end, pos, chunk;
+	size_t read_size = 0;
+	size_t out_len;
+	AvbIOResult ret = AVB_IO_RESULT_OK;
+	int err;
+
+	err = hb_fit_kernel_decomp(load_addr, image_size, &fd, &start, &end);
+	if (err) {
+		if (err != -EPROTONOSUPPORT && err != -ENOENT)
+			debug("%s: no parallel decompression (err=%d)\n",
+			      partition, err);
+		return avb_ops->read_from_partition(avb_ops, partition, from,
+						    image_size - from,
+						    load_addr + from,
+						    &read_size);
+	}
+
+	for (pos = from; pos < image_size; pos += chunk) {
+		chunk = min_t(u64, image_size - pos, HB_BOOT_READ_CHUNK);
+		ret = avb_ops->read_from_partition(avb_ops, partition, pos,
+						   chunk, load_addr + pos,
+						   &read_size);
+		if (ret) {
+			/* Nothing is kept, bootm has nothing stale to pick up */
+			frame_decomp_abort(&fd);
+			return ret;
+		}
+		if (pos + chunk > start)
+			frame_decomp_feed(&fd, min(pos + chunk, end) - start);
+	}
+
+	/* On error the output is dropped, bootm decompresses it again */
+	bootstage_start(BOOTSTAGE_ID_ACCUM_DECOMP, "kernel_decomp");
+	err = frame_decomp_finish(&fd, &out_len);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_DECOMP);
+	debug("%s: kernel decompressed while reading, 0x%zx bytes (err=%d)\n",
+	      partition, err ? 0 : out_len, err);
+
+	return 0;
+}
+#endif
+
+/*
+ * Load the boot image from @partition to @load_addr, reading only the
+ * bytes described by its header instead of the whole partition.
+ * Unknown formats fall back to reading the full partition.
+ */
+static int hb_load_boot_image(const char *partition, u64 part_size,
+			      void *load_addr)
+{
+	size_t read_size = 0;
+	u64 hdr_size, image_size;
+	char *stage_name;
+	AvbIOResult ret;
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_BOOT_LOAD, "boot_load");
+	hdr_size = min_t(u64, HB_BOOT_HDR_READ_SIZE, part_size);
+	ret = avb_ops->read_from_partition(avb_ops, partition, 0, hdr_size,
+					   load_addr, &read_size);
+	if (ret)
+		goto err;
+
+	switch (genimg_get_format(load_addr)) {
+#if CONFIG_IS_ENABLED(LEGACY_IMAGE_FORMAT)
+	case IMAGE_FORMAT_LEGACY:
+		image_size = image_get_image_size(load_addr);
+		break;
+#endif
+#if CONFIG_IS_ENABLED(FIT)
+	case IMAGE_FORMAT_FIT:
+		image_size = fdt_totalsize(load_addr);
+		/* Never parse the FIT past the data loaded from the partition */
+		if (image_size > part_size) {
+			printf("FIT size 0x%llx exceeds partition %s\n",
+			       image_size, partition);
+			ret = AVB_IO_RESULT_ERROR_RANGE_OUTSIDE_PARTITION;
+			goto err;
+		}
+		if (image_size > hdr_size) {
+			/* The FIT structure itself is needed to find its end */
+			ret = avb_ops->read_from_partition(avb_ops, partition,
+							   hdr_size,
+							   image_size - hdr_size,
+							   load_addr + hdr_size,
+							   &read_size);
+			if (ret)
+				goto err;
+			hdr_size = image_size;
+		}
+		image_size = hb_fit_image_size(load_addr);
+		break;
+#endif
+#ifdef CONFIG_ANDROID_BOOT_IMAGE
+	case IMAGE_FORMAT_ANDROID:
+		image_size = android_image_get_end(load_addr) -
+			     (ulong)load_addr;
+		break;
+#endif
+	default:
+		image_size = part_size;
+		break;
+	}
+
+	if (image_size > part_size) {
+		printf("boot image size 0x%llx exceeds partition %s, truncated\n",
+		       image_size, partition);
+		image_size = part_size;
+	}
+
+	if (image_size > hdr_size) {
+#if CONFIG_IS_ENABLED(FRAME_DECOMP) && CONFIG_IS_ENABLED(FIT)
+		if (genimg_get_format(load_addr) == IMAGE_FORMAT_FIT)
+			ret = hb_read_fit_decomp(partition, load_addr,
+						 hdr_size, image_size);
+		else
+#endif
+			ret = avb_ops->read_from_partition(avb_ops, partition,
+							   hdr_size,
+							   image_size - hdr_size,
+							   load_addr + hdr_size,
+							   &read_size);
+		if (ret)
+			goto err;
+	}
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_BOOT_LOAD);
+
+	debug("%s: loaded 0x%llx of 0x%llx bytes\n", partition,
+	      max(image_size, hdr_size), part_size);
+	stage_name = malloc(64);
+	if (stage_name) {
+		snprintf(stage_name, 64, "load %s: %lluK read, %lluK skipped",
+			 partition, max(image_size, hdr_size) >> 10,
+			 (part_size - max(image_size, hdr_size)) >> 10);
+		bootstage_mark_name(BOOTSTAGE_ID_ALLOC, stage_name);
+	}
+
+	return 0;
+
+err:
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_BOOT_LOAD);
+
+	return ret;
+}
+
 static int32_t hb_non_secure_boot(char *bootintf, char *bootdev, char *slot_suffix)
 {
 	int32_t ret = 0;
@@ -138,15 +399,14 @@ static int32_t hb_non_secure_boot(char *bootintf, char *bootdev, char *slot_suff
 	char partition[20] = {0};
 	char system_part[64] = {0};
 	uint64_t part_size = 0;
-	size_t read_size = 0;
 	void *kernel_addr = NULL;
-	void *board_id = NULL;
 
 	snprintf(buffer, sizeof(buffer), "avb init %s %s", bootintf, bootdev);
 	ret = run_command(buffer, 0);
 	if (ret) {
 		panic("run avb init failed\n");
 	}
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "avb_init");
 	kernel_addr = (void *)env_get_ulong("kernel_addr", 16, 0);
 	if (kernel_addr == 0) {
 		printf("env kernel_addr is not set\n");
@@ -165,7 +425,7 @@ static int32_t hb_non_secure_boot(char *bootintf, char *bootdev, char *slot_suff
 			do_reset(NULL, 0, 0, NULL);
 		}
 	}
-	ret = avb_ops->read_from_partition(avb_ops, partition, 0, part_size, kernel_addr, &read_size);
+	ret = hb_load_boot_image(partition, part_size, kernel_addr);
 	if (ret) {
 		printf("Can't read from boot partition, ret=%d\n", ret);
 		do_reset(NULL, 0, 0, NULL);
@@ -174,12 +434,10 @@ static int32_t hb_non_secure_boot(char *bootintf, char *bootdev, char *slot_suff
 	env_set("system_part", system_part);
 	board_bootargs_setup();
 	memset(buffer, 0, sizeof(buffer));
-	board_id = (void *)env_get("hb_board_id");
-	if (board_id == NULL) {
-		snprintf(buffer, sizeof(buffer), "bootm ${kernel_addr}");
-	} else {
-		snprintf(buffer, sizeof(buffer), "bootm ${kernel_addr}#boardid-${hb_board_id}");
-	}
+	strcpy(buffer, "bootm ");
+	hb_bootm_image(buffer + strlen(buffer), sizeof(buffer) - strlen(buffer),
+		       (ulong)kernel_addr);
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "bootm");
 	ret = run_command(buffer, 0);	if (ret) {
 		printf("Boot Failed with status %d\n", ret);
 		run_command("run $enter_safety_cmd", 0);
@@ -197,7 +455,6 @@ static int32_t hb_avb_verify_boot(char *bootintf, char *bootdev, char *slot_suff
 	bool out_is_unlocked = 0;
 	char system_part[64] = {0};
 	void *kernel_addr = NULL;
-	void *board_id = NULL;
 	bool ab_exist = true;
 
 	snprintf(ab_corrupt_cmd, sizeof(ab_corrupt_cmd),
@@ -207,6 +464,7 @@ static int32_t hb_avb_verify_boot(char *bootintf, char *bootdev, char *slot_suff
 	if (ret) {
 		panic("run avb init failed\n");
 	}
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "avb_init");
 
 	ret = avb_ops->read_is_device_unlocked(avb_ops, &out_is_unlocked);
 	if (ret != AVB_IO_RESULT_OK) {
@@ -237,6 +495,7 @@ static int32_t hb_avb_verify_boot(char *bootintf, char *bootdev, char *slot_suff
 		run_command(ab_corrupt_cmd, 0);
 		do_reset(NULL, 0, 0, NULL);
 	}
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "avb_verify");
 
 	dr_get_partition_dev("system", slot_suffix, system_part, sizeof(system_part));
 	if (strncmp(bootintf, "mmc", strlen("mmc") + 1) == 0) {
@@ -244,17 +503,16 @@ static int32_t hb_avb_verify_boot(char *bootintf, char *bootdev, char *slot_suff
 		if (ret && (!out_is_unlocked)) {
 			do_reset(NULL, 0, 0, NULL);
 		}
+		bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "replace_dm_part");
 	}
 
 	board_bootargs_setup();
 	kernel_addr = (void *)env_get_ulong("kernel_addr", 16, 0);
 	memset(buffer, 0, sizeof(buffer));
-	board_id = (void *)env_get("hb_board_id");
-	if (board_id == NULL) {
-		snprintf(buffer, sizeof(buffer), "bootm ${kernel_addr}");
-	} else {
-		snprintf(buffer, sizeof(buffer), "bootm ${kernel_addr}#boardid-${hb_board_id}");
-	}
+	strcpy(buffer, "bootm ");
+	hb_bootm_image(buffer + strlen(buffer), sizeof(buffer) - strlen(buffer),
+		       (ulong)kernel_addr);
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "bootm");
 	ret = run_command(buffer, 0);
 	if (ret) {
 		printf("Boot Failed with status %d\n", ret);
@@ -9,7 +9,9 @@
  */
 #include <common.h>
 #include <command.h>
+#include <deferred.h>
 #include <net.h>
+#include <smp_job.h>
 
 #ifdef CONFIG_CMD_GO
 
@@ -33,6 +35,11 @@ static int do_go(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 
 	printf ("## Starting application at 0x%08lX ...\n", addr);
 
+	/* Nothing queued may outlive the command */
+	deferred_flush();
+	/* The application may bring up the secondary CPUs itself */
+	smp_job_park();
+
 	/*
 	 * pass address parameter as argv[0] (aka command name),
 	 * and all remaining args
@@ -13,6 +13,7 @@
 #include <dtoverlay.h>
 #include <fs.h>
 #include <mmc.h>
+#include <u-boot/sha256.h>
 
 #include <hb_utils.h>
 
@@ -32,6 +33,82 @@ uint32_t hb_dev_name_get(char *devname)
 	return 0;
 }
 
+/*
+ * Hash everything the result of a config.txt depends on: the device tree,
+ * config.txt itself and every overlay it names, whether or not a filter
+ * section leaves it out.
+ */
+static void dtoverlay_bundle_key(void *fdt, char *cfg, loff_t cfg_size,
+                                 ulong overlay_addr, u8 *key)
+{
+    sha256_context ctx;
+    char line[128], path[96];
+    char *dp = cfg, *lp, *comma;
+    loff_t size;
+
+    sha256_starts(&ctx);
+    sha256_update(&ctx, fdt, fdt_totalsize(fdt));
+    sha256_update(&ctx, (u8 *)cfg, cfg_size);
+
+    while (hb_getline(line, sizeof(line), &dp) > 0) {
+        lp = line;
+        while (isblank(*lp))
+            ++lp;
+
+        if (strncmp(lp, "dtoverlay=", 10) != 0)
+            continue;
+
+        lp += strlen("dtoverlay=");
+        comma = strchr(lp, ',');
+        if (comma != NULL)
+            *comma = '\0';
+        lp = strim(lp);
+        if (strlen(lp) == 0)
+            continue;
+
+        snprintf(path, sizeof(path), DTOVERLAY_PATH_FMT, lp);
+        if (hb_ext4_load(path, overlay_addr, &size) != 0)
+            size = -1;
+
+        sha256_update(&ctx, (u8 *)lp, strlen(lp) + 1);
+        sha256_update(&ctx, (u8 *)&size, sizeof(size));
+        if (size > 0)
+            sha256_update(&ctx, map_sysmem(overlay_addr, size), size);
+    }
+
+    sha256_finish(&ctx, key);
+}
+
+static int dtoverlay_bundle_load(char *path, ulong addr, void *fdt, u8 *key)
+{
+    loff_t size;
+
+    if (hb_ext4_load(path, addr, &size) != 0)
+        return -ENOENT;
+
+    return dtoverlay_bundle_apply(map_sysmem(addr, size), size, key, fdt,
+                                  DTOVERLAY_FDT_MAX_SIZE);
+}
+
+static void dtoverlay_bundle_store(char *path, void *base, void *fdt, u8 *key)
+{
+    void *bundle;
+    int size;
+    int ret;
+
+    ret = dtoverlay_bundle_make(base, fdt, key, &bundle, &size);
+    if (ret == 0) {
+        if (hb_ext4_store(path, map_to_sysmem(bundle), size) != 0)
+            ret = -EIO;
+        free(bundle);
+    }
+
+    if (ret != 0)
+        dtoverlay_debug("can't store %s (%d)\n", path, ret);
+    else
+        dtoverlay_debug("stored %s, %d bytes\n", path, size);
+}
+
 static int do_dtoverlay(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 {
     char *data, *dp, *lp, *ptr, *cfg_file;
@@ -44,6 +121,11 @@ static int do_dtoverlay(struct cmd_tbl *cmdtp, int flag, int argc, char *const a
     char *comma, *token, *equal_sign;
     int som_type = 0;
     char devname[32];
+    char bundle_path[128];
+    u8 key[SHA256_SUM_LEN];
+    void *base = NULL;
+    int apply = 1;
+    int ret;
 
     if (argc < 5)
         return CMD_RET_USAGE;
@@ -80,6 +162,35 @@ static int do_dtoverlay(struct cmd_tbl *cmdtp, int flag, int argc, char *const a
 
     fdt_shrink_to_minimum((void *)dt_addr, 0x1000);
 
+    /*
+     * With a bundle from the same inputs the device tree is patched from
+     * it, only the lines with side effects other than on it are run.
+     */
+    if (IS_ENABLED(CONFIG_DTOVERLAY_BUNDLE))
+    {
+        snprintf(bundle_path, sizeof(bundle_path), "%s" DTOVERLAY_BUNDLE_SUFFIX,
+                 cfg_file);
+        dtoverlay_bundle_key((void *)dt_addr, data, size, overlay_addr, key);
+
+        ret = dtoverlay_bundle_load(bundle_path, overlay_addr,
+                                    (void *)dt_addr, key);
+        if (ret == 0)
+        {
+            dtoverlay_debug("applied %s\n", bundle_path);
+            apply = 0;
+        }
+        else if (ret != -ENOENT && ret != -EINVAL && ret != -ESTALE &&
+                 ret != -EILSEQ)
+        {
+            /* Written from these inputs already, a rewrite would not help */
+            dtoverlay_debug("can't apply %s (%d)\n", bundle_path, ret);
+        }
+        else if ((base = malloc(fdt_totalsize((void *)dt_addr))) != NULL)
+        {
+            memcpy(base, (void *)dt_addr, fdt_totalsize((void *)dt_addr));
+        }
+    }
+
     while ((length = hb_getline(line, sizeof(line), &dp)) > 0) {
         dtoverlay_debug("Line length: %d, Read line: %s\n", length, line);
 
@@ -101,6 +212,11 @@ static int do_dtoverlay(struct cmd_tbl *cmdtp, int flag, int argc, char *const a
         if (som_type != 0 && strncmp(lp, "[", 1) != 0 )
             continue;
 
+        /* Already in the device tree patched from the bundle */
+        if (!apply && (strncmp(lp, "dtparam=", 8) == 0 ||
+                       strncmp(lp, "dtoverlay=", 10) == 0))
+            continue;
+
         if (strncmp(lp, "dtparam=", 8) == 0)
         {
             lp += strlen("dtparam=");
@@ -218,6 +334,16 @@ static int do_dtoverlay(struct cmd_tbl *cmdtp, int flag, int argc, char *const a
     {
         do_dtparam(dt_addr, "", dtparam, param_num);
     }
+    if (base != NULL)
+    {
+        /*
+         * do_dtparam() leaves the totalsize at the room it edited in, drop
+         * that so the bundle holds the tree and not what lies after it
+         */
+        fdt_shrink_to_minimum((void *)dt_addr, 0x1000);
+        dtoverlay_bundle_store(bundle_path, base, (void *)dt_addr, key);
+        free(base);
+    }
     free(data);
     return 0;
 }
@@ -7,11 +7,13 @@
 #include <common.h>
 #include <command.h>
 #include <cpu_func.h>
+#include <deferred.h>
 #include <elf.h>
 #include <env.h>
 #include <image.h>
 #include <log.h>
 #include <net.h>
+#include <smp_job.h>
 #include <vxworks.h>
 #ifdef CONFIG_X86
 #include <vesa.h>
@@ -73,6 +75,11 @@ int do_bootelf(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 
 	printf("## Starting application at 0x%08lx ...\n", addr);
 
+	/* Nothing queued may outlive the command */
+	deferred_flush();
+	/* The application may bring up the secondary CPUs itself */
+	smp_job_park();
+
 	/*
 	 * pass address parameter as argv[0] (aka command name),
 	 * and all remaining args
@@ -275,6 +282,8 @@ int do_bootvx(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 
 	printf("## Starting vxWorks at 0x%08lx ...\n", addr);
 
+	deferred_flush();
+	smp_job_park();
 	dcache_disable();
 #if defined(CONFIG_ARM64) && defined(CONFIG_ARMV8_PSCI)
 	armv8_setup_psci();
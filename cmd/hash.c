@@ -12,7 +12,74 @@
 #include <common.h>
 #include <command.h>
 #include <hash.h>
+#include <hash_tree.h>
+#include <hexdump.h>
+#include <mapmem.h>
+#include <smp_job.h>
+#include <time.h>
 #include <linux/ctype.h>
+#include <linux/sizes.h>
+
+#if CONFIG_IS_ENABLED(HASH_TREE)
+static int do_hash_tree(int argc, char *const argv[])
+{
+	u8 salt[HASH_TREE_MAX_DIGEST], root[HASH_TREE_MAX_DIGEST];
+	struct hash_tree tree = {
+		.block_size = SZ_4K,
+		.salt = salt,
+	};
+	ulong addr, len, start, us;
+	const void *buf;
+	int size, ret;
+
+	if (argc < 4)
+		return CMD_RET_USAGE;
+	if (!strcmp(argv[1], "-s")) {
+		tree.serial = true;
+		argc--;
+		argv++;
+		if (argc < 4)
+			return CMD_RET_USAGE;
+	}
+
+	tree.algo = argv[1];
+	addr = hextoul(argv[2], NULL);
+	len = hextoul(argv[3], NULL);
+	if (argc > 4) {
+		tree.salt_len = strlen(argv[4]) / 2;
+		if (strlen(argv[4]) % 2 || tree.salt_len > sizeof(salt) ||
+		    hex2bin(salt, argv[4], tree.salt_len)) {
+			printf("Invalid salt '%s'\n", argv[4]);
+			return CMD_RET_FAILURE;
+		}
+	}
+
+	size = hash_tree_digest_size(&tree);
+	if (size < 0) {
+		printf("Unsupported algorithm '%s'\n", tree.algo);
+		return CMD_RET_FAILURE;
+	}
+
+	buf = map_sysmem(addr, len);
+	start = timer_get_us();
+	ret = hash_tree_root(&tree, buf, len, root);
+	us = max(timer_get_us() - start, 1UL);
+	unmap_sysmem(buf);
+	if (ret) {
+		printf("Cannot hash (err=%d)\n", ret);
+		return CMD_RET_FAILURE;
+	}
+
+	printf("%s tree for %08lx ... %08lx ==> ", tree.algo, addr,
+	       addr + len - 1);
+	for (ret = 0; ret < size; ret++)
+		printf("%02x", root[ret]);
+	printf("\n%lu us, %llu MB/s on %u CPU(s)\n", us, (u64)len / us,
+	       tree.serial ? 1 : smp_job_nr_cpus());
+
+	return CMD_RET_SUCCESS;
+}
+#endif
 
 static int do_hash(struct cmd_tbl *cmdtp, int flag, int argc,
 		   char *const argv[])
@@ -20,6 +87,22 @@ static int do_hash(struct cmd_tbl *cmdtp, int flag, int argc,
 	char *s;
 	int flags = HASH_FLAG_ENV;
 
+#if CONFIG_IS_ENABLED(HASH_TREE)
+	if (argc >= 2 && !strcmp(argv[1], "tree"))
+		return do_hash_tree(argc - 1, argv + 1);
+#endif
+
+	if (argc >= 2 && !strcmp(argv[1], "bench")) {
+		ulong size = SZ_16M;
+
+		if (argc > 2)
+			size = hextoul(argv[2], NULL);
+		if (!size)
+			return CMD_RET_USAGE;
+
+		return hash_bench(size) ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+	}
+
 #ifdef CONFIG_HASH_VERIFY
 	if (argc < 4)
 		return CMD_RET_USAGE;
@@ -37,7 +120,9 @@ static int do_hash(struct cmd_tbl *cmdtp, int flag, int argc,
 	return hash_command(*argv, flags, cmdtp, flag, argc - 1, argv + 1);
 }
 
-#ifdef CONFIG_HASH_VERIFY
+#if CONFIG_IS_ENABLED(HASH_TREE)
+#define HARGS 7
+#elif defined(CONFIG_HASH_VERIFY)
 #define HARGS 6
 #else
 #define HARGS 5
@@ -47,7 +132,14 @@ U_BOOT_CMD(
 	hash,	HARGS,	1,	do_hash,
 	"compute hash message digest",
 	"algorithm address count [[*]hash_dest]\n"
-		"    - compute message digest [save to env var / *address]"
+		"    - compute message digest [save to env var / *address]\n"
+	"hash bench [size]\n"
+		"    - report the throughput of each algorithm hashing size bytes"
+#if CONFIG_IS_ENABLED(HASH_TREE)
+	"\nhash tree [-s] algorithm address count [salt]\n"
+		"    - compute the root digest of the 4 KiB block hash tree\n"
+		"      (dm-verity / AVB hashtree), on all CPUs or, with -s, serially"
+#endif
 #ifdef CONFIG_HASH_VERIFY
 	"\nhash -v algorithm address count [*]hash\n"
 		"    - verify message digest of memory area to immediate value, \n"
@@ -8,12 +8,14 @@
 #include <blk.h>
 #include <command.h>
 #include <console.h>
+#include <deferred.h>
 #include <display_options.h>
 #include <memalign.h>
 #include <mmc.h>
 #include <part.h>
 #include <sparse_format.h>
 #include <image-sparse.h>
+#include <time.h>
 #include <asm/io.h>
 #include <linux/delay.h>
 
@@ -373,6 +375,54 @@ static int do_mmc_read(struct cmd_tbl *cmdtp, int flag,
 	return (n == cnt) ? CMD_RET_SUCCESS : CMD_RET_FAILURE;
 }
 
+static int do_mmc_bench(struct cmd_tbl *cmdtp, int flag,
+			int argc, char *const argv[])
+{
+	struct mmc *mmc;
+	u32 blk, cnt, n;
+	ulong start, us;
+	uint bl_len;
+	bool write;
+	void *addr;
+
+	if (argc != 5)
+		return CMD_RET_USAGE;
+
+	if (!strcmp(argv[1], "read"))
+		write = false;
+	else if (CONFIG_IS_ENABLED(MMC_WRITE) && !strcmp(argv[1], "write"))
+		write = true;
+	else
+		return CMD_RET_USAGE;
+
+	addr = (void *)hextoul(argv[2], NULL);
+	blk = hextoul(argv[3], NULL);
+	cnt = hextoul(argv[4], NULL);
+
+	mmc = init_mmc_device(curr_device, false);
+	if (!mmc)
+		return CMD_RET_FAILURE;
+
+	if (write && mmc_getwp(mmc) == 1) {
+		printf("Error: card is write protected!\n");
+		return CMD_RET_FAILURE;
+	}
+
+	start = timer_get_us();
+	if (write)
+		n = blk_dwrite(mmc_get_blk_desc(mmc), blk, cnt, addr);
+	else
+		n = blk_dread(mmc_get_blk_desc(mmc), blk, cnt, addr);
+	us = max(timer_get_us() - start, 1UL);
+	bl_len = write ? mmc->write_bl_len : mmc->read_bl_len;
+
+	printf("MMC bench %s: dev # %d, %s, %u blocks in %lu us, %llu MB/s\n",
+	       argv[1], curr_device, mmc_mode_name(mmc->selected_mode), n, us,
+	       (u64)n * bl_len / us);
+
+	return (n == cnt) ? CMD_RET_SUCCESS : CMD_RET_FAILURE;
+}
+
 #if CONFIG_IS_ENABLED(CMD_MMC_SWRITE)
 static lbaint_t mmc_sparse_write(struct sparse_storage *info, lbaint_t blk,
 				 lbaint_t blkcnt, const void *buffer)
@@ -1077,6 +1127,7 @@ static int do_mmc_boot_wp(struct cmd_tbl *cmdtp, int flag,
 static struct cmd_tbl cmd_mmc[] = {
 	U_BOOT_CMD_MKENT(info, 1, 0, do_mmcinfo, "", ""),
 	U_BOOT_CMD_MKENT(read, 4, 1, do_mmc_read, "", ""),
+	U_BOOT_CMD_MKENT(bench, 5, 0, do_mmc_bench, "", ""),
 	U_BOOT_CMD_MKENT(wp, 2, 0, do_mmc_boot_wp, "", ""),
 #if CONFIG_IS_ENABLED(MMC_WRITE)
 	U_BOOT_CMD_MKENT(write, 4, 0, do_mmc_write, "", ""),
@@ -1163,7 +1214,7 @@ static int do_imgupdate(struct cmd_tbl *cmdtp, int flag,
 		if(value == 1)
 			break;
 		
-		udelay(500*1000);
+		deferred_udelay(500*1000);
 		i--;
 	}
 
@@ -1192,6 +1243,7 @@ U_BOOT_CMD(
 	"mmc swrite addr blk#\n"
 #endif
 	"mmc erase blk# cnt\n"
+	"mmc bench read|write addr blk# cnt - time a raw transfer of cnt blocks\n"
 	"mmc rescan [mode]\n"
 	"mmc part - lists available partition on current mmc device\n"
 	"mmc dev [dev] [part] [mode] - show or set current mmc device [partition] and set mode\n"
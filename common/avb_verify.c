@@ -7,10 +7,13 @@
 #include <avb_verify.h>
 #include <blk.h>
 #include <cpu_func.h>
+#include <div64.h>
+#include <hash_tree.h>
 #include <image.h>
 #include <malloc.h>
 #include <part.h>
 #include <tee.h>
+#include <time.h>
 #include <tee/optee_ta_avb.h>
 
 static unsigned char avb_root_pub[520] = {
@@ -296,18 +299,14 @@ static unsigned long mmc_write(struct mmc_part *part, lbaint_t start,
 			  start, sectors, tmp_buf);
 }
 
-static struct mmc_part *get_partition(AvbOps *ops, const char *partition)
+static int get_partition(AvbOps *ops, const char *partition,
+			 struct mmc_part *part)
 {
 	int ret;
 	u8 dev_num;
 	int part_num = 0;
-	struct mmc_part *part;
 	struct blk_desc *mmc_blk;
 
-	part = malloc(sizeof(struct mmc_part));
-	if (!part)
-		return NULL;
-
 	dev_num = get_boot_device(ops);
 	part->mmc = find_mmc_device(dev_num);
 	if (!part->mmc) {
@@ -339,10 +338,9 @@ static struct mmc_part *get_partition(AvbOps *ops, const char *partition)
 	part->dev_num = dev_num;
 	part->mmc_blk = mmc_blk;
 
-	return part;
+	return 0;
 err:
-	free(part);
-	return NULL;
+	return -ENODEV;
 }
 
 static AvbIOResult mmc_byte_io(AvbOps *ops,
@@ -354,7 +352,7 @@ static AvbIOResult mmc_byte_io(AvbOps *ops,
 			       enum mmc_io_type io_type)
 {
 	ulong ret;
-	struct mmc_part *part;
+	struct mmc_part found, *part = &found;
 	u64 start_offset, start_sector, sectors, residue;
 	u8 *tmp_buf;
 	size_t io_cnt = 0;
@@ -362,8 +360,7 @@ static AvbIOResult mmc_byte_io(AvbOps *ops,
 	if (!partition || !buffer || io_type > IO_WRITE)
 		return AVB_IO_RESULT_ERROR_IO;
 
-	part = get_partition(ops, partition);
-	if (!part)
+	if (get_partition(ops, partition, part))
 		return AVB_IO_RESULT_ERROR_NO_SUCH_PARTITION;
 
 	if (!part->info.blksz)
@@ -587,18 +584,69 @@ static AvbIOResult validate_vbmeta_public_key(AvbOps *ops,
 	return AVB_IO_RESULT_OK;
 }
 
-static AvbIOResult get_preloaded_partition (AvbOps* ops,
-                                         const char* partition,
-                                         size_t num_bytes,
-                                         uint8_t** out_pointer,
-                                         size_t* out_num_bytes_preloaded)
+/*
+ * The boot partition is read directly to kernel_addr, so the buffer that
+ * libavb hashes is the same one later handed to bootm and the image never
+ * has to be read or copied a second time. Other partitions are left to
+ * libavb, which allocates its own buffer for them.
+ */
+static void *avb_preload_addr(const char *partition)
+{
+	if (strncmp(partition, "boot", 4) ||
+	    (partition[4] != '\0' && partition[4] != '_'))
+		return NULL;
+
+	return (void *)env_get_ulong("kernel_addr", 16, 0);
+}
+
+/**
+ * get_preload_buffer() - gets the address a partition is preloaded to
+ *
+ * @ops: contains AVB ops handlers
+ * @partition: partition name, including the slot suffix
+ * @num_bytes: image size given by the hash descriptor
+ * @out_pointer: set to the preload buffer, or NULL if not preloaded
+ *
+ * @return:
+ *      AVB_IO_RESULT_OK
+ */
+static AvbIOResult get_preload_buffer(AvbOps *ops,
+				      const char *partition,
+				      size_t num_bytes,
+				      u8 **out_pointer)
 {
-    void *buffer;
+	*out_pointer = avb_preload_addr(partition);
 
-    buffer = (void *)env_get_ulong("kernel_addr", 16, 0);
-    *out_pointer = buffer;
-    return ops->read_from_partition(ops, partition, 0, num_bytes, buffer,
-                            out_num_bytes_preloaded);
+	return AVB_IO_RESULT_OK;
+}
+
+/**
+ * get_preloaded_partition() - load a partition straight to its boot address
+ *
+ * @ops: contains AVB ops handlers
+ * @partition: partition name, including the slot suffix
+ * @num_bytes: image size given by the hash descriptor
+ * @out_pointer: set to the preloaded buffer, or NULL if not preloaded
+ * @out_num_bytes_preloaded: amount of bytes read
+ *
+ * @return:
+ *      AVB_IO_RESULT_OK, if the partition was preloaded or skipped
+ */
+static AvbIOResult get_preloaded_partition(AvbOps *ops,
+					   const char *partition,
+					   size_t num_bytes,
+					   u8 **out_pointer,
+					   size_t *out_num_bytes_preloaded)
+{
+	void *buffer;
+
+	buffer = avb_preload_addr(partition);
+	*out_pointer = buffer;
+	if (!buffer)
+		return AVB_IO_RESULT_OK;
+
+	return ops->read_from_partition(ops, partition, 0, num_bytes, buffer,
+					out_num_bytes_preloaded);
 }
 
 #ifdef CONFIG_OPTEE_TA_AVB
@@ -662,6 +710,121 @@ static AvbIOResult invoke_func(struct AvbOpsData *ops_data, u32 func,
 		return AVB_IO_RESULT_ERROR_IO;
 	}
 }
+
+/**
+ * struct avb_ta_value - Persistent value cached in struct avb_ta_cache
+ *
+ * @next:	Next value in the list
+ * @name:	Name of the value
+ * @size:	Size of @data
+ * @data:	Value, followed by @name
+ */
+struct avb_ta_value {
+	struct avb_ta_value *next;
+	const char *name;
+	size_t size;
+	u8 data[];
+};
+
+/*
+ * Read the lock state and all rollback indexes in one call, each of them
+ * is otherwise a world switch and an RPMB read in OP-TEE. Only tried once,
+ * a TA without the command leaves the cache to fill one read at a time.
+ */
+static void ta_cache_load(struct AvbOpsData *ops_data)
+{
+	struct avb_ta_cache *ta = &ops_data->ta;
+	struct tee_param param;
+	struct tee_shm *shm;
+	u64 *state;
+	int i;
+
+	if (ta->loaded)
+		return;
+	ta->loaded = true;
+
+	if (get_open_session(ops_data))
+		return;
+	if (tee_shm_alloc(ops_data->tee, TA_AVB_STATE_SIZE, TEE_SHM_ALLOC,
+			  &shm))
+		return;
+
+	memset(&param, 0, sizeof(param));
+	param.attr = TEE_PARAM_ATTR_TYPE_MEMREF_OUTPUT;
+	param.u.memref.shm = shm;
+	param.u.memref.size = TA_AVB_STATE_SIZE;
+
+	if (!invoke_func(ops_data, TA_AVB_CMD_READ_STATE, 1, &param) &&
+	    param.u.memref.size == TA_AVB_STATE_SIZE) {
+		state = shm->addr;
+		ta->lock_state = state[0];
+		ta->lock_valid = true;
+		for (i = 0; i < TA_AVB_MAX_ROLLBACK_LOCATIONS; i++) {
+			ta->rb[i] = state[1 + i];
+			ta->rb_flags[i] = AVB_TA_RB_VALID;
+		}
+	}
+
+	tee_shm_free(shm);
+}
+
+static struct avb_ta_value *ta_cache_find(struct avb_ta_cache *ta,
+					  const char *name)
+{
+	struct avb_ta_value *val;
+
+	for (val = ta->values; val; val = val->next)
+		if (!strcmp(val->name, name))
+			return val;
+
+	return NULL;
+}
+
+static void ta_cache_drop(struct avb_ta_cache *ta, const char *name)
+{
+	struct avb_ta_value **link, *val;
+
+	for (link = &ta->values; *link; link = &(*link)->next) {
+		val = *link;
+		if (!strcmp(val->name, name)) {
+			*link = val->next;
+			avb_free(val);
+			return;
+		}
+	}
+}
+
+static void ta_cache_add(struct avb_ta_cache *ta, const char *name,
+			 const u8 *data, size_t size)
+{
+	size_t name_size = strlen(name) + 1;
+	struct avb_ta_value *val;
+
+	ta_cache_drop(ta, name);
+
+	/* Only a cache, the TA still has the value if this fails */
+	val = avb_malloc(sizeof(*val) + size + name_size);
+	if (!val)
+		return;
+
+	memcpy(val->data, data, size);
+	memcpy(val->data + size, name, name_size);
+	val->name = (const char *)val->data + size;
+	val->size = size;
+	val->next = ta->values;
+	ta->values = val;
+}
+
+static void ta_cache_free(struct avb_ta_cache *ta)
+{
+	struct avb_ta_value *val;
+
+	while (ta->values) {
+		val = ta->values;
+		ta->values = val->next;
+		avb_free(val);
+	}
+}
 #endif
 
 /**
@@ -688,24 +851,34 @@ static AvbIOResult read_rollback_index(AvbOps *ops,
 
 	return AVB_IO_RESULT_OK;
 #else
+	struct AvbOpsData *ops_data = ops->user_data;
+	struct avb_ta_cache *ta = &ops_data->ta;
 	AvbIOResult rc;
 	struct tee_param param[2];
 
 	if (rollback_index_slot >= TA_AVB_MAX_ROLLBACK_LOCATIONS)
 		return AVB_IO_RESULT_ERROR_NO_SUCH_VALUE;
 
+	ta_cache_load(ops_data);
+	if (ta->rb_flags[rollback_index_slot] & AVB_TA_RB_VALID) {
+		*out_rollback_index = ta->rb[rollback_index_slot];
+		return AVB_IO_RESULT_OK;
+	}
+
 	memset(param, 0, sizeof(param));
 	param[0].attr = TEE_PARAM_ATTR_TYPE_VALUE_INPUT;
 	param[0].u.value.a = rollback_index_slot;
 	param[1].attr = TEE_PARAM_ATTR_TYPE_VALUE_OUTPUT;
 
-	rc = invoke_func(ops->user_data, TA_AVB_CMD_READ_ROLLBACK_INDEX,
+	rc = invoke_func(ops_data, TA_AVB_CMD_READ_ROLLBACK_INDEX,
 			 ARRAY_SIZE(param), param);
 	if (rc)
 		return rc;
 
-	*out_rollback_index = (u64)param[1].u.value.a << 32 |
-			      (u32)param[1].u.value.b;
+	ta->rb[rollback_index_slot] = (u64)param[1].u.value.a << 32 |
+				      (u32)param[1].u.value.b;
+	ta->rb_flags[rollback_index_slot] = AVB_TA_RB_VALID;
+	*out_rollback_index = ta->rb[rollback_index_slot];
 	return AVB_IO_RESULT_OK;
 #endif
 }
@@ -731,20 +904,26 @@ static AvbIOResult write_rollback_index(AvbOps *ops,
 
 	return AVB_IO_RESULT_OK;
 #else
-	struct tee_param param[2];
+	struct AvbOpsData *ops_data = ops->user_data;
+	struct avb_ta_cache *ta = &ops_data->ta;
+	AvbIOResult rc;
+	u64 cur;
 
-	if (rollback_index_slot >= TA_AVB_MAX_ROLLBACK_LOCATIONS)
-		return AVB_IO_RESULT_ERROR_NO_SUCH_VALUE;
+	rc = read_rollback_index(ops, rollback_index_slot, &cur);
+	if (rc)
+		return rc;
 
-	memset(param, 0, sizeof(param));
-	param[0].attr = TEE_PARAM_ATTR_TYPE_VALUE_INPUT;
-	param[0].u.value.a = rollback_index_slot;
-	param[1].attr = TEE_PARAM_ATTR_TYPE_VALUE_INPUT;
-	param[1].u.value.a = (u32)(rollback_index >> 32);
-	param[1].u.value.b = (u32)rollback_index;
+	/* The TA refuses to lower an index, refuse it here already */
+	if (rollback_index < cur)
+		return AVB_IO_RESULT_ERROR_IO;
+	if (rollback_index == cur)
+		return AVB_IO_RESULT_OK;
 
-	return invoke_func(ops->user_data, TA_AVB_CMD_WRITE_ROLLBACK_INDEX,
-			   ARRAY_SIZE(param), param);
+	/* Written to the TA by avb_ops_commit() */
+	ta->rb[rollback_index_slot] = rollback_index;
+	ta->rb_flags[rollback_index_slot] |= AVB_TA_RB_DIRTY;
+
+	return AVB_IO_RESULT_OK;
 #endif
 }
 
@@ -770,13 +949,21 @@ static AvbIOResult read_is_device_unlocked(AvbOps *ops, bool *out_is_unlocked)
 
 	return AVB_IO_RESULT_OK;
 #else
+	struct AvbOpsData *ops_data = ops->user_data;
+	struct avb_ta_cache *ta = &ops_data->ta;
 	AvbIOResult rc;
 	struct tee_param param = { .attr = TEE_PARAM_ATTR_TYPE_VALUE_OUTPUT };
 
-	rc = invoke_func(ops->user_data, TA_AVB_CMD_READ_LOCK_STATE, 1, &param);
-	if (rc)
-		return rc;
-	*out_is_unlocked = !param.u.value.a;
+	ta_cache_load(ops_data);
+	if (!ta->lock_valid) {
+		rc = invoke_func(ops_data, TA_AVB_CMD_READ_LOCK_STATE, 1,
+				 &param);
+		if (rc)
+			return rc;
+		ta->lock_state = param.u.value.a;
+		ta->lock_valid = true;
+	}
+	*out_is_unlocked = !ta->lock_state;
 	return AVB_IO_RESULT_OK;
 #endif
 }
@@ -802,11 +989,10 @@ static AvbIOResult get_unique_guid_for_partition(AvbOps *ops,
 						 char *guid_buf,
 						 size_t guid_buf_size)
 {
-	struct mmc_part *part;
+	struct mmc_part found, *part = &found;
 	size_t uuid_size;
 
-	part = get_partition(ops, partition);
-	if (!part)
+	if (get_partition(ops, partition, part))
 		return AVB_IO_RESULT_ERROR_NO_SUCH_PARTITION;
 
 	uuid_size = sizeof(part->info.uuid);
@@ -836,13 +1022,12 @@ static AvbIOResult get_size_of_partition(AvbOps *ops,
 					 const char *partition,
 					 u64 *out_size_num_bytes)
 {
-	struct mmc_part *part;
+	struct mmc_part found, *part = &found;
 
 	if (!out_size_num_bytes)
 		return AVB_IO_RESULT_ERROR_INSUFFICIENT_SPACE;
 
-	part = get_partition(ops, partition);
-	if (!part)
+	if (get_partition(ops, partition, part))
 		return AVB_IO_RESULT_ERROR_NO_SUCH_PARTITION;
 
 	*out_size_num_bytes = part->info.blksz * part->info.size;
@@ -857,6 +1042,8 @@ static AvbIOResult read_persistent_value(AvbOps *ops,
 					 u8 *out_buffer,
 					 size_t *out_num_bytes_read)
 {
+	struct avb_ta_cache *ta = &((struct AvbOpsData *)ops->user_data)->ta;
+	struct avb_ta_value *val;
 	AvbIOResult rc;
 	struct tee_shm *shm_name;
 	struct tee_shm *shm_buf;
@@ -864,6 +1051,15 @@ static AvbIOResult read_persistent_value(AvbOps *ops,
 	struct udevice *tee;
 	size_t name_size = strlen(name) + 1;
 
+	val = ta_cache_find(ta, name);
+	if (val) {
+		*out_num_bytes_read = val->size;
+		if (val->size > buffer_size)
+			return AVB_IO_RESULT_ERROR_INSUFFICIENT_SPACE;
+		memcpy(out_buffer, val->data, val->size);
+		return AVB_IO_RESULT_OK;
+	}
+
 	if (get_open_session(ops->user_data))
 		return AVB_IO_RESULT_ERROR_IO;
 
@@ -904,6 +1100,7 @@ static AvbIOResult read_persistent_value(AvbOps *ops,
 	*out_num_bytes_read = param[1].u.memref.size;
 
 	memcpy(out_buffer, shm_buf->addr, *out_num_bytes_read);
+	ta_cache_add(ta, name, out_buffer, *out_num_bytes_read);
 
 out:
 	tee_shm_free(shm_buf);
@@ -921,6 +1118,7 @@ static AvbIOResult write_persistent_value(AvbOps *ops,
 	AvbIOResult rc;
 	struct tee_shm *shm_name;
 	struct tee_shm *shm_buf;
+	struct avb_ta_cache *ta = &((struct AvbOpsData *)ops->user_data)->ta;
 	struct tee_param param[2];
 	struct udevice *tee;
 	size_t name_size = strlen(name) + 1;
@@ -956,11 +1154,15 @@ static AvbIOResult write_persistent_value(AvbOps *ops,
 	param[1].u.memref.shm = shm_buf;
 	param[1].u.memref.size = value_size;
 
+	/* Written through, a persistent value is expected to be durable */
+	ta_cache_drop(ta, name);
 	rc = invoke_func(ops->user_data, TA_AVB_CMD_WRITE_PERSIST_VALUE,
 			 2, param);
 	if (rc)
 		goto out;
 
+	ta_cache_add(ta, name, value, value_size);
+
 out:
 	tee_shm_free(shm_buf);
 free_name:
@@ -970,6 +1172,282 @@ free_name:
 }
 #endif
 
+#if CONFIG_IS_ENABLED(AVB_HASHTREE_CHECK)
+/**
+ * ============================================================================
+ * dm-verity hashtree spot check
+ * ============================================================================
+ */
+struct avb_hashtree_check {
+	AvbOps *ops;
+	const char *ab_suffix;
+	int ret;
+};
+
+static int avb_hashtree_read(AvbOps *ops, const char *partition, u64 offset,
+			     size_t num_bytes, void *buffer)
+{
+	size_t num_read;
+
+	if (ops->read_from_partition(ops, partition, offset, num_bytes,
+				     buffer, &num_read) != AVB_IO_RESULT_OK ||
+	    num_read != num_bytes)
+		return -EIO;
+
+	return 0;
+}
+
+/*
+ * Check every level of the tree against the level below it and the top
+ * one against the root digest, then the sampled data blocks against the
+ * bottom level. This reads the whole tree.
+ */
+static int avb_check_hashtree_full(AvbOps *ops,
+				   const AvbHashtreeDescriptor *desc,
+				   const char *partition,
+				   const struct hash_tree *tree,
+				   const struct hash_tree_layout *layout,
+				   const u8 *root_digest, uint samples)
+{
+	int digest_size = hash_tree_digest_size(tree);
+	int entry = hash_tree_entry_size(tree);
+	u8 digest[HASH_TREE_MAX_DIGEST];
+	u64 nr_blocks, blk, offset;
+	u8 *levels, *buf;
+	int level, top, i, ret;
+	size_t len;
+
+	levels = malloc(layout->tree_size);
+	buf = malloc(max_t(u64, layout->nr_levels > 1 ? layout->size[1] : 0,
+			   tree->block_size));
+	if (!levels || !buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = avb_hashtree_read(ops, partition, desc->tree_offset,
+				layout->tree_size, levels);
+	if (ret)
+		goto out;
+
+	ret = -EBADMSG;
+	top = layout->nr_levels - 1;
+	for (level = 0; level < top; level++) {
+		if (hash_tree_level(tree, levels + layout->offset[level],
+				    layout->size[level], buf) ||
+		    memcmp(buf, levels + layout->offset[level + 1],
+			   layout->size[level + 1]))
+			goto out;
+	}
+	if (hash_tree_hash_block(tree, levels + layout->offset[top],
+				 layout->size[top], digest) ||
+	    memcmp(digest, root_digest, digest_size))
+		goto out;
+
+	/* The first and last blocks and a few evenly spread in between */
+	nr_blocks = DIV_ROUND_UP_ULL(desc->image_size, tree->block_size);
+	samples = min_t(u64, samples, nr_blocks);
+	for (i = 0; i < samples; i++) {
+		blk = samples > 1 ? i * (nr_blocks - 1) / (samples - 1) : 0;
+		offset = blk * tree->block_size;
+		len = min_t(u64, desc->image_size - offset, tree->block_size);
+		ret = avb_hashtree_read(ops, partition, offset, len, buf);
+		if (ret)
+			goto out;
+		ret = -EBADMSG;
+		if (hash_tree_hash_block(tree, buf, len, digest) ||
+		    memcmp(digest, levels + layout->offset[0] + blk * entry,
+			   digest_size))
+			goto out;
+	}
+	ret = 0;
+
+out:
+	free(buf);
+	free(levels);
+
+	return ret;
+}
+
+/*
+ * Check data block @blk up to the root digest, reading only the one hash
+ * block it depends on at each level
+ */
+static int avb_check_hashtree_path(AvbOps *ops,
+				   const AvbHashtreeDescriptor *desc,
+				   const char *partition,
+				   const struct hash_tree *tree,
+				   const struct hash_tree_layout *layout,
+				   const u8 *root_digest, u64 blk, u8 *buf)
+{
+	int digest_size = hash_tree_digest_size(tree);
+	int entry = hash_tree_entry_size(tree);
+	u8 digest[HASH_TREE_MAX_DIGEST];
+	u64 offset = blk * tree->block_size;
+	size_t len;
+	uint pos;
+	int level, ret;
+
+	len = min_t(u64, desc->image_size - offset, tree->block_size);
+	ret = avb_hashtree_read(ops, partition, offset, len, buf);
+	if (ret)
+		return ret;
+	if (hash_tree_hash_block(tree, buf, len, digest))
+		return -EBADMSG;
+
+	for (level = 0; level < layout->nr_levels; level++) {
+		/* Entry @blk of this level: which block, and where in it */
+		blk *= entry;
+		pos = do_div(blk, tree->block_size);
+		ret = avb_hashtree_read(ops, partition, desc->tree_offset +
+					layout->offset[level] +
+					blk * tree->block_size,
+					tree->block_size, buf);
+		if (ret)
+			return ret;
+		if (memcmp(digest, buf + pos, digest_size) ||
+		    hash_tree_hash_block(tree, buf, tree->block_size, digest))
+			return -EBADMSG;
+	}
+
+	return memcmp(digest, root_digest, digest_size) ? -EBADMSG : 0;
+}
+
+/*
+ * Check the hashtree of a partition against its root digest: the first and
+ * last data blocks and a few evenly spread in between, each up to the root.
+ * The kernel checks the rest of the data as it reads it.
+ */
+static int avb_check_hashtree(AvbOps *ops, const AvbHashtreeDescriptor *desc,
+			      const char *partition, const u8 *salt,
+			      const u8 *root_digest)
+{
+	char algo[sizeof(desc->hash_algorithm) + 1];
+	struct hash_tree_layout layout;
+	struct hash_tree tree;
+	u64 nr_blocks, blk;
+	int digest_size, i, ret;
+	uint samples = CONFIG_AVB_HASHTREE_CHECK_SAMPLES;
+	u8 *buf;
+
+	memcpy(algo, desc->hash_algorithm, sizeof(desc->hash_algorithm));
+	algo[sizeof(desc->hash_algorithm)] = '\0';
+	tree.algo = algo;
+	tree.block_size = desc->data_block_size;
+	tree.salt = salt;
+	tree.salt_len = desc->salt_len;
+	tree.serial = false;
+
+	/* A persistent digest or a layout avbtool does not produce */
+	if (!desc->root_digest_len ||
+	    desc->data_block_size != desc->hash_block_size)
+		return -EPROTONOSUPPORT;
+
+	digest_size = hash_tree_digest_size(&tree);
+	if (digest_size < 0)
+		return digest_size;
+	if (desc->root_digest_len != digest_size)
+		return -EINVAL;
+
+	ret = hash_tree_layout(&tree, desc->image_size, &layout);
+	if (ret)
+		return ret;
+	if (layout.tree_size != desc->tree_size)
+		return -EINVAL;
+	if (!layout.nr_levels)
+		return -EPROTONOSUPPORT;
+
+	if (IS_ENABLED(CONFIG_AVB_HASHTREE_CHECK_FULL))
+		return avb_check_hashtree_full(ops, desc, partition, &tree,
+					       &layout, root_digest, samples);
+
+	buf = malloc(tree.block_size);
+	if (!buf)
+		return -ENOMEM;
+
+	/* At least the first block, which also checks the top level */
+	nr_blocks = DIV_ROUND_UP_ULL(desc->image_size, tree.block_size);
+	samples = clamp_t(u64, samples, 1, nr_blocks);
+	for (i = 0; i < samples && !ret; i++) {
+		blk = samples > 1 ? i * (nr_blocks - 1) / (samples - 1) : 0;
+		ret = avb_check_hashtree_path(ops, desc, partition, &tree,
+					      &layout, root_digest, blk, buf);
+	}
+	free(buf);
+
+	return ret;
+}
+
+static bool avb_check_hashtree_desc(const AvbDescriptor *descriptor,
+				    void *user_data)
+{
+	const AvbHashtreeDescriptor *raw = (const void *)descriptor;
+	struct avb_hashtree_check *check = user_data;
+	AvbHashtreeDescriptor desc;
+	AvbDescriptor header;
+	char partition[64];
+	const u8 *name, *salt;
+	ulong start;
+	int ret;
+
+	if (!avb_descriptor_validate_and_byteswap(descriptor, &header) ||
+	    header.tag != AVB_DESCRIPTOR_TAG_HASHTREE)
+		return true;
+	if (!avb_hashtree_descriptor_validate_and_byteswap(raw, &desc)) {
+		check->ret = -EINVAL;
+		return false;
+	}
+
+	name = (const u8 *)raw + sizeof(*raw);
+	salt = name + desc.partition_name_len;
+	snprintf(partition, sizeof(partition), "%.*s%s",
+		 (int)desc.partition_name_len, name,
+		 desc.flags & AVB_HASHTREE_DESCRIPTOR_FLAGS_DO_NOT_USE_AB ?
+		 "" : check->ab_suffix);
+
+	start = get_timer(0);
+	ret = avb_check_hashtree(check->ops, &desc, partition, salt,
+				 salt + desc.salt_len);
+	switch (ret) {
+	case 0:
+		printf("Hashtree of '%s' checked in %lu ms\n", partition,
+		       get_timer(start));
+		break;
+	case -EPROTONOSUPPORT:
+		break;
+	case -EBADMSG:
+	case -EINVAL:
+		printf("Hashtree of '%s' does not match (err=%d)\n",
+		       partition, ret);
+		check->ret = ret;
+		return false;
+	default:
+		printf("Cannot check hashtree of '%s' (err=%d)\n", partition,
+		       ret);
+	}
+
+	return true;
+}
+
+int avb_check_hashtrees(AvbOps *ops, AvbSlotVerifyData *data)
+{
+	struct avb_hashtree_check check = {
+		.ops = ops,
+		.ab_suffix = data->ab_suffix,
+	};
+	AvbVBMetaData *vbmeta;
+	size_t i;
+
+	for (i = 0; i < data->num_vbmeta_images && !check.ret; i++) {
+		vbmeta = &data->vbmeta_images[i];
+		avb_descriptor_foreach(vbmeta->vbmeta_data, vbmeta->vbmeta_size,
+				       avb_check_hashtree_desc, &check);
+	}
+
+	return check.ret;
+}
+#endif
+
 /**
  * ============================================================================
  * AVB2.0 AvbOps alloc/initialisation/free
@@ -1032,6 +1510,7 @@ setup_public_ops:
 	ops_data->ops.write_rollback_index = write_rollback_index;
 	ops_data->ops.read_is_device_unlocked = read_is_device_unlocked;
 	ops_data->ops.get_preloaded_partition = get_preloaded_partition;
+	ops_data->ops.get_preload_buffer = get_preload_buffer;
 
 #ifdef CONFIG_OPTEE_TA_AVB
 	ops_data->ops.write_persistent_value = write_persistent_value;
@@ -1043,6 +1522,82 @@ setup_public_ops:
 	return &ops_data->ops;
 }
 
+/**
+ * avb_ops_commit() - Write rollback index updates to the TA
+ *
+ * write_rollback_index() only records the new index, so that updates made
+ * while verifying reach the TA, and its secure storage, in one go. The TA
+ * has no batched write command though: this is still one
+ * TA_AVB_CMD_WRITE_ROLLBACK_INDEX invocation, and one RPMB write in
+ * OP-TEE, per slot changed since the last commit.
+ *
+ * @ops: AvbOps handlers
+ * Return: 0 if OK, -EIO if an index could not be written
+ */
+int avb_ops_commit(AvbOps *ops)
+{
+#ifdef CONFIG_OPTEE_TA_AVB
+	struct AvbOpsData *ops_data;
+	struct avb_ta_cache *ta;
+	struct tee_param param[2];
+	int ret = 0;
+	int i;
+
+	if (!ops || !ops->user_data)
+		return 0;
+
+	ops_data = ops->user_data;
+	ta = &ops_data->ta;
+	for (i = 0; i < TA_AVB_MAX_ROLLBACK_LOCATIONS; i++) {
+		if (!(ta->rb_flags[i] & AVB_TA_RB_DIRTY))
+			continue;
+
+		memset(param, 0, sizeof(param));
+		param[0].attr = TEE_PARAM_ATTR_TYPE_VALUE_INPUT;
+		param[0].u.value.a = i;
+		param[1].attr = TEE_PARAM_ATTR_TYPE_VALUE_INPUT;
+		param[1].u.value.a = (u32)(ta->rb[i] >> 32);
+		param[1].u.value.b = (u32)ta->rb[i];
+
+		if (invoke_func(ops_data, TA_AVB_CMD_WRITE_ROLLBACK_INDEX,
+				ARRAY_SIZE(param), param)) {
+			/* Ask the TA again what it has */
+			ta->rb_flags[i] = 0;
+			ret = -EIO;
+			continue;
+		}
+		ta->rb_flags[i] &= ~AVB_TA_RB_DIRTY;
+	}
+
+	return ret;
+#else
+	return 0;
+#endif
+}
+
+/**
+ * avb_ops_drop_values() - Forget the cached persistent values
+ *
+ * Persistent values can also be written to the TA without these AvbOps,
+ * e.g. by the optee_rpmb command. Callers which keep the AvbOps across
+ * commands drop the values once a command is done, so that the next read
+ * asks the TA again.
+ *
+ * @ops: AvbOps handlers
+ */
+void avb_ops_drop_values(AvbOps *ops)
+{
+#ifdef CONFIG_OPTEE_TA_AVB
+	struct AvbOpsData *ops_data;
+
+	if (!ops || !ops->user_data)
+		return;
+
+	ops_data = ops->user_data;
+	ta_cache_free(&ops_data->ta);
+#endif
+}
+
 void avb_ops_free(AvbOps *ops)
 {
 	struct AvbOpsData *ops_data;
@@ -1054,8 +1609,11 @@ void avb_ops_free(AvbOps *ops)
 
 	if (ops_data) {
 #ifdef CONFIG_OPTEE_TA_AVB
+		if (avb_ops_commit(ops))
+			printf("%s: rollback indexes not written\n", __func__);
 		if (ops_data->tee)
 			tee_close_session(ops_data->tee, ops_data->session);
+		ta_cache_free(&ops_data->ta);
 #endif
 		avb_free(ops_data);
 	}
@@ -115,38 +115,31 @@ static unsigned long blk_write(struct blk_part *part, lbaint_t start,
 			  start, sectors, tmp_buf);
 }
 
-static struct blk_part *get_partition(AvbOps *ops, const char *partition)
+static int get_partition(AvbOps *ops, const char *partition,
+			 struct blk_part *part)
 {
 	int ret;
 	u8 dev_num;
-	struct blk_part *part;
 	struct blk_desc *desc;
 	struct blk_avb_info *info = OPS_TO_INFO(ops);
 
-	part = malloc(sizeof(struct blk_part));
-	if (!part)
-		return NULL;
-
 	dev_num = get_boot_device(ops);
 
 	desc = blk_get_dev(info->if_typename, dev_num);
 	if (!desc) {
 		printf("Can't find dev_num '%d' blk %p\n", dev_num, desc);
-		goto err;
+		return -ENODEV;
 	}
 
 	ret = part_get_info_by_name(desc, partition, &part->info);
 	if (ret < 0) {
 		printf("Can't find partition '%s'\n", partition);
-		goto err;
+		return ret;
 	}
 
 	part->dev_num = dev_num;
 	part->blk_desc = desc;
-	return part;
-err:
-	free(part);
-	return NULL;
+	return 0;
 }
 
 static AvbIOResult blk_byte_io(AvbOps *ops,
@@ -158,7 +151,7 @@ static AvbIOResult blk_byte_io(AvbOps *ops,
 			       enum mmc_io_type io_type)
 {
 	ulong ret;
-	struct blk_part *part;
+	struct blk_part found, *part = &found;
 	u64 start_offset, start_sector, sectors, residue, part_size;
 	u8 *tmp_buf;
 	size_t io_cnt = 0;
@@ -166,8 +159,7 @@ static AvbIOResult blk_byte_io(AvbOps *ops,
 	if (!partition || !buffer || io_type > IO_WRITE)
 		return AVB_IO_RESULT_ERROR_IO;
 
-	part = get_partition(ops, partition);
-	if (!part)
+	if (get_partition(ops, partition, part))
 		return AVB_IO_RESULT_ERROR_NO_SUCH_PARTITION;
 
 	if (!part->info.blksz)
@@ -351,11 +343,10 @@ static AvbIOResult get_unique_guid_for_partition(AvbOps *ops,
 						 char *guid_buf,
 						 size_t guid_buf_size)
 {
-	struct blk_part *part;
+	struct blk_part found, *part = &found;
 	size_t uuid_size;
 
-	part = get_partition(ops, partition);
-	if (!part)
+	if (get_partition(ops, partition, part))
 		return AVB_IO_RESULT_ERROR_NO_SUCH_PARTITION;
 
 	uuid_size = sizeof(part->info.uuid);
@@ -385,13 +376,12 @@ static AvbIOResult get_size_of_partition(AvbOps *ops,
 					 const char *partition,
 					 u64 *out_size_num_bytes)
 {
-	struct blk_part *part;
+	struct blk_part found, *part = &found;
 
 	if (!out_size_num_bytes)
 		return AVB_IO_RESULT_ERROR_INSUFFICIENT_SPACE;
 
-	part = get_partition(ops, partition);
-	if (!part)
+	if (get_partition(ops, partition, part))
 		return AVB_IO_RESULT_ERROR_NO_SUCH_PARTITION;
 
 	*out_size_num_bytes = part->info.blksz * part->info.size;
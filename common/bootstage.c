@@ -26,6 +26,8 @@ DECLARE_GLOBAL_DATA_PTR;
 
 enum {
 	RECORD_COUNT = CONFIG_VAL(BOOTSTAGE_RECORD_COUNT),
+	IO_COUNT = 16,
+	IO_NAME_LEN = 16,
 };
 
 struct bootstage_record {
@@ -36,10 +38,22 @@ struct bootstage_record {
 	enum bootstage_id id;
 };
 
+/* Reads from one storage device */
+struct bootstage_io {
+	char name[IO_NAME_LEN];
+	uint64_t bytes;
+	ulong time_us;
+	uint reads;
+};
+
 struct bootstage_data {
 	uint rec_count;
 	uint next_id;
 	struct bootstage_record record[RECORD_COUNT];
+#ifdef ENABLE_BOOTSTAGE_TIMELINE
+	uint io_count;
+	struct bootstage_io io[IO_COUNT];
+#endif
 };
 
 enum {
@@ -218,6 +232,39 @@ uint32_t bootstage_accum(enum bootstage_id id)
 	return duration;
 }
 
+#ifdef ENABLE_BOOTSTAGE_TIMELINE
+void bootstage_io(const char *dev, int devnum, uint64_t bytes, ulong start_us)
+{
+	struct bootstage_data *data = gd->bootstage;
+	char name[IO_NAME_LEN];
+	struct bootstage_io *io;
+	uint i;
+
+	if (!data)
+		return;
+
+	if (devnum >= 0)
+		snprintf(name, sizeof(name), "%s%d", dev, devnum);
+	else
+		strlcpy(name, dev, sizeof(name));
+
+	for (i = 0, io = data->io; i < data->io_count; i++, io++) {
+		if (!strcmp(io->name, name))
+			break;
+	}
+	if (i == data->io_count) {
+		if (i == IO_COUNT)
+			return;
+		strcpy(io->name, name);
+		data->io_count++;
+	}
+
+	io->bytes += bytes;
+	io->time_us += timer_get_boot_us() - start_us;
+	io->reads++;
+}
+#endif
+
 /**
  * Get a record name as a printable string
  *
@@ -327,10 +374,21 @@ static int add_bootstages_devicetree(struct fdt_header *blob)
 	return 0;
 }
 
+#ifdef ENABLE_BOOTSTAGE_TIMELINE
+__weak int ft_board_bootstage(void *blob)
+{
+	return 0;
+}
+#endif
+
 int bootstage_fdt_add_report(void)
 {
 	if (add_bootstages_devicetree(working_fdt))
 		puts("bootstage: Failed to add to device tree\n");
+#ifdef ENABLE_BOOTSTAGE_TIMELINE
+	if (ft_board_bootstage(working_fdt))
+		puts("bootstage: Failed to add timeline to device tree\n");
+#endif
 
 	return 0;
 }
@@ -366,6 +424,20 @@ void bootstage_report(void)
 		if (rec->start_us)
 			prev = print_time_record(rec, -1);
 	}
+
+#ifdef ENABLE_BOOTSTAGE_TIMELINE
+	if (data->io_count) {
+		printf("\nStorage reads:\n%11s%11s%9s  %s\n", "Bytes",
+		       "Time", "Reads", "Device");
+		for (i = 0; i < data->io_count; i++) {
+			struct bootstage_io *io = &data->io[i];
+
+			print_grouped_ull(io->bytes, BOOTSTAGE_DIGITS);
+			print_grouped_ull(io->time_us, BOOTSTAGE_DIGITS);
+			printf("%9u  %s\n", io->reads, io->name);
+		}
+	}
+#endif
 }
 
 /**
@@ -390,6 +462,81 @@ static void append_data(char **ptrp, char *end, const void *data, int size)
 	memcpy(ptr, data, size);
 }
 
+#ifdef ENABLE_BOOTSTAGE_TIMELINE
+static bool timeline_skip(const struct bootstage_record *rec)
+{
+	return rec->id != BOOTSTAGE_ID_AWAKE && rec->time_us == 0;
+}
+
+int bootstage_timeline(void *buf, int size)
+{
+	const struct bootstage_data *data = gd->bootstage;
+	const struct bootstage_record *rec;
+	const struct bootstage_io *io;
+	struct bootstage_tl_hdr hdr;
+	char *ptr = buf, *end = ptr + size;
+	uint name = 0;
+	char tmp[20];
+	int count = 0;
+	int i;
+
+	for (rec = data->record, i = 0; i < data->rec_count; i++, rec++)
+		count += !timeline_skip(rec);
+
+	hdr.magic = cpu_to_le32(BOOTSTAGE_TL_MAGIC);
+	hdr.version = cpu_to_le16(BOOTSTAGE_TL_VERSION);
+	hdr.rec_count = cpu_to_le16(count);
+	hdr.io_count = cpu_to_le16(data->io_count);
+	hdr.str_size = 0;
+	append_data(&ptr, end, &hdr, sizeof(hdr));
+
+	for (rec = data->record, i = 0; i < data->rec_count; i++, rec++) {
+		struct bootstage_tl_rec tl;
+
+		if (timeline_skip(rec))
+			continue;
+		tl.time_us = cpu_to_le32(rec->time_us);
+		tl.id = cpu_to_le32(rec->id);
+		tl.flags = cpu_to_le16((rec->start_us ? BOOTSTAGE_TL_ACCUM : 0) |
+				       (rec->flags & BOOTSTAGEF_ERROR ?
+					BOOTSTAGE_TL_ERROR : 0));
+		tl.name = cpu_to_le16(name);
+		append_data(&ptr, end, &tl, sizeof(tl));
+		name += strlen(get_record_name(tmp, sizeof(tmp), rec)) + 1;
+	}
+
+	for (io = data->io, i = 0; i < data->io_count; i++, io++) {
+		struct bootstage_tl_io tl = {};
+
+		tl.bytes = cpu_to_le64(io->bytes);
+		tl.time_us = cpu_to_le32(io->time_us);
+		tl.reads = cpu_to_le32(io->reads);
+		tl.name = cpu_to_le16(name);
+		append_data(&ptr, end, &tl, sizeof(tl));
+		name += strlen(io->name) + 1;
+	}
+
+	for (rec = data->record, i = 0; i < data->rec_count; i++, rec++) {
+		const char *str;
+
+		if (timeline_skip(rec))
+			continue;
+		str = get_record_name(tmp, sizeof(tmp), rec);
+		append_data(&ptr, end, str, strlen(str) + 1);
+	}
+	for (io = data->io, i = 0; i < data->io_count; i++, io++)
+		append_data(&ptr, end, io->name, strlen(io->name) + 1);
+
+	/* Names are referred to by 16-bit offsets */
+	if (name > U16_MAX)
+		return -E2BIG;
+	if (ptr <= end)
+		((struct bootstage_tl_hdr *)buf)->str_size = cpu_to_le16(name);
+
+	return ptr - (char *)buf;
+}
+#endif
+
 int bootstage_stash(void *base, int size)
 {
 	const struct bootstage_data *data = gd->bootstage;
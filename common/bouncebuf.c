@@ -38,6 +38,8 @@ int bounce_buffer_start_extalign(struct bounce_buffer *state, void *data,
 				 size_t alignment,
 				 int (*addr_is_aligned)(struct bounce_buffer *state))
 {
+	size_t flushed = 0;
+
 	state->user_buffer = data;
 	state->bounce_buffer = data;
 	state->len = len;
@@ -50,17 +52,26 @@ int bounce_buffer_start_extalign(struct bounce_buffer *state, void *data,
 		if (!state->bounce_buffer)
 			return -ENOMEM;
 
-		if (state->flags & GEN_BB_READ)
+		if ((state->flags & GEN_BB_READ) &&
+		    IS_ENABLED(CONFIG_HAVE_MEMCPY_FLUSH_DCACHE)) {
+			/* Flush the copy while it is still in the cache */
+			memcpy_flush_dcache(state->bounce_buffer,
+					    state->user_buffer, state->len);
+			flushed = ALIGN_DOWN(state->len, ARCH_DMA_MINALIGN);
+		} else if (state->flags & GEN_BB_READ) {
 			memcpy(state->bounce_buffer, state->user_buffer,
 				state->len);
+		}
 	}
 
 	/*
 	 * Flush data to RAM so DMA reads can pick it up,
 	 * and any CPU writebacks don't race with DMA writes
 	 */
-	flush_dcache_range((unsigned long)state->bounce_buffer,
-				(unsigned long)(state->bounce_buffer) +
+	if (flushed < state->len_aligned)
+		flush_dcache_range((unsigned long)state->bounce_buffer +
+					flushed,
+				   (unsigned long)(state->bounce_buffer) +
 					state->len_aligned);
 
 	return 0;
@@ -7,6 +7,7 @@
 #include <common.h>
 #include <console.h>
 #include <debug_uart.h>
+#include <deferred.h>
 #include <display_options.h>
 #include <dm.h>
 #include <env.h>
@@ -481,6 +482,7 @@ int fgetc(int file)
 		 */
 		for (;;) {
 			WATCHDOG_RESET();
+			deferred_poll();
 			if (CONFIG_IS_ENABLED(CONSOLE_MUX)) {
 				/*
 				 * Upper layer may have already called tstc() so
@@ -572,6 +574,9 @@ int getchar(void)
 
 int tstc(void)
 {
+	/* Callers poll tstc() while waiting, e.g. the autoboot countdown */
+	deferred_poll();
+
 	if (IS_ENABLED(CONFIG_DISABLE_CONSOLE) && (gd->flags & GD_FLG_DISABLE_CONSOLE))
 		return 0;
 
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Cooperative deferred work
+ *
+ * Work items sit in a single list sorted by deadline. deferred_poll() runs
+ * every item that is due, in deadline order, and requeues those whose
+ * callback asks to be called again.
+ */
+
+#define LOG_CATEGORY LOGC_BOOT
+
+#include <common.h>
+#include <bootstage.h>
+#include <deferred.h>
+#include <dm/device.h>
+#include <log.h>
+#include <time.h>
+#include <watchdog.h>
+#include <linux/errno.h>
+
+static LIST_HEAD(deferred_queue);
+static bool deferred_running;
+
+static bool deferred_due(ulong deadline, ulong now)
+{
+	return (long)(now - deadline) >= 0;
+}
+
+static void deferred_insert(struct deferred_work *work)
+{
+	struct deferred_work *pos;
+
+	list_for_each_entry(pos, &deferred_queue, sibling) {
+		if ((long)(work->deadline - pos->deadline) < 0)
+			break;
+	}
+	list_add_tail(&work->sibling, &pos->sibling);
+	work->pending = true;
+}
+
+void deferred_init(struct deferred_work *work, const char *name,
+		   deferred_func_t func, void *priv)
+{
+	memset(work, '\0', sizeof(*work));
+	work->name = name;
+	work->func = func;
+	work->priv = priv;
+	INIT_LIST_HEAD(&work->sibling);
+}
+
+void deferred_schedule(struct deferred_work *work, ulong delay_us)
+{
+	if (work->pending)
+		list_del(&work->sibling);
+	work->deadline = timer_get_us() + delay_us;
+	deferred_insert(work);
+	log_debug("%s: due in %lu us\n", work->name, delay_us);
+}
+
+void deferred_cancel(struct deferred_work *work)
+{
+	if (!work->pending)
+		return;
+	list_del_init(&work->sibling);
+	work->pending = false;
+}
+
+static void deferred_run(struct deferred_work *work)
+{
+	int ret;
+
+	list_del_init(&work->sibling);
+	work->pending = false;
+
+	ret = work->func(work);
+	work->step++;
+	work->ret = ret;
+	if (ret > 0) {
+		work->deadline = timer_get_us() + ret;
+		deferred_insert(work);
+		return;
+	}
+
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, work->name);
+	if (ret < 0)
+		log_err("%s: failed (err=%d)\n", work->name, ret);
+	else
+		log_debug("%s: done after %u steps\n", work->name, work->step);
+}
+
+void deferred_poll(void)
+{
+	struct deferred_work *work;
+	ulong now;
+
+	if (deferred_running || list_empty(&deferred_queue))
+		return;
+
+	deferred_running = true;
+	now = timer_get_us();
+	while (!list_empty(&deferred_queue)) {
+		work = list_first_entry(&deferred_queue, struct deferred_work,
+					sibling);
+		if (!deferred_due(work->deadline, now))
+			break;
+		deferred_run(work);
+	}
+	deferred_running = false;
+}
+
+void deferred_udelay(ulong usec)
+{
+	ulong end = timer_get_us() + usec;
+
+	while (!deferred_due(end, timer_get_us())) {
+		WATCHDOG_RESET();
+		deferred_poll();
+	}
+}
+
+int deferred_wait(struct deferred_work *work)
+{
+	/* A callback cannot wait for work that only it would run */
+	if (deferred_running)
+		return -EDEADLK;
+
+	while (work->pending) {
+		WATCHDOG_RESET();
+		deferred_poll();
+	}
+
+	return work->ret < 0 ? work->ret : 0;
+}
+
+int deferred_wait_dev(struct udevice *dev)
+{
+	struct deferred_work *work, *pos;
+	int ret = 0;
+
+	if (deferred_running)
+		return -EDEADLK;
+
+	do {
+		work = NULL;
+		list_for_each_entry(pos, &deferred_queue, sibling) {
+			if (pos->dev == dev) {
+				work = pos;
+				break;
+			}
+		}
+		if (work) {
+			log_debug("%s: waiting for %s\n", dev->name, work->name);
+			if (deferred_wait(work))
+				ret = work->ret;
+		}
+	} while (work);
+
+	return ret;
+}
+
+void deferred_flush(void)
+{
+	if (deferred_running)
+		return;
+
+	while (!list_empty(&deferred_queue)) {
+		WATCHDOG_RESET();
+		deferred_poll();
+	}
+}
@@ -13,14 +13,18 @@
 #include <common.h>
 #include <command.h>
 #include <env.h>
+#include <hash_tree.h>
 #include <log.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <smp_job.h>
+#include <time.h>
 #include <hw_sha.h>
 #include <asm/cache.h>
 #include <asm/global_data.h>
 #include <asm/io.h>
 #include <linux/errno.h>
+#include <linux/sizes.h>
 #include <u-boot/crc.h>
 #else
 #include "mkimage.h"
@@ -644,5 +648,70 @@ int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 
 	return 0;
 }
+
+#if CONFIG_IS_ENABLED(CMD_HASH)
+/* Name of the implementation used for @algo, for reporting purposes */
+static const char *hash_backend_name(struct hash_algo *algo)
+{
+	if (CONFIG_IS_ENABLED(SHA_HW_ACCEL) &&
+	    (!strcmp(algo->name, "sha1") || !strcmp(algo->name, "sha256")))
+		return "hw";
+#if CONFIG_IS_ENABLED(SHA1)
+	if (!strcmp(algo->name, "sha1"))
+		return sha1_backend_name();
+#endif
+#if CONFIG_IS_ENABLED(SHA256)
+	if (!strcmp(algo->name, "sha256"))
+		return sha256_backend_name();
+#endif
+	return "generic";
+}
+
+int hash_bench(ulong size)
+{
+	u8 output[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	ulong start, us;
+	void *buf;
+	int i;
+
+	reloc_update();
+
+	buf = memalign(ARCH_DMA_MINALIGN, size);
+	if (!buf) {
+		printf("Cannot allocate %lu bytes\n", size);
+		return -ENOMEM;
+	}
+	memset(buf, 0x5a, size);
+
+	printf("Hashing %lu KiB per algorithm\n", size >> 10);
+	for (i = 0; i < ARRAY_SIZE(hash_algo); i++) {
+		algo = &hash_algo[i];
+		start = timer_get_us();
+		algo->hash_func_ws(buf, size, output, algo->chunk_size);
+		us = max(timer_get_us() - start, 1UL);
+		printf("%-12s %-9s %8lu us  %5llu MB/s\n", algo->name,
+		       hash_backend_name(algo), us, (u64)size / us);
+	}
+
+	if (CONFIG_IS_ENABLED(HASH_TREE) && CONFIG_IS_ENABLED(SHA256)) {
+		struct hash_tree tree = { .algo = "sha256", .block_size = SZ_4K };
+
+		for (i = 0; i < 2; i++) {
+			tree.serial = !i;
+			start = timer_get_us();
+			if (hash_tree_root(&tree, buf, size, output))
+				break;
+			us = max(timer_get_us() - start, 1UL);
+			printf("%-12s %u CPU(s) %5lu us  %5llu MB/s\n",
+			       "sha256-tree", tree.serial ? 1 : smp_job_nr_cpus(),
+			       us, (u64)size / us);
+		}
+	}
+	free(buf);
+
+	return 0;
+}
+#endif
 #endif /* CONFIG_CMD_HASH || CONFIG_CMD_SHA1SUM || CONFIG_CMD_CRC32) */
 #endif /* !USE_HOSTCC */
@@ -41,9 +41,8 @@ int hb_extract_filter_name(const char* line, char* filter_name)
     return 0;
 }
 
-int hb_ext4_load(char *filename, unsigned long addr, loff_t *len_read)
+static int hb_ext4_set_dev(void)
 {
-      int ret;
       char dev_part_str[16];
       char *devtype, *devnum, *devplist;
 
@@ -66,6 +65,16 @@ int hb_ext4_load(char *filename, unsigned long addr, loff_t *len_read)
 
       if (fs_set_blk_dev(devtype, dev_part_str, FS_TYPE_EXT))
          return 1;
+
+      return 0;
+}
+
+int hb_ext4_load(char *filename, unsigned long addr, loff_t *len_read)
+{
+      int ret;
+
+      if (hb_ext4_set_dev())
+         return 1;
       ret = fs_read(filename, addr, 0, 0, len_read);
 
       if (ret < 0)
@@ -74,6 +83,21 @@ int hb_ext4_load(char *filename, unsigned long addr, loff_t *len_read)
       return 0;
 }
 
+int hb_ext4_store(char *filename, unsigned long addr, loff_t len)
+{
+      loff_t len_written;
+      int ret;
+
+      if (hb_ext4_set_dev())
+         return 1;
+      ret = fs_write(filename, addr, 0, len, &len_written);
+
+      if (ret < 0 || len_written != len)
+         return 1;
+
+      return 0;
+}
+
 int hb_getline(char str[], int lim, char **mem_ptr)
 {
     char c = '\0';
@@ -39,6 +39,14 @@
 #include <linux/arm-smccc.h>
 #include <linux/sizes.h>
 #include <part.h>
+#include <env.h>
+#include <memalign.h>
+#include <time.h>
+#include <watchdog.h>
+#include <u-boot/zlib.h>
+#include <asm/global_data.h>
+
+DECLARE_GLOBAL_DATA_PTR;
 
 #ifndef MEMDUMP_PARTITION
 #define MEMDUMP_PARTITION            "ramdump"
@@ -84,9 +92,553 @@ static struct blk_desc *memdump_get_blk_desc(char *intf, int dev)
 	return blk_desc;
 }
 
-int memdump_dump_blk_offset(char *intf, int dev, unsigned long dump_start)
+#if CONFIG_IS_ENABLED(MEMDUMP_STREAM)
+/* Room left below the initial stack pointer for U-Boot's own stack */
+#define MEMDUMP_STACK_ROOM	SZ_1M
+#define MEMDUMP_BUF_SIZE	(MEMDUMP_CHUNK_SIZE + 2 * SZ_4K)
+
+struct memdump_plan {
+	u64 offset;
+	u32 len;
+	u16 bank;
+};
+
+struct memdump_stream {
+	struct memdump_stream_hdr hdr;
+	unsigned int codec;
+	unsigned int align;
+	bool hdr_done;
+	bool ended;
+	bool test;
+	/* Next chunk to scan */
+	unsigned int bank;
+	u64 offset;
+	/* Last chunk emitted */
+	unsigned int chunk_bank;
+	u64 chunk_offset;
+	/* Encoded output, header or chunk */
+	u8 *buf;
+	size_t len;
+	size_t pos;
+	/* Fastboot only: chunk list from the sizing pass */
+	struct memdump_plan *plan;
+	unsigned int plan_cnt;
+	unsigned int plan_max;
+	unsigned int plan_idx;
+	u64 total;
+	u64 raw;
+	z_stream zs;
+	bool zs_ready;
+};
+
+static void *memdump_zalloc(void *x, unsigned int items, unsigned int size)
+{
+	return malloc(items * size);
+}
+
+static void memdump_zfree(void *x, void *addr, unsigned int nb)
+{
+	free(addr);
+}
+
+static unsigned int memdump_stream_codec(unsigned int def)
+{
+	const char *codec = env_get("memdump_codec");
+
+	if (!codec)
+		return def;
+
+	if (!strcmp(codec, "deflate"))
+		return MEMDUMP_CODEC_DEFLATE;
+
+	return MEMDUMP_CODEC_NONE;
+}
+
+static bool memdump_page_skipped(struct memdump_stream *ms, u64 addr)
+{
+	int i;
+
+	for (i = 0; i < MEMDUMP_MAX_SKIP; i++) {
+		u64 start = le64_to_cpu(ms->hdr.skip[i].start);
+		u64 size = le64_to_cpu(ms->hdr.skip[i].size);
+
+		if (addr >= start && addr < start + size)
+			return true;
+	}
+
+	return false;
+}
+
+static bool memdump_page_is_zero(const void *page)
+{
+	const u64 *p = page;
+	int i;
+
+	for (i = 0; i < MEMDUMP_PAGE_SIZE / sizeof(*p); i += 4)
+		if (p[i] | p[i + 1] | p[i + 2] | p[i + 3])
+			return false;
+
+	return true;
+}
+
+static struct memdump_stream *memdump_stream_open(unsigned int codec,
+						  unsigned int align)
+{
+	struct memdump_stream *ms;
+	struct memdump_stream_hdr *hdr;
+	int i, n = 0;
+
+	ms = calloc(1, sizeof(*ms));
+	if (!ms)
+		return NULL;
+
+	ms->buf = malloc_cache_aligned(MEMDUMP_BUF_SIZE);
+	if (!ms->buf) {
+		free(ms);
+		return NULL;
+	}
+
+	if (codec == MEMDUMP_CODEC_DEFLATE) {
+		ms->zs.zalloc = memdump_zalloc;
+		ms->zs.zfree = memdump_zfree;
+		/* Raw deflate, every chunk is a stream of its own */
+		if (deflateInit2_(&ms->zs, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS,
+				  8, Z_DEFAULT_STRATEGY, ZLIB_VERSION,
+				  sizeof(z_stream)) == Z_OK)
+			ms->zs_ready = true;
+		else
+			codec = MEMDUMP_CODEC_NONE;
+	}
+
+	ms->codec = codec;
+	ms->align = align;
+	ms->test = env_get_yesno("memdump_test") == 1;
+
+	hdr = &ms->hdr;
+	hdr->magic = cpu_to_le32(MEMDUMP_STREAM_MAGIC);
+	hdr->version = cpu_to_le16(MEMDUMP_STREAM_VERSION);
+	hdr->codec = cpu_to_le16(codec);
+	hdr->page_size = cpu_to_le32(MEMDUMP_PAGE_SIZE);
+	hdr->chunk_size = cpu_to_le32(MEMDUMP_CHUNK_SIZE);
+	hdr->align = cpu_to_le32(align);
+
+	for (i = 0; i < CONFIG_NR_DRAM_BANKS && n < MEMDUMP_MAX_BANKS; i++) {
+		if (!gd->bd->bi_dram[i].size)
+			continue;
+
+		hdr->banks[n].start = cpu_to_le64(gd->bd->bi_dram[i].start);
+		hdr->banks[n].size = cpu_to_le64(gd->bd->bi_dram[i].size);
+		n++;
+	}
+	hdr->nr_banks = cpu_to_le32(n);
+
+	/*
+	 * What U-Boot relocated itself over no longer holds pre-crash data and
+	 * keeps changing while we stream, leave it out.
+	 */
+	hdr->skip[0].start = cpu_to_le64(ALIGN_DOWN(gd->start_addr_sp -
+						    MEMDUMP_STACK_ROOM,
+						    MEMDUMP_PAGE_SIZE));
+	hdr->skip[0].size = cpu_to_le64(gd->ram_top -
+					le64_to_cpu(hdr->skip[0].start));
+	/* skip secure world memory region */
+	hdr->skip[1].start = cpu_to_le64(gd->bd->bi_dram[0].start);
+	hdr->skip[1].size = cpu_to_le64(EL3_RESERVED_REGION);
+
+	return ms;
+}
+
+static void memdump_stream_free(struct memdump_stream *ms)
+{
+	if (ms->zs_ready)
+		deflateEnd(&ms->zs);
+	free(ms->plan);
+	free(ms->buf);
+	free(ms);
+}
+
+static void memdump_stream_rewind(struct memdump_stream *ms)
+{
+	ms->hdr_done = false;
+	ms->ended = false;
+	ms->bank = 0;
+	ms->offset = 0;
+	ms->len = 0;
+	ms->pos = 0;
+	ms->plan_idx = 0;
+	ms->total = 0;
+	ms->raw = 0;
+}
+
+static void memdump_stream_pad(struct memdump_stream *ms)
+{
+	size_t len = ALIGN(ms->len, ms->align);
+
+	memset(ms->buf + ms->len, 0, len - ms->len);
+	ms->len = len;
+}
+
+static int memdump_stream_deflate(struct memdump_stream *ms,
+				  const struct memdump_chunk_hdr *ch,
+				  const u8 *base, unsigned int npages,
+				  unsigned int present)
+{
+	z_stream *zs = &ms->zs;
+	unsigned int i, left = present;
+	int ret = Z_OK;
+
+	deflateReset(zs);
+	zs->next_out = ms->buf + sizeof(*ch);
+	/* Give up as soon as it gets larger than storing the pages */
+	zs->avail_out = present * MEMDUMP_PAGE_SIZE;
+
+	for (i = 0; i < npages; i++) {
+		if (!(ch->bitmap[i / 8] & BIT(i % 8)))
+			continue;
+
+		zs->next_in = (u8 *)base + i * MEMDUMP_PAGE_SIZE;
+		zs->avail_in = MEMDUMP_PAGE_SIZE;
+		ret = deflate(zs, --left ? Z_NO_FLUSH : Z_FINISH);
+		if (ret == Z_STREAM_END)
+			break;
+		if (ret != Z_OK || !zs->avail_out || zs->avail_in)
+			return -ENOSPC;
+	}
+
+	if (ret != Z_STREAM_END)
+		return -ENOSPC;
+
+	return present * MEMDUMP_PAGE_SIZE - zs->avail_out;
+}
+
+/*
+ * Encode the chunk at @offset of bank @bank into ms->buf. Return 0 if the
+ * chunk has nothing to dump and @force is not set, 1 otherwise.
+ */
+static int memdump_stream_chunk(struct memdump_stream *ms, unsigned int bank,
+				u64 offset, bool force)
+{
+	struct memdump_chunk_hdr *ch = (struct memdump_chunk_hdr *)ms->buf;
+	u64 start = le64_to_cpu(ms->hdr.banks[bank].start) + offset;
+	u64 size = le64_to_cpu(ms->hdr.banks[bank].size) - offset;
+	unsigned int raw_len = min_t(u64, size, MEMDUMP_CHUNK_SIZE);
+	unsigned int npages = DIV_ROUND_UP(raw_len, MEMDUMP_PAGE_SIZE);
+	const u8 *base = (const u8 *)(uintptr_t)start;
+	unsigned int i, present = 0;
+	u16 flags = 0;
+	int len = -ENOSPC;
+
+	memset(ch, 0, sizeof(*ch));
+	for (i = 0; i < npages; i++) {
+		const u8 *page = base + i * MEMDUMP_PAGE_SIZE;
+
+		if (memdump_page_skipped(ms, start + i * MEMDUMP_PAGE_SIZE) ||
+		    memdump_page_is_zero(page))
+			continue;
+
+		ch->bitmap[i / 8] |= BIT(i % 8);
+		present++;
+	}
+
+	if (!present && !force)
+		return 0;
+
+	if (present && ms->codec == MEMDUMP_CODEC_DEFLATE)
+		len = memdump_stream_deflate(ms, ch, base, npages, present);
+
+	if (len >= 0) {
+		flags |= MEMDUMP_CHUNK_F_DEFLATE;
+	} else {
+		u8 *dst = ms->buf + sizeof(*ch);
+
+		for (i = 0; i < npages; i++) {
+			if (!(ch->bitmap[i / 8] & BIT(i % 8)))
+				continue;
+
+			memcpy(dst, base + i * MEMDUMP_PAGE_SIZE,
+			       MEMDUMP_PAGE_SIZE);
+			dst += MEMDUMP_PAGE_SIZE;
+		}
+		len = present * MEMDUMP_PAGE_SIZE;
+	}
+
+	ch->magic = cpu_to_le32(MEMDUMP_CHUNK_MAGIC);
+	ch->bank = cpu_to_le16(bank);
+	ch->flags = cpu_to_le16(flags);
+	ch->offset = cpu_to_le64(offset);
+	ch->raw_len = cpu_to_le32(raw_len);
+	ch->data_len = cpu_to_le32(len);
+
+	ms->len = sizeof(*ch) + len;
+	ms->raw += raw_len;
+	memdump_stream_pad(ms);
+
+	return 1;
+}
+
+static void memdump_stream_end(struct memdump_stream *ms)
+{
+	struct memdump_chunk_hdr *ch = (struct memdump_chunk_hdr *)ms->buf;
+
+	memset(ch, 0, sizeof(*ch));
+	ch->magic = cpu_to_le32(MEMDUMP_CHUNK_MAGIC);
+	ch->bank = cpu_to_le16(0xffff);
+	ch->flags = cpu_to_le16(MEMDUMP_CHUNK_F_END);
+	ms->len = sizeof(*ch);
+	memdump_stream_pad(ms);
+	ms->ended = true;
+}
+
+/*
+ * Produce the next piece of the stream into ms->buf: the stream header
+ * first, then one chunk per call and the end marker last.
+ */
+static void memdump_stream_next(struct memdump_stream *ms)
+{
+	unsigned int nr_banks = le32_to_cpu(ms->hdr.nr_banks);
+
+	ms->pos = 0;
+	if (!ms->hdr_done) {
+		memcpy(ms->buf, &ms->hdr, sizeof(ms->hdr));
+		ms->len = sizeof(ms->hdr);
+		memdump_stream_pad(ms);
+		ms->hdr_done = true;
+		goto out;
+	}
+
+	while (ms->bank < nr_banks) {
+		u64 size = le64_to_cpu(ms->hdr.banks[ms->bank].size);
+		unsigned int bank = ms->bank;
+		u64 offset = ms->offset;
+		int ret;
+
+		if (offset >= size) {
+			ms->bank++;
+			ms->offset = 0;
+			continue;
+		}
+
+		WATCHDOG_RESET();
+		ms->offset += MEMDUMP_CHUNK_SIZE;
+		ret = memdump_stream_chunk(ms, bank, offset, false);
+		if (!ret)
+			continue;
+
+		ms->chunk_bank = bank;
+		ms->chunk_offset = offset;
+
+		/* One chunk is enough to check the whole path */
+		if (ms->test)
+			ms->bank = nr_banks;
+
+		goto out;
+	}
+
+	memdump_stream_end(ms);
+out:
+	ms->total += ms->len;
+}
+
+static int memdump_stream_blk(struct blk_desc *blk_desc, lbaint_t start,
+			      lbaint_t blkcnt)
+{
+	struct memdump_stream *ms;
+	lbaint_t lba = start;
+	ulong time, cnt, count;
+	int ret = 0;
+
+	ms = memdump_stream_open(memdump_stream_codec(MEMDUMP_CODEC_DEFLATE),
+				 blk_desc->blksz);
+	if (!ms)
+		return -ENOMEM;
+
+	printf("Streaming ramdump (%s) to LBA 0x" LBAF "\n",
+	       ms->codec == MEMDUMP_CODEC_DEFLATE ? "deflate" : "zero-skip",
+	       start);
+	time = get_timer(0);
+	do {
+		memdump_stream_next(ms);
+		cnt = ms->len >> blk_desc->log2blksz;
+		if (lba + cnt > start + blkcnt) {
+			printf("ramdump partition too small, stopped at 0x%llx\n",
+			       ms->raw);
+			ret = -ENOSPC;
+			goto out;
+		}
+
+		count = blk_dwrite(blk_desc, lba, cnt, ms->buf);
+		if (count != cnt) {
+			debug("block write failed, cnt: 0x%016lx, ret: 0x%016lx\n",
+			      cnt, count);
+			ret = -EIO;
+			goto out;
+		}
+		lba += cnt;
+	} while (!ms->ended);
+
+	/* Rewrite the header now that the dump is known to be complete */
+	ms->hdr.total_size = cpu_to_le64(ms->total);
+	ms->hdr.raw_size = cpu_to_le64(ms->raw);
+	ms->hdr_done = false;
+	memdump_stream_next(ms);
+	count = blk_dwrite(blk_desc, start, ms->len >> blk_desc->log2blksz,
+			   ms->buf);
+	if (count != ms->len >> blk_desc->log2blksz) {
+		ret = -EIO;
+		goto out;
+	}
+
+	time = max_t(ulong, get_timer(time), 1);
+	printf("%llu bytes of memory dumped as %llu bytes in %lu ms (%lu KiB/s)\n",
+	       ms->raw, le64_to_cpu(ms->hdr.total_size), time,
+	       (ulong)(ms->raw / time * 1000 / 1024));
+out:
+	memdump_stream_free(ms);
+
+	return ret;
+}
+
+/* Stream fed to the fastboot upload, see memdump_stream_prepare() */
+static struct memdump_stream *memdump_fb_stream;
+
+/**
+ * memdump_stream_prepare() - Set up a streamed ramdump for a pull transport
+ *
+ * @total: filled with the exact length of the stream
+ *
+ * Transports like fastboot must announce the length before sending anything,
+ * so walk the memory once to size every chunk. The data is then produced
+ * again, chunk by chunk, by memdump_stream_read().
+ *
+ * Return: 0 on success, negative error code otherwise
+ */
+int memdump_stream_prepare(u64 *total)
+{
+	struct memdump_stream *ms;
+	int i;
+
+	memdump_stream_close();
+
+	ms = memdump_stream_open(memdump_stream_codec(MEMDUMP_CODEC_NONE), 1);
+	if (!ms)
+		return -ENOMEM;
+
+	for (i = 0; i < le32_to_cpu(ms->hdr.nr_banks); i++)
+		ms->plan_max += DIV_ROUND_UP(le64_to_cpu(ms->hdr.banks[i].size),
+					     MEMDUMP_CHUNK_SIZE);
+
+	ms->plan = calloc(ms->plan_max, sizeof(*ms->plan));
+	if (!ms->plan) {
+		memdump_stream_free(ms);
+		return -ENOMEM;
+	}
+
+	/* Skip the header, then record every chunk that gets emitted */
+	memdump_stream_next(ms);
+	for (;;) {
+		memdump_stream_next(ms);
+		if (ms->ended)
+			break;
+
+		ms->plan[ms->plan_cnt].bank = ms->chunk_bank;
+		ms->plan[ms->plan_cnt].offset = ms->chunk_offset;
+		ms->plan[ms->plan_cnt].len = ms->len;
+		ms->plan_cnt++;
+	}
+
+	ms->hdr.total_size = cpu_to_le64(ms->total);
+	ms->hdr.raw_size = cpu_to_le64(ms->raw);
+	*total = ms->total;
+
+	memdump_stream_rewind(ms);
+	memdump_fb_stream = ms;
+
+	return 0;
+}
+
+static void memdump_stream_fill(struct memdump_stream *ms)
+{
+	struct memdump_chunk_hdr *ch = (struct memdump_chunk_hdr *)ms->buf;
+	struct memdump_plan *plan;
+
+	if (!ms->hdr_done || ms->plan_idx >= ms->plan_cnt) {
+		if (ms->hdr_done) {
+			ms->pos = 0;
+			memdump_stream_end(ms);
+		} else {
+			memdump_stream_next(ms);
+		}
+		return;
+	}
+
+	WATCHDOG_RESET();
+	plan = &ms->plan[ms->plan_idx++];
+	ms->pos = 0;
+	memdump_stream_chunk(ms, plan->bank, plan->offset, true);
+	if (ms->len == plan->len)
+		return;
+
+	/*
+	 * The memory changed since it was sized, keep the announced length
+	 * and flag the chunk instead of corrupting the rest of the stream.
+	 */
+	memset(ms->buf + sizeof(*ch), 0, plan->len - sizeof(*ch));
+	ch->flags = cpu_to_le16(MEMDUMP_CHUNK_F_LOST);
+	ch->data_len = cpu_to_le32(plan->len - sizeof(*ch));
+	ms->len = plan->len;
+}
+
+/**
+ * memdump_stream_read() - Read the next bytes of a prepared ramdump stream
+ *
+ * @buf: destination buffer
+ * @len: number of bytes to read
+ *
+ * Return: number of bytes read, 0 at the end of the stream, negative error
+ * code if no stream was prepared
+ */
+int memdump_stream_read(void *buf, size_t len)
+{
+	struct memdump_stream *ms = memdump_fb_stream;
+	size_t done = 0;
+
+	if (!ms)
+		return -ENODEV;
+
+	while (done < len) {
+		size_t n;
+
+		if (ms->pos == ms->len) {
+			if (ms->ended)
+				break;
+			memdump_stream_fill(ms);
+		}
+
+		n = min(len - done, ms->len - ms->pos);
+		memcpy(buf + done, ms->buf + ms->pos, n);
+		ms->pos += n;
+		done += n;
+	}
+
+	return done;
+}
+
+/**
+ * memdump_stream_close() - Release the stream set up by memdump_stream_prepare()
+ */
+void memdump_stream_close(void)
+{
+	if (!memdump_fb_stream)
+		return;
+
+	memdump_stream_free(memdump_fb_stream);
+	memdump_fb_stream = NULL;
+}
+#endif
+
+static int memdump_dump_blk_range(struct blk_desc *blk_desc,
+				  unsigned long dump_start, lbaint_t dump_cnt)
 {
-	struct blk_desc *blk_desc;
 	lbaint_t blkcnt, temp;
 	lbaint_t offset;
 	unsigned long count;
@@ -95,9 +647,10 @@ int memdump_dump_blk_offset(char *intf, int dev, unsigned long dump_start)
 	void *buffer;
 	int i;
 
-	blk_desc = memdump_get_blk_desc(intf, dev);
-	if (!blk_desc)
-		return -ENODEV;
+#if CONFIG_IS_ENABLED(MEMDUMP_STREAM)
+	if (env_get_yesno("memdump_raw") != 1)
+		return memdump_stream_blk(blk_desc, dump_start, dump_cnt);
+#endif
 
 	dump_block_cnt = MEMDUMP_BLOCK_SIZE >> blk_desc->log2blksz;
 
@@ -154,10 +707,23 @@ int memdump_dump_blk_offset(char *intf, int dev, unsigned long dump_start)
 	return 0;
 }
 
+int memdump_dump_blk_offset(char *intf, int dev, unsigned long dump_start)
+{
+	struct blk_desc *blk_desc;
+
+	blk_desc = memdump_get_blk_desc(intf, dev);
+	if (!blk_desc)
+		return -ENODEV;
+
+	return memdump_dump_blk_range(blk_desc, dump_start,
+				      blk_desc->lba - dump_start);
+}
+
 int memdump_dump_blk(char *intf, int dev, char *partition)
 {
 	struct blk_desc *blk_desc;
 	unsigned long dump_start;
+	lbaint_t dump_cnt;
 
 	blk_desc = memdump_get_blk_desc(intf, dev);
 	if (!blk_desc)
@@ -175,12 +741,14 @@ int memdump_dump_blk(char *intf, int dev, char *partition)
 		}
 
 		dump_start = info.start;
+		dump_cnt = info.size;
 	}
 #else
 	dump_start = simple_strtoul(partition, NULL, 16);
+	dump_cnt = blk_desc->lba - dump_start;
 #endif
 
-	return memdump_dump_blk_offset(intf, dev, dump_start);
+	return memdump_dump_blk_range(blk_desc, dump_start, dump_cnt);
 
 	return 0;
 }
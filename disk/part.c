@@ -54,6 +54,214 @@ static struct part_driver *part_driver_lookup_type(struct blk_desc *dev_desc)
 	return NULL;
 }
 
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+/* Blocks at each end of the device which may hold a GPT or its backup */
+#define PART_CACHE_GPT_BLKS	34
+
+/**
+ * struct part_cache - Partition table of a device, see part_cache_get()
+ *
+ * @drv:	Partition driver which parsed the table
+ * @hwpart:	Hardware partition the table was read from
+ * @count:	Number of partitions, numbered 1 to @count
+ * @parts:	Partition information, @parts[0] is partition 1
+ * @hash_mask:	Size of @hash minus one
+ * @hash:	Partition names hashed to the index in @parts plus one, or 0
+ * @hits:	Lookups answered from the cache
+ * @reads_saved: Calls to @drv->get_info() these lookups did not need
+ */
+struct part_cache {
+	struct part_driver *drv;
+	int hwpart;
+	int count;
+	struct disk_partition *parts;
+	uint hash_mask;
+	u16 *hash;
+	ulong hits;
+	ulong reads_saved;
+};
+
+static uint part_cache_hash(const char *name)
+{
+	uint hash = 0;
+
+	while (*name)
+		hash = hash * 31 + (uchar)*name++;
+
+	return hash;
+}
+
+void part_cache_invalidate(struct blk_desc *desc)
+{
+	struct part_cache *cache = desc->part_cache;
+
+	if (!cache)
+		return;
+	free(cache->parts);
+	free(cache->hash);
+	free(cache);
+	desc->part_cache = NULL;
+}
+
+void part_cache_write(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt)
+{
+	struct part_cache *cache = desc->part_cache;
+
+	/*
+	 * Other tables, e.g. DOS extended partitions, can be anywhere. On a
+	 * device too small for both GPT copies, any write may hit one.
+	 */
+	if (cache && cache->drv->part_type == PART_TYPE_EFI &&
+	    desc->lba >= 2 * PART_CACHE_GPT_BLKS &&
+	    start >= PART_CACHE_GPT_BLKS &&
+	    start <= desc->lba - PART_CACHE_GPT_BLKS &&
+	    blkcnt <= desc->lba - PART_CACHE_GPT_BLKS - start)
+		return;
+
+	part_cache_invalidate(desc);
+}
+
+int part_cache_get_stats(struct blk_desc *desc, struct part_cache_stats *stats)
+{
+	struct part_cache *cache = desc->part_cache;
+
+	if (!cache)
+		return -ENOENT;
+	stats->entries = cache->count;
+	stats->hits = cache->hits;
+	stats->reads_saved = cache->reads_saved;
+
+	return 0;
+}
+
+/*
+ * Read the partition table of @desc into memory, or return the copy read
+ * before, in which case @cached is set. Partitions are read up to the first
+ * one get_info() rejects, as part_get_info_by_name_type() always did.
+ */
+static struct part_cache *part_cache_get(struct blk_desc *desc, bool *cached)
+{
+	struct part_cache *cache = desc->part_cache;
+	struct disk_partition *parts;
+	struct part_driver *drv;
+	uint size, slot;
+	int i;
+
+	*cached = cache && cache->hwpart == desc->hwpart;
+	if (*cached)
+		return cache;
+	part_cache_invalidate(desc);
+
+	drv = part_driver_lookup_type(desc);
+	if (!drv || !drv->get_info)
+		return NULL;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+	cache->drv = drv;
+	cache->hwpart = desc->hwpart;
+
+	for (i = 1; i < drv->max_entries; i++) {
+		if (!(cache->count % 16)) {
+			parts = realloc(cache->parts,
+					(cache->count + 16) * sizeof(*parts));
+			if (!parts)
+				goto err;
+			cache->parts = parts;
+		}
+		parts = &cache->parts[cache->count];
+		memset(parts, '\0', sizeof(*parts));
+		if (drv->get_info(desc, i, parts))
+			break;
+		cache->count++;
+	}
+
+	/* Keep the hash table at most half full */
+	for (size = 16; size < cache->count * 2; size <<= 1)
+		;
+	cache->hash = calloc(size, sizeof(*cache->hash));
+	if (!cache->hash)
+		goto err;
+	cache->hash_mask = size - 1;
+
+	/* The first of several partitions with the same name wins */
+	for (i = 0; i < cache->count; i++) {
+		const char *name = (const char *)cache->parts[i].name;
+
+		slot = part_cache_hash(name) & cache->hash_mask;
+		while (cache->hash[slot] &&
+		       strcmp(name, (const char *)
+			      cache->parts[cache->hash[slot] - 1].name))
+			slot = (slot + 1) & cache->hash_mask;
+		if (!cache->hash[slot])
+			cache->hash[slot] = i + 1;
+	}
+	desc->part_cache = cache;
+
+	return cache;
+
+err:
+	free(cache->parts);
+	free(cache);
+
+	return NULL;
+}
+
+/* Return: partition number, -ENOENT if not found, -ENOSYS if not cached */
+static int part_cache_find_name(struct blk_desc *desc, const char *name,
+				struct disk_partition *info)
+{
+	struct part_cache *cache;
+	bool cached;
+	uint slot;
+	int i;
+
+	cache = part_cache_get(desc, &cached);
+	if (!cache)
+		return -ENOSYS;
+
+	/* A lookup which just read the table saved nothing */
+	if (cached)
+		cache->hits++;
+	slot = part_cache_hash(name) & cache->hash_mask;
+	for (; cache->hash[slot]; slot = (slot + 1) & cache->hash_mask) {
+		i = cache->hash[slot] - 1;
+		if (!strcmp(name, (const char *)cache->parts[i].name)) {
+			if (cached)
+				cache->reads_saved += i + 1;
+			*info = cache->parts[i];
+			return i + 1;
+		}
+	}
+	/* A miss walks the whole table and one past it */
+	if (cached)
+		cache->reads_saved += cache->count + 1;
+
+	return -ENOENT;
+}
+
+/* Return: 0 if found, -ENOSYS if @part is not cached */
+static int part_cache_find_num(struct blk_desc *desc, int part,
+			       struct disk_partition *info)
+{
+	struct part_cache *cache;
+	bool cached;
+
+	cache = part_cache_get(desc, &cached);
+	if (!cache || part < 1 || part > cache->count)
+		return -ENOSYS;
+
+	if (cached) {
+		cache->hits++;
+		cache->reads_saved++;
+	}
+	*info = cache->parts[part - 1];
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_HAVE_BLOCK_DEVICE
 static struct blk_desc *get_dev_hwpart(const char *ifname, int dev, int hwpart)
 {
@@ -240,6 +448,7 @@ void part_init(struct blk_desc *dev_desc)
 	struct part_driver *entry;
 
 	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+	part_cache_invalidate(dev_desc);
 
 	dev_desc->part_type = PART_TYPE_UNKNOWN;
 	for (entry = drv; entry != drv + n_ents; entry++) {
@@ -341,6 +550,10 @@ int part_get_info(struct blk_desc *dev_desc, int part,
 	info->type_guid[0] = 0;
 #endif
 
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+	if (!part_cache_find_num(dev_desc, part, info))
+		return 0;
+#endif
 	drv = part_driver_lookup_type(dev_desc);
 	if (!drv) {
 		debug("## Unknown partition table type %x\n",
@@ -671,6 +884,11 @@ int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
 	int ret;
 	int i;
 
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+	ret = part_cache_find_name(dev_desc, name, info);
+	if (ret != -ENOSYS)
+		return ret;
+#endif
 	part_drv = part_driver_lookup_type(dev_desc);
 	if (!part_drv)
 		return -1;
@@ -15,9 +15,10 @@
 #include <dma-uclass.h>
 #include <dt-structs.h>
 #include <errno.h>
+#include <linux/sizes.h>
 
 #define SANDBOX_DMA_CH_CNT 3
-#define SANDBOX_DMA_BUF_SIZE 1024
+#define SANDBOX_DMA_BUF_SIZE SZ_4K
 
 struct sandbox_dma_chan {
 	struct sandbox_dma_dev *ud;
@@ -158,7 +159,7 @@ static int sandbox_dma_send(struct dma *dma,
 
 	if (dma->id >= SANDBOX_DMA_CH_CNT)
 		return -EINVAL;
-	if (!src || !metadata)
+	if (!src)
 		return -EINVAL;
 
 	debug("%s(dma id=%lu)\n", __func__, dma->id);
@@ -175,7 +176,7 @@ static int sandbox_dma_send(struct dma *dma,
 
 	memcpy(ud->buf, src, len);
 	ud->data_len = len;
-	ud->meta = *((u32 *)metadata);
+	ud->meta = metadata ? *((u32 *)metadata) : 0;
 
 	debug("%s(dma id=%lu len=%zu meta=%08x)\n",
 	      __func__, dma->id, len, ud->meta);
@@ -190,7 +191,7 @@ static int sandbox_dma_receive(struct dma *dma, void **dst, void *metadata)
 
 	if (dma->id >= SANDBOX_DMA_CH_CNT)
 		return -EINVAL;
-	if (!dst || !metadata)
+	if (!dst)
 		return -EINVAL;
 
 	uc = &ud->channels[dma->id];
@@ -210,7 +211,8 @@ static int sandbox_dma_receive(struct dma *dma, void **dst, void *metadata)
 		memcpy(*dst, ud->buf, ud->data_len);
 	}
 
-	*((u32 *)metadata) = ud->meta;
+	if (metadata)
+		*((u32 *)metadata) = ud->meta;
 
 	debug("%s(dma id=%lu len=%zu meta=%08x %p)\n",
 	      __func__, dma->id, ud->data_len, ud->meta, *dst);
@@ -15,6 +15,8 @@
 #include <part.h>
 #include <stdlib.h>
 #include <mapmem.h>
+#include <memdump.h>
+#include <time.h>
 
 #include <asm/global_data.h>
 
@@ -43,6 +45,18 @@ static u32 fastboot_bytes_send;
  */
 static u32 fastboot_bytes_expected;
 
+/**
+ * fastboot_xfer_start - timer value when the current transfer started
+ */
+static ulong fastboot_xfer_start;
+
+#if CONFIG_IS_ENABLED(MEMDUMP_STREAM)
+/**
+ * fastboot_ramdump_stream - current upload is a streamed ramdump
+ */
+static bool fastboot_ramdump_stream;
+#endif
+
 static void okay(char *, char *);
 static void getvar(char *, char *);
 static void download(char *, char *);
@@ -256,6 +270,7 @@ static void download(char *cmd_parameter, char *response)
 	} else {
 		printf("Starting download of %d bytes\n",
 		       fastboot_bytes_expected);
+		fastboot_xfer_start = get_timer(0);
 		fastboot_response("DATA", response, "%s", cmd_parameter);
 	}
 }
@@ -314,6 +329,19 @@ void fastboot_data_download(const void *fastboot_data,
 	*response = '\0';
 }
 
+/**
+ * fastboot_print_rate() - Print how long the current transfer took
+ *
+ * @bytes: Number of bytes transferred
+ */
+static void fastboot_print_rate(u32 bytes)
+{
+	ulong time = max_t(ulong, get_timer(fastboot_xfer_start), 1);
+
+	printf("%u bytes in %lu ms (%lu KiB/s)\n", bytes, time,
+	       (ulong)((u64)bytes * 1000 / 1024 / time));
+}
+
 /**
  * fastboot_download_complete() - Mark current transfer complete
  *
@@ -326,6 +354,7 @@ void fastboot_download_complete(char *response)
 	/* Download complete. Respond with "OKAY" */
 	fastboot_okay(NULL, response);
 	printf("\ndownloading of %d bytes finished\n", fastboot_bytes_received);
+	fastboot_print_rate(fastboot_bytes_received);
 	image_size = fastboot_bytes_received;
 	env_set_hex("filesize", image_size);
 	fastboot_bytes_expected = 0;
@@ -344,8 +373,25 @@ void fastboot_upload_complete(char *response)
 	/* Upload complete. Respond with "OKAY" */
 	fastboot_okay(NULL, response);
 	printf("\nuploading of %u bytes finished\n", fastboot_bytes_send);
+	fastboot_print_rate(fastboot_bytes_send);
+	fastboot_upload_abort();
+}
+
+/**
+ * fastboot_upload_abort() - Drop the current transfer
+ *
+ * Reset global transfer info, and close the ramdump stream being uploaded.
+ */
+void fastboot_upload_abort(void)
+{
 	fastboot_bytes_expected = 0;
 	fastboot_bytes_send = 0;
+#if CONFIG_IS_ENABLED(MEMDUMP_STREAM)
+	if (fastboot_ramdump_stream) {
+		memdump_stream_close();
+		fastboot_ramdump_stream = false;
+	}
+#endif
 }
 
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH)
@@ -451,6 +497,15 @@ void fastboot_data_upload(void *fastboot_data,
 	}
 
 	/* Upload data to fastboot_data */
+#if CONFIG_IS_ENABLED(MEMDUMP_STREAM)
+	if (fastboot_ramdump_stream) {
+		if (memdump_stream_read(fastboot_data, fastboot_data_len) !=
+		    fastboot_data_len) {
+			fastboot_fail("ramdump stream ended early", response);
+			return;
+		}
+	} else
+#endif
 	memcpy(fastboot_data, dram_start_addr + fastboot_bytes_send,
 			fastboot_data_len);
 
@@ -662,9 +717,33 @@ static void oem_ramdump(char *cmd_parameter, char *response)
 {
 	char *tmp;
 
+#if CONFIG_IS_ENABLED(MEMDUMP_STREAM)
+	fastboot_ramdump_stream = false;
+	if (!cmd_parameter) {
+		u64 total;
+
+		if (memdump_stream_prepare(&total)) {
+			fastboot_fail("Cannot set up ramdump stream", response);
+			return;
+		}
+
+		if (total > U32_MAX) {
+			memdump_stream_close();
+			fastboot_fail("ramdump stream too large, set memdump_codec=deflate",
+				      response);
+			return;
+		}
+
+		fastboot_ramdump_stream = true;
+		fastboot_bytes_expected = total;
+	} else if (!strcmp(cmd_parameter, "raw")) {
+		fastboot_bytes_expected = gd->ram_size;
+	} else
+#else
 	if (!cmd_parameter)
 		fastboot_bytes_expected = gd->ram_size;
 	else
+#endif
 		fastboot_bytes_expected = simple_strtoul(cmd_parameter, &tmp, 16);
 
 	if (!fastboot_bytes_expected) {
@@ -675,6 +754,8 @@ static void oem_ramdump(char *cmd_parameter, char *response)
 	fastboot_response("DATA", response, "%08x", fastboot_bytes_expected);
 	fastboot_tx_write_more(response);
 
+	fastboot_xfer_start = get_timer(0);
+
 	fastboot_upload_ramdump();
 
 	fastboot_none_resp(response);
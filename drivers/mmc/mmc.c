@@ -11,6 +11,7 @@
 #include <common.h>
 #include <blk.h>
 #include <command.h>
+#include <deferred.h>
 #include <dm.h>
 #include <log.h>
 #include <dm/device-internal.h>
@@ -300,7 +301,7 @@ int mmc_poll_for_busy(struct mmc *mmc, int timeout_ms)
 		if (timeout_ms-- <= 0)
 			break;
 
-		udelay(1000);
+		deferred_udelay(1000);
 	}
 
 	if (timeout_ms <= 0) {
@@ -637,7 +638,7 @@ static int sd_send_op_cond(struct mmc *mmc, bool uhs_en)
 		if (timeout-- <= 0)
 			return -EOPNOTSUPP;
 
-		udelay(1000);
+		deferred_udelay(1000);
 	}
 
 	if (mmc->version != SD_VERSION_2)
@@ -714,7 +715,7 @@ static int mmc_send_op_cond(struct mmc *mmc)
 
 		if (get_timer(start) > timeout)
 			return -ETIMEDOUT;
-		udelay(100);
+		deferred_udelay(100);
 	}
 	mmc->op_cond_pending = 1;
 	return 0;
@@ -741,7 +742,7 @@ static int mmc_complete_op_cond(struct mmc *mmc)
 				break;
 			if (get_timer(start) > timeout)
 				return -EOPNOTSUPP;
-			udelay(100);
+			deferred_udelay(100);
 		}
 	}
 
@@ -2918,6 +2919,8 @@ int mmc_start_init(struct mmc *mmc)
 		}
 	}
 #if CONFIG_IS_ENABLED(DM_MMC)
+	/* Board code may still be powering up the slot */
+	deferred_wait_dev(mmc->dev);
 	mmc_deferred_probe(mmc);
 #endif
 #if !defined(CONFIG_MMC_BROKEN_CD)
@@ -9,56 +9,78 @@
 #include <malloc.h>
 #include <asm/cache.h>
 
-static void sdhci_adma_desc(struct sdhci_adma_desc *desc,
-			    dma_addr_t addr, u16 len, bool end)
+/**
+ * sdhci_adma_write_desc() - Write one ADMA descriptor
+ *
+ * @desc:	Pointer to the descriptor, advanced to the next free one
+ * @addr:	DMA address of the data
+ * @len:	Length of the data, at most ADMA_MAX_LEN
+ * @end:	Mark the descriptor as the last one of the table
+ */
+void sdhci_adma_write_desc(void **desc, dma_addr_t addr, int len, bool end)
 {
+	struct sdhci_adma_desc *dma_desc = *desc;
 	u8 attr;
 
 	attr = ADMA_DESC_ATTR_VALID | ADMA_DESC_TRANSFER_DATA;
 	if (end)
 		attr |= ADMA_DESC_ATTR_END;
 
-	desc->attr = attr;
-	desc->len = len;
-	desc->reserved = 0;
-	desc->addr_lo = lower_32_bits(addr);
+	dma_desc->attr = attr;
+	dma_desc->len = len;
+	dma_desc->reserved = 0;
+	dma_desc->addr_lo = lower_32_bits(addr);
 #ifdef CONFIG_DMA_ADDR_T_64BIT
-	desc->addr_hi = upper_32_bits(addr);
+	dma_desc->addr_hi = upper_32_bits(addr);
 #endif
+
+	*desc = dma_desc + 1;
+}
+
+static void sdhci_adma_desc(struct sdhci_host *host, void **desc,
+			    dma_addr_t addr, int len, bool end)
+{
+	if (host && host->ops && host->ops->adma_write_desc)
+		host->ops->adma_write_desc(host, desc, addr, len, end);
+	else
+		sdhci_adma_write_desc(desc, addr, len, end);
 }
 
 /**
  * sdhci_prepare_adma_table() - Populate the ADMA table
  *
+ * @host:	Pointer to the host structure, may be NULL
  * @table:	Pointer to the ADMA table
  * @data:	Pointer to MMC data
  * @addr:	DMA address to write to or read from
  *
  * Fill the ADMA table according to the MMC data to read from or write to the
- * given DMA address.
+ * given DMA address. If the host provides an adma_write_desc() op, it is used
+ * to write the descriptors so that it can split them further.
  * Please note, that the table size depends on CONFIG_SYS_MMC_MAX_BLK_COUNT and
  * we don't have to check for overflow.
  */
-void sdhci_prepare_adma_table(struct sdhci_adma_desc *table,
+void sdhci_prepare_adma_table(struct sdhci_host *host,
+			      struct sdhci_adma_desc *table,
 			      struct mmc_data *data, dma_addr_t addr)
 {
 	uint trans_bytes = data->blocksize * data->blocks;
 	uint desc_count = DIV_ROUND_UP(trans_bytes, ADMA_MAX_LEN);
-	struct sdhci_adma_desc *desc = table;
+	void *desc = table;
 	int i = desc_count;
 
 	while (--i) {
-		sdhci_adma_desc(desc, addr, ADMA_MAX_LEN, false);
+		sdhci_adma_desc(host, &desc, addr, ADMA_MAX_LEN, false);
 		addr += ADMA_MAX_LEN;
 		trans_bytes -= ADMA_MAX_LEN;
-		desc++;
 	}
 
-	sdhci_adma_desc(desc, addr, trans_bytes, true);
+	sdhci_adma_desc(host, &desc, addr, trans_bytes, true);
 
+#ifndef CONFIG_SYS_NONCACHED_POOLS
 	flush_cache((dma_addr_t)table,
-		    ROUND(desc_count * sizeof(struct sdhci_adma_desc),
-			  ARCH_DMA_MINALIGN));
+		    ROUND(desc - (void *)table, ARCH_DMA_MINALIGN));
+#endif
 }
 
 /**
@@ -69,5 +91,11 @@ void sdhci_prepare_adma_table(struct sdhci_adma_desc *table,
  */
 struct sdhci_adma_desc *sdhci_adma_init(void)
 {
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+	/* Written by the CPU for each transfer, so no flush is needed */
+	return (void *)noncached_alloc_type(ADMA_TABLE_SZ, ARCH_DMA_MINALIGN,
+					    NONCACHED_WC);
+#else
 	return memalign(ARCH_DMA_MINALIGN, ADMA_TABLE_SZ);
+#endif
 }
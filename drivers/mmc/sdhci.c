@@ -110,7 +110,7 @@ static void sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
 	}
 #if CONFIG_IS_ENABLED(MMC_SDHCI_ADMA)
 	else if (host->flags & (USE_ADMA | USE_ADMA64)) {
-		sdhci_prepare_adma_table(host->adma_desc_table, data,
+		sdhci_prepare_adma_table(host, host->adma_desc_table, data,
 					 host->start_addr);
 
 		sdhci_writel(host, lower_32_bits(host->adma_addr),
@@ -876,6 +876,8 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 		return -EINVAL;
 	}
 	host->adma_desc_table = sdhci_adma_init();
+	if (!host->adma_desc_table)
+		return -ENOMEM;
 	host->adma_addr = (dma_addr_t)host->adma_desc_table;
 
 #ifdef CONFIG_DMA_ADDR_T_64BIT
@@ -8,10 +8,13 @@
 #include <common.h>
 #include <clk.h>
 #include <dm.h>
+#include <env.h>
 #include <malloc.h>
 #include <sdhci.h>
+#include <asm/arch/hb_sdhci.h>
 #include "mmc_private.h"
 #include <linux/delay.h>
+#include <linux/sizes.h>
 
 #define SDHC_MIN_FREQ	400000
 /* DWC IP vendor area 1 pointer */
@@ -34,14 +37,40 @@
 
 #define HSIO_CLK_EN_REG	0x342100A0
 
+/* A single ADMA descriptor must not cross a 128 MiB address boundary */
+#define DWCMSHC_ADMA_BOUNDARY		SZ_128M
+
 DECLARE_GLOBAL_DATA_PTR;
 
 /* x5 phy */
 #define DWCMSHC_EMMC_PHY_BASE		0x300
+#define PHY_DLL_CTRL			(DWCMSHC_EMMC_PHY_BASE + 0x24)
+#define  PHY_DLL_CTRL_ENABLE		BIT(0)
+#define PHY_DLL_CNFG1			(DWCMSHC_EMMC_PHY_BASE + 0x25)
+#define  PHY_DLL_CNFG1_SLVDLY		(0x2 << 4)
+#define  PHY_DLL_CNFG1_WAITCYCLE	0x5
+#define PHY_DLL_CNFG2			(DWCMSHC_EMMC_PHY_BASE + 0x26)
+#define  PHY_DLL_CNFG2_JUMPSTEP		0xa
+#define PHY_DLLDL_CNFG			(DWCMSHC_EMMC_PHY_BASE + 0x28)
+#define  PHY_DLLDL_CNFG_SLV_INPSEL	(0x3 << 5)
+#define PHY_DLL_STATUS			(DWCMSHC_EMMC_PHY_BASE + 0x2e)
+#define  PHY_DLL_STATUS_LOCK_STS	BIT(0)
+#define  PHY_DLL_STATUS_ERROR_STS	BIT(1)
+
+/* DWCMSHC specific Mode Select value */
+#define DWCMSHC_CTRL_HS400		0x7
+/* Offset inside the vendor area 1 */
+#define DWCMSHC_EMMC_CONTROL		0x2c
+#define  DWCMSHC_CARD_IS_EMMC		BIT(0)
+#define  DWCMSHC_ENHANCED_STROBE	BIT(8)
 
 struct x5_sdhci_plat {
 	struct mmc_config cfg;
 	struct mmc mmc;
+#if CONFIG_IS_ENABLED(MMC_SDHCI_X5_TUNING_CACHE)
+	bool tuning_deferred;
+	char tuning[64];
+#endif
 };
 
 struct x5_sdhci_priv {
@@ -271,6 +300,109 @@ static int x5_sdhci_set_dll(struct sdhci_host *host, int degrees)
 }
 
 #define X5_TUNING_MAX 128
+/* Tuning commands a cached phase must pass before it is trusted */
+#define X5_TUNING_VERIFY 3
+
+#if CONFIG_IS_ENABLED(MMC_SDHCI_X5_TUNING_CACHE)
+/*
+ * The tuned sample phase is recorded as "<cid>,<mode>,<phase>". The board
+ * keeps it in the "mmc<N>_tuning" environment variable, so that a later
+ * boot with the same card in the same bus mode only has to check the
+ * phase instead of sweeping all of them. Until the environment is loaded
+ * the tuned modes are skipped, see x5_sdhci_tuning_get().
+ */
+static void x5_sdhci_tuning_key(struct mmc *mmc, char *key, int len)
+{
+	snprintf(key, len, "%08x%08x%08x%08x,%d", mmc->cid[0], mmc->cid[1],
+		 mmc->cid[2], mmc->cid[3], mmc->selected_mode);
+}
+
+static int x5_sdhci_tuning_cache_load(struct mmc *mmc, u8 opcode)
+{
+	struct x5_sdhci_plat *plat = dev_get_plat(mmc->dev);
+	struct sdhci_host *host = mmc->priv;
+	char name[16], key[48];
+	const char *val;
+	ulong phase;
+	int len, i;
+
+	if (!(gd->flags & GD_FLG_ENV_READY)) {
+		plat->tuning_deferred = true;
+		return -EAGAIN;
+	}
+
+	snprintf(name, sizeof(name), "mmc%d_tuning", dev_seq(mmc->dev));
+	x5_sdhci_tuning_key(mmc, key, sizeof(key));
+	len = strlen(key);
+	val = env_get(name);
+	if (!val || strncmp(val, key, len) || val[len] != ',')
+		return -ENOENT;
+
+	phase = simple_strtoul(val + len + 1, NULL, 10);
+	if (phase >= X5_TUNING_MAX)
+		return -EINVAL;
+
+	if (x5_sdhci_set_dll(host, phase) < 0)
+		return -EIO;
+
+	for (i = 0; i < X5_TUNING_VERIFY; i++) {
+		if (mmc_send_tuning(mmc, opcode, NULL)) {
+			debug("cached sample phase %lu failed\n", phase);
+			return -EIO;
+		}
+	}
+
+	strlcpy(plat->tuning, val, sizeof(plat->tuning));
+	debug("Using cached sample phase %lu\n", phase);
+	printf("(Tuning Cached!) ");
+
+	return 0;
+}
+
+static void x5_sdhci_tuning_cache_store(struct mmc *mmc, int phase)
+{
+	struct x5_sdhci_plat *plat = dev_get_plat(mmc->dev);
+	char key[48];
+
+	x5_sdhci_tuning_key(mmc, key, sizeof(key));
+	snprintf(plat->tuning, sizeof(plat->tuning), "%s,%d", key, phase);
+}
+
+int x5_sdhci_tuning_get(struct udevice *dev, char *val, int len)
+{
+	struct x5_sdhci_plat *plat;
+	int ret;
+
+	if (dev->driver != DM_DRIVER_GET(x5_sdhci_drv))
+		return -ENODEV;
+
+	plat = dev_get_plat(dev);
+	if (plat->tuning_deferred) {
+		/* Now that the environment is loaded, select the tuned mode */
+		plat->tuning_deferred = false;
+		plat->mmc.has_init = 0;
+		ret = mmc_init(&plat->mmc);
+		if (ret)
+			return ret;
+	}
+
+	if (!plat->tuning[0])
+		return -ENOENT;
+
+	strlcpy(val, plat->tuning, len);
+
+	return 0;
+}
+#else
+static int x5_sdhci_tuning_cache_load(struct mmc *mmc, u8 opcode)
+{
+	return -ENOSYS;
+}
+
+static void x5_sdhci_tuning_cache_store(struct mmc *mmc, int phase)
+{
+}
+#endif
 
 static int x5_sdhci_execute_tuning(struct mmc *mmc, u8 opcode)
 {
@@ -289,6 +421,11 @@ static int x5_sdhci_execute_tuning(struct mmc *mmc, u8 opcode)
 	int middle_phase;
     int current_dll;
 
+	ret = x5_sdhci_tuning_cache_load(mmc, opcode);
+	if (!ret || ret == -EAGAIN)
+		return ret;
+	ret = 0;
+
 	ranges = valloc((X5_TUNING_MAX / 2 + 1) *sizeof(*ranges));
 	if (!ranges)
 		return -ENOMEM;
@@ -367,6 +504,7 @@ static int x5_sdhci_execute_tuning(struct mmc *mmc, u8 opcode)
 		middle_phase);
 
 	x5_sdhci_set_dll(host, middle_phase);
+	x5_sdhci_tuning_cache_store(mmc, middle_phase);
 	printf("(Tuning Ok!) ");
 
 free:
@@ -387,10 +525,118 @@ static void x5_sdhci_set_control_reg(struct sdhci_host *host)
 	priv->has_pad_init = 1;
 }
 
+/*
+ * In HS400 the data is sampled on the data strobe, which is delayed by
+ * the PHY DLL. The DLL has to be locked before any data transfer.
+ */
+static int x5_sdhci_phy_dll_enable(struct sdhci_host *host, bool enable)
+{
+	unsigned int timeout;
+	u8 val;
+
+	sdhci_writeb(host, 0, PHY_DLL_CTRL);
+	if (!enable)
+		return 0;
+
+	sdhci_writeb(host, PHY_DLL_CNFG1_SLVDLY | PHY_DLL_CNFG1_WAITCYCLE,
+		     PHY_DLL_CNFG1);
+	sdhci_writeb(host, PHY_DLL_CNFG2_JUMPSTEP, PHY_DLL_CNFG2);
+	sdhci_writeb(host, PHY_DLLDL_CNFG_SLV_INPSEL, PHY_DLLDL_CNFG);
+	sdhci_writeb(host, PHY_DLL_CTRL_ENABLE, PHY_DLL_CTRL);
+
+	/* Wait max 150 ms */
+	timeout = 150;
+	while (!((val = sdhci_readb(host, PHY_DLL_STATUS)) &
+		 PHY_DLL_STATUS_LOCK_STS)) {
+		if (timeout == 0) {
+			printf("%s: phy dll never locked.\n", __func__);
+			return -ETIMEDOUT;
+		}
+		timeout--;
+		udelay(1000);
+	}
+
+	if (val & PHY_DLL_STATUS_ERROR_STS) {
+		printf("%s: phy dll lock error.\n", __func__);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int x5_sdhci_set_ios_post(struct sdhci_host *host)
+{
+	struct mmc *mmc = host->mmc;
+	struct x5_sdhci_priv *priv = dev_get_priv(mmc->dev);
+	u16 ctrl;
+	u32 reg;
+
+	ctrl = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+	if (mmc->selected_mode == MMC_HS_400 ||
+	    mmc->selected_mode == MMC_HS_400_ES) {
+		ctrl &= ~SDHCI_CTRL_UHS_MASK;
+		ctrl |= DWCMSHC_CTRL_HS400;
+		sdhci_writew(host, ctrl, SDHCI_HOST_CONTROL2);
+
+		/* set CARD_IS_EMMC bit to enable Data Strobe for HS400 */
+		reg = sdhci_readl(host, priv->mshc_ctrl_addr +
+				  DWCMSHC_EMMC_CONTROL);
+		reg |= DWCMSHC_CARD_IS_EMMC;
+		sdhci_writel(host, reg, priv->mshc_ctrl_addr +
+			     DWCMSHC_EMMC_CONTROL);
+
+		return x5_sdhci_phy_dll_enable(host, true);
+	}
+
+	/* Leaving HS400, e.g. on a fallback to a slower mode */
+	if ((ctrl & SDHCI_CTRL_UHS_MASK) == DWCMSHC_CTRL_HS400) {
+		ctrl &= ~SDHCI_CTRL_UHS_MASK;
+		sdhci_writew(host, ctrl, SDHCI_HOST_CONTROL2);
+		x5_sdhci_phy_dll_enable(host, false);
+	}
+
+	return 0;
+}
+
+static int x5_sdhci_set_enhanced_strobe(struct sdhci_host *host)
+{
+	struct mmc *mmc = host->mmc;
+	struct x5_sdhci_priv *priv = dev_get_priv(mmc->dev);
+	u32 reg;
+
+	reg = sdhci_readl(host, priv->mshc_ctrl_addr + DWCMSHC_EMMC_CONTROL);
+	if (mmc->selected_mode == MMC_HS_400_ES)
+		reg |= DWCMSHC_ENHANCED_STROBE;
+	else
+		reg &= ~DWCMSHC_ENHANCED_STROBE;
+	sdhci_writel(host, reg, priv->mshc_ctrl_addr + DWCMSHC_EMMC_CONTROL);
+
+	return 0;
+}
+
+static void x5_sdhci_adma_write_desc(struct sdhci_host *host, void **desc,
+				     dma_addr_t addr, int len, bool end)
+{
+	dma_addr_t boundary = ALIGN(addr + 1, DWCMSHC_ADMA_BOUNDARY);
+	int first;
+
+	if (addr + len <= boundary) {
+		sdhci_adma_write_desc(desc, addr, len, end);
+		return;
+	}
+
+	first = boundary - addr;
+	sdhci_adma_write_desc(desc, addr, first, false);
+	sdhci_adma_write_desc(desc, boundary, len - first, end);
+}
+
 const struct sdhci_ops x5_sdhci_ops = {
 	.platform_execute_tuning	= &x5_sdhci_execute_tuning,
 	.set_control_reg = &x5_sdhci_set_control_reg,
 	.platform_set_clock = &x5_sdhci_set_clock,
+	.adma_write_desc = &x5_sdhci_adma_write_desc,
+	.set_ios_post = &x5_sdhci_set_ios_post,
+	.set_enhanced_strobe = &x5_sdhci_set_enhanced_strobe,
 };
 
 static int x5_soc_reset(struct udevice *dev)
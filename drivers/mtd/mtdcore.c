@@ -30,6 +30,7 @@
 #include <linux/bug.h>
 #include <linux/err.h>
 #include <ubi_uboot.h>
+#include <bootstage.h>
 #endif
 
 #include <linux/log2.h>
@@ -975,6 +976,8 @@ EXPORT_SYMBOL_GPL(mtd_get_unmapped_area);
 int mtd_read(struct mtd_info *mtd, loff_t from, size_t len, size_t *retlen,
 	     u_char *buf)
 {
+	struct mtd_info *master = mtd;
+	ulong start_us = 0;
 	int ret_code;
 	*retlen = 0;
 	if (from < 0 || from > mtd->size || len > mtd->size - from)
@@ -987,6 +990,8 @@ int mtd_read(struct mtd_info *mtd, loff_t from, size_t len, size_t *retlen,
 	 * representing the maximum number of bitflips that were corrected on
 	 * any one ecc region (if applicable; zero otherwise).
 	 */
+	if (CONFIG_IS_ENABLED(BOOTSTAGE_TIMELINE))
+		start_us = timer_get_boot_us();
 	if (mtd->_read) {
 		ret_code = mtd->_read(mtd, from, len, retlen, buf);
 	} else if (mtd->_read_oob) {
@@ -1001,6 +1006,11 @@ int mtd_read(struct mtd_info *mtd, loff_t from, size_t len, size_t *retlen,
 		return -ENOTSUPP;
 	}
 
+	/* Account partition reads to the device they are on */
+	while (master->parent)
+		master = master->parent;
+	bootstage_io(master->name, -1, *retlen, start_us);
+
 	if (unlikely(ret_code < 0))
 		return ret_code;
 	if (mtd->ecc_strength == 0)
@@ -25,10 +25,12 @@
 #include <watchdog.h>
 #include <spi.h>
 #include <spi-mem.h>
+#include <asm/cache.h>
 #include <dm/device_compat.h>
 #include <dm/devres.h>
 #include <linux/bitops.h>
 #include <linux/bug.h>
+#include <linux/err.h>
 #include <linux/mtd/spinand.h>
 #endif
 
@@ -243,27 +245,20 @@ static int spinand_load_page_op(struct spinand_device *spinand,
 static int spinand_read_from_cache_op(struct spinand_device *spinand,
 				      const struct nand_page_io_req *req)
 {
-	struct spi_mem_op op = *spinand->op_templates.read_cache;
 	struct nand_device *nand = spinand_to_nand(spinand);
 	struct mtd_info *mtd = nanddev_to_mtd(nand);
-	struct nand_page_io_req adjreq = *req;
+	struct spi_mem_dirmap_desc *rdesc;
 	unsigned int nbytes = 0;
 	void *buf = NULL;
 	u16 column = 0;
-	int ret;
+	ssize_t ret;
 
 	if (req->datalen) {
-		adjreq.datalen = nanddev_page_size(nand);
-		adjreq.dataoffs = 0;
-		adjreq.databuf.in = spinand->databuf;
 		buf = spinand->databuf;
-		nbytes = adjreq.datalen;
+		nbytes = nanddev_page_size(nand);
 	}
 
 	if (req->ooblen) {
-		adjreq.ooblen = nanddev_per_page_oobsize(nand);
-		adjreq.ooboffs = 0;
-		adjreq.oobbuf.in = spinand->oobbuf;
 		nbytes += nanddev_per_page_oobsize(nand);
 		if (!buf) {
 			buf = spinand->oobbuf;
@@ -271,28 +266,25 @@ static int spinand_read_from_cache_op(struct spinand_device *spinand,
 		}
 	}
 
-	spinand_cache_op_adjust_colum(spinand, &adjreq, &column);
-	op.addr.val = column;
+	/* The plane number is already part of the mapping offset */
+	rdesc = spinand->dirmaps[req->pos.plane].rdesc;
 
 	/*
 	 * Some controllers are limited in term of max RX data size. In this
-	 * case, just repeat the READ_CACHE operation after updating the
-	 * column.
+	 * case, the dirmap read returns less than requested and we just
+	 * repeat it after updating the column.
 	 */
 	while (nbytes) {
-		op.data.buf.in = buf;
-		op.data.nbytes = nbytes;
-		ret = spi_mem_adjust_op_size(spinand->slave, &op);
-		if (ret)
+		ret = spi_mem_dirmap_read(rdesc, column, nbytes, buf);
+		if (ret < 0)
 			return ret;
 
-		ret = spi_mem_exec_op(spinand->slave, &op);
-		if (ret)
-			return ret;
+		if (!ret || ret > nbytes)
+			return -EIO;
 
-		buf += op.data.nbytes;
-		nbytes -= op.data.nbytes;
-		op.addr.val += op.data.nbytes;
+		buf += ret;
+		nbytes -= ret;
+		column += ret;
 	}
 
 	if (req->datalen)
@@ -560,24 +552,17 @@ static int spinand_write_page(struct spinand_device *spinand,
 	return ret;
 }
 
-static int spinand_mtd_read(struct mtd_info *mtd, loff_t from,
-			    struct mtd_oob_ops *ops)
+static int spinand_mtd_regular_page_read(struct mtd_info *mtd, loff_t from,
+					 struct mtd_oob_ops *ops,
+					 bool enable_ecc,
+					 unsigned int *max_bitflips)
 {
 	struct spinand_device *spinand = mtd_to_spinand(mtd);
 	struct nand_device *nand = mtd_to_nanddev(mtd);
-	unsigned int max_bitflips = 0;
 	struct nand_io_iter iter;
-	bool enable_ecc = false;
 	bool ecc_failed = false;
 	int ret = 0;
 
-	if (ops->mode != MTD_OPS_RAW && spinand->eccinfo.ooblayout)
-		enable_ecc = true;
-
-#ifndef __UBOOT__
-	mutex_lock(&spinand->lock);
-#endif
-
 	nanddev_io_for_each_page(nand, from, ops, &iter) {
 		WATCHDOG_RESET();
 		ret = spinand_select_target(spinand, iter.req.pos.target);
@@ -598,18 +583,237 @@ static int spinand_mtd_read(struct mtd_info *mtd, loff_t from,
 			ret = 0;
 		} else {
 			mtd->ecc_stats.corrected += ret;
-			max_bitflips = max_t(unsigned int, max_bitflips, ret);
+			*max_bitflips = max_t(unsigned int, *max_bitflips, ret);
+			ret = 0;
 		}
 
 		ops->retlen += iter.req.datalen;
 		ops->oobretlen += iter.req.ooblen;
 	}
 
+	if (ecc_failed && !ret)
+		ret = -EBADMSG;
+
+	return ret;
+}
+
+/*
+ * Read @npages consecutive pages starting at @pos with the chip in continuous
+ * read mode. The chip loads page N + 1 into its cache while page N is shifted
+ * out, so only the first page pays the array read latency.
+ */
+static int spinand_cont_read_pages(struct spinand_device *spinand,
+				   const struct nand_pos *pos,
+				   unsigned int npages, u8 *buf,
+				   bool enable_ecc)
+{
+	struct nand_device *nand = spinand_to_nand(spinand);
+	struct nand_page_io_req req = { .pos = *pos };
+	size_t pagesize = nanddev_page_size(nand);
+	size_t len = npages * pagesize;
+	struct spi_mem_op op;
+	size_t done = 0;
+	ssize_t nread;
+	u8 status;
+	int ret, ret2;
+
+	ret = spinand->set_cont_read(spinand, true);
+	if (ret)
+		return ret;
+
+	ret = spinand_load_page_op(spinand, &req);
+	if (ret)
+		goto out;
+
+	ret = spinand_wait(spinand, NULL);
+	if (ret)
+		goto out;
+
+	/*
+	 * Keep every transfer a multiple of the page size, otherwise the data
+	 * output might get out of sequence from one read command to another.
+	 */
+	while (done < len) {
+		op = spinand->cont_rdesc->info.op_tmpl;
+		op.data.nbytes = len - done;
+		ret = spi_mem_adjust_op_size(spinand->slave, &op);
+		if (ret)
+			goto out;
+
+		op.data.nbytes = rounddown(op.data.nbytes, pagesize);
+		if (!op.data.nbytes) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		nread = spi_mem_dirmap_read(spinand->cont_rdesc, done,
+					    op.data.nbytes, buf + done);
+		if (nread < 0) {
+			ret = nread;
+			goto out;
+		}
+
+		if (nread != op.data.nbytes) {
+			ret = -EIO;
+			goto out;
+		}
+
+		done += nread;
+	}
+
+	ret = spinand_wait(spinand, &status);
+	if (ret)
+		goto out;
+
+	if (enable_ecc)
+		ret = spinand_check_ecc_status(spinand, status);
+
+out:
+	ret2 = spinand->set_cont_read(spinand, false);
+	if (ret2 && ret >= 0)
+		ret = ret2;
+
+	return ret;
+}
+
+static int spinand_mtd_continuous_page_read(struct mtd_info *mtd, loff_t from,
+					    struct mtd_oob_ops *ops,
+					    bool enable_ecc,
+					    unsigned int *max_bitflips)
+{
+	struct spinand_device *spinand = mtd_to_spinand(mtd);
+	struct nand_device *nand = mtd_to_nanddev(mtd);
+	size_t pagesize = nanddev_page_size(nand);
+	size_t bsize = nanddev_eraseblock_size(nand);
+	bool ecc_failed = false;
+	int ret = 0;
+
+	/*
+	 * Split the request at eraseblock boundaries: a segment then never
+	 * crosses a die and always fits in the bounce buffer.
+	 */
+	while (ops->retlen < ops->len) {
+		u8 *dst = ops->datbuf + ops->retlen;
+		loff_t offs = from + ops->retlen;
+		struct nand_pos pos;
+		unsigned int pageoffs, npages;
+		size_t seglen, blkoffs;
+		u8 *buf;
+
+		WATCHDOG_RESET();
+		pageoffs = nanddev_offs_to_pos(nand, offs, &pos);
+		blkoffs = pos.page * pagesize + pageoffs;
+		seglen = min_t(size_t, ops->len - ops->retlen, bsize - blkoffs);
+		npages = DIV_ROUND_UP(pageoffs + seglen, pagesize);
+
+		ret = spinand_select_target(spinand, pos.target);
+		if (ret)
+			break;
+
+		ret = spinand_ecc_enable(spinand, enable_ecc);
+		if (ret)
+			break;
+
+		/* Skip the bounce buffer for page-aligned, DMA-able requests */
+		if (!pageoffs && !(seglen % pagesize) &&
+		    IS_ALIGNED((uintptr_t)dst, ARCH_DMA_MINALIGN))
+			buf = dst;
+		else
+			buf = spinand->databuf;
+
+		ret = spinand_cont_read_pages(spinand, &pos, npages, buf,
+					      enable_ecc);
+		if (ret == -EBADMSG) {
+			/*
+			 * The status only tells us that one of the pages is
+			 * uncorrectable: redo the segment page by page to get
+			 * the exact ECC stats and return as much good data as
+			 * possible.
+			 */
+			struct mtd_oob_ops segops = {
+				.mode = ops->mode,
+				.len = seglen,
+				.datbuf = dst,
+			};
+
+			ret = spinand_mtd_regular_page_read(mtd, offs, &segops,
+							    enable_ecc,
+							    max_bitflips);
+			ops->retlen += segops.retlen;
+			if (ret == -EBADMSG) {
+				ecc_failed = true;
+				ret = 0;
+			}
+			if (ret)
+				break;
+
+			continue;
+		}
+
+		if (ret < 0)
+			break;
+
+		mtd->ecc_stats.corrected += ret;
+		*max_bitflips = max_t(unsigned int, *max_bitflips, ret);
+		ret = 0;
+
+		if (buf != dst)
+			memcpy(dst, buf + pageoffs, seglen);
+
+		ops->retlen += seglen;
+	}
+
+	if (ecc_failed && !ret)
+		ret = -EBADMSG;
+
+	return ret;
+}
+
+static bool spinand_use_cont_read(struct mtd_info *mtd, loff_t from,
+				  struct mtd_oob_ops *ops)
+{
+	struct spinand_device *spinand = mtd_to_spinand(mtd);
+	struct nand_device *nand = mtd_to_nanddev(mtd);
+	size_t pagesize = nanddev_page_size(nand);
+
+	if (!spinand->cont_read_possible)
+		return false;
+
+	/* The OOB area is not part of the continuous read stream */
+	if (ops->ooblen || ops->oobbuf || !ops->datbuf)
+		return false;
+
+	/* Only worth it if more than one page is involved */
+	return (from & (pagesize - 1)) + ops->len > pagesize;
+}
+
+static int spinand_mtd_read(struct mtd_info *mtd, loff_t from,
+			    struct mtd_oob_ops *ops)
+{
+	struct spinand_device *spinand = mtd_to_spinand(mtd);
+	unsigned int max_bitflips = 0;
+	bool enable_ecc = false;
+	int ret;
+
+	if (ops->mode != MTD_OPS_RAW && spinand->eccinfo.ooblayout)
+		enable_ecc = true;
+
+#ifndef __UBOOT__
+	mutex_lock(&spinand->lock);
+#endif
+
+	if (spinand_use_cont_read(mtd, from, ops))
+		ret = spinand_mtd_continuous_page_read(mtd, from, ops,
+						       enable_ecc,
+						       &max_bitflips);
+	else
+		ret = spinand_mtd_regular_page_read(mtd, from, ops,
+						    enable_ecc,
+						    &max_bitflips);
+
 #ifndef __UBOOT__
 	mutex_unlock(&spinand->lock);
 #endif
-	if (ecc_failed && !ret)
-		ret = -EBADMSG;
 
 	return ret ? ret : max_bitflips;
 }
@@ -959,6 +1163,15 @@ int spinand_match_and_init(struct spinand_device *spinand,
 					       info->op_variants.update_cache);
 		spinand->op_templates.update_cache = op;
 
+		if (info->set_cont_read) {
+			op = spinand_select_op_variant(spinand,
+						       info->cont_read_cache);
+			if (op) {
+				spinand->op_templates.cont_read_cache = op;
+				spinand->set_cont_read = info->set_cont_read;
+			}
+		}
+
 		return 0;
 	}
 
@@ -1003,6 +1216,104 @@ static int spinand_detect(struct spinand_device *spinand)
 	return 0;
 }
 
+static int spinand_create_dirmap(struct spinand_device *spinand,
+				 unsigned int plane)
+{
+	struct nand_device *nand = spinand_to_nand(spinand);
+	struct spi_mem_dirmap_info info = {
+		.length = nanddev_page_size(nand) +
+			  nanddev_per_page_oobsize(nand),
+	};
+	struct spi_mem_dirmap_desc *desc;
+
+	/* The plane number is passed in MSB just above the column address */
+	info.offset = plane << fls(nand->memorg.pagesize);
+
+	info.op_tmpl = *spinand->op_templates.read_cache;
+	desc = spi_mem_dirmap_create(spinand->slave, &info);
+	if (IS_ERR(desc))
+		return PTR_ERR(desc);
+
+	spinand->dirmaps[plane].rdesc = desc;
+
+	return 0;
+}
+
+static void spinand_create_cont_dirmap(struct spinand_device *spinand)
+{
+	struct nand_device *nand = spinand_to_nand(spinand);
+	struct spi_mem_dirmap_info info = {
+		.op_tmpl = *spinand->op_templates.cont_read_cache,
+		.length = nanddev_eraseblock_size(nand),
+	};
+	struct spi_mem_dirmap_desc *desc;
+	struct spi_mem_op op = info.op_tmpl;
+
+	/*
+	 * The controller must be able to move at least one full page per
+	 * command, otherwise there is no way to keep the output in sequence.
+	 */
+	op.data.nbytes = nanddev_page_size(nand);
+	if (spi_mem_adjust_op_size(spinand->slave, &op) ||
+	    op.data.nbytes != nanddev_page_size(nand))
+		goto disable;
+
+	desc = spi_mem_dirmap_create(spinand->slave, &info);
+	if (IS_ERR(desc))
+		goto disable;
+
+	spinand->cont_rdesc = desc;
+
+	return;
+
+disable:
+	/* Not fatal, we just fall back to page reads */
+	spinand->cont_read_possible = false;
+}
+
+static int spinand_create_dirmaps(struct spinand_device *spinand)
+{
+	struct nand_device *nand = spinand_to_nand(spinand);
+	int i, ret;
+
+	spinand->dirmaps = kcalloc(nand->memorg.planes_per_lun,
+				   sizeof(*spinand->dirmaps), GFP_KERNEL);
+	if (!spinand->dirmaps)
+		return -ENOMEM;
+
+	for (i = 0; i < nand->memorg.planes_per_lun; i++) {
+		ret = spinand_create_dirmap(spinand, i);
+		if (ret)
+			return ret;
+	}
+
+	if (spinand->cont_read_possible)
+		spinand_create_cont_dirmap(spinand);
+
+	return 0;
+}
+
+static void spinand_destroy_dirmaps(struct spinand_device *spinand)
+{
+	struct nand_device *nand = spinand_to_nand(spinand);
+	int i;
+
+	if (spinand->cont_rdesc)
+		spi_mem_dirmap_destroy(spinand->cont_rdesc);
+	spinand->cont_rdesc = NULL;
+
+	if (!spinand->dirmaps)
+		return;
+
+	for (i = 0; i < nand->memorg.planes_per_lun; i++) {
+		if (spinand->dirmaps[i].rdesc)
+			spi_mem_dirmap_destroy(spinand->dirmaps[i].rdesc);
+	}
+
+	kfree(spinand->dirmaps);
+	spinand->dirmaps = NULL;
+}
+
 static int spinand_noecc_ooblayout_ecc(struct mtd_info *mtd, int section,
 				       struct mtd_oob_region *region)
 {
@@ -1031,6 +1342,7 @@ static int spinand_init(struct spinand_device *spinand)
 {
 	struct mtd_info *mtd = spinand_to_mtd(spinand);
 	struct nand_device *nand = mtd_to_nanddev(mtd);
+	size_t bufsize;
 	int ret, i;
 
 	/*
@@ -1045,14 +1357,23 @@ static int spinand_init(struct spinand_device *spinand)
 	if (ret)
 		goto err_free_bufs;
 
+	/*
+	 * Continuous reads stream whole pages without their OOB area, only do
+	 * it on single-plane chips where the column never carries the plane.
+	 */
+	spinand->cont_read_possible = spinand->set_cont_read &&
+				      nand->memorg.planes_per_lun == 1;
+
 	/*
 	 * Use kzalloc() instead of devm_kzalloc() here, because some drivers
 	 * may use this buffer for DMA access.
 	 * Memory allocated by devm_ does not guarantee DMA-safe alignment.
 	 */
-	spinand->databuf = kzalloc(nanddev_page_size(nand) +
-			       nanddev_per_page_oobsize(nand),
-			       GFP_KERNEL);
+	bufsize = nanddev_page_size(nand) + nanddev_per_page_oobsize(nand);
+	if (spinand->cont_read_possible)
+		bufsize = max_t(size_t, bufsize,
+				nanddev_eraseblock_size(nand));
+	spinand->databuf = kzalloc(bufsize, GFP_KERNEL);
 	if (!spinand->databuf) {
 		ret = -ENOMEM;
 		goto err_free_bufs;
@@ -1095,6 +1416,14 @@ static int spinand_init(struct spinand_device *spinand)
 	if (ret)
 		goto err_manuf_cleanup;
 
+	ret = spinand_create_dirmaps(spinand);
+	if (ret) {
+		dev_err(spinand->slave->dev,
+			"Failed to create direct mappings for read ops (err = %d)\n",
+			ret);
+		goto err_cleanup_nanddev;
+	}
+
 	/*
 	 * Right now, we don't support ECC, so let the whole oob
 	 * area is available for user.
@@ -1120,6 +1449,7 @@ static int spinand_init(struct spinand_device *spinand)
 	return 0;
 
 err_cleanup_nanddev:
+	spinand_destroy_dirmaps(spinand);
 	nanddev_cleanup(nand);
 
 err_manuf_cleanup:
@@ -1135,6 +1465,7 @@ static void spinand_cleanup(struct spinand_device *spinand)
 {
 	struct nand_device *nand = spinand_to_nand(spinand);
 
+	spinand_destroy_dirmaps(spinand);
 	nanddev_cleanup(nand);
 	spinand_manufacturer_cleanup(spinand);
 	kfree(spinand->databuf);
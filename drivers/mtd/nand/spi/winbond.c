@@ -27,6 +27,17 @@ static SPINAND_OP_VARIANTS(read_cache_variants,
 		SPINAND_PAGE_READ_FROM_CACHE_OP(true, 0, 1, NULL, 0),
 		SPINAND_PAGE_READ_FROM_CACHE_OP(false, 0, 1, NULL, 0));
 
+/*
+ * With BUF = 0 the column address is ignored and the output starts at the
+ * first byte of the loaded page, the address cycles only count as dummy
+ * clocks. The fast variants need 32 of them instead of 24.
+ */
+static SPINAND_OP_VARIANTS(cont_read_cache_variants,
+		SPINAND_PAGE_READ_FROM_CACHE_X4_OP(0, 2, NULL, 0),
+		SPINAND_PAGE_READ_FROM_CACHE_X2_OP(0, 2, NULL, 0),
+		SPINAND_PAGE_READ_FROM_CACHE_OP(true, 0, 2, NULL, 0),
+		SPINAND_PAGE_READ_FROM_CACHE_OP(false, 0, 1, NULL, 0));
+
 static SPINAND_OP_VARIANTS(write_cache_variants,
 		SPINAND_PROG_LOAD_X4(true, 0, NULL, 0),
 		SPINAND_PROG_LOAD(true, 0, NULL, 0));
@@ -78,6 +89,12 @@ static int w25m02gv_select_target(struct spinand_device *spinand,
 	return spi_mem_exec_op(spinand->slave, &op);
 }
 
+static int w25n_set_cont_read(struct spinand_device *spinand, bool enable)
+{
+	return spinand_upd_cfg(spinand, WINBOND_CFG_BUF_READ,
+			       enable ? 0 : WINBOND_CFG_BUF_READ);
+}
+
 static const struct spinand_info winbond_spinand_table[] = {
 	SPINAND_INFO("W25M02GV", 0xAB,
 		     NAND_MEMORG(1, 2048, 64, 64, 1024, 1, 1, 2),
@@ -87,7 +104,9 @@ static const struct spinand_info winbond_spinand_table[] = {
 					      &update_cache_variants),
 		     0,
 		     SPINAND_ECCINFO(&w25m02gv_ooblayout, NULL),
-		     SPINAND_SELECT_TARGET(w25m02gv_select_target)),
+		     SPINAND_SELECT_TARGET(w25m02gv_select_target)
+		     SPINAND_CONT_READ(w25n_set_cont_read,
+				       &cont_read_cache_variants)),
 	SPINAND_INFO("W25N01GV", 0xAA,
 		     NAND_MEMORG(1, 2048, 64, 64, 1024, 1, 1, 1),
 		     NAND_ECCREQ(1, 512),
@@ -95,7 +114,9 @@ static const struct spinand_info winbond_spinand_table[] = {
 					      &write_cache_variants,
 					      &update_cache_variants),
 		     0,
-		     SPINAND_ECCINFO(&w25m02gv_ooblayout, NULL)),
+		     SPINAND_ECCINFO(&w25m02gv_ooblayout, NULL),
+		     SPINAND_CONT_READ(w25n_set_cont_read,
+				       &cont_read_cache_variants)),
 
 	SPINAND_INFO("W25N02JW", 0xBF,
 		     NAND_MEMORG(1, 2048, 64, 64, 2048, 1, 1, 1),
@@ -75,15 +75,28 @@
  */
 static void *eqos_alloc_descs(struct eqos_priv *eqos, unsigned int num)
 {
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+	/* No cache-lines to share, so no padding between descriptors */
+	eqos->desc_size = sizeof(struct eqos_desc);
+
+	return (void *)noncached_alloc_type(num * eqos->desc_size,
+					    ARCH_DMA_MINALIGN, NONCACHED_WC);
+#else
 	eqos->desc_size = ALIGN(sizeof(struct eqos_desc),
 				(unsigned int)ARCH_DMA_MINALIGN);
 
 	return memalign(eqos->desc_size, num * eqos->desc_size);
+#endif
 }
 
-static void eqos_free_descs(void *descs)
+static void eqos_free_descs(struct eqos_priv *eqos)
 {
-	free(descs);
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+	noncached_free((phys_addr_t)eqos->descs,
+		       EQOS_DESCRIPTORS_NUM * eqos->desc_size);
+#else
+	free(eqos->descs);
+#endif
 }
 
 static struct eqos_desc *eqos_get_desc(struct eqos_priv *eqos,
@@ -95,20 +108,24 @@ static struct eqos_desc *eqos_get_desc(struct eqos_priv *eqos,
 
 void eqos_inval_desc_generic(void *desc)
 {
+#ifndef CONFIG_SYS_NONCACHED_POOLS
 	unsigned long start = (unsigned long)desc;
 	unsigned long end = ALIGN(start + sizeof(struct eqos_desc),
 				  ARCH_DMA_MINALIGN);
 
 	invalidate_dcache_range(start, end);
+#endif
 }
 
 void eqos_flush_desc_generic(void *desc)
 {
+#ifndef CONFIG_SYS_NONCACHED_POOLS
 	unsigned long start = (unsigned long)desc;
 	unsigned long end = ALIGN(start + sizeof(struct eqos_desc),
 				  ARCH_DMA_MINALIGN);
 
 	flush_dcache_range(start, end);
+#endif
 }
 
 void eqos_inval_buffer_tegra186(void *buf, size_t size)
@@ -1064,6 +1081,34 @@ err:
 	return ret;
 }
 
+/*
+ * Wait for the DMA to hand a TX descriptor back. Descriptors complete in
+ * ring order, so waiting on the most recently queued one drains the ring.
+ */
+static int eqos_tx_wait(struct eqos_priv *eqos, struct eqos_desc *tx_desc)
+{
+	int i;
+
+	for (i = 0; i < EQOS_TX_TIMEOUT_US; i++) {
+		eqos->config->ops->eqos_inval_desc(tx_desc);
+		if (!(readl(&tx_desc->des3) & EQOS_DESC3_OWN))
+			return 0;
+		udelay(1);
+	}
+
+	return -ETIMEDOUT;
+}
+
+static void eqos_tx_drain(struct eqos_priv *eqos)
+{
+	unsigned int last;
+
+	last = (eqos->tx_desc_idx + EQOS_DESCRIPTORS_TX - 1) %
+		EQOS_DESCRIPTORS_TX;
+	if (eqos_tx_wait(eqos, eqos_get_desc(eqos, last, false)))
+		debug("%s: TX timeout\n", __func__);
+}
+
 static void eqos_stop(struct udevice *dev)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
@@ -1076,6 +1121,9 @@ static void eqos_stop(struct udevice *dev)
 	eqos->started = false;
 	eqos->reg_access_ok = false;
 
+	/* Let the frames still queued in the TX ring go out */
+	eqos_tx_drain(eqos);
+
 	/* Disable TX DMA */
 	clrbits_le32(&eqos->dma_regs->ch0_tx_control,
 		     EQOS_DMA_CH0_TX_CONTROL_ST);
@@ -1121,19 +1169,30 @@ static int eqos_send(struct udevice *dev, void *packet, int length)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
 	struct eqos_desc *tx_desc;
-	int i;
+	void *tx_buf;
 
 	debug("%s(dev=%p, packet=%p, length=%d):\n", __func__, dev, packet,
 	      length);
 
-	memcpy(eqos->tx_dma_buf, packet, length);
-	eqos->config->ops->eqos_flush_buffer(eqos->tx_dma_buf, length);
-
+	/*
+	 * Each descriptor owns a slot of tx_dma_buf, so the frame is only
+	 * waited for once the ring wraps around onto a descriptor the DMA
+	 * has not finished with yet.
+	 */
 	tx_desc = eqos_get_desc(eqos, eqos->tx_desc_idx, false);
+	if (eqos_tx_wait(eqos, tx_desc)) {
+		debug("%s: TX timeout\n", __func__);
+		return -ETIMEDOUT;
+	}
+
+	tx_buf = eqos->tx_dma_buf + eqos->tx_desc_idx * EQOS_MAX_PACKET_SIZE;
+	memcpy(tx_buf, packet, length);
+	eqos->config->ops->eqos_flush_buffer(tx_buf, length);
+
 	eqos->tx_desc_idx++;
 	eqos->tx_desc_idx %= EQOS_DESCRIPTORS_TX;
 
-	tx_desc->des0 = (ulong)eqos->tx_dma_buf;
+	tx_desc->des0 = (ulong)tx_buf;
 	tx_desc->des1 = 0;
 	tx_desc->des2 = length;
 	/*
@@ -1147,16 +1206,7 @@ static int eqos_send(struct udevice *dev, void *packet, int length)
 	writel((ulong)eqos_get_desc(eqos, eqos->tx_desc_idx, false),
 		&eqos->dma_regs->ch0_txdesc_tail_pointer);
 
-	for (i = 0; i < 1000000; i++) {
-		eqos->config->ops->eqos_inval_desc(tx_desc);
-		if (!(readl(&tx_desc->des3) & EQOS_DESC3_OWN))
-			return 0;
-		udelay(1);
-	}
-
-	debug("%s: TX timeout\n", __func__);
-
-	return -ETIMEDOUT;
+	return 0;
 }
 
 static int eqos_recv(struct udevice *dev, int flags, uchar **packetp)
@@ -1241,7 +1291,7 @@ static int eqos_probe_resources_core(struct udevice *dev)
 		goto err;
 	}
 
-	eqos->tx_dma_buf = memalign(EQOS_BUFFER_ALIGN, EQOS_MAX_PACKET_SIZE);
+	eqos->tx_dma_buf = memalign(EQOS_BUFFER_ALIGN, EQOS_TX_BUFFER_SIZE);
 	if (!eqos->tx_dma_buf) {
 		debug("%s: memalign(tx_dma_buf) failed\n", __func__);
 		ret = -ENOMEM;
@@ -1257,26 +1307,16 @@ static int eqos_probe_resources_core(struct udevice *dev)
 	}
 	debug("%s: rx_dma_buf=%p\n", __func__, eqos->rx_dma_buf);
 
-	eqos->rx_pkt = malloc(EQOS_MAX_PACKET_SIZE);
-	if (!eqos->rx_pkt) {
-		debug("%s: malloc(rx_pkt) failed\n", __func__);
-		ret = -ENOMEM;
-		goto err_free_rx_dma_buf;
-	}
-	debug("%s: rx_pkt=%p\n", __func__, eqos->rx_pkt);
-
 	eqos->config->ops->eqos_inval_buffer(eqos->rx_dma_buf,
 			EQOS_MAX_PACKET_SIZE * EQOS_DESCRIPTORS_RX);
 
 	debug("%s: OK\n", __func__);
 	return 0;
 
-err_free_rx_dma_buf:
-	free(eqos->rx_dma_buf);
 err_free_tx_dma_buf:
 	free(eqos->tx_dma_buf);
 err_free_descs:
-	eqos_free_descs(eqos->descs);
+	eqos_free_descs(eqos);
 err:
 
 	debug("%s: returns %d\n", __func__, ret);
@@ -1289,10 +1329,9 @@ static int eqos_remove_resources_core(struct udevice *dev)
 
 	debug("%s(dev=%p):\n", __func__, dev);
 
-	free(eqos->rx_pkt);
 	free(eqos->rx_dma_buf);
 	free(eqos->tx_dma_buf);
-	eqos_free_descs(eqos->descs);
+	eqos_free_descs(eqos);
 
 	debug("%s: OK\n", __func__);
 	return 0;
@@ -192,12 +192,14 @@ struct eqos_tegra186_regs {
 #define EQOS_AUTO_CAL_STATUS_ACTIVE			BIT(31)
 
 /* Descriptors */
-#define EQOS_DESCRIPTORS_TX	4
-#define EQOS_DESCRIPTORS_RX	4
+#define EQOS_DESCRIPTORS_TX	CONFIG_DWC_ETH_QOS_TX_DESCS
+#define EQOS_DESCRIPTORS_RX	CONFIG_DWC_ETH_QOS_RX_DESCS
 #define EQOS_DESCRIPTORS_NUM	(EQOS_DESCRIPTORS_TX + EQOS_DESCRIPTORS_RX)
 #define EQOS_BUFFER_ALIGN	ARCH_DMA_MINALIGN
 #define EQOS_MAX_PACKET_SIZE	ALIGN(1568, ARCH_DMA_MINALIGN)
+#define EQOS_TX_BUFFER_SIZE	(EQOS_DESCRIPTORS_TX * EQOS_MAX_PACKET_SIZE)
 #define EQOS_RX_BUFFER_SIZE	(EQOS_DESCRIPTORS_RX * EQOS_MAX_PACKET_SIZE)
+#define EQOS_TX_TIMEOUT_US	1000000
 
 struct eqos_desc {
 	u32 des0;
@@ -269,7 +271,6 @@ struct eqos_priv {
 	unsigned int desc_size;
 	void *tx_dma_buf;
 	void *rx_dma_buf;
-	void *rx_pkt;
 	bool started;
 	bool reg_access_ok;
 	bool clk_ck_enabled;
@@ -9,6 +9,7 @@
  */
 #include <common.h>
 #include <console.h>
+#include <deferred.h>
 #include <dm.h>
 #include <log.h>
 #include <malloc.h>
@@ -265,7 +266,7 @@ int genphy_update_link(struct phy_device *phydev)
 				printf(".");
 
 			mii_reg = phy_read(phydev, MDIO_DEVAD_NONE, MII_BMSR);
-			mdelay(50);	/* 50 ms */
+			deferred_udelay(50 * 1000);	/* 50 ms */
 		}
 		printf(" done\n");
 		phydev->link = 1;
@@ -13,7 +13,9 @@
 #define LOG_CATEGORY UCLASS_SPI
 #include <common.h>
 #include <clk.h>
+#include <cpu_func.h>
 #include <dm.h>
+#include <dma.h>
 #include <dm/device_compat.h>
 #include <errno.h>
 #include <fdtdec.h>
@@ -22,6 +24,7 @@
 #include <reset.h>
 #include <spi.h>
 #include <spi-mem.h>
+#include <asm/cache.h>
 #include <asm/io.h>
 #include <asm-generic/gpio.h>
 #include <linux/bitfield.h>
@@ -167,6 +170,16 @@
 /* Stretch the clock if the FIFO over/underflows */
 #define SPI_CTRLR0_CLK_STRETCH_EN	BIT(30)
 
+/* Bit fields in DMACR */
+#define DMACR_RDMAE			BIT(0)
+#define DMACR_TDMAE			BIT(1)
+
+/*
+ * spi-mem data phases shorter than this are moved by the CPU; setting up
+ * the DMA channel costs more than polling a few FIFOs worth of data.
+ */
+#define DW_SPI_DMA_MIN_LEN		SZ_1K
+
 #define RX_TIMEOUT			1000		/* timeout in ms */
 
 /* DW SPI capabilities */
@@ -192,6 +205,23 @@
 	} while (start < end); \
 } while (0)
 
+/* Frames are shifted MSB first, keep the bytes of a 32-bit frame in order */
+#define do_read_be32() do { \
+	__be32 *start = ((__be32 *)rx) + idx; \
+	__be32 *end = start + count; \
+	do { \
+		*start++ = cpu_to_be32(__raw_readl(dr)); \
+	} while (start < end); \
+} while (0)
+
+#define do_write_be32() do { \
+	const __be32 *start = ((const __be32 *)tx) + idx; \
+	const __be32 *end = start + count; \
+	do { \
+		__raw_writel(be32_to_cpu(*start++), dr); \
+	} while (start < end); \
+} while (0)
+
 #ifdef CONFIG_TARGET_X5
 /* Sunrise5 SoC reset registers */
 #define X5_QSPI_NOC_IDLE_CTRL (0x31032004)
@@ -239,6 +269,13 @@ struct dw_spi_priv {
 	u8 tmode;			/* TR/TO/RO/EEPROM */
 	u8 type;			/* SPI/SSP/MicroWire */
 	u8 spi_frf;			/* BYTE/DUAL/QUAD/OCTAL */
+
+#if CONFIG_IS_ENABLED(DMA_CHANNELS)
+	struct dma rx_dma;
+	struct dma tx_dma;
+	bool has_rx_dma;		/* "rx" channel in dma-names */
+	bool has_tx_dma;		/* "tx" channel in dma-names */
+#endif
 };
 
 static inline u32 dw_read(struct dw_spi_priv *priv, u32 offset)
@@ -520,7 +557,7 @@ static int dw_spi_of_to_plat(struct udevice *bus)
 {
 	struct dw_spi_plat *plat = dev_get_plat(bus);
 
-	plat->regs = dev_read_addr_ptr(bus);
+	plat->regs = dev_remap_addr(bus);
 	if (!plat->regs)
 		return -EINVAL;
 
@@ -625,6 +662,169 @@ static int dw_spi_reset(struct udevice *bus)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(DMA_CHANNELS)
+static void dw_spi_dma_init(struct udevice *bus, struct dw_spi_priv *priv)
+{
+	priv->has_rx_dma = !dma_get_by_name(bus, "rx", &priv->rx_dma);
+	priv->has_tx_dma = !dma_get_by_name(bus, "tx", &priv->tx_dma);
+	if (priv->has_rx_dma || priv->has_tx_dma)
+		dev_dbg(bus, "dma rx:%d tx:%d\n", priv->has_rx_dma,
+			priv->has_tx_dma);
+}
+
+/**
+ * dw_spi_can_dma() - Check if the data phase of @op can use the DMA
+ * @priv: Driver private data
+ * @op: The spi-mem operation
+ *
+ * The buffer is handed to the DMA engine as is, so it must be cache line
+ * aligned. Writes are only done with DMA in enhanced (TMOD_TO) mode, since
+ * in TMOD_TR mode nobody would drain the rx fifo.
+ *
+ * Return: true if the data phase should be moved by the DMA
+ */
+static bool dw_spi_can_dma(struct dw_spi_priv *priv,
+			   const struct spi_mem_op *op)
+{
+	ulong buf = (ulong)op->data.buf.in;
+
+	if (op->data.nbytes < DW_SPI_DMA_MIN_LEN ||
+	    !IS_ALIGNED(buf, ARCH_DMA_MINALIGN) ||
+	    !IS_ALIGNED(op->data.nbytes, ARCH_DMA_MINALIGN))
+		return false;
+
+	if (op->data.dir == SPI_MEM_DATA_IN)
+		return priv->has_rx_dma;
+
+	return priv->has_tx_dma && priv->tmode == CTRLR0_TMOD_TO;
+}
+
+/**
+ * dw_spi_dma_setup() - Arm the controller and the DMA for a data phase
+ * @priv: Driver private data
+ * @op: The spi-mem operation
+ *
+ * Must be called with the controller disabled, before the instruction is
+ * written. The rx channel is started here so that no frame is lost once
+ * the controller begins clocking in data.
+ *
+ * Return: 0 if OK, -ve on error
+ */
+static int dw_spi_dma_setup(struct dw_spi_priv *priv,
+			    const struct spi_mem_op *op)
+{
+	u32 burst = priv->fifo_len / 2;
+	void *buf = op->data.buf.in;
+	size_t len = op->data.nbytes;
+	int ret;
+
+	if (op->data.dir == SPI_MEM_DATA_IN) {
+		invalidate_dcache_range((ulong)buf, (ulong)buf + len);
+		ret = dma_prepare_rcv_buf(&priv->rx_dma, buf, len);
+		if (!ret)
+			ret = dma_enable(&priv->rx_dma);
+		if (ret)
+			return ret;
+
+		dw_write(priv, DW_SPI_DMARDLR, burst - 1);
+		dw_write(priv, DW_SPI_DMACR, DMACR_RDMAE);
+	} else {
+		flush_dcache_range((ulong)buf, (ulong)buf + len);
+		ret = dma_enable(&priv->tx_dma);
+		if (ret)
+			return ret;
+
+		dw_write(priv, DW_SPI_DMATDLR, burst);
+		dw_write(priv, DW_SPI_DMACR, DMACR_TDMAE);
+	}
+
+	return 0;
+}
+
+/**
+ * dw_spi_dma_transfer() - Run the data phase of @op through the DMA
+ * @priv: Driver private data
+ * @op: The spi-mem operation, already set up by dw_spi_dma_setup()
+ *
+ * Return: 0 if OK, -ve on error
+ */
+static int dw_spi_dma_transfer(struct dw_spi_priv *priv,
+			       const struct spi_mem_op *op)
+{
+	void *buf = op->data.buf.in;
+	size_t len = op->data.nbytes;
+	ulong start;
+	int ret;
+
+	if (op->data.dir == SPI_MEM_DATA_OUT) {
+		ret = dma_send(&priv->tx_dma, buf, len, NULL);
+		dma_disable(&priv->tx_dma);
+
+		return ret;
+	}
+
+	start = get_timer(0);
+	do {
+		ret = dma_receive(&priv->rx_dma, &buf, NULL);
+		if (ret)
+			break;
+	} while (get_timer(start) < RX_TIMEOUT);
+
+	dma_disable(&priv->rx_dma);
+	invalidate_dcache_range((ulong)op->data.buf.in,
+				(ulong)op->data.buf.in + len);
+
+	if (!ret)
+		return -ETIMEDOUT;
+
+	return ret < 0 ? ret : 0;
+}
+#else
+static inline void dw_spi_dma_init(struct udevice *bus,
+				   struct dw_spi_priv *priv)
+{
+}
+
+static inline bool dw_spi_can_dma(struct dw_spi_priv *priv,
+				  const struct spi_mem_op *op)
+{
+	return false;
+}
+
+static inline int dw_spi_dma_setup(struct dw_spi_priv *priv,
+				   const struct spi_mem_op *op)
+{
+	return -ENOSYS;
+}
+
+static inline int dw_spi_dma_transfer(struct dw_spi_priv *priv,
+				      const struct spi_mem_op *op)
+{
+	return -ENOSYS;
+}
+#endif
+
+/**
+ * dw_spi_can_dfs32() - Check if the data phase of @op can use 32-bit frames
+ * @priv: Driver private data
+ * @op: The spi-mem operation
+ *
+ * Only enhanced (dual/quad) frames carry the instruction and address in
+ * FIFO entries of their own, so the data frame size can be changed freely.
+ *
+ * Return: true if the data phase should be moved in 32-bit frames
+ */
+static bool dw_spi_can_dfs32(struct dw_spi_priv *priv,
+			     const struct spi_mem_op *op)
+{
+	if (priv->spi_frf == CTRLR0_SPI_FRF_BYTE ||
+	    !(priv->caps & (DW_SPI_CAP_DWC_SSI | DW_SPI_CAP_DFS32)))
+		return false;
+
+	return op->data.nbytes && IS_ALIGNED(op->data.nbytes, 4) &&
+	       IS_ALIGNED((ulong)op->data.buf.in, 4);
+}
+
 typedef int (*dw_spi_init_t)(struct udevice *bus, struct dw_spi_priv *priv);
 
 static int dw_spi_probe(struct udevice *bus)
@@ -668,6 +868,8 @@ static int dw_spi_probe(struct udevice *bus)
 	/* Basic HW init */
 	spi_hw_init(bus, priv);
 
+	dw_spi_dma_init(bus, priv);
+
 	return 0;
 }
 
@@ -714,7 +916,7 @@ static inline uint dw_writer_enh(struct dw_spi_priv *priv, const void *tx, uint
 	case 3:
 	case 4:
 	default:
-		do_write(u32);
+		do_write_be32();
 		break;
 	}
 	return count;
@@ -752,7 +954,7 @@ static inline uint dw_reader_enh(struct dw_spi_priv *priv, void *rx, uint idx, u
 	case 3:
 	case 4:
 	default:
-		do_read(u32);
+		do_read_be32();
 		break;
 	}
 	return count;
@@ -779,17 +981,19 @@ static uint poll_transfer_enh(struct dw_spi_priv *priv, const void *tx, void *rx
 	uint rx_frames = rx ? frames : 0;
 
 	while (tx_frames || rx_frames) {
+		uint tx_diff = 0, rx_diff = 0;
+
 		if (tx_frames) {
-			uint tx_diff = dw_writer_enh(priv, tx, tx_idx, tx_frames,
-						 rx_frames, frame_bytes);
+			tx_diff = dw_writer_enh(priv, tx, tx_idx, tx_frames,
+						rx_frames, frame_bytes);
 
 			tx_idx += tx_diff;
 			tx_frames -= tx_diff;
 		}
 
 		if (rx_frames) {
-			uint rx_diff = dw_reader_enh(priv, rx, rx_idx, rx_frames,
-						 frame_bytes);
+			rx_diff = dw_reader_enh(priv, rx, rx_idx, rx_frames,
+						frame_bytes);
 
 			rx_idx += rx_diff;
 			rx_frames -= rx_diff;
@@ -798,9 +1002,11 @@ static uint poll_transfer_enh(struct dw_spi_priv *priv, const void *tx, void *rx
 		/*
 		 * If we don't read/write fast enough, the transfer stops.
 		 * Don't bother reading out what's left in the FIFO; it's
-		 * garbage.
+		 * garbage. The FIFOs only stall when nothing moved, so only
+		 * then spend a register read on checking for that.
 		 */
-		if (dw_read(priv, DW_SPI_RISR) & (ISR_RXOI | ISR_TXUI))
+		if (!tx_diff && !rx_diff &&
+		    dw_read(priv, DW_SPI_RISR) & (ISR_RXOI | ISR_TXUI))
 			break;
 	}
 	return min(tx ? tx_idx : rx_idx, rx ? rx_idx : tx_idx);
@@ -1005,6 +1211,8 @@ static int dw_spi_exec_op(struct spi_slave *slave, const struct spi_mem_op *op)
 	u32 cr0, spi_cr0, val;
 	u32 rx_sample_dly;
 	u32 rx_sample_dly_ns;
+	uint frame_bytes, frames;
+	bool use_dma;
 
 	/* Only bytes are supported for spi-mem transfers */
 	if (priv->bits_per_word != 8)
@@ -1036,6 +1244,17 @@ static int dw_spi_exec_op(struct spi_slave *slave, const struct spi_mem_op *op)
 		else
 			priv->tmode = CTRLR0_TMOD_TO;
 
+	/*
+	 * The CPU moves enhanced data phases in 32-bit frames, a quarter of
+	 * the FIFO accesses byte frames need. The DMA keeps byte frames, as
+	 * it moves the bytes in memory order.
+	 */
+	use_dma = dw_spi_can_dma(priv, op);
+	if (!use_dma && dw_spi_can_dfs32(priv, op))
+		priv->bits_per_word = 32;
+	frame_bytes = priv->bits_per_word >> 3;
+	frames = op->data.nbytes / frame_bytes;
+
 	cr0 = dw_spi_update_cr0(priv);
 	spi_cr0 = dw_spi_update_spi_cr0(op);
 	dev_dbg(bus, "cr0=%08x spi_cr0=%08x buf=%p len=%u [bytes]\n", cr0,
@@ -1047,7 +1266,7 @@ static int dw_spi_exec_op(struct spi_slave *slave, const struct spi_mem_op *op)
 	dw_write(priv, DW_SPI_CTRLR0, cr0);
 	if (priv->spi_frf != CTRLR0_SPI_FRF_BYTE)
 		dw_write(priv, DW_SPI_ENHANCE_CTRLR0, spi_cr0);
-	dw_write(priv, DW_SPI_CTRLR1, op->data.nbytes - 1);
+	dw_write(priv, DW_SPI_CTRLR1, frames - 1);
 	if (priv->spi_frf == CTRLR0_SPI_FRF_QUAD && priv->tmode == CTRLR0_TMOD_TO) {
 		val = dw_read(priv, DW_SPI_TXFTLR);
 		val &= (unsigned int)0xffff;
@@ -1067,6 +1286,12 @@ static int dw_spi_exec_op(struct spi_slave *slave, const struct spi_mem_op *op)
 		dw_write(priv, DW_SPI_RX_SAMPLE_DLY, rx_sample_dly);
 		priv->cur_rx_sample_dly = rx_sample_dly;
 	}
+
+	/* Fall back to polling if the DMA can't take this data phase */
+	if (use_dma && dw_spi_dma_setup(priv, op))
+		use_dma = false;
+	if (!use_dma)
+		dw_write(priv, DW_SPI_DMACR, 0);
 	dw_write(priv, DW_SPI_SSIENR, 1);
 
 	/* Write out the instruction */
@@ -1092,12 +1317,14 @@ static int dw_spi_exec_op(struct spi_slave *slave, const struct spi_mem_op *op)
 	 * XXX: The following are tight loops! Enabling debug messages may cause
 	 * them to fail because we are not reading/writing the fifo fast enough.
 	 */
-	if (read)
+	if (use_dma)
+		ret = dw_spi_dma_transfer(priv, op);
+	else if (read)
 		mut_op->data.nbytes = poll_transfer_enh(priv, NULL, op->data.buf.in,
-						    op->data.nbytes);
+						    frames) * frame_bytes;
 	else
 		mut_op->data.nbytes = poll_transfer_enh(priv, op->data.buf.out,
-						    NULL, op->data.nbytes);
+						    NULL, frames) * frame_bytes;
 	/*
 	 * Ensure the data (or the instruction for zero-data instructions) has
 	 * been transmitted from the fifo/shift register before disabling the
@@ -1109,8 +1336,11 @@ static int dw_spi_exec_op(struct spi_slave *slave, const struct spi_mem_op *op)
 		dev_dbg(bus, "timed out; sr=%x\n", dw_read(priv, DW_SPI_SR));
 		ret = -ETIMEDOUT;
 	}
+	if (use_dma)
+		dw_write(priv, DW_SPI_DMACR, 0);
 	dw_write(priv, DW_SPI_SER, 0);
 	external_cs_manage(slave->dev, true);
+	priv->bits_per_word = 8;
 
 	dev_dbg(bus, "%u bytes xfered\n", op->data.nbytes);
 	return ret;
@@ -1212,6 +1442,13 @@ static int dw_spi_remove(struct udevice *bus)
 	struct dw_spi_priv *priv = dev_get_priv(bus);
 	int ret;
 
+#if CONFIG_IS_ENABLED(DMA_CHANNELS)
+	if (priv->has_rx_dma)
+		dma_free(&priv->rx_dma);
+	if (priv->has_tx_dma)
+		dma_free(&priv->tx_dma);
+#endif
+
 	ret = reset_release_bulk(&priv->resets);
 	if (ret)
 		return ret;
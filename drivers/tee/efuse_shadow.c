@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Copyright(C) 2024, D-Robotics Co., Ltd. All rights reserved
+ *
+ * RAM mirror of the efuses readable through the efuse PTA. One session and
+ * one shared memory buffer are kept for all requests, so that reading a
+ * handful of words costs one PTA call per readable region instead of a
+ * session per word.
+ */
+
+#define LOG_CATEGORY UCLASS_TEE
+
+#include <common.h>
+#include <log.h>
+#include <tee.h>
+#include <tee/efuse_shadow.h>
+#include <tee/optee_ta_efuse.h>
+#include <linux/bitops.h>
+
+struct efuse_region {
+	u32 offset;
+	u32 size;
+};
+
+static const struct efuse_region efuse_readable[] = PTA_EFUSE_READABLE;
+
+/**
+ * struct efuse_shadow - State of the mirror
+ *
+ * @dev:	TEE device of the session, NULL if no session is open
+ * @session:	Session to the efuse PTA
+ * @shm:	Buffer passed to the PTA, PTA_EFUSE_SIZE bytes
+ * @loaded:	The regions have been read since the last invalidation
+ * @valid:	Bit n is set if efuse_readable[n] is in @mirror
+ * @mirror:	Copy of the efuse array
+ */
+struct efuse_shadow {
+	struct udevice *dev;
+	u32 session;
+	struct tee_shm *shm;
+	bool loaded;
+	u32 valid;
+	u8 mirror[PTA_EFUSE_SIZE];
+};
+
+static struct efuse_shadow shadow;
+
+static int efuse_shadow_open(void)
+{
+	const struct tee_optee_ta_uuid uuid = PTA_EFUSE_UUID;
+	struct tee_open_session_arg arg;
+	struct udevice *dev;
+	int ret;
+
+	if (shadow.dev)
+		return 0;
+
+	dev = tee_find_device(NULL, NULL, NULL, NULL);
+	if (!dev)
+		return -ENODEV;
+
+	ret = tee_shm_alloc(dev, PTA_EFUSE_SIZE, TEE_SHM_ALLOC, &shadow.shm);
+	if (ret)
+		return -ENOMEM;
+
+	memset(&arg, 0, sizeof(arg));
+	tee_optee_ta_uuid_to_octets(arg.uuid, &uuid);
+	if (tee_open_session(dev, &arg, 0, NULL) || arg.ret) {
+		tee_shm_free(shadow.shm);
+		shadow.shm = NULL;
+		return -ENXIO;
+	}
+
+	shadow.dev = dev;
+	shadow.session = arg.session;
+
+	return 0;
+}
+
+static int efuse_shadow_invoke(u32 func, u32 offset, u32 size, bool quiet)
+{
+	struct tee_invoke_arg arg;
+	struct tee_param param[2];
+	int ret;
+
+	memset(param, 0, sizeof(param));
+	param[0].attr = TEE_PARAM_ATTR_TYPE_VALUE_INPUT;
+	param[0].u.value.a = offset;
+	param[1].attr = TEE_PARAM_ATTR_TYPE_MEMREF_OUTPUT;
+	param[1].u.memref.shm = shadow.shm;
+	param[1].u.memref.size = size;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.func = func;
+	arg.session = shadow.session;
+
+	ret = tee_invoke_func(shadow.dev, &arg, ARRAY_SIZE(param), param);
+	if (ret) {
+		printf("tee_invoke_func failed with error [0x%x]\n", ret);
+		return ret;
+	}
+	if (arg.ret) {
+		if (quiet)
+			log_debug("efuse %#x+%#x: error %#x\n", offset, size,
+				  arg.ret);
+		else if (arg.ret == TEE_ERROR_ACCESS_DENIED)
+			printf("efuse region access denied\n");
+		else
+			printf("optee %s efuse failed with error [0x%x]\n",
+			       func == PTA_EFUSE_READ ? "read" : "write",
+			       arg.ret);
+		return arg.ret;
+	}
+
+	return 0;
+}
+
+/* Read every readable region, leaving out the ones the PTA refuses */
+static int efuse_shadow_load(void)
+{
+	const struct efuse_region *reg;
+	int ret;
+	int i;
+
+	if (shadow.loaded)
+		return 0;
+
+	ret = efuse_shadow_open();
+	if (ret)
+		return ret;
+
+	shadow.valid = 0;
+	for (i = 0; i < ARRAY_SIZE(efuse_readable); i++) {
+		reg = &efuse_readable[i];
+		if (efuse_shadow_invoke(PTA_EFUSE_READ, reg->offset, reg->size,
+					true))
+			continue;
+		memcpy(shadow.mirror + reg->offset, shadow.shm->addr,
+		       reg->size);
+		shadow.valid |= BIT(i);
+	}
+	shadow.loaded = true;
+
+	return 0;
+}
+
+static bool efuse_shadow_covers(u32 offset, u32 size)
+{
+	const struct efuse_region *reg;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(efuse_readable); i++) {
+		reg = &efuse_readable[i];
+		if ((shadow.valid & BIT(i)) && offset >= reg->offset &&
+		    offset + size <= reg->offset + reg->size)
+			return true;
+	}
+
+	return false;
+}
+
+int efuse_shadow_read(u32 offset, u32 size, void *buf)
+{
+	int ret;
+
+	if (offset > PTA_EFUSE_SIZE || size > PTA_EFUSE_SIZE - offset)
+		return -EINVAL;
+
+	ret = efuse_shadow_load();
+	if (ret)
+		return ret;
+
+	if (efuse_shadow_covers(offset, size)) {
+		memcpy(buf, shadow.mirror + offset, size);
+		return 0;
+	}
+
+	ret = efuse_shadow_invoke(PTA_EFUSE_READ, offset, size, false);
+	if (ret)
+		return ret;
+	memcpy(buf, shadow.shm->addr, size);
+
+	return 0;
+}
+
+int efuse_shadow_write(u32 offset, u32 value)
+{
+	int ret;
+
+	ret = efuse_shadow_open();
+	if (ret)
+		return ret;
+
+	efuse_shadow_invalidate();
+	memcpy(shadow.shm->addr, &value, sizeof(value));
+
+	return efuse_shadow_invoke(PTA_EFUSE_WRITE, offset, sizeof(value),
+				   false);
+}
+
+void efuse_shadow_invalidate(void)
+{
+	shadow.loaded = false;
+	shadow.valid = 0;
+}
+
+void efuse_shadow_release(void)
+{
+	efuse_shadow_invalidate();
+	if (!shadow.dev)
+		return;
+
+	tee_close_session(shadow.dev, shadow.session);
+	tee_shm_free(shadow.shm);
+	shadow.shm = NULL;
+	shadow.dev = NULL;
+}
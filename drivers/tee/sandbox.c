@@ -7,6 +7,7 @@
 #include <sandboxtee.h>
 #include <tee.h>
 #include <tee/optee_ta_avb.h>
+#include <tee/optee_ta_efuse.h>
 #include <tee/optee_ta_rpc_test.h>
 #include <tee/optee_ta_scp03.h>
 
@@ -16,7 +17,7 @@
 /*
  * The sandbox tee driver tries to emulate a generic Trusted Exectution
  * Environment (TEE) with the Trusted Applications (TA) OPTEE_TA_AVB and
- * OPTEE_TA_RPC_TEST available.
+ * OPTEE_TA_RPC_TEST available, and the efuse PTA with TEE_EFUSE_SHADOW.
  */
 
 static const u32 pstorage_max = 16;
@@ -69,7 +70,8 @@ void *optee_alloc_and_init_page_list(void *buf, ulong len,
 	return NULL;
 }
 
-#if defined(CONFIG_OPTEE_TA_SCP03) || defined(CONFIG_OPTEE_TA_AVB)
+#if defined(CONFIG_OPTEE_TA_SCP03) || defined(CONFIG_OPTEE_TA_AVB) || \
+	defined(CONFIG_TEE_EFUSE_SHADOW)
 static u32 get_attr(uint n, uint num_params, struct tee_param *params)
 {
 	if (n >= num_params)
@@ -169,6 +171,8 @@ static u32 ta_avb_invoke_func(struct udevice *dev, u32 func, uint num_params,
 	char *value;
 	u32 value_sz;
 
+	state->ta_avb_invokes++;
+
 	switch (func) {
 	case TA_AVB_CMD_READ_ROLLBACK_INDEX:
 		res = check_params(TEE_PARAM_ATTR_TYPE_VALUE_INPUT,
@@ -212,6 +216,31 @@ static u32 ta_avb_invoke_func(struct udevice *dev, u32 func, uint num_params,
 		state->ta_avb_rollback_indexes[slot] = val;
 		return TEE_SUCCESS;
 
+	case TA_AVB_CMD_READ_STATE:
+		if (state->ta_avb_no_read_state)
+			return TEE_ERROR_NOT_SUPPORTED;
+
+		res = check_params(TEE_PARAM_ATTR_TYPE_MEMREF_OUTPUT,
+				   TEE_PARAM_ATTR_TYPE_NONE,
+				   TEE_PARAM_ATTR_TYPE_NONE,
+				   TEE_PARAM_ATTR_TYPE_NONE,
+				   num_params, params);
+		if (res)
+			return res;
+
+		if (params[0].u.memref.size < TA_AVB_STATE_SIZE) {
+			params[0].u.memref.size = TA_AVB_STATE_SIZE;
+			return TEE_ERROR_SHORT_BUFFER;
+		}
+
+		val = state->ta_avb_lock_state;
+		memcpy(params[0].u.memref.shm->addr, &val, sizeof(val));
+		memcpy((u8 *)params[0].u.memref.shm->addr + sizeof(val),
+		       state->ta_avb_rollback_indexes,
+		       sizeof(state->ta_avb_rollback_indexes));
+		params[0].u.memref.size = TA_AVB_STATE_SIZE;
+		return TEE_SUCCESS;
+
 	case TA_AVB_CMD_READ_LOCK_STATE:
 		res = check_params(TEE_PARAM_ATTR_TYPE_VALUE_OUTPUT,
 				   TEE_PARAM_ATTR_TYPE_NONE,
@@ -390,6 +419,77 @@ out:
 }
 #endif /* CONFIG_OPTEE_TA_RPC_TEST */
 
+#ifdef CONFIG_TEE_EFUSE_SHADOW
+static const struct {
+	u32 offset;
+	u32 size;
+} pta_efuse_readable[] = PTA_EFUSE_READABLE;
+
+static u32 pta_efuse_open_session(struct udevice *dev, uint num_params,
+				  struct tee_param *params)
+{
+	return check_params(TEE_PARAM_ATTR_TYPE_NONE, TEE_PARAM_ATTR_TYPE_NONE,
+			    TEE_PARAM_ATTR_TYPE_NONE, TEE_PARAM_ATTR_TYPE_NONE,
+			    num_params, params);
+}
+
+static bool pta_efuse_may_read(u32 offset, u32 size)
+{
+	uint n;
+
+	for (n = 0; n < ARRAY_SIZE(pta_efuse_readable); n++)
+		if (offset >= pta_efuse_readable[n].offset &&
+		    offset + size <= pta_efuse_readable[n].offset +
+				     pta_efuse_readable[n].size)
+			return true;
+
+	return false;
+}
+
+static u32 pta_efuse_invoke_func(struct udevice *dev, u32 func, uint num_params,
+				 struct tee_param *params)
+{
+	struct sandbox_tee_state *state = dev_get_priv(dev);
+	u32 offset, size, value;
+	u8 *buf;
+	u32 res;
+
+	res = check_params(TEE_PARAM_ATTR_TYPE_VALUE_INPUT,
+			   TEE_PARAM_ATTR_TYPE_MEMREF_OUTPUT,
+			   TEE_PARAM_ATTR_TYPE_NONE,
+			   TEE_PARAM_ATTR_TYPE_NONE,
+			   num_params, params);
+	if (res)
+		return res;
+
+	offset = params[0].u.value.a;
+	size = params[1].u.memref.size;
+	buf = params[1].u.memref.shm->addr;
+	if (offset > PTA_EFUSE_SIZE || size > PTA_EFUSE_SIZE - offset)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	switch (func) {
+	case PTA_EFUSE_READ:
+		state->pta_efuse_reads++;
+		if (!pta_efuse_may_read(offset, size))
+			return TEE_ERROR_ACCESS_DENIED;
+		memcpy(buf, state->pta_efuse + offset, size);
+
+		return TEE_SUCCESS;
+	case PTA_EFUSE_WRITE:
+		if (size != sizeof(value) || offset % sizeof(value))
+			return TEE_ERROR_BAD_PARAMETERS;
+		memcpy(&value, state->pta_efuse + offset, sizeof(value));
+		value |= *(u32 *)buf;
+		memcpy(state->pta_efuse + offset, &value, sizeof(value));
+
+		return TEE_SUCCESS;
+	default:
+		return TEE_ERROR_NOT_SUPPORTED;
+	}
+}
+#endif
+
 static const struct ta_entry ta_entries[] = {
 #ifdef CONFIG_OPTEE_TA_AVB
 	{ .uuid = TA_AVB_UUID,
@@ -409,6 +509,12 @@ static const struct ta_entry ta_entries[] = {
 	  .invoke_func = pta_scp03_invoke_func,
 	},
 #endif
+#ifdef CONFIG_TEE_EFUSE_SHADOW
+	{ .uuid = PTA_EFUSE_UUID,
+	  .open_session = pta_efuse_open_session,
+	  .invoke_func = pta_efuse_invoke_func,
+	},
+#endif
 };
 
 static void sandbox_tee_get_version(struct udevice *dev,
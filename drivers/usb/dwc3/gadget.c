@@ -343,9 +343,8 @@ static int dwc3_alloc_trb_pool(struct dwc3_ep *dep)
 	if (dep->number == 0 || dep->number == 1)
 		return 0;
 
-	dep->trb_pool = dma_alloc_coherent(sizeof(struct dwc3_trb) *
-					   DWC3_TRB_NUM,
-					   (unsigned long *)&dep->trb_pool_dma);
+	dep->trb_pool = dwc3_dma_alloc(sizeof(struct dwc3_trb) * DWC3_TRB_NUM,
+				       (unsigned long *)&dep->trb_pool_dma);
 	if (!dep->trb_pool) {
 		dev_err(dep->dwc->dev, "failed to allocate trb pool for %s\n",
 				dep->name);
@@ -357,7 +356,7 @@ static int dwc3_alloc_trb_pool(struct dwc3_ep *dep)
 
 static void dwc3_free_trb_pool(struct dwc3_ep *dep)
 {
-	dma_free_coherent(dep->trb_pool);
+	dwc3_dma_free(dep->trb_pool, sizeof(struct dwc3_trb) * DWC3_TRB_NUM);
 
 	dep->trb_pool = NULL;
 	dep->trb_pool_dma = 0;
@@ -2564,33 +2563,34 @@ static irqreturn_t dwc3_interrupt(int irq, void *_dwc)
  */
 int dwc3_gadget_init(struct dwc3 *dwc)
 {
+	unsigned long				setup_buf_addr;
 	int					ret;
 
-	dwc->ctrl_req = dma_alloc_coherent(sizeof(*dwc->ctrl_req),
-					(unsigned long *)&dwc->ctrl_req_addr);
+	dwc->ctrl_req = dwc3_dma_alloc(sizeof(*dwc->ctrl_req),
+				       (unsigned long *)&dwc->ctrl_req_addr);
 	if (!dwc->ctrl_req) {
 		dev_err(dwc->dev, "failed to allocate ctrl request\n");
 		ret = -ENOMEM;
 		goto err0;
 	}
 
-	dwc->ep0_trb = dma_alloc_coherent(sizeof(*dwc->ep0_trb) * 2,
-					  (unsigned long *)&dwc->ep0_trb_addr);
+	dwc->ep0_trb = dwc3_dma_alloc(sizeof(*dwc->ep0_trb) * 2,
+				      (unsigned long *)&dwc->ep0_trb_addr);
 	if (!dwc->ep0_trb) {
 		dev_err(dwc->dev, "failed to allocate ep0 trb\n");
 		ret = -ENOMEM;
 		goto err1;
 	}
 
-	dwc->setup_buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
-				  DWC3_EP0_BOUNCE_SIZE);
+	dwc->setup_buf = dwc3_dma_alloc(DWC3_EP0_BOUNCE_SIZE,
+					&setup_buf_addr);
 	if (!dwc->setup_buf) {
 		ret = -ENOMEM;
 		goto err2;
 	}
 
-	dwc->ep0_bounce = dma_alloc_coherent(DWC3_EP0_BOUNCE_SIZE,
-					(unsigned long *)&dwc->ep0_bounce_addr);
+	dwc->ep0_bounce = dwc3_dma_alloc(DWC3_EP0_BOUNCE_SIZE,
+					 (unsigned long *)&dwc->ep0_bounce_addr);
 	if (!dwc->ep0_bounce) {
 		dev_err(dwc->dev, "failed to allocate ep0 bounce buffer\n");
 		ret = -ENOMEM;
@@ -2627,16 +2627,16 @@ int dwc3_gadget_init(struct dwc3 *dwc)
 
 err4:
 	dwc3_gadget_free_endpoints(dwc);
-	dma_free_coherent(dwc->ep0_bounce);
+	dwc3_dma_free(dwc->ep0_bounce, DWC3_EP0_BOUNCE_SIZE);
 
 err3:
-	kfree(dwc->setup_buf);
+	dwc3_dma_free(dwc->setup_buf, DWC3_EP0_BOUNCE_SIZE);
 
 err2:
-	dma_free_coherent(dwc->ep0_trb);
+	dwc3_dma_free(dwc->ep0_trb, sizeof(*dwc->ep0_trb) * 2);
 
 err1:
-	dma_free_coherent(dwc->ctrl_req);
+	dwc3_dma_free(dwc->ctrl_req, sizeof(*dwc->ctrl_req));
 
 err0:
 	return ret;
@@ -2650,13 +2650,13 @@ void dwc3_gadget_exit(struct dwc3 *dwc)
 
 	dwc3_gadget_free_endpoints(dwc);
 
-	dma_free_coherent(dwc->ep0_bounce);
+	dwc3_dma_free(dwc->ep0_bounce, DWC3_EP0_BOUNCE_SIZE);
 
-	kfree(dwc->setup_buf);
+	dwc3_dma_free(dwc->setup_buf, DWC3_EP0_BOUNCE_SIZE);
 
-	dma_free_coherent(dwc->ep0_trb);
+	dwc3_dma_free(dwc->ep0_trb, sizeof(*dwc->ep0_trb) * 2);
 
-	dma_free_coherent(dwc->ctrl_req);
+	dwc3_dma_free(dwc->ctrl_req, sizeof(*dwc->ctrl_req));
 }
 
 /**
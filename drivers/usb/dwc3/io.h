@@ -18,7 +18,9 @@
 #define __DRIVERS_USB_DWC3_IO_H
 
 #include <cpu_func.h>
+#include <asm/cache.h>
 #include <asm/io.h>
+#include <linux/dma-mapping.h>
 
 #define	CACHELINE_SIZE		CONFIG_SYS_CACHELINE_SIZE
 static inline u32 dwc3_readl(void __iomem *base, u32 offset)
@@ -50,6 +52,34 @@ static inline void dwc3_writel(void __iomem *base, u32 offset, u32 value)
 
 static inline void dwc3_flush_cache(uintptr_t addr, int length)
 {
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+	if (noncached_range(addr, length))
+		return;
+#endif
 	flush_dcache_range(addr, addr + ROUND(length, CACHELINE_SIZE));
 }
+
+/*
+ * TRBs, event buffers and the ep0 buffers are taken from the write-combining
+ * pool where there is one, so that dwc3_flush_cache() has nothing to do
+ */
+static inline void *dwc3_dma_alloc(size_t len, unsigned long *handle)
+{
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+	*handle = noncached_alloc_type(len, CACHELINE_SIZE, NONCACHED_WC);
+
+	return (void *)*handle;
+#else
+	return dma_alloc_coherent(len, handle);
+#endif
+}
+
+static inline void dwc3_dma_free(void *addr, size_t len)
+{
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+	noncached_free((phys_addr_t)addr, len);
+#else
+	dma_free_coherent(addr);
+#endif
+}
 #endif /* __DRIVERS_USB_DWC3_IO_H */
@@ -17,6 +17,7 @@
 #include <fastboot.h>
 #include <log.h>
 #include <malloc.h>
+#include <asm/cache.h>
 #include <linux/usb/ch9.h>
 #include <linux/usb/gadget.h>
 #include <linux/usb/composite.h>
@@ -38,7 +39,8 @@
  * that expect bulk OUT requests to be divisible by maxpacket size.
  */
 
-#define RAMDUMP_MAGIC			0xFA47B007AADD00FF
+#define FASTBOOT_REQ_SIZE		CONFIG_FASTBOOT_USB_REQ_SIZE
+#define FASTBOOT_REQ_COUNT		CONFIG_FASTBOOT_USB_REQ_COUNT
 
 typedef struct usb_req usb_req;
 struct usb_req {
@@ -53,6 +55,14 @@ struct f_fastboot {
 	struct usb_ep *in_ep, *out_ep;
 	struct usb_request *in_req, *out_req;
 	usb_req *front, *rear;
+
+	/* Requests kept queued during the data phase of download/upload */
+	struct usb_request *rx_ring[FASTBOOT_REQ_COUNT];
+	struct usb_request *tx_ring[FASTBOOT_REQ_COUNT];
+	/* Bytes of OUT requests queued but not completed yet */
+	unsigned int rx_inflight;
+	/* Number of IN requests queued but not completed yet */
+	unsigned int tx_inflight;
 };
 
 static char fb_ext_prop_name[] = "DeviceInterfaceGUID";
@@ -203,6 +213,8 @@ static struct usb_gadget_strings *fastboot_strings[] = {
 };
 
 static void rx_handler_command(struct usb_ep *ep, struct usb_request *req);
+static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req);
+static void tx_handler_ul_image(struct usb_ep *ep, struct usb_request *req);
 
 static void fastboot_fifo_complete(struct usb_ep *ep, struct usb_request *req)
 {
@@ -302,6 +314,47 @@ static void fastboot_unbind(struct usb_configuration *c, struct usb_function *f)
 	memset(fastboot_func, 0, sizeof(*fastboot_func));
 }
 
+/*
+ * The upload ring is only written by the CPU, so it can live in
+ * write-combining memory where the controller needs no flush before each
+ * transfer. Downloaded data is read back, which is faster when cached.
+ */
+static void *fastboot_alloc_buf(unsigned int size, bool wc)
+{
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+	if (wc)
+		return (void *)noncached_alloc_type(size,
+						    CONFIG_SYS_CACHELINE_SIZE,
+						    NONCACHED_WC);
+#endif
+	return memalign(CONFIG_SYS_CACHELINE_SIZE, size);
+}
+
+static void fastboot_free_buf(void *buf, unsigned int size)
+{
+#ifdef CONFIG_SYS_NONCACHED_POOLS
+	if (noncached_range((phys_addr_t)buf, size)) {
+		noncached_free((phys_addr_t)buf, size);
+		return;
+	}
+#endif
+	free(buf);
+}
+
+static void fastboot_free_ring(struct usb_ep *ep, struct usb_request **ring)
+{
+	int i;
+
+	for (i = 0; i < FASTBOOT_REQ_COUNT; i++) {
+		if (!ring[i])
+			continue;
+
+		fastboot_free_buf(ring[i]->buf, FASTBOOT_REQ_SIZE);
+		usb_ep_free_request(ep, ring[i]);
+		ring[i] = NULL;
+	}
+}
+
 static void fastboot_disable(struct usb_function *f)
 {
 	struct f_fastboot *f_fb = func_to_fastboot(f);
@@ -309,6 +362,11 @@ static void fastboot_disable(struct usb_function *f)
 	usb_ep_disable(f_fb->out_ep);
 	usb_ep_disable(f_fb->in_ep);
 
+	fastboot_free_ring(f_fb->out_ep, f_fb->rx_ring);
+	fastboot_free_ring(f_fb->in_ep, f_fb->tx_ring);
+	f_fb->rx_inflight = 0;
+	f_fb->tx_inflight = 0;
+
 	if (f_fb->out_req) {
 		free(f_fb->out_req->buf);
 		usb_ep_free_request(f_fb->out_ep, f_fb->out_req);
@@ -321,7 +379,8 @@ static void fastboot_disable(struct usb_function *f)
 	}
 }
 
-static struct usb_request *fastboot_start_ep(struct usb_ep *ep)
+static struct usb_request *fastboot_alloc_req(struct usb_ep *ep,
+					      unsigned int size, bool wc)
 {
 	struct usb_request *req;
 
@@ -329,8 +388,8 @@ static struct usb_request *fastboot_start_ep(struct usb_ep *ep)
 	if (!req)
 		return NULL;
 
-	req->length = EP_BUFFER_SIZE;
-	req->buf = memalign(CONFIG_SYS_CACHELINE_SIZE, EP_BUFFER_SIZE);
+	req->length = size;
+	req->buf = fastboot_alloc_buf(size, wc);
 	if (!req->buf) {
 		usb_ep_free_request(ep, req);
 		return NULL;
@@ -340,6 +399,29 @@ static struct usb_request *fastboot_start_ep(struct usb_ep *ep)
 	return req;
 }
 
+static struct usb_request *fastboot_start_ep(struct usb_ep *ep)
+{
+	return fastboot_alloc_req(ep, EP_BUFFER_SIZE, false);
+}
+
+static int fastboot_alloc_ring(struct usb_ep *ep, struct usb_request **ring,
+			       void (*complete)(struct usb_ep *ep,
+						struct usb_request *req),
+			       bool wc)
+{
+	int i;
+
+	for (i = 0; i < FASTBOOT_REQ_COUNT; i++) {
+		ring[i] = fastboot_alloc_req(ep, FASTBOOT_REQ_SIZE, wc);
+		if (!ring[i])
+			return -ENOMEM;
+
+		ring[i]->complete = complete;
+	}
+
+	return 0;
+}
+
 static int fastboot_set_alt(struct usb_function *f,
 			    unsigned interface, unsigned alt)
 {
@@ -382,6 +464,15 @@ static int fastboot_set_alt(struct usb_function *f,
 	}
 	f_fb->in_req->complete = fastboot_complete;
 
+	if (fastboot_alloc_ring(f_fb->out_ep, f_fb->rx_ring,
+				rx_handler_dl_image, false) ||
+	    fastboot_alloc_ring(f_fb->in_ep, f_fb->tx_ring,
+				tx_handler_ul_image, true)) {
+		puts("failed to alloc data reqs\n");
+		ret = -ENOMEM;
+		goto err;
+	}
+
 	ret = usb_ep_queue(f_fb->out_ep, f_fb->out_req, 0);
 	if (ret)
 		goto err;
@@ -496,16 +587,23 @@ static void compl_do_reset(struct usb_ep *ep, struct usb_request *req)
 	do_reset(NULL, 0, 0, NULL);
 }
 
-static unsigned int rx_bytes_expected(struct usb_ep *ep)
+/*
+ * Queue @req for the part of the download not covered by the requests
+ * already in flight. Completions come back in queue order, so the data
+ * keeps landing at the right offset.
+ */
+static int fastboot_rx_ring_queue(struct usb_ep *ep, struct usb_request *req)
 {
-	int rx_remain = fastboot_download_remaining();
-	unsigned int rem;
+	unsigned int rx_remain = fastboot_download_remaining();
 	unsigned int maxpacket = usb_endpoint_maxp(ep->desc);
+	unsigned int len;
+	int ret;
 
-	if (rx_remain <= 0)
+	if (rx_remain <= fastboot_func->rx_inflight)
 		return 0;
-	else if (rx_remain > EP_BUFFER_SIZE)
-		return EP_BUFFER_SIZE;
+
+	len = min_t(unsigned int, rx_remain - fastboot_func->rx_inflight,
+		    FASTBOOT_REQ_SIZE);
 
 	/*
 	 * Some controllers e.g. DWC3 don't like OUT transfers to be
@@ -513,11 +611,45 @@ static unsigned int rx_bytes_expected(struct usb_ep *ep)
 	 * always requesting for integral multiple of maxpackets.
 	 * This shouldn't bother controllers that don't care about it.
 	 */
-	rem = rx_remain % maxpacket;
-	if (rem > 0)
-		rx_remain = rx_remain + (maxpacket - rem);
+	len = roundup(len, maxpacket);
+
+	req->length = len;
+	req->actual = 0;
+	ret = usb_ep_queue(ep, req, 0);
+	if (ret) {
+		printf("Error %d on queue\n", ret);
+		return ret;
+	}
+
+	fastboot_func->rx_inflight += len;
+
+	return 0;
+}
+
+static void fastboot_rx_ring_start(struct usb_ep *ep)
+{
+	int i;
+
+	fastboot_func->rx_inflight = 0;
+	for (i = 0; i < FASTBOOT_REQ_COUNT; i++)
+		if (fastboot_rx_ring_queue(ep, fastboot_func->rx_ring[i]))
+			break;
+}
+
+/* Leave the data phase and wait for the next command */
+static void fastboot_rx_ring_stop(struct usb_ep *ep)
+{
+	struct usb_request *req = fastboot_func->out_req;
+	int i;
 
-	return rx_remain;
+	if (fastboot_func->rx_inflight) {
+		for (i = 0; i < FASTBOOT_REQ_COUNT; i++)
+			usb_ep_dequeue(ep, fastboot_func->rx_ring[i]);
+		fastboot_func->rx_inflight = 0;
+	}
+
+	req->actual = 0;
+	usb_ep_queue(ep, req, 0);
 }
 
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
@@ -528,10 +660,13 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	unsigned int buffer_size = req->actual;
 
 	if (req->status != 0) {
-		printf("Bad status: %d\n", req->status);
+		if (req->status != -ECONNRESET)
+			printf("Bad status: %d\n", req->status);
 		return;
 	}
 
+	fastboot_func->rx_inflight -= req->length;
+
 	if (buffer_size < transfer_size)
 		transfer_size = buffer_size;
 
@@ -540,71 +675,106 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 		fastboot_tx_write_str(response);
 	} else if (!fastboot_download_remaining()) {
 		fastboot_download_complete(response);
-
-		/*
-		 * Reset global transfer variable
-		 */
-		req->complete = rx_handler_command;
-		req->length = EP_BUFFER_SIZE;
-
 		fastboot_tx_write_str(response);
 	} else {
-		req->length = rx_bytes_expected(ep);
+		fastboot_rx_ring_queue(ep, req);
+		return;
 	}
 
-	req->actual = 0;
-	usb_ep_queue(ep, req, 0);
+	fastboot_rx_ring_stop(ep);
 }
 
-static void tx_handler_ul_image(struct usb_ep *ep, struct usb_request *req)
+static int fastboot_tx_ring_queue(struct usb_ep *ep, struct usb_request *req,
+				  char *response)
 {
-	char response[FASTBOOT_RESPONSE_LEN] = {0};
-	struct usb_request *in_req = fastboot_func->in_req;
 	unsigned int transfer_size = fastboot_upload_remaining();
-	void *buffer = in_req->buf;
 	int ret;
 
-	if ((u64)ep == RAMDUMP_MAGIC && (u64)req == RAMDUMP_MAGIC)
-		printf("start ramdump\n");
-	else if (req->status)
-		printf("status: %d ep '%s' trans: %d len %d\n", req->status,
-		      ep->name, req->actual, req->length);
+	if (!transfer_size)
+		return 0;
 
-	if (!fastboot_upload_remaining()) {
-		fastboot_upload_complete(response);
+	if (transfer_size > FASTBOOT_REQ_SIZE)
+		transfer_size = FASTBOOT_REQ_SIZE;
 
-		/*
-		 * Reset global transfer variable
-		 */
-		in_req->complete = fastboot_complete;
-		in_req->length = EP_BUFFER_SIZE;
+	fastboot_data_upload(req->buf, transfer_size, response);
+	if (response[0])
+		return -EIO;
 
-		fastboot_tx_write_str(response);
+	/* Proceed with USB request */
+	req->length = transfer_size;
+	debug("Uploading 0x%x bytes\n", transfer_size);
+	ret = usb_ep_queue(ep, req, 0);
+	if (ret) {
+		printf("Error %d on queue\n", ret);
+		fastboot_fail("USB queue failed", response);
+		return ret;
+	}
+
+	fastboot_func->tx_inflight++;
+
+	return 0;
+}
+
+/* Drop the rest of a failed upload, the response goes out next */
+static void fastboot_tx_ring_abort(struct usb_ep *ep)
+{
+	int i;
+
+	for (i = 0; i < FASTBOOT_REQ_COUNT; i++)
+		usb_ep_dequeue(ep, fastboot_func->tx_ring[i]);
+	fastboot_func->tx_inflight = 0;
+	fastboot_upload_abort();
+}
+
+static void tx_handler_ul_image(struct usb_ep *ep, struct usb_request *req)
+{
+	char response[FASTBOOT_RESPONSE_LEN] = {0};
+
+	if (req->status) {
+		if (req->status != -ECONNRESET) {
+			printf("status: %d ep '%s' trans: %d len %d\n",
+			       req->status, ep->name, req->actual,
+			       req->length);
+			fastboot_tx_ring_abort(ep);
+		}
 		return;
 	}
 
-	if (transfer_size > EP_BUFFER_SIZE)
-		transfer_size = EP_BUFFER_SIZE;
+	fastboot_func->tx_inflight--;
 
-	fastboot_data_upload(buffer, transfer_size, response);
-	if (response[0]) {
-		fastboot_tx_write_str(response);
+	if (!fastboot_tx_ring_queue(ep, req, response)) {
+		if (fastboot_func->tx_inflight)
+			return;
+
+		fastboot_upload_complete(response);
 	} else {
-		/* Proceed with USB request */
-		in_req->length = transfer_size;
-		in_req->complete = tx_handler_ul_image;
-		debug("Uploading 0x%x bytes\n", transfer_size);
-		usb_ep_dequeue(fastboot_func->in_ep, in_req);
-		ret = usb_ep_queue(fastboot_func->in_ep, in_req, 0);
-		if (ret)
-			printf("Error %d on queue\n", ret);
+		fastboot_tx_ring_abort(ep);
 	}
+
+	fastboot_tx_write_str(response);
 }
 
 void fastboot_upload_ramdump(void)
 {
-	tx_handler_ul_image((struct usb_ep *)RAMDUMP_MAGIC,
-			(struct usb_request *)RAMDUMP_MAGIC);
+	char response[FASTBOOT_RESPONSE_LEN] = {0};
+	struct usb_ep *ep = fastboot_func->in_ep;
+	int i;
+
+	printf("start ramdump\n");
+	fastboot_func->tx_inflight = 0;
+	for (i = 0; i < FASTBOOT_REQ_COUNT; i++) {
+		if (fastboot_tx_ring_queue(ep, fastboot_func->tx_ring[i],
+					   response)) {
+			fastboot_tx_ring_abort(ep);
+			fastboot_tx_write_str(response);
+			return;
+		}
+	}
+
+	if (!fastboot_func->tx_inflight) {
+		fastboot_upload_complete(response);
+		fastboot_tx_write_str(response);
+	}
 }
 
 static void do_exit_on_complete(struct usb_ep *ep, struct usb_request *req)
@@ -634,6 +804,7 @@ static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
 {
 	char *cmdbuf = req->buf;
 	char response[FASTBOOT_RESPONSE_LEN] = {0};
+	bool download = false;
 	int cmd = -1;
 
 	/* init in request FIFO pointer */
@@ -653,10 +824,8 @@ static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
 
 
 	if (!strncmp("DATA", response, 4)
-			&& cmd == FASTBOOT_COMMAND_DOWNLOAD) {
-		req->complete = rx_handler_dl_image;
-		req->length = rx_bytes_expected(ep);
-	}
+			&& cmd == FASTBOOT_COMMAND_DOWNLOAD)
+		download = true;
 
 	if (!strncmp("OKAY", response, 4)) {
 		switch (cmd) {
@@ -686,5 +855,10 @@ static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
 
 	*cmdbuf = '\0';
 	req->actual = 0;
-	usb_ep_queue(ep, req, 0);
+
+	/* The command request is queued again once the download is done */
+	if (download)
+		fastboot_rx_ring_start(ep);
+	else
+		usb_ep_queue(ep, req, 0);
 }
@@ -163,11 +163,15 @@ int dtoverlay_create_node(DTBLOB_T *dtb, const char *node_path, int path_len)
 
       subnode_off = fdt_subnode_offset_namelen(dtb->fdt, node_off, path_ptr,
                                                path_next - path_ptr);
-      if (subnode_off >= 0)
-         node_off = subnode_off;
-      else
-         node_off = fdt_add_subnode_namelen(dtb->fdt, node_off, path_ptr,
-                                            path_next - path_ptr);
+      if (subnode_off < 0)
+      {
+         int struct_size = fdt_size_dt_struct(dtb->fdt);
+
+         subnode_off = fdt_add_subnode_namelen(dtb->fdt, node_off, path_ptr,
+                                               path_next - path_ptr);
+         dtoverlay_index_moved(dtb, node_off, struct_size);
+      }
+      node_off = subnode_off;
       if (node_off < 0)
          break;
 
@@ -188,9 +192,10 @@ int dtoverlay_delete_node(DTBLOB_T *dtb, const char *node_path, int path_len)
       path_len = strlen(node_path);
 
    dtoverlay_debug("delete_node(%.*s)", path_len, node_path);
-   node_off = fdt_path_offset_namelen(dtb->fdt, node_path, path_len);
+   node_off = dtoverlay_index_path(dtb, node_path, path_len);
    if (node_off < 0)
       return node_off;
+   dtoverlay_index_free(dtb);
    return fdt_del_node(dtb->fdt, node_off);
 }
 
@@ -200,7 +205,7 @@ int dtoverlay_find_node(DTBLOB_T *dtb, const char *node_path, int path_len)
 {
    if (!path_len)
       path_len = strlen(node_path);
-   return fdt_path_offset_namelen(dtb->fdt, node_path, path_len);
+   return dtoverlay_index_path(dtb, node_path, path_len);
 }
 
 // Returns 0 on success, otherwise <0 error code
@@ -211,7 +216,7 @@ int dtoverlay_set_node_properties(DTBLOB_T *dtb, const char *node_path,
    int err = 0;
    int node_off;
 
-   node_off = fdt_path_offset(dtb->fdt, node_path);
+   node_off = dtoverlay_find_node(dtb, node_path, 0);
    if (node_off < 0)
       node_off = dtoverlay_create_node(dtb, node_path, 0);
    if (node_off >= 0)
@@ -220,9 +225,11 @@ int dtoverlay_set_node_properties(DTBLOB_T *dtb, const char *node_path,
       for (i = 0; (i < num_properties) && (err == 0); i++)
       {
          DTOVERLAY_PARAM_T *p;
+         int struct_size = fdt_size_dt_struct(dtb->fdt);
 
          p = properties + i;
          err = fdt_setprop(dtb->fdt, node_off, p->param, p->b, p->len);
+         dtoverlay_index_moved(dtb, node_off, struct_size);
       }
    }
    else
@@ -367,6 +374,9 @@ static int dtoverlay_set_node_name(DTBLOB_T *dtb, int node_off,
    }
    old_path = path_buf.buf;
 
+   // The paths of the node and all below it change
+   dtoverlay_index_free(dtb);
+
    err = fdt_set_name(dtb->fdt, node_off, name);
    if (err || dtb->fixups_applied)
       goto clean_up;
@@ -548,6 +558,7 @@ static int dtoverlay_merge_fragment(DTBLOB_T *base_dtb, int target_off,
       int prop_len;
       struct fdt_property *target_prop;
       int target_len;
+      int struct_size;
 
       prop_val = fdt_getprop_by_offset(overlay_dtb->fdt, prop_off,
                                        &prop_name, &prop_len);
@@ -560,6 +571,7 @@ static int dtoverlay_merge_fragment(DTBLOB_T *base_dtb, int target_off,
 
       dtoverlay_debug("  +prop(%s)", prop_name);
 
+      struct_size = fdt_size_dt_struct(base_dtb->fdt);
       if ((strcmp(prop_name, "bootargs") == 0) &&
          ((target_prop = fdt_get_property_w(base_dtb->fdt, target_off, prop_name, &target_len)) != NULL) &&
          (target_len > 0) && *target_prop->data)
@@ -569,6 +581,7 @@ static int dtoverlay_merge_fragment(DTBLOB_T *base_dtb, int target_off,
       }
       else
          err = fdt_setprop(base_dtb->fdt, target_off, prop_name, prop_val, prop_len);
+      dtoverlay_index_moved(base_dtb, target_off, struct_size);
    }
 
    // Merge each subnode of the node
@@ -585,8 +598,13 @@ static int dtoverlay_merge_fragment(DTBLOB_T *base_dtb, int target_off,
       subtarget_off = fdt_subnode_offset_namelen(base_dtb->fdt, target_off,
                                                  subnode_name, name_len);
       if (subtarget_off < 0)
+      {
+         int struct_size = fdt_size_dt_struct(base_dtb->fdt);
+
          subtarget_off = fdt_add_subnode_namelen(base_dtb->fdt, target_off,
                                                  subnode_name, name_len);
+         dtoverlay_index_moved(base_dtb, target_off, struct_size);
+      }
 
       if (subtarget_off >= 0)
       {
@@ -849,7 +867,7 @@ static int dtoverlay_resolve_fixups(DTBLOB_T *base_dtb, DTBLOB_T *overlay_dtb)
       if (fixup_off >= 0)
       {
          // Find the symbols, which will be needed to resolve the fixups
-         symbols_off = fdt_path_offset(base_dtb->fdt, "/__symbols__");
+         symbols_off = dtoverlay_find_node(base_dtb, "/__symbols__", 0);
 
          if (symbols_off < 0)
          {
@@ -887,8 +905,7 @@ static int dtoverlay_resolve_fixups(DTBLOB_T *base_dtb, DTBLOB_T *overlay_dtb)
          }
          else
          {
-            target_path = fdt_getprop(base_dtb->fdt, symbols_off, symbol_name,
-                                      &err);
+            target_path = dtoverlay_index_symbol(base_dtb, symbol_name, &err);
             if (!target_path)
             {
                dtoverlay_error("can't find symbol '%s'", symbol_name);
@@ -898,7 +915,7 @@ static int dtoverlay_resolve_fixups(DTBLOB_T *base_dtb, DTBLOB_T *overlay_dtb)
             ref_type = "symbol";
          }
 
-         target_off = fdt_path_offset(base_dtb->fdt, target_path);
+         target_off = dtoverlay_find_node(base_dtb, target_path, 0);
          if (target_off < 0)
          {
             dtoverlay_error("%s '%s' is invalid", ref_type, symbol_name);
@@ -912,21 +929,20 @@ static int dtoverlay_resolve_fixups(DTBLOB_T *base_dtb, DTBLOB_T *overlay_dtb)
          {
             // It doesn't, so give it one
             fdt32_t temp;
+            int struct_size = fdt_size_dt_struct(base_dtb->fdt);
             target_phandle = ++base_dtb->max_phandle;
             temp = cpu_to_fdt32(target_phandle);
 
             err = fdt_setprop(base_dtb->fdt, target_off, "phandle",
                               &temp, 4);
+            dtoverlay_index_moved(base_dtb, target_off, struct_size);
 
             if (err != 0)
             {
                dtoverlay_error("failed to add a phandle");
                break;
             }
-            phandle_debug("  phandle '%s'->%d", target_path, target_phandle);
-
-            // The symbols may have moved, so recalculate
-            symbols_off = fdt_path_offset(base_dtb->fdt, "/__symbols__");
+            phandle_debug("  phandle '%s'->%d", symbol_name, target_phandle);
          }
 
          // Now apply the valid target_phandle to the items in the fixup string
@@ -981,7 +997,7 @@ int dtoverlay_merge_overlay(DTBLOB_T *base_dtb, DTBLOB_T *overlay_dtb)
       {
          if (len && (target_path[len - 1] == '\0'))
             len--;
-         target_off = fdt_path_offset_namelen(base_dtb->fdt, target_path, len);
+         target_off = dtoverlay_find_node(base_dtb, target_path, len);
          if (target_off < 0)
          {
             dtoverlay_error("invalid target-path '%.*s'", len, target_path);
@@ -1002,8 +1018,8 @@ int dtoverlay_merge_overlay(DTBLOB_T *base_dtb, DTBLOB_T *overlay_dtb)
             return NON_FATAL(FDT_ERR_BADSTRUCTURE);
 
          target_off =
-            fdt_node_offset_by_phandle(base_dtb->fdt,
-                                       fdt32_to_cpu(*(fdt32_t *)target_prop));
+            dtoverlay_find_phandle(base_dtb,
+                                   fdt32_to_cpu(*(fdt32_t *)target_prop));
          if (target_off < 0)
          {
             dtoverlay_error("invalid target");
@@ -1078,6 +1094,7 @@ int dtoverlay_merge_params(DTBLOB_T *dtb, const DTOVERLAY_PARAM_T *params,
          const char *prop_name = slash + 1;
          int prop_len;
          struct fdt_property *prop;
+         int struct_size = fdt_size_dt_struct(dtb->fdt);
 
          if ((strcmp(prop_name, "bootargs") == 0) &&
             ((prop = fdt_get_property_w(dtb->fdt, node_off, prop_name, &prop_len)) != NULL) &&
@@ -1088,6 +1105,7 @@ int dtoverlay_merge_params(DTBLOB_T *dtb, const DTOVERLAY_PARAM_T *params,
          }
          else
             err = fdt_setprop(dtb->fdt, node_off, prop_name, p->b, p->len);
+         dtoverlay_index_moved(dtb, node_off, struct_size);
       }
       else
          err = node_off;
@@ -1106,7 +1124,7 @@ const char *dtoverlay_find_override(DTBLOB_T *dtb, const char *override_name,
    int len;
 
    // Find the table of overrides
-   overrides_off = fdt_path_offset(dtb->fdt, "/__overrides__");
+   overrides_off = dtoverlay_find_node(dtb, "/__overrides__", 0);
    dtoverlay_debug("[%s][%d]overrides_off=%d\n", __func__, __LINE__, overrides_off);
    if (overrides_off < 0)
    {
@@ -1446,6 +1464,7 @@ int dtoverlay_foreach_override_target(DTBLOB_T *dtb, const char *override_name,
       int target_size = 0;
       int override_type;
       int node_off = 0;
+      int struct_size;
       override_type = dtoverlay_extract_override(override_name,
                                                 &target_phandle,
                                                 &override_data, &data_len,
@@ -1456,7 +1475,7 @@ int dtoverlay_foreach_override_target(DTBLOB_T *dtb, const char *override_name,
 
       if (target_phandle != 0)
       {
-         node_off = fdt_node_offset_by_phandle(dtb->fdt, target_phandle);
+         node_off = dtoverlay_find_phandle(dtb, target_phandle);
          if (node_off < 0)
          {
             dtoverlay_error("  phandle %d not found", target_phandle);
@@ -1478,9 +1497,12 @@ int dtoverlay_foreach_override_target(DTBLOB_T *dtb, const char *override_name,
          memcpy(prop_name, target_prop, name_len);
          prop_name[name_len] = '\0';
       }
+      // The callbacks only edit the target node (renames drop the index)
+      struct_size = fdt_size_dt_struct(dtb->fdt);
       err = callback(override_type, dtb, node_off, prop_name,
            target_phandle, target_off, target_size,
            callback_value);
+      dtoverlay_index_moved(dtb, node_off, struct_size);
 
       if (prop_name)
          free(prop_name);
@@ -1706,7 +1728,7 @@ DTBLOB_T *dtoverlay_load_dtb(ulong fdt, char* dt_file,int max_size)
 
    if (len > 1)
    {
-      sprintf(overlay_dt_file, "/boot/overlays/%s.dtbo", dt_file);
+      sprintf(overlay_dt_file, DTOVERLAY_PATH_FMT, dt_file);
       dtoverlay_debug("loading overlay: %s\n", overlay_dt_file);
       if(hb_ext4_load(overlay_dt_file, fdt, &bytes_read) != 0)
       {
@@ -1721,8 +1743,10 @@ DTBLOB_T *dtoverlay_load_dtb(ulong fdt, char* dt_file,int max_size)
    dtb_len = fdt_totalsize((void *)fdt);
 
    dtb = dtoverlay_import_fdt((void *)fdt, bytes_read+100);
+   if (!dtb)
+      return NULL;
 
-   dtb->fdt_is_malloced = 1;
+   // The fdt is the caller's load address, not ours to free
 
    if (bytes_read > dtb_len)
    {
@@ -1805,6 +1829,7 @@ void dtoverlay_free_dtb(DTBLOB_T *dtb)
 {
    if (dtb)
    {
+      dtoverlay_index_free(dtb);
       if (dtb->fdt_is_malloced)
          free(dtb->fdt);
       if (dtb->trailer_is_malloced)
@@ -1815,7 +1840,7 @@ void dtoverlay_free_dtb(DTBLOB_T *dtb)
 
 int dtoverlay_find_phandle(DTBLOB_T *dtb, int phandle)
 {
-   return fdt_node_offset_by_phandle(dtb->fdt, phandle);
+   return dtoverlay_index_phandle(dtb, phandle);
 }
 
 int dtoverlay_find_symbol(DTBLOB_T *dtb, const char *symbol_name)
@@ -1831,7 +1856,7 @@ int dtoverlay_find_symbol(DTBLOB_T *dtb, const char *symbol_name)
    }
    else
    {
-      symbols_off = fdt_path_offset(dtb->fdt, "/__symbols__");
+      symbols_off = dtoverlay_find_node(dtb, "/__symbols__", 0);
 
       if (symbols_off < 0)
       {
@@ -1839,11 +1864,11 @@ int dtoverlay_find_symbol(DTBLOB_T *dtb, const char *symbol_name)
          return -FDT_ERR_NOTFOUND;
       }
 
-      node_path = fdt_getprop(dtb->fdt, symbols_off, symbol_name, &path_len);
+      node_path = dtoverlay_index_symbol(dtb, symbol_name, &path_len);
       if (path_len < 0)
          return -FDT_ERR_NOTFOUND;
    }
-   return fdt_path_offset_namelen(dtb->fdt, node_path, path_len);
+   return dtoverlay_find_node(dtb, node_path, path_len);
 }
 
 int dtoverlay_find_matching_node(DTBLOB_T *dtb, const char **node_names,
@@ -1894,7 +1919,9 @@ const void *dtoverlay_get_property(DTBLOB_T *dtb, int pos, const char *prop_name
 int dtoverlay_set_property(DTBLOB_T *dtb, int pos,
                            const char *prop_name, const void *prop, int prop_len)
 {
+   int struct_size = fdt_size_dt_struct(dtb->fdt);
    int err = fdt_setprop(dtb->fdt, pos, prop_name, prop, prop_len);
+   dtoverlay_index_moved(dtb, pos, struct_size);
    if (err < 0)
       dtoverlay_error("Failed to set property '%s'", prop_name);
    return err;
@@ -1906,7 +1933,7 @@ const char *dtoverlay_get_alias(DTBLOB_T *dtb, const char *alias_name)
    int prop_len;
    const char *alias;
 
-   node_off = fdt_path_offset(dtb->fdt, "/aliases");
+   node_off = dtoverlay_find_node(dtb, "/aliases", 0);
 
    alias = fdt_getprop(dtb->fdt, node_off, alias_name, &prop_len);
    if (alias && !prop_len)
@@ -2043,7 +2070,7 @@ void do_dtparam(ulong fdt, char* dt_file, DTPARAM_T *param, int num)
    int override_len;
    int err;
    int i;
-   overlay_dtb = dtoverlay_load_dtb(fdt, dt_file, 0x50000);
+   overlay_dtb = dtoverlay_load_dtb(fdt, dt_file, DTOVERLAY_FDT_MAX_SIZE);
 
    if (!overlay_dtb)
    {
@@ -2055,13 +2082,21 @@ void do_dtparam(ulong fdt, char* dt_file, DTPARAM_T *param, int num)
       override = dtoverlay_find_override(overlay_dtb, param[i].name, &override_len);
 
       if (!override)
-         return dtoverlay_error("Unknown parameter '%s'", param[i].name);
+      {
+         dtoverlay_error("Unknown parameter '%s'", param[i].name);
+         break;
+      }
 
       err = dtparam_apply(overlay_dtb, param[i].name,
                override, override_len,
                param[i].value, NULL);
 
       if (err != 0)
-         return dtoverlay_error("Failed to set %s=%s", param[i].name, param[i].value);
+      {
+         dtoverlay_error("Failed to set %s=%s", param[i].name, param[i].value);
+         break;
+      }
    }
+
+   dtoverlay_free_dtb(overlay_dtb);
 }
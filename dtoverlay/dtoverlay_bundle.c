@@ -0,0 +1,300 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Copyright(C) 2024, D-Robotics Co., Ltd. All rights reserved
+ *
+ * Bundle holding what the dtoverlay command did to a device tree.
+ *
+ * The bundle is a header followed by a delta from the device tree before
+ * the overlays and dtparams of a config.txt to the one after. The delta is
+ * a list of ops, each a u32 tag followed by its operand:
+ *
+ *	DTOVERLAY_OP_COPY | len, offset	- copy len bytes of the base at offset
+ *	DTOVERLAY_OP_INSERT | len, data	- insert len bytes, padded to 4 bytes
+ *
+ * Applying it is one pass over the ops, writing the output in order.
+ */
+
+#include <common.h>
+#include <dtoverlay.h>
+#include <errno.h>
+#include <malloc.h>
+#include <asm/unaligned.h>
+#include <linux/libfdt.h>
+#include <u-boot/sha256.h>
+
+#define DTOVERLAY_BUNDLE_MAGIC		0x4e425444	/* "DTBN" */
+#define DTOVERLAY_BUNDLE_VERSION	1
+
+#define DTOVERLAY_OP_COPY		0
+#define DTOVERLAY_OP_INSERT		BIT(31)
+#define DTOVERLAY_OP_LEN		(BIT(31) - 1)
+
+/*
+ * Device tree contents are 4-byte aligned, so are the places where an
+ * overlay inserts into it. A match starts with a block this long.
+ */
+#define DTOVERLAY_BLOCK			32
+
+struct dtoverlay_bundle_hdr {
+	u32 magic;
+	u32 version;
+	u32 base_size;
+	u32 out_size;
+	u32 delta_size;
+	u32 reserved;
+	u8 key[SHA256_SUM_LEN];
+	u8 delta_hash[SHA256_SUM_LEN];
+};
+
+struct dtoverlay_delta {
+	u8 *buf;
+	int size;
+	int max;
+};
+
+static u32 dtoverlay_block_hash(const u8 *p)
+{
+	u32 h = 0;
+	int i;
+
+	for (i = 0; i < DTOVERLAY_BLOCK; i += 4)
+		h = (h ^ get_unaligned((u32 *)(p + i))) * 0x9e3779b1;
+
+	return h ^ (h >> 16);
+}
+
+static int dtoverlay_delta_add(struct dtoverlay_delta *delta, u32 tag,
+			       const void *data, int len)
+{
+	int size = sizeof(tag) + ALIGN(len, 4);
+
+	if (delta->size + size > delta->max)
+		return -ENOSPC;
+
+	memcpy(delta->buf + delta->size, &tag, sizeof(tag));
+	memset(delta->buf + delta->size + sizeof(tag), 0, ALIGN(len, 4));
+	memcpy(delta->buf + delta->size + sizeof(tag), data, len);
+	delta->size += size;
+
+	return 0;
+}
+
+static int dtoverlay_delta_copy(struct dtoverlay_delta *delta, u32 offset,
+				int len)
+{
+	return dtoverlay_delta_add(delta, DTOVERLAY_OP_COPY | len, &offset,
+				   sizeof(offset));
+}
+
+static int dtoverlay_delta_insert(struct dtoverlay_delta *delta,
+				  const u8 *data, int len)
+{
+	if (!len)
+		return 0;
+
+	return dtoverlay_delta_add(delta, DTOVERLAY_OP_INSERT | len, data, len);
+}
+
+/* Slots tried for a block in the index, so that collisions lose little */
+#define DTOVERLAY_PROBES		4
+
+static int dtoverlay_delta_find(const u32 *index, int mask, const u8 *base,
+				const u8 *out)
+{
+	u32 h = dtoverlay_block_hash(out);
+	u32 cand;
+	int i;
+
+	for (i = 0; i < DTOVERLAY_PROBES; i++) {
+		cand = index[(h + i) & mask];
+		if (!cand)
+			break;
+		if (!memcmp(base + cand - 1, out, DTOVERLAY_BLOCK))
+			return cand - 1;
+	}
+
+	return -1;
+}
+
+/*
+ * Index the base by a hash of each aligned block, then walk the output
+ * looking each aligned block up. A hit is grown as far as the bytes match
+ * and becomes a copy, what lies between hits becomes an insert.
+ */
+static int dtoverlay_delta_make(struct dtoverlay_delta *delta, const u8 *base,
+				int base_size, const u8 *out, int out_size)
+{
+	int bits = 10, mask, pos, lit, len, off, ret, i;
+	u32 *index;
+	u32 h;
+
+	while ((1 << bits) < base_size / 2 && bits < 22)
+		bits++;
+	mask = (1 << bits) - 1;
+
+	index = calloc(1 << bits, sizeof(*index));
+	if (!index)
+		return -ENOMEM;
+
+	/* Keep the first of equal blocks, so that copies run long */
+	for (off = 0; off + DTOVERLAY_BLOCK <= base_size; off += 4) {
+		h = dtoverlay_block_hash(base + off);
+		for (i = 0; i < DTOVERLAY_PROBES; i++) {
+			if (!index[(h + i) & mask]) {
+				index[(h + i) & mask] = off + 1;
+				break;
+			}
+		}
+	}
+
+	ret = 0;
+	pos = 0;
+	lit = 0;
+	while (pos + DTOVERLAY_BLOCK <= out_size) {
+		off = dtoverlay_delta_find(index, mask, base, out + pos);
+		if (off < 0) {
+			pos += 4;
+			continue;
+		}
+
+		len = DTOVERLAY_BLOCK;
+		while (pos + len < out_size && off + len < base_size &&
+		       out[pos + len] == base[off + len] &&
+		       len < DTOVERLAY_OP_LEN)
+			len++;
+
+		ret = dtoverlay_delta_insert(delta, out + lit, pos - lit);
+		if (!ret)
+			ret = dtoverlay_delta_copy(delta, off, len);
+		if (ret)
+			break;
+
+		/* Matches resume at an aligned offset, if at all */
+		lit = pos + len;
+		pos = ALIGN(lit, 4);
+	}
+	if (!ret)
+		ret = dtoverlay_delta_insert(delta, out + lit, out_size - lit);
+
+	free(index);
+
+	return ret;
+}
+
+int dtoverlay_bundle_make(const void *base, const void *fdt, const u8 *key,
+			  void **bundlep, int *sizep)
+{
+	int base_size = fdt_totalsize(base);
+	int out_size = fdt_totalsize(fdt);
+	struct dtoverlay_bundle_hdr *hdr;
+	struct dtoverlay_delta delta;
+	int ret;
+
+	/* An insert of everything is the worst case */
+	delta.max = sizeof(*hdr) + 2 * sizeof(u32) + ALIGN(out_size, 4);
+	delta.buf = malloc(delta.max);
+	if (!delta.buf)
+		return -ENOMEM;
+	delta.size = sizeof(*hdr);
+
+	ret = dtoverlay_delta_make(&delta, base, base_size, fdt, out_size);
+	if (ret) {
+		free(delta.buf);
+		return ret;
+	}
+
+	hdr = (struct dtoverlay_bundle_hdr *)delta.buf;
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->magic = DTOVERLAY_BUNDLE_MAGIC;
+	hdr->version = DTOVERLAY_BUNDLE_VERSION;
+	hdr->base_size = base_size;
+	hdr->out_size = out_size;
+	hdr->delta_size = delta.size - sizeof(*hdr);
+	memcpy(hdr->key, key, SHA256_SUM_LEN);
+	sha256_csum_wd(delta.buf + sizeof(*hdr), hdr->delta_size,
+		       hdr->delta_hash, CHUNKSZ_SHA256);
+
+	*bundlep = delta.buf;
+	*sizep = delta.size;
+
+	return 0;
+}
+
+int dtoverlay_bundle_apply(const void *bundle, int size, const u8 *key,
+			   void *fdt, int max_size)
+{
+	const struct dtoverlay_bundle_hdr *hdr = bundle;
+	const u8 *op, *end;
+	u8 hash[SHA256_SUM_LEN];
+	u32 tag, len, offset;
+	u8 *base, *out;
+	int ret = 0;
+
+	if (size < sizeof(*hdr) || hdr->magic != DTOVERLAY_BUNDLE_MAGIC ||
+	    hdr->version != DTOVERLAY_BUNDLE_VERSION)
+		return -EINVAL;
+	if (memcmp(hdr->key, key, SHA256_SUM_LEN) ||
+	    hdr->base_size != fdt_totalsize(fdt))
+		return -ESTALE;
+
+	if (hdr->delta_size > size - sizeof(*hdr))
+		return -EILSEQ;
+	if (hdr->out_size > max_size)
+		return -ENOSPC;
+
+	op = bundle + sizeof(*hdr);
+	end = op + hdr->delta_size;
+	sha256_csum_wd(op, hdr->delta_size, hash, CHUNKSZ_SHA256);
+	if (memcmp(hash, hdr->delta_hash, SHA256_SUM_LEN))
+		return -EILSEQ;
+
+	base = malloc(hdr->base_size);
+	if (!base)
+		return -ENOMEM;
+	memcpy(base, fdt, hdr->base_size);
+
+	out = fdt;
+	while (op < end) {
+		if (end - op < 2 * sizeof(u32)) {
+			ret = -EILSEQ;
+			break;
+		}
+		memcpy(&tag, op, sizeof(tag));
+		op += sizeof(tag);
+		len = tag & DTOVERLAY_OP_LEN;
+		if (len > (u8 *)fdt + hdr->out_size - out) {
+			ret = -EILSEQ;
+			break;
+		}
+
+		if (tag & DTOVERLAY_OP_INSERT) {
+			if (ALIGN(len, 4) > end - op) {
+				ret = -EILSEQ;
+				break;
+			}
+			memcpy(out, op, len);
+			op += ALIGN(len, 4);
+		} else {
+			memcpy(&offset, op, sizeof(offset));
+			op += sizeof(offset);
+			if (offset > hdr->base_size ||
+			    len > hdr->base_size - offset) {
+				ret = -EILSEQ;
+				break;
+			}
+			memcpy(out, base + offset, len);
+		}
+		out += len;
+	}
+
+	if (!ret && out != (u8 *)fdt + hdr->out_size)
+		ret = -EILSEQ;
+	if (!ret && fdt_check_header(fdt))
+		ret = -EILSEQ;
+	/* Leave the base as it was rather than half patched */
+	if (ret)
+		memcpy(fdt, base, hdr->base_size);
+	free(base);
+
+	return ret;
+}
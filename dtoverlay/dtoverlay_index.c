@@ -0,0 +1,495 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Copyright(C) 2024, D-Robotics Co., Ltd. All rights reserved
+ *
+ * Lookup index for a DTBLOB_T.
+ *
+ * Resolving an overlay looks up phandles, __symbols__ and paths in the base
+ * tree, and libfdt answers each of those by walking the tree. The index is
+ * built with one walk the first time a blob is looked up in and maps:
+ *
+ *	phandle	-> node offset
+ *	symbol	-> path
+ *	path	-> node offset
+ *
+ * Setting a property or adding a subnode moves every node after the edited
+ * one. The editors in dtoverlay.c report each edit through
+ * dtoverlay_index_moved(); the index keeps a short list of these moves,
+ * replays it on the offsets it returns and folds it into its tables when
+ * the list is full. Any other change to the size of the structure block
+ * drops the index on the next lookup, and each hit is checked against the
+ * tree before it is returned, so a stale entry costs a rebuild rather than
+ * a wrong answer.
+ */
+
+#include <common.h>
+#include <dtoverlay.h>
+#include <malloc.h>
+#include <linux/libfdt.h>
+
+#define DTOVERLAY_INDEX_DEPTH		32
+#define DTOVERLAY_INDEX_PATH		256
+#define DTOVERLAY_INDEX_MOVES		64
+/* Phandles above this are looked up by walking the tree */
+#define DTOVERLAY_INDEX_MAX_PHANDLE	0x10000
+
+struct dtoverlay_index_entry {
+	int key;	/* offset of the key in the pool + 1, 0 if unused */
+	int val;
+};
+
+struct dtoverlay_index_table {
+	struct dtoverlay_index_entry *slots;
+	int size;	/* power of 2, at most half full */
+	int used;
+};
+
+struct dtoverlay_index_move {
+	int off;	/* nodes after this one moved... */
+	int delta;	/* ...by this many bytes */
+};
+
+struct dtoverlay_index {
+	int struct_size;
+	int symbols_off;
+	int *phandles;
+	int num_phandles;
+	struct dtoverlay_index_table paths;	/* path -> node offset */
+	struct dtoverlay_index_table symbols;	/* name -> path in the pool */
+	char *pool;
+	int pool_len;
+	int pool_max;
+	struct dtoverlay_index_move moves[DTOVERLAY_INDEX_MOVES];
+	int num_moves;
+};
+
+static int dtoverlay_index_enabled = 1;
+
+static u32 dtoverlay_index_hash(const char *s, int len)
+{
+	u32 h = 2166136261;
+
+	while (len--)
+		h = (h ^ (u8)*s++) * 16777619;
+
+	return h;
+}
+
+static int dtoverlay_index_intern(struct dtoverlay_index *idx, const char *s,
+				  int len)
+{
+	int off = idx->pool_len;
+
+	if (off + len + 1 > idx->pool_max) {
+		int max = max(idx->pool_max * 2, off + len + 1 + 4096);
+		char *pool = realloc(idx->pool, max);
+
+		if (!pool)
+			return -FDT_ERR_NOSPACE;
+		idx->pool = pool;
+		idx->pool_max = max;
+	}
+	memcpy(idx->pool + off, s, len);
+	idx->pool[off + len] = '\0';
+	idx->pool_len += len + 1;
+
+	return off;
+}
+
+/* Returns the entry for the key, or the unused slot where it would go */
+static struct dtoverlay_index_entry *
+dtoverlay_index_slot(const struct dtoverlay_index *idx,
+		     const struct dtoverlay_index_table *t, const char *s,
+		     int len)
+{
+	u32 i;
+
+	if (!t->size)
+		return NULL;
+
+	for (i = dtoverlay_index_hash(s, len); ; i++) {
+		struct dtoverlay_index_entry *e = &t->slots[i & (t->size - 1)];
+		const char *key;
+
+		if (!e->key)
+			return e;
+		key = idx->pool + e->key - 1;
+		if (!strncmp(key, s, len) && !key[len])
+			return e;
+	}
+}
+
+static int dtoverlay_index_grow(struct dtoverlay_index *idx,
+				struct dtoverlay_index_table *t)
+{
+	struct dtoverlay_index_entry *old = t->slots;
+	int old_size = t->size;
+	int i;
+
+	t->size = old_size ? old_size * 2 : 64;
+	t->slots = calloc(t->size, sizeof(*t->slots));
+	if (!t->slots) {
+		t->slots = old;
+		t->size = old_size;
+		return -FDT_ERR_NOSPACE;
+	}
+
+	for (i = 0; i < old_size; i++) {
+		const char *key;
+
+		if (!old[i].key)
+			continue;
+		key = idx->pool + old[i].key - 1;
+		*dtoverlay_index_slot(idx, t, key, strlen(key)) = old[i];
+	}
+	free(old);
+
+	return 0;
+}
+
+static int dtoverlay_index_insert(struct dtoverlay_index *idx,
+				  struct dtoverlay_index_table *t,
+				  const char *s, int len, int val)
+{
+	struct dtoverlay_index_entry *e;
+	int err;
+
+	if ((t->used + 1) * 2 > t->size) {
+		err = dtoverlay_index_grow(idx, t);
+		if (err)
+			return err;
+	}
+
+	e = dtoverlay_index_slot(idx, t, s, len);
+	if (!e->key) {
+		int key = dtoverlay_index_intern(idx, s, len);
+
+		if (key < 0)
+			return key;
+		e->key = key + 1;
+		t->used++;
+	}
+	e->val = val;
+
+	return 0;
+}
+
+static int dtoverlay_index_set_phandle(struct dtoverlay_index *idx,
+				       u32 phandle, int off)
+{
+	if (!phandle || phandle > DTOVERLAY_INDEX_MAX_PHANDLE)
+		return 0;
+
+	if (phandle >= (u32)idx->num_phandles) {
+		int num = max((int)phandle + 1, idx->num_phandles * 2);
+		int *phandles = realloc(idx->phandles, num * sizeof(int));
+		int i;
+
+		if (!phandles)
+			return -FDT_ERR_NOSPACE;
+		for (i = idx->num_phandles; i < num; i++)
+			phandles[i] = -1;
+		idx->phandles = phandles;
+		idx->num_phandles = num;
+	}
+	idx->phandles[phandle] = off;
+
+	return 0;
+}
+
+static void dtoverlay_index_release(struct dtoverlay_index *idx)
+{
+	free(idx->phandles);
+	free(idx->paths.slots);
+	free(idx->symbols.slots);
+	free(idx->pool);
+	free(idx);
+}
+
+static struct dtoverlay_index *dtoverlay_index_build(const void *fdt)
+{
+	char path[DTOVERLAY_INDEX_PATH];
+	int lens[DTOVERLAY_INDEX_DEPTH];
+	struct dtoverlay_index *idx;
+	int node_off, prop_off;
+	int depth = 0;
+	int err = 0;
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return NULL;
+	idx->struct_size = fdt_size_dt_struct(fdt);
+	idx->symbols_off = -FDT_ERR_NOTFOUND;
+
+	/*
+	 * Nodes nested too deeply or with too long a path are left out and
+	 * looked up in the tree
+	 */
+	for (node_off = 0;
+	     (node_off >= 0) && (depth >= 0) && !err;
+	     node_off = fdt_next_node(fdt, node_off, &depth)) {
+		const char *name;
+		int len, parent_len;
+
+		if (!depth) {
+			lens[0] = 0;
+			err = dtoverlay_index_insert(idx, &idx->paths, "/", 1, 0);
+		} else if (depth < DTOVERLAY_INDEX_DEPTH) {
+			lens[depth] = -1;
+			parent_len = lens[depth - 1];
+			name = fdt_get_name(fdt, node_off, &len);
+			if (name && (parent_len >= 0) &&
+			    (parent_len + 1 + len < DTOVERLAY_INDEX_PATH)) {
+				path[parent_len] = '/';
+				memcpy(path + parent_len + 1, name, len);
+				len += parent_len + 1;
+				lens[depth] = len;
+				err = dtoverlay_index_insert(idx, &idx->paths,
+							     path, len,
+							     node_off);
+				if ((len == 12) &&
+				    !memcmp(path, "/__symbols__", 12))
+					idx->symbols_off = node_off;
+			}
+		}
+
+		if (!err) {
+			u32 phandle = fdt_get_phandle(fdt, node_off);
+
+			err = dtoverlay_index_set_phandle(idx, phandle,
+							  node_off);
+		}
+	}
+
+	for (prop_off = fdt_first_property_offset(fdt, idx->symbols_off);
+	     (prop_off >= 0) && !err;
+	     prop_off = fdt_next_property_offset(fdt, prop_off)) {
+		const char *name, *val;
+		int len, key;
+
+		val = fdt_getprop_by_offset(fdt, prop_off, &name, &len);
+		if (!val || (len <= 0))
+			continue;
+		key = dtoverlay_index_intern(idx, val, strnlen(val, len));
+		if (key < 0)
+			err = key;
+		else
+			err = dtoverlay_index_insert(idx, &idx->symbols, name,
+						     strlen(name), key);
+	}
+
+	if (err) {
+		dtoverlay_debug("no lookup index (%d)", err);
+		dtoverlay_index_release(idx);
+		return NULL;
+	}
+
+	return idx;
+}
+
+void dtoverlay_index_free(DTBLOB_T *dtb)
+{
+	if (dtb->index) {
+		dtoverlay_index_release(dtb->index);
+		dtb->index = NULL;
+	}
+}
+
+static struct dtoverlay_index *dtoverlay_index_get(DTBLOB_T *dtb)
+{
+	if (dtb->index &&
+	    (!dtoverlay_index_enabled ||
+	     (dtb->index->struct_size != fdt_size_dt_struct(dtb->fdt))))
+		dtoverlay_index_free(dtb);
+
+	if (!dtb->index && dtoverlay_index_enabled)
+		dtb->index = dtoverlay_index_build(dtb->fdt);
+
+	return dtb->index;
+}
+
+/*
+ * A hit that no longer matches the tree. Paths handed out may still be in
+ * use by the caller, so the index is only dropped on the next lookup.
+ */
+static void dtoverlay_index_stale(struct dtoverlay_index *idx)
+{
+	idx->struct_size = -1;
+}
+
+static int dtoverlay_index_replay(const struct dtoverlay_index *idx, int off)
+{
+	int i;
+
+	for (i = 0; i < idx->num_moves; i++) {
+		if (off > idx->moves[i].off)
+			off += idx->moves[i].delta;
+	}
+
+	return off;
+}
+
+static void dtoverlay_index_flush(struct dtoverlay_index *idx)
+{
+	int i;
+
+	if (!idx->num_moves)
+		return;
+
+	for (i = 0; i < idx->num_phandles; i++) {
+		int *off = &idx->phandles[i];
+
+		if (*off >= 0)
+			*off = dtoverlay_index_replay(idx, *off);
+	}
+	for (i = 0; i < idx->paths.size; i++) {
+		struct dtoverlay_index_entry *e = &idx->paths.slots[i];
+
+		if (e->key)
+			e->val = dtoverlay_index_replay(idx, e->val);
+	}
+	idx->num_moves = 0;
+}
+
+void dtoverlay_index_moved(DTBLOB_T *dtb, int node_off, int old_size)
+{
+	struct dtoverlay_index *idx = dtb->index;
+	int size;
+
+	if (!idx)
+		return;
+
+	/* The symbols are copied, so an edit of them needs a rebuild */
+	if ((idx->struct_size != old_size) || (node_off == idx->symbols_off)) {
+		dtoverlay_index_free(dtb);
+		return;
+	}
+
+	size = fdt_size_dt_struct(dtb->fdt);
+	if (size == old_size)
+		return;
+
+	if (idx->num_moves == DTOVERLAY_INDEX_MOVES)
+		dtoverlay_index_flush(idx);
+	idx->moves[idx->num_moves].off = node_off;
+	idx->moves[idx->num_moves].delta = size - old_size;
+	idx->num_moves++;
+
+	if (idx->symbols_off > node_off)
+		idx->symbols_off += size - old_size;
+	idx->struct_size = size;
+}
+
+int dtoverlay_index_phandle(DTBLOB_T *dtb, uint32_t phandle)
+{
+	struct dtoverlay_index *idx = dtoverlay_index_get(dtb);
+	int off;
+
+	if (idx && (phandle < (uint32_t)idx->num_phandles) &&
+	    (idx->phandles[phandle] >= 0)) {
+		off = dtoverlay_index_replay(idx, idx->phandles[phandle]);
+		if (fdt_get_phandle(dtb->fdt, off) == phandle)
+			return off;
+		dtoverlay_index_stale(idx);
+		idx = NULL;
+	}
+
+	/* Not indexed yet, e.g. a phandle an overlay brought in */
+	off = fdt_node_offset_by_phandle(dtb->fdt, phandle);
+	if (idx && (off >= 0)) {
+		dtoverlay_index_flush(idx);
+		dtoverlay_index_set_phandle(idx, phandle, off);
+	}
+
+	return off;
+}
+
+/* Same match as libfdt: "name" also finds "name@unit" */
+static int dtoverlay_index_check(const void *fdt, int off, const char *path,
+				 int len)
+{
+	const char *comp = path + len;
+	const char *name;
+	int comp_len, name_len;
+
+	while ((comp > path) && (comp[-1] != '/'))
+		comp--;
+	comp_len = path + len - comp;
+	if (!comp_len)
+		return off == 0;
+
+	name = fdt_get_name(fdt, off, &name_len);
+	if (!off || !name || (name_len < comp_len) ||
+	    memcmp(name, comp, comp_len))
+		return 0;
+
+	return (name_len == comp_len) ||
+	       ((name[comp_len] == '@') && !memchr(comp, '@', comp_len));
+}
+
+int dtoverlay_index_path(DTBLOB_T *dtb, const char *path, int len)
+{
+	struct dtoverlay_index *idx = dtoverlay_index_get(dtb);
+	int off;
+
+	/* Aliases and paths with a trailing '/' go straight to libfdt */
+	if (!len || (path[0] != '/') || ((len > 1) && (path[len - 1] == '/')))
+		idx = NULL;
+
+	if (idx) {
+		struct dtoverlay_index_entry *e;
+
+		e = dtoverlay_index_slot(idx, &idx->paths, path, len);
+		if (e && e->key) {
+			off = dtoverlay_index_replay(idx, e->val);
+			if (dtoverlay_index_check(dtb->fdt, off, path, len))
+				return off;
+			dtoverlay_index_stale(idx);
+			idx = NULL;
+		}
+	}
+
+	off = fdt_path_offset_namelen(dtb->fdt, path, len);
+	if (idx && (off >= 0)) {
+		dtoverlay_index_flush(idx);
+		dtoverlay_index_insert(idx, &idx->paths, path, len, off);
+	}
+
+	return off;
+}
+
+const char *dtoverlay_index_symbol(DTBLOB_T *dtb, const char *name, int *lenp)
+{
+	struct dtoverlay_index *idx = dtoverlay_index_get(dtb);
+	const char *path;
+	int symbols_off;
+
+	if (idx) {
+		struct dtoverlay_index_entry *e;
+
+		e = dtoverlay_index_slot(idx, &idx->symbols, name,
+					 strlen(name));
+		if (e && e->key) {
+			path = idx->pool + e->val;
+			*lenp = strlen(path);
+			return path;
+		}
+	}
+
+	symbols_off = dtoverlay_index_path(dtb, "/__symbols__", 12);
+	if (symbols_off < 0) {
+		*lenp = symbols_off;
+		return NULL;
+	}
+
+	path = fdt_getprop(dtb->fdt, symbols_off, name, lenp);
+	if (path)
+		*lenp = strnlen(path, *lenp);
+
+	return path;
+}
+
+void dtoverlay_enable_index(int enable)
+{
+	dtoverlay_index_enabled = enable;
+}
@@ -11,6 +11,7 @@
 #include <../lib/libavb/libavb.h>
 #include <mapmem.h>
 #include <mmc.h>
+#include <tee/optee_ta_avb.h>
 
 #define AVB_MAX_ARGS			1024
 #define VERITY_TABLE_OPT_RESTART	"restart_on_corruption"
@@ -24,6 +25,37 @@ enum avb_boot_state {
 	AVB_RED,
 };
 
+#ifdef CONFIG_OPTEE_TA_AVB
+/* Flags of a rollback index slot in struct avb_ta_cache */
+#define AVB_TA_RB_VALID		BIT(0)	/* @rb holds the index */
+#define AVB_TA_RB_DIRTY		BIT(1)	/* @rb is not written to the TA yet */
+
+struct avb_ta_value;
+
+/**
+ * struct avb_ta_cache - AVB TA state kept for the life of an AvbOps
+ *
+ * Reads are answered from here once the TA was asked. Rollback index writes
+ * only land here until avb_ops_commit(). Persistent values are dropped by
+ * avb_ops_drop_values().
+ *
+ * @loaded:	TA_AVB_CMD_READ_STATE was tried
+ * @lock_valid:	@lock_state holds the lock state
+ * @lock_state:	Lock state from the TA, 0 if unlocked
+ * @rb_flags:	AVB_TA_RB_... flags of each rollback index slot
+ * @rb:		Rollback index of each slot
+ * @values:	Persistent values read or written so far
+ */
+struct avb_ta_cache {
+	bool loaded;
+	bool lock_valid;
+	u32 lock_state;
+	u8 rb_flags[TA_AVB_MAX_ROLLBACK_LOCATIONS];
+	u64 rb[TA_AVB_MAX_ROLLBACK_LOCATIONS];
+	struct avb_ta_value *values;
+};
+#endif
+
 struct AvbOpsData {
 	struct AvbOps ops;
 	int mmc_dev;
@@ -32,6 +64,7 @@ struct AvbOpsData {
 #ifdef CONFIG_OPTEE_TA_AVB
 	struct udevice *tee;
 	u32 session;
+	struct avb_ta_cache ta;
 #endif
 };
 
@@ -49,6 +82,8 @@ enum mmc_io_type {
 
 AvbOps *avb_ops_alloc(const char *intf, int boot_device);
 void avb_ops_free(AvbOps *ops);
+int avb_ops_commit(AvbOps *ops);
+void avb_ops_drop_values(AvbOps *ops);
 
 char *avb_set_state(AvbOps *ops, enum avb_boot_state boot_state);
 char *avb_set_enforce_verity(const char *cmdline);
@@ -56,6 +91,29 @@ char *avb_set_ignore_corruption(const char *cmdline);
 
 char *append_cmd_line(char *cmdline_orig, char *cmdline_new);
 
+#if CONFIG_IS_ENABLED(AVB_HASHTREE_CHECK)
+/**
+ * avb_check_hashtrees() - Spot-check the dm-verity hashtrees of a slot
+ *
+ * For each hashtree descriptor in @data, check a few data blocks up to the
+ * root digest, reading one hash block per tree level for each, or the whole
+ * tree with AVB_HASHTREE_CHECK_FULL. This catches a corrupted partition
+ * before the kernel boots with restart_on_corruption and ends up in a reset
+ * loop.
+ *
+ * @ops: AvbOps used to read the partitions
+ * @data: Result of a successful avb_slot_verify()
+ * Return: 0 if OK or if a tree cannot be checked, -EBADMSG or -EINVAL if
+ *	a tree does not match its descriptor
+ */
+int avb_check_hashtrees(AvbOps *ops, AvbSlotVerifyData *data);
+#else
+static inline int avb_check_hashtrees(AvbOps *ops, AvbSlotVerifyData *data)
+{
+	return 0;
+}
+#endif
+
 /**
  * ============================================================================
  * I/O helper inline functions
@@ -209,6 +209,12 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_FSP_M,
 	BOOTSTAGE_ID_ACCUM_FSP_S,
 	BOOTSTAGE_ID_ACCUM_MMAP_SPI,
+	BOOTSTAGE_ID_ACCUM_BOOT_LOAD,
+	BOOTSTAGE_ID_ACCUM_AVB_READ,
+	BOOTSTAGE_ID_ACCUM_AVB_HASH,
+	BOOTSTAGE_ID_ACCUM_BOOT_RELOC,
+	BOOTSTAGE_ID_ACCUM_FDT,
+	BOOTSTAGE_ID_ACCUM_FDT_BOARD,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -450,6 +456,92 @@ static inline int bootstage_init(bool first)
 
 #endif /* ENABLE_BOOTSTAGE */
 
+#ifdef ENABLE_BOOTSTAGE
+#if CONFIG_IS_ENABLED(BOOTSTAGE_TIMELINE)
+#define ENABLE_BOOTSTAGE_TIMELINE
+#endif
+#endif
+
+#ifdef ENABLE_BOOTSTAGE_TIMELINE
+
+/*
+ * Binary boot timeline, as written by bootstage_timeline(). All fields are
+ * little-endian. The header is followed by @rec_count records, @io_count
+ * storage read summaries and then @str_size bytes of NUL-terminated names,
+ * which the records refer to by their offset.
+ */
+enum {
+	BOOTSTAGE_TL_MAGIC	= 0x4c544253,	/* "SBTL" */
+	BOOTSTAGE_TL_VERSION	= 1,
+};
+
+/* Record flags */
+enum {
+	BOOTSTAGE_TL_ACCUM	= 1 << 0,	/* time_us is an accumulated time */
+	BOOTSTAGE_TL_ERROR	= 1 << 1,	/* Error record */
+};
+
+struct bootstage_tl_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t rec_count;
+	uint16_t io_count;
+	uint16_t str_size;
+};
+
+struct bootstage_tl_rec {
+	uint32_t time_us;
+	uint32_t id;
+	uint16_t flags;
+	uint16_t name;
+};
+
+struct bootstage_tl_io {
+	uint64_t bytes;
+	uint32_t time_us;
+	uint32_t reads;
+	uint16_t name;
+	uint16_t reserved[3];
+};
+
+/**
+ * bootstage_io() - Account a read from a storage device
+ *
+ * @dev:	Device name, e.g. "mmc" or an MTD device name
+ * @devnum:	Device number appended to @dev, or -1 for none
+ * @bytes:	Number of bytes read
+ * @start_us:	timer_get_boot_us() when the read started
+ */
+void bootstage_io(const char *dev, int devnum, uint64_t bytes, ulong start_us);
+
+/**
+ * bootstage_timeline() - Write the binary boot timeline
+ *
+ * @buf:	Buffer to write to
+ * @size:	Size of @buf, 0 to just get the size needed
+ * Return: size of the timeline, @buf is only written if it is large enough
+ */
+int bootstage_timeline(void *buf, int size);
+
+/**
+ * ft_board_bootstage() - Add board-specific bootstage data to the OS FDT
+ *
+ * Called by bootstage_fdt_add_report() once the last bootstage record is in,
+ * typically to add the output of bootstage_timeline() where the OS looks for
+ * it.
+ *
+ * @blob:	FDT to update
+ * Return: 0 if OK, -ve on error
+ */
+int ft_board_bootstage(void *blob);
+
+#else
+static inline void bootstage_io(const char *dev, int devnum, uint64_t bytes,
+				ulong start_us)
+{
+}
+#endif /* ENABLE_BOOTSTAGE_TIMELINE */
+
 /* Helper macro for adding a bootstage to a line of code */
 #define BOOTSTAGE_MARKER()	\
 		bootstage_mark_code(__FILE__, __func__, __LINE__)
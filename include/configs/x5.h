@@ -88,7 +88,7 @@
 	(RDK_DEFAULT_ION_TOTAL_SIZE - RDK_DEFAULT_ION_RESERVED_SIZE - \
 	RDK_DEFAULT_ION_CARVEOUT_SIZE) /* 128M */
 
-#define CONFIG_SYS_MMC_MAX_BLK_COUNT 1024
+#define CONFIG_SYS_MMC_MAX_BLK_COUNT 65535
 
 #ifdef CONFIG_DISTRO_DEFAULTS
 #define FDT_ADDR                0x84000000
@@ -68,6 +68,21 @@ void flush_dcache_all(void);
 void flush_dcache_range(unsigned long start, unsigned long stop);
 void invalidate_dcache_range(unsigned long start, unsigned long stop);
 void invalidate_dcache_all(void);
+
+/**
+ * memcpy_flush_dcache() - Copy a buffer and flush the copy to memory
+ *
+ * This does the same as memcpy() followed by flush_dcache_range() over the
+ * cache lines holding @dst, e.g. to hand a buffer over to a DMA engine, but
+ * where possible it flushes each piece right after copying it, while it is
+ * still in the cache, rather than in a second pass over the whole buffer.
+ * Only provided when CONFIG_HAVE_MEMCPY_FLUSH_DCACHE is enabled.
+ *
+ * @dst: Destination buffer
+ * @src: Source buffer, which must not overlap @dst
+ * @len: Number of bytes to copy
+ */
+void memcpy_flush_dcache(void *dst, const void *src, size_t len);
 void invalidate_icache_all(void);
 
 enum {
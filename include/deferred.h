@@ -0,0 +1,189 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Cooperative deferred work
+ *
+ * Lets init code hand a slow, mostly-waiting sequence (power ramps, reset
+ * pulses, button sampling) to a queue of deadline-ordered callbacks. The
+ * queue is run from the polling loops of the console, MMC and network
+ * code, so the boot CPU keeps doing useful work instead of spinning in
+ * udelay().
+ */
+
+#ifndef __DEFERRED_H
+#define __DEFERRED_H
+
+#include <linux/delay.h>
+#include <linux/list.h>
+#include <linux/types.h>
+
+struct udevice;
+struct deferred_work;
+
+/**
+ * typedef deferred_func_t - Deferred work callback
+ *
+ * @work: Work item being run
+ * Return: number of microseconds after which to call the callback again,
+ *	0 when the work is complete, or -ve on error (which also completes it)
+ */
+typedef int (*deferred_func_t)(struct deferred_work *work);
+
+/**
+ * struct deferred_work - A deferred work item
+ *
+ * @name: Name of the work, also used as its bootstage marker. This must
+ *	be a string constant since bootstage keeps the pointer
+ * @func: Callback to run once the deadline has passed
+ * @priv: Private data for @func
+ * @dev: Device which must not be used before the work completes, or NULL
+ * @step: Number of times @func has been called, for use by @func to track
+ *	where it is in its sequence
+ * @ret: Result of the last call to @func
+ * @pending: true while the work is queued
+ * @deadline: timer_get_us() value after which @func is due
+ * @sibling: Node in the queue
+ */
+struct deferred_work {
+	const char *name;
+	deferred_func_t func;
+	void *priv;
+	struct udevice *dev;
+	uint step;
+	int ret;
+	bool pending;
+	ulong deadline;
+	struct list_head sibling;
+};
+
+#if CONFIG_IS_ENABLED(DEFERRED_WORK)
+
+/**
+ * deferred_init() - Set up a work item
+ *
+ * @work: Work item to set up
+ * @name: Name of the work (see struct deferred_work)
+ * @func: Callback to run
+ * @priv: Private data for @func
+ */
+void deferred_init(struct deferred_work *work, const char *name,
+		   deferred_func_t func, void *priv);
+
+/**
+ * deferred_schedule() - Queue a work item
+ *
+ * The callback runs from the next deferred_poll() once @delay_us has
+ * passed. Queueing a work item which is already pending moves its
+ * deadline.
+ *
+ * @work: Work item to queue
+ * @delay_us: Number of microseconds to wait before running it
+ */
+void deferred_schedule(struct deferred_work *work, ulong delay_us);
+
+/**
+ * deferred_cancel() - Remove a work item from the queue
+ *
+ * @work: Work item to cancel
+ */
+void deferred_cancel(struct deferred_work *work);
+
+/**
+ * deferred_poll() - Run all work items whose deadline has passed
+ *
+ * This is cheap when nothing is due and may be called from any polling
+ * loop. Calls made from within a callback return immediately.
+ */
+void deferred_poll(void);
+
+/**
+ * deferred_udelay() - Delay while running deferred work
+ *
+ * Like udelay(), but runs deferred_poll() while waiting. The delay may
+ * overrun by the time taken by a callback.
+ *
+ * @usec: Number of microseconds to wait
+ */
+void deferred_udelay(ulong usec);
+
+/**
+ * deferred_wait() - Wait for a work item to complete
+ *
+ * Other work items keep running while waiting.
+ *
+ * @work: Work item to wait for
+ * Return: 0 if OK, -ve error returned by the callback
+ */
+int deferred_wait(struct deferred_work *work);
+
+/**
+ * deferred_wait_dev() - Wait for all work items gating a device
+ *
+ * @dev: Device about to be used
+ * Return: 0 if OK, -ve error returned by the last failing callback
+ */
+int deferred_wait_dev(struct udevice *dev);
+
+/**
+ * deferred_flush() - Wait for all work items to complete
+ *
+ * This is called before handing over to the OS.
+ */
+void deferred_flush(void);
+
+#else
+
+static inline void deferred_init(struct deferred_work *work, const char *name,
+				 deferred_func_t func, void *priv)
+{
+	work->name = name;
+	work->func = func;
+	work->priv = priv;
+	work->dev = NULL;
+	work->step = 0;
+	work->ret = 0;
+	work->pending = false;
+}
+
+/* Without the queue, run the whole sequence in place */
+static inline void deferred_schedule(struct deferred_work *work, ulong delay_us)
+{
+	int ret = delay_us;
+
+	do {
+		udelay(ret);
+		ret = work->func(work);
+		work->step++;
+	} while (ret > 0);
+	work->ret = ret;
+}
+
+static inline void deferred_cancel(struct deferred_work *work)
+{
+}
+
+static inline void deferred_poll(void)
+{
+}
+
+static inline void deferred_udelay(ulong usec)
+{
+	udelay(usec);
+}
+
+static inline int deferred_wait(struct deferred_work *work)
+{
+	return work->ret;
+}
+
+static inline int deferred_wait_dev(struct udevice *dev)
+{
+	return 0;
+}
+
+static inline void deferred_flush(void)
+{
+}
+
+#endif
+
+#endif
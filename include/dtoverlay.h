@@ -59,6 +59,8 @@ typedef struct dtoverlay_struct
    const char *b;
 } DTOVERLAY_PARAM_T;
 
+struct dtoverlay_index;
+
 typedef struct dtblob_struct
 {
    void *fdt;
@@ -69,6 +71,7 @@ typedef struct dtblob_struct
    int max_phandle;
    void *trailer;
    int trailer_len;
+   struct dtoverlay_index *index; /* See dtoverlay/dtoverlay_index.c */
 } DTBLOB_T;
 
 typedef struct string_struct
@@ -217,9 +220,64 @@ void dtoverlay_set_logging_func(DTOVERLAY_LOGGING_FUNC *func);
 
 void dtoverlay_enable_debug(int enable);
 
+/* Lookup index, see dtoverlay/dtoverlay_index.c */
+int dtoverlay_index_phandle(DTBLOB_T *dtb, uint32_t phandle);
+
+int dtoverlay_index_path(DTBLOB_T *dtb, const char *path, int len);
+
+/* The path stays valid until the next lookup in or edit of the blob */
+const char *dtoverlay_index_symbol(DTBLOB_T *dtb, const char *name, int *lenp);
+
+/* Call after an edit within the node at node_off, with the
+   fdt_size_dt_struct() from before it */
+void dtoverlay_index_moved(DTBLOB_T *dtb, int node_off, int old_size);
+
+void dtoverlay_index_free(DTBLOB_T *dtb);
+
+void dtoverlay_enable_index(int enable);
+
 void dtoverlay_error(const char *fmt, ...);
 
 void dtoverlay_debug(const char *fmt, ...);
 
 void load_env_file(char* env_name,ulong file_addr,loff_t* len_read);
+
+/* Where the dtoverlay= entries of config.txt are looked up */
+#define DTOVERLAY_PATH_FMT "/boot/overlays/%s.dtbo"
+
+/* Room do_dtparam() lets a device tree or overlay grow into */
+#define DTOVERLAY_FDT_MAX_SIZE 0x50000
+
+/* Bundle stored next to config.txt, see dtoverlay/dtoverlay_bundle.c */
+#define DTOVERLAY_BUNDLE_SUFFIX ".bundle"
+
+/**
+ * dtoverlay_bundle_make() - Record what the overlays did to a device tree
+ *
+ * @base:	Device tree before the overlays
+ * @fdt:	Device tree after the overlays
+ * @key:	SHA-256 of everything the result depends on
+ * @bundlep:	Returns the bundle, to be freed by the caller
+ * @sizep:	Returns the size of the bundle
+ * Return: 0 if OK, -ve on error
+ */
+int dtoverlay_bundle_make(const void *base, const void *fdt,
+                          const unsigned char *key, void **bundlep,
+                          int *sizep);
+
+/**
+ * dtoverlay_bundle_apply() - Replay a bundle on a device tree
+ *
+ * @bundle:	Bundle from dtoverlay_bundle_make()
+ * @size:	Size of @bundle
+ * @key:	SHA-256 of the current inputs, must match the bundle's
+ * @fdt:	Device tree before the overlays, patched in place
+ * @max_size:	Room at @fdt, which the device tree after the overlays may
+ *		grow into
+ * Return: 0 if OK, -ESTALE if the bundle is for other inputs, -EILSEQ if
+ * it is damaged, -ENOSPC if the result does not fit in @max_size, other -ve
+ * on error; @fdt is then unchanged
+ */
+int dtoverlay_bundle_apply(const void *bundle, int size,
+                           const unsigned char *key, void *fdt, int max_size);
 #endif
@@ -269,6 +269,14 @@ void fastboot_upload_ramdump(void);
  */
 void fastboot_upload_complete(char *response);
 
+/**
+ * fastboot_upload_abort() - Drop the current transfer
+ *
+ * Reset global transfer info, and close the ramdump stream being uploaded.
+ * Used when an upload fails partway.
+ */
+void fastboot_upload_abort(void);
+
 
 #if CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT)
 void fastboot_acmd_complete(void);
@@ -0,0 +1,153 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Decompress independent LZ4 blocks and zstd frames on all CPUs
+ *
+ * An LZ4 frame with independent blocks, a series of LZ4 frames or a series
+ * of zstd frames is made of units which can each be decompressed on their
+ * own, provided that we know where their output goes. The boot CPU parses
+ * the stream as it becomes available and publishes each complete unit;
+ * the units are decompressed by the other CPUs in the meantime, so that a
+ * caller can overlap reading the stream from storage with decompressing
+ * it.
+ *
+ * Streams which cannot be split this way (dependent LZ4 blocks, frames of
+ * unknown size followed by other frames, in-place decompression) fail
+ * with -EPROTONOSUPPORT, and the caller falls back to the serial
+ * decompressors.
+ */
+
+#ifndef __FRAME_DECOMP_H
+#define __FRAME_DECOMP_H
+
+#include <linux/bitops.h>
+#include <linux/types.h>
+
+struct frame_decomp_unit;
+
+/* Keep the result so that frame_decomp_lookup() can find it */
+#define FRAME_DECOMP_KEEP	BIT(0)
+
+/**
+ * struct frame_decomp - A stream being decompressed
+ *
+ * All members are private to frame_decomp.c.
+ */
+struct frame_decomp {
+	int comp;
+	uint flags;
+	const u8 *src;
+	size_t src_len;
+	size_t parsed;
+	u8 *dst;
+	size_t dst_len;
+	size_t dst_pos;
+	bool open_ended;
+
+	/* LZ4 frame being parsed */
+	bool in_frame;
+	bool block_csum;
+	bool content_csum;
+	uint block_max;
+	u64 content_size;
+	size_t frame_start;
+
+	struct frame_decomp_unit *units;
+	uint max_units;
+	uint ready;
+	uint next;
+	bool closed;
+
+	void **workspace;
+	size_t workspace_size;
+	uint nr_lanes;
+	bool queued;
+	int ret;
+};
+
+/**
+ * frame_decomp_start() - Start decompressing a stream
+ *
+ * @fd: Stream state
+ * @comp: Compression type (IH_COMP_LZ4 or IH_COMP_ZSTD)
+ * @src: Compressed data, which need not be available yet
+ * @src_len: Total length of the compressed data
+ * @dst: Destination buffer, which must not overlap @src
+ * @dst_len: Size of @dst
+ * @flags: FRAME_DECOMP_... flags
+ * Return: 0 if OK, -EPROTONOSUPPORT if @comp cannot be split or the buffers
+ *	overlap, -ENOMEM if out of memory
+ */
+int frame_decomp_start(struct frame_decomp *fd, int comp, const void *src,
+		       size_t src_len, void *dst, size_t dst_len, uint flags);
+
+/**
+ * frame_decomp_feed() - Tell how much of the compressed data is available
+ *
+ * Units which are now complete are handed out to the other CPUs.
+ *
+ * @fd: Stream state
+ * @avail: Number of bytes available from the start of the stream, which
+ *	may only grow from one call to the next
+ * Return: 0 if OK, -ve if the stream cannot be decompressed this way;
+ *	frame_decomp_finish() or frame_decomp_abort() must still be called
+ */
+int frame_decomp_feed(struct frame_decomp *fd, size_t avail);
+
+/**
+ * frame_decomp_finish() - Wait for the stream to be decompressed
+ *
+ * The whole compressed data must be available. This also frees the
+ * resources held by @fd.
+ *
+ * @fd: Stream state
+ * @out_len: Returns the length of the decompressed data
+ * Return: 0 if OK, -EPROTONOSUPPORT if the stream cannot be decompressed
+ *	this way, other -ve on error
+ */
+int frame_decomp_finish(struct frame_decomp *fd, size_t *out_len);
+
+/**
+ * frame_decomp_abort() - Give up on a stream
+ *
+ * This is for when the compressed data cannot all be made available, e.g.
+ * on a read error. The other CPUs stop, the resources held by @fd are freed
+ * and nothing is kept for frame_decomp_lookup().
+ *
+ * @fd: Stream state
+ */
+void frame_decomp_abort(struct frame_decomp *fd);
+
+/**
+ * frame_decomp() - Decompress a buffer on all CPUs
+ *
+ * @comp: Compression type (IH_COMP_LZ4 or IH_COMP_ZSTD)
+ * @src: Compressed data
+ * @src_len: Length of @src
+ * @dst: Destination buffer
+ * @dst_len: On entry, size of @dst; returns the decompressed length
+ * Return: 0 if OK, -EPROTONOSUPPORT if the stream cannot be decompressed
+ *	this way, other -ve on error
+ */
+int frame_decomp(int comp, const void *src, size_t src_len, void *dst,
+		 size_t *dst_len);
+
+/**
+ * frame_decomp_lookup() - Find data decompressed ahead of time
+ *
+ * This returns the result of the last stream started with
+ * FRAME_DECOMP_KEEP if it matches, then forgets about it. The compressed
+ * data is matched by its length and checksum rather than by its address,
+ * so that different data loaded at the same place is decompressed again.
+ *
+ * @comp: Compression type
+ * @src: Compressed data
+ * @src_len: Length of @src
+ * @dst: Destination buffer
+ * @dst_len: Size of @dst
+ * @out_len: Returns the decompressed length
+ * Return: true if @src is already decompressed in @dst
+ */
+bool frame_decomp_lookup(int comp, const void *src, size_t src_len,
+			 const void *dst, size_t dst_len, size_t *out_len);
+
+#endif
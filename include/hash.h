@@ -120,6 +120,17 @@ int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 int hash_block(const char *algo_name, const void *data, unsigned int len,
 	       uint8_t *output, int *output_size);
 
+/**
+ * hash_bench() - Measure the throughput of every hash algorithm
+ *
+ * Hashes a @size byte buffer with each supported algorithm and prints the
+ * time taken, the implementation in use and the resulting MB/s.
+ *
+ * @size:		Number of bytes to hash per algorithm
+ * Return: 0 if ok, -ENOMEM if the buffer cannot be allocated
+ */
+int hash_bench(ulong size);
+
 #endif /* !USE_HOSTCC */
 
 /**
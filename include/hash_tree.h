@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Block hash trees, as used by dm-verity and AVB hashtree descriptors
+ *
+ * The data is split into blocks which are hashed independently, each as
+ * H(salt || block), the last block being padded with zeroes. The digests
+ * of one level, each padded to a power of two and the level itself padded
+ * to a whole block, form the data of the level above, until a level fits
+ * in a single block. The root digest is the hash of that block.
+ *
+ * Since the blocks of a level are independent, they are hashed on all
+ * CPUs with smp_job_run().
+ */
+
+#ifndef __HASH_TREE_H
+#define __HASH_TREE_H
+
+#include <linux/types.h>
+
+#define HASH_TREE_MAX_DIGEST	64
+#define HASH_TREE_MAX_LEVELS	16
+
+/**
+ * struct hash_tree - Hash tree parameters
+ *
+ * @algo: Hash algorithm name, "sha1", "sha256" or "sha512"
+ * @block_size: Size of data and hash blocks, a power of two
+ * @salt: Salt prepended to each block, or NULL
+ * @salt_len: Length of @salt in bytes
+ * @serial: Hash on the calling CPU only (e.g. to compare throughput)
+ */
+struct hash_tree {
+	const char *algo;
+	uint block_size;
+	const u8 *salt;
+	uint salt_len;
+	bool serial;
+};
+
+/**
+ * struct hash_tree_layout - Position of the tree levels in the hash area
+ *
+ * Levels are numbered from the bottom one, which hashes the data. They are
+ * stored top-down, the top level first.
+ *
+ * @nr_levels: Number of levels
+ * @offset: Offset of each level from the start of the tree
+ * @size: Size of each level, a whole number of blocks
+ * @tree_size: Total size of the tree
+ */
+struct hash_tree_layout {
+	uint nr_levels;
+	u64 offset[HASH_TREE_MAX_LEVELS];
+	u64 size[HASH_TREE_MAX_LEVELS];
+	u64 tree_size;
+};
+
+/**
+ * hash_tree_digest_size() - Get the digest size of the tree algorithm
+ *
+ * @tree: Tree parameters
+ * Return: digest size in bytes, or -EPROTONOSUPPORT if the algorithm is not
+ *	supported
+ */
+int hash_tree_digest_size(const struct hash_tree *tree);
+
+/**
+ * hash_tree_entry_size() - Get the size of a digest within a level
+ *
+ * @tree: Tree parameters
+ * Return: digest size rounded up to a power of two, or -ve on error
+ */
+int hash_tree_entry_size(const struct hash_tree *tree);
+
+/**
+ * hash_tree_hash_block() - Hash a single block
+ *
+ * @tree: Tree parameters
+ * @data: Block data
+ * @len: Length of @data, at most the block size; the rest of the block is
+ *	taken as zeroes
+ * @digest: Returns the digest
+ * Return: 0 if OK, -ve on error
+ */
+int hash_tree_hash_block(const struct hash_tree *tree, const void *data,
+			 uint len, u8 *digest);
+
+/**
+ * hash_tree_level() - Hash all the blocks of a buffer
+ *
+ * @tree: Tree parameters
+ * @data: Data to hash
+ * @len: Length of @data
+ * @out: Returns the digests, each padded to the entry size, followed by
+ *	zeroes up to the next block boundary. This must hold
+ *	hash_tree_level_size() bytes.
+ * Return: 0 if OK, -ve on error
+ */
+int hash_tree_level(const struct hash_tree *tree, const void *data,
+		    u64 len, u8 *out);
+
+/**
+ * hash_tree_level_size() - Get the size of the level hashing a buffer
+ *
+ * @tree: Tree parameters
+ * @len: Length of the data hashed by the level
+ * Return: size of the level in bytes, 0 on error
+ */
+u64 hash_tree_level_size(const struct hash_tree *tree, u64 len);
+
+/**
+ * hash_tree_layout() - Work out the levels of the tree for an image
+ *
+ * @tree: Tree parameters
+ * @image_size: Size of the data, a multiple of the block size
+ * @layout: Returns the layout
+ * Return: 0 if OK, -ve on error
+ */
+int hash_tree_layout(const struct hash_tree *tree, u64 image_size,
+		     struct hash_tree_layout *layout);
+
+/**
+ * hash_tree_root() - Calculate the root digest of a buffer
+ *
+ * @tree: Tree parameters
+ * @data: Data to hash
+ * @len: Length of @data
+ * @root: Returns the root digest
+ * Return: 0 if OK, -ENOMEM if out of memory, other -ve on error
+ */
+int hash_tree_root(const struct hash_tree *tree, const void *data, u64 len,
+		   u8 *root);
+
+#endif
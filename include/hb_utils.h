@@ -12,6 +12,7 @@ int hb_get_som_type_by_filter_name(char *filter_name);
 int hb_extract_filter_name(const char* line, char* filter_name);
 
 int hb_ext4_load(char *filename, unsigned long addr, loff_t *len_read);
+int hb_ext4_store(char *filename, unsigned long addr, loff_t len);
 int hb_getline(char str[], int lim, char **mem_ptr);
 int atoi(const char * str);
 
@@ -265,6 +265,10 @@ struct spinand_ecc_info {
  * @op_variants.update_cache: variants of the update-cache operation
  * @select_target: function used to select a target/die. Required only for
  *		   multi-die chips
+ * @set_cont_read: function used to enter/leave continuous read mode.
+ *		   Optional
+ * @cont_read_cache: variants of the read-cache operation to use while in
+ *		     continuous read mode. Required if @set_cont_read is set
  *
  * Each SPI NAND manufacturer driver should have a spinand_info table
  * describing all the chips supported by the driver.
@@ -283,6 +287,8 @@ struct spinand_info {
 	} op_variants;
 	int (*select_target)(struct spinand_device *spinand,
 			     unsigned int target);
+	int (*set_cont_read)(struct spinand_device *spinand, bool enable);
+	const struct spinand_op_variants *cont_read_cache;
 };
 
 #define SPINAND_INFO_OP_VARIANTS(__read, __write, __update)		\
@@ -301,6 +307,10 @@ struct spinand_info {
 #define SPINAND_SELECT_TARGET(__func)					\
 	.select_target = __func,
 
+#define SPINAND_CONT_READ(__set_cont_read, __variants)			\
+	.set_cont_read = __set_cont_read,				\
+	.cont_read_cache = __variants,
+
 #define SPINAND_INFO(__model, __id, __memorg, __eccreq, __op_variants,	\
 		     __flags, ...)					\
 	{								\
@@ -313,6 +323,14 @@ struct spinand_info {
 		__VA_ARGS__						\
 	}
 
+/**
+ * struct spinand_dirmap - SPI NAND direct mapping
+ * @rdesc: direct mapping descriptor for the read from cache operation
+ */
+struct spinand_dirmap {
+	struct spi_mem_dirmap_desc *rdesc;
+};
+
 /**
  * struct spinand_device - SPI NAND device instance
  * @base: NAND device instance
@@ -324,13 +342,24 @@ struct spinand_info {
  * @op_templates.read_cache: read cache op template
  * @op_templates.write_cache: write cache op template
  * @op_templates.update_cache: update cache op template
+ * @op_templates.cont_read_cache: read cache op template used while the chip is
+ *				  in continuous read mode
+ * @dirmaps: direct mappings for read from cache, one per plane
+ * @cont_rdesc: direct mapping used for continuous reads, spanning a whole
+ *		eraseblock
  * @select_target: select a specific target/die. Usually called before sending
  *		   a command addressing a page or an eraseblock embedded in
  *		   this die. Only required if your chip exposes several dies
  * @cur_target: currently selected target/die
+ * @set_cont_read: enable/disable the continuous read mode of the chip. Only
+ *		   set if the chip supports sequential page reads where the
+ *		   next page is loaded into the cache while the current one is
+ *		   shifted out
+ * @cont_read_possible: continuous read can be used for multi-page reads
  * @eccinfo: on-die ECC information
  * @cfg_cache: config register cache. One entry per die
- * @databuf: bounce buffer for data
+ * @databuf: bounce buffer for data. Large enough to hold a whole eraseblock
+ *	     when continuous read is possible
  * @oobbuf: bounce buffer for OOB data
  * @scratchbuf: buffer used for everything but page accesses. This is needed
  *		because the spi-mem interface explicitly requests that buffers
@@ -354,12 +383,19 @@ struct spinand_device {
 		const struct spi_mem_op *read_cache;
 		const struct spi_mem_op *write_cache;
 		const struct spi_mem_op *update_cache;
+		const struct spi_mem_op *cont_read_cache;
 	} op_templates;
 
+	struct spinand_dirmap *dirmaps;
+	struct spi_mem_dirmap_desc *cont_rdesc;
+
 	int (*select_target)(struct spinand_device *spinand,
 			     unsigned int target);
 	unsigned int cur_target;
 
+	int (*set_cont_read)(struct spinand_device *spinand, bool enable);
+	bool cont_read_possible;
+
 	struct spinand_ecc_info eccinfo;
 
 	u8 *cfg_cache;
@@ -26,6 +26,10 @@
 #ifndef MEMDUMP_H
 #define MEMDUMP_H
 
+#include <linux/bitops.h>
+#include <linux/sizes.h>
+#include <linux/types.h>
+
 #define ENABLE_USERDATA_MEMDUMP 1
 #define	RAMDUMP_USERDATA_STORAGE "mmc"
 #define	RAMDUMP_MMC_DEVICE_NUM	"0"
@@ -45,6 +49,73 @@
 		(UNRESERVED_MEMORY_END - UNRESERVED_MEMORY_START)
 #define MMC_SDMA_HIGEST_ADDR     (0x1000000000UL)
 
+/*
+ * Streamed ramdump format (CONFIG_MEMDUMP_STREAM), all fields little endian:
+ *
+ *   struct memdump_stream_hdr, padded to 'align'
+ *   { struct memdump_chunk_hdr, payload, padded to 'align' } ...
+ *   struct memdump_chunk_hdr with MEMDUMP_CHUNK_F_END
+ *
+ * Each chunk covers up to MEMDUMP_CHUNK_SIZE bytes of one bank. Its bitmap has
+ * one bit per page, set if the page is part of the payload. Pages with a clear
+ * bit are either all zeroes or inside one of the header skip ranges, and
+ * chunks without any such page are not emitted at all. The payload is the
+ * concatenation of the present pages, raw-deflated when MEMDUMP_CHUNK_F_DEFLATE
+ * is set. Every chunk is self-contained.
+ */
+#define MEMDUMP_STREAM_MAGIC	0x504d4448	/* "HDMP" */
+#define MEMDUMP_CHUNK_MAGIC	0x4b4e4843	/* "CHNK" */
+#define MEMDUMP_STREAM_VERSION	1
+
+#define MEMDUMP_PAGE_SIZE	SZ_4K
+#define MEMDUMP_CHUNK_SIZE	SZ_1M
+#define MEMDUMP_CHUNK_PAGES	(MEMDUMP_CHUNK_SIZE / MEMDUMP_PAGE_SIZE)
+#define MEMDUMP_MAX_BANKS	16
+#define MEMDUMP_MAX_SKIP	2
+
+#define MEMDUMP_CODEC_NONE	0
+#define MEMDUMP_CODEC_DEFLATE	1
+
+#define MEMDUMP_CHUNK_F_DEFLATE	BIT(0)
+/* Memory changed while streaming, the payload is zero filled and invalid */
+#define MEMDUMP_CHUNK_F_LOST	BIT(1)
+#define MEMDUMP_CHUNK_F_END	BIT(15)
+
+struct memdump_stream_range {
+	__le64 start;
+	__le64 size;
+};
+
+struct memdump_stream_hdr {
+	__le32 magic;
+	__le16 version;
+	__le16 codec;
+	__le32 page_size;
+	__le32 chunk_size;
+	__le32 align;
+	__le32 nr_banks;
+	/* Length of the whole stream, 0 if the dump did not complete */
+	__le64 total_size;
+	__le64 raw_size;
+	struct memdump_stream_range banks[MEMDUMP_MAX_BANKS];
+	/* Memory that was not dumped, e.g. what U-Boot itself runs from */
+	struct memdump_stream_range skip[MEMDUMP_MAX_SKIP];
+} __packed;
+
+struct memdump_chunk_hdr {
+	__le32 magic;
+	__le16 bank;
+	__le16 flags;
+	__le64 offset;
+	__le32 raw_len;
+	__le32 data_len;
+	u8 bitmap[MEMDUMP_CHUNK_PAGES / 8];
+} __packed;
+
+int memdump_stream_prepare(u64 *total);
+int memdump_stream_read(void *buf, size_t len);
+void memdump_stream_close(void);
+
 int memdump_dump_blk_offset(char *intf, int dev, unsigned long dump_start);
 int memdump_dump_blk(char *intf, int dev, char *partition);
 int memdump_dump_ext4(char *intf, int dev, int part, char *directory);
@@ -162,6 +162,28 @@ void *os_realloc(void *ptr, size_t length);
  */
 void os_usleep(unsigned long usec);
 
+/**
+ * os_thread_create() - start a host thread
+ *
+ * @func:	function to run in the thread
+ * @arg:	argument for @func
+ * Return:	thread handle, or NULL on error
+ */
+void *os_thread_create(void (*func)(void *arg), void *arg);
+
+/**
+ * os_thread_join() - wait for a host thread to finish
+ *
+ * @thread:	handle returned by os_thread_create()
+ * Return:	0 for success
+ */
+int os_thread_join(void *thread);
+
+/**
+ * os_thread_yield() - let other host threads run
+ */
+void os_thread_yield(void);
+
 /**
  * Gets a monotonic increasing number of nano seconds from the OS
  *
@@ -541,6 +541,55 @@ int layout_mbr_partitions(struct disk_partition *p, int count,
 
 #endif
 
+/**
+ * struct part_cache_stats - Use of the partition table cache of a device
+ *
+ * @entries:	Number of partitions in the cache
+ * @hits:	Lookups answered from the cache
+ * @reads_saved: Partition table reads which these lookups did not need
+ */
+struct part_cache_stats {
+	int entries;
+	ulong hits;
+	ulong reads_saved;
+};
+
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+/**
+ * part_cache_invalidate() - Drop the cached partition table of a device
+ *
+ * @desc:	Block device
+ */
+void part_cache_invalidate(struct blk_desc *desc);
+
+/**
+ * part_cache_write() - Drop the cached partition table if a write changes it
+ *
+ * @desc:	Block device written to
+ * @start:	First block written
+ * @blkcnt:	Number of blocks written
+ */
+void part_cache_write(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt);
+
+/**
+ * part_cache_get_stats() - Get the use of the partition table cache
+ *
+ * @desc:	Block device
+ * @stats:	Returns the statistics
+ * Return: 0 if OK, -ENOENT if the device has no cached partition table
+ */
+int part_cache_get_stats(struct blk_desc *desc, struct part_cache_stats *stats);
+#else
+static inline void part_cache_invalidate(struct blk_desc *desc) {}
+static inline void part_cache_write(struct blk_desc *desc, lbaint_t start,
+				    lbaint_t blkcnt) {}
+static inline int part_cache_get_stats(struct blk_desc *desc,
+				       struct part_cache_stats *stats)
+{
+	return -ENOENT;
+}
+#endif
+
 #if CONFIG_IS_ENABLED(PARTITIONS)
 /**
  * part_driver_get_count() - get partition driver count
@@ -8,6 +8,7 @@
 
 #include <search.h>
 #include <tee/optee_ta_avb.h>
+#include <tee/optee_ta_efuse.h>
 
 /**
  * struct sandbox_tee_state - internal state of the sandbox TEE
@@ -16,7 +17,11 @@
  * @ta:				Trusted Application of current session
  * @ta_avb_rollback_indexes	TA avb rollback indexes storage
  * @ta_avb_lock_state		TA avb lock state storage
+ * @ta_avb_no_read_state	TA avb without TA_AVB_CMD_READ_STATE
+ * @ta_avb_invokes		number of TA avb function invocations
  * @pstorage_htab		named persistent values storage
+ * @pta_efuse			PTA efuse array storage
+ * @pta_efuse_reads		number of PTA efuse read requests
  */
 struct sandbox_tee_state {
 	u32 session;
@@ -24,7 +29,11 @@ struct sandbox_tee_state {
 	void *ta;
 	u64 ta_avb_rollback_indexes[TA_AVB_MAX_ROLLBACK_LOCATIONS];
 	u32 ta_avb_lock_state;
+	bool ta_avb_no_read_state;
+	u32 ta_avb_invokes;
 	struct hsearch_data pstorage_htab;
+	u8 pta_efuse[PTA_EFUSE_SIZE];
+	u32 pta_efuse_reads;
 };
 
 #endif /*__SANDBOXTEE_H*/
@@ -285,6 +285,23 @@ struct sdhci_ops {
 	 * Return: 0 if successful, -ve on error
 	 */
 	int	(*set_enhanced_strobe)(struct sdhci_host *host);
+
+	/**
+	 * adma_write_desc() - Write ADMA descriptor(s) for one buffer
+	 *
+	 * Controllers with restrictions on where a single descriptor may
+	 * point, such as not crossing an address boundary, can use this to
+	 * split the buffer over several descriptors written with
+	 * sdhci_adma_write_desc().
+	 *
+	 * @host: SDHCI host structure
+	 * @desc: Next free descriptor, advanced past the ones written
+	 * @addr: DMA address of the buffer
+	 * @len: Length of the buffer, at most ADMA_MAX_LEN
+	 * @end: True if this is the last buffer of the transfer
+	 */
+	void	(*adma_write_desc)(struct sdhci_host *host, void **desc,
+				   dma_addr_t addr, int len, bool end);
 };
 
 #define ADMA_MAX_LEN	65532
@@ -293,8 +310,9 @@ struct sdhci_ops {
 #else
 #define ADMA_DESC_LEN	8
 #endif
-#define ADMA_TABLE_NO_ENTRIES (CONFIG_SYS_MMC_MAX_BLK_COUNT * \
-			       MMC_MAX_BLOCK_LEN) / ADMA_MAX_LEN
+/* One spare entry for a controller splitting a buffer at a boundary */
+#define ADMA_TABLE_NO_ENTRIES (DIV_ROUND_UP(CONFIG_SYS_MMC_MAX_BLK_COUNT * \
+			       MMC_MAX_BLOCK_LEN, ADMA_MAX_LEN) + 1)
 
 #define ADMA_TABLE_SZ (ADMA_TABLE_NO_ENTRIES * ADMA_DESC_LEN)
 
@@ -521,7 +539,9 @@ extern const struct dm_mmc_ops sdhci_ops;
 #endif
 
 struct sdhci_adma_desc *sdhci_adma_init(void);
-void sdhci_prepare_adma_table(struct sdhci_adma_desc *table,
+void sdhci_adma_write_desc(void **desc, dma_addr_t addr, int len, bool end);
+void sdhci_prepare_adma_table(struct sdhci_host *host,
+			      struct sdhci_adma_desc *table,
 			      struct mmc_data *data, dma_addr_t addr);
 
 #endif /* __SDHCI_HW_H */
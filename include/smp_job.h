@@ -0,0 +1,203 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Run a loop across all CPUs
+ *
+ * smp_job_run() hands the iterations of a loop out to the boot CPU and to
+ * the secondary CPUs, then waits for all of them to finish. Each secondary
+ * CPU has its own mailbox, on its own cache line, through which the boot
+ * CPU posts commands; the iterations themselves are claimed from a shared
+ * counter so that uneven jobs still balance.
+ *
+ * Job functions run concurrently with each other. They must only touch
+ * their own slice of the context, must not call printf(), malloc() or
+ * driver code, and must not rely on the timer or the watchdog. The boot
+ * CPU keeps the watchdog alive while it waits, but gives up with a panic
+ * if a secondary CPU is still busy seconds after the boot CPU is done.
+ */
+
+#ifndef __SMP_JOB_H
+#define __SMP_JOB_H
+
+#include <asm/cache.h>
+#include <linux/errno.h>
+#include <linux/types.h>
+
+/**
+ * typedef smp_job_func_t - Job function
+ *
+ * @ctx: Context passed to smp_job_run()
+ * @idx: Iteration to run, 0 to count - 1
+ */
+typedef void (*smp_job_func_t)(void *ctx, uint idx);
+
+/**
+ * struct smp_job_cpu - A secondary CPU and its mailbox
+ *
+ * The first members are written by the boot CPU, the last one by the
+ * secondary CPU. Keep the struct cache-line aligned so that mailboxes do
+ * not share lines.
+ *
+ * @index: CPU number, 1 for the first secondary CPU
+ * @arch: Data private to the arch backend
+ * @cmd: Command to run on the next @seq update (enum smp_job_cmd)
+ * @seq: Command sequence number, bumped to post @cmd
+ * @ack: Last @seq completed by the CPU, or ~0 once it is online
+ */
+struct smp_job_cpu {
+	uint index;
+	void *arch;
+	u32 cmd;
+	u32 seq;
+	u32 ack __aligned(ARCH_DMA_MINALIGN);
+} __aligned(ARCH_DMA_MINALIGN);
+
+/**
+ * enum smp_job_cmd - Mailbox commands
+ *
+ * @SMP_JOB_CMD_RUN: Help running the current job
+ * @SMP_JOB_CMD_PARK: Leave smp_job_worker() so the CPU can be turned off
+ */
+enum smp_job_cmd {
+	SMP_JOB_CMD_RUN,
+	SMP_JOB_CMD_PARK,
+};
+
+#if CONFIG_IS_ENABLED(SMP_JOB)
+
+/**
+ * smp_job_run() - Run @func for each of @count iterations
+ *
+ * Secondary CPUs are started on first use. When none are available, or
+ * when called from within a job, the iterations simply run in order on
+ * the calling CPU.
+ *
+ * @func: Job function
+ * @ctx: Context for @func
+ * @count: Number of iterations
+ */
+void smp_job_run(smp_job_func_t func, void *ctx, uint count);
+
+/**
+ * smp_job_queue() - Start running @func on the secondary CPUs
+ *
+ * Unlike smp_job_run(), this returns straight away so that the boot CPU
+ * can carry on, e.g. reading the data the job works on. The job must then
+ * be completed with smp_job_flush(), which also runs the iterations no
+ * secondary CPU has picked up yet. Until then, smp_job_run() runs its
+ * iterations on the calling CPU.
+ *
+ * @func: Job function
+ * @ctx: Context for @func
+ * @count: Number of iterations
+ * Return: 0 if OK, -EBUSY if called from a job or with a job queued
+ */
+int smp_job_queue(smp_job_func_t func, void *ctx, uint count);
+
+/**
+ * smp_job_flush() - Complete the job started by smp_job_queue()
+ *
+ * Returns once all iterations have run. Does nothing if no job is queued.
+ */
+void smp_job_flush(void);
+
+/**
+ * smp_job_nr_cpus() - Get the number of CPUs which run jobs
+ *
+ * This starts the secondary CPUs if needed, so callers can size their
+ * work, e.g. split a buffer into one chunk per CPU.
+ *
+ * Return: number of CPUs, including the boot CPU
+ */
+uint smp_job_nr_cpus(void);
+
+/**
+ * smp_job_park() - Turn the secondary CPUs off
+ *
+ * This must be called on every path which leaves U-Boot (bootm, go,
+ * bootelf, UEFI ExitBootServices()), as the OS or application expects to
+ * start the secondary CPUs itself. A job still queued is flushed first. A
+ * later smp_job_run() starts the CPUs again.
+ *
+ * It must also be called before changing the translation tables, as TLB
+ * maintenance in U-Boot only covers the calling CPU. The arch entry points
+ * which do so (mmu_set_region_dcache_behaviour(), mmu_change_region_attr(),
+ * mem_map_set_dcache() and hence the non-cached pools) park the CPUs
+ * themselves.
+ */
+void smp_job_park(void);
+
+/**
+ * smp_job_worker() - Main loop of a secondary CPU
+ *
+ * Called by the arch backend on the secondary CPU once it can run C code
+ * with caches enabled. Returns when the CPU is parked.
+ *
+ * @cpu: Mailbox of this CPU
+ */
+void smp_job_worker(struct smp_job_cpu *cpu);
+
+/* Arch backend */
+
+/**
+ * arch_smp_job_cpu_on() - Start a secondary CPU
+ *
+ * The CPU must call smp_job_worker(@cpu) and turn itself off when that
+ * returns.
+ *
+ * @cpu: Mailbox of the CPU, with @cpu->index set
+ * Return: 0 if OK, -ve on error (the CPU is then not used)
+ */
+int arch_smp_job_cpu_on(struct smp_job_cpu *cpu);
+
+/**
+ * arch_smp_job_cpu_off() - Wait for a parked secondary CPU to be off
+ *
+ * @cpu: Mailbox of the CPU
+ * Return: 0 if OK, -ve on error
+ */
+int arch_smp_job_cpu_off(struct smp_job_cpu *cpu);
+
+/**
+ * arch_smp_job_wait() - Wait for an event from the boot CPU
+ *
+ * Only secondary CPUs wait here; the boot CPU polls so that it can time
+ * out. This may return spuriously.
+ */
+void arch_smp_job_wait(void);
+
+/**
+ * arch_smp_job_notify() - Wake up CPUs in arch_smp_job_wait()
+ */
+void arch_smp_job_notify(void);
+
+#else
+
+static inline void smp_job_run(smp_job_func_t func, void *ctx, uint count)
+{
+	uint i;
+
+	for (i = 0; i < count; i++)
+		func(ctx, i);
+}
+
+static inline int smp_job_queue(smp_job_func_t func, void *ctx, uint count)
+{
+	return -ENOSYS;
+}
+
+static inline void smp_job_flush(void)
+{
+}
+
+static inline uint smp_job_nr_cpus(void)
+{
+	return 1;
+}
+
+static inline void smp_job_park(void)
+{
+}
+
+#endif
+
+#endif
@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright(C) 2024, D-Robotics Co., Ltd. All rights reserved
+ */
+#ifndef __TEE_EFUSE_SHADOW_H
+#define __TEE_EFUSE_SHADOW_H
+
+#include <linux/errno.h>
+#include <linux/types.h>
+
+#ifdef CONFIG_TEE_EFUSE_SHADOW
+/**
+ * efuse_shadow_read() - Read efuse bytes through the efuse PTA
+ *
+ * The first call opens a session to the PTA and reads all readable regions
+ * into a RAM mirror, later reads within those regions are served from it.
+ * Anything else is passed on to the PTA, which may deny it.
+ *
+ * @offset:	Byte offset into the efuse array
+ * @size:	Number of bytes to read
+ * @buf:	Buffer for the bytes read
+ * Return: 0 if OK, -ve on error, or the TEE_ERROR_... code of the PTA
+ */
+int efuse_shadow_read(u32 offset, u32 size, void *buf);
+
+/**
+ * efuse_shadow_write() - Burn an efuse word through the efuse PTA
+ *
+ * The mirror is dropped whether or not the write succeeds, the next read
+ * reloads it.
+ *
+ * @offset:	Byte offset of the word in the efuse array
+ * @value:	Bits to burn
+ * Return: 0 if OK, -ve on error, or the TEE_ERROR_... code of the PTA
+ */
+int efuse_shadow_write(u32 offset, u32 value);
+
+/**
+ * efuse_shadow_invalidate() - Drop the mirror, keeping the session
+ */
+void efuse_shadow_invalidate(void);
+
+/**
+ * efuse_shadow_release() - Drop the mirror and close the session
+ *
+ * Must be called before the TEE device goes away, e.g. before booting an OS.
+ */
+void efuse_shadow_release(void);
+#else
+static inline int efuse_shadow_read(u32 offset, u32 size, void *buf)
+{
+	return -ENOSYS;
+}
+
+static inline int efuse_shadow_write(u32 offset, u32 value)
+{
+	return -ENOSYS;
+}
+
+static inline void efuse_shadow_invalidate(void) {}
+static inline void efuse_shadow_release(void) {}
+#endif
+
+#endif /* __TEE_EFUSE_SHADOW_H */
@@ -61,4 +61,22 @@
  */
 #define TA_AVB_CMD_WRITE_PERSIST_VALUE	5
 
+/*
+ * Gets the lock state and all rollback indexes in one call.
+ *
+ * This is not part of the AVB TA of upstream OP-TEE (ta/avb in optee_os),
+ * which only has commands 0 to 5. It needs the TA to be extended with a
+ * handler reading the lock state and rollback index objects from secure
+ * storage into the buffer below. TAs without this command return an
+ * error, callers then fall back to TA_AVB_CMD_READ_LOCK_STATE and
+ * TA_AVB_CMD_READ_ROLLBACK_INDEX.
+ *
+ * out	params[0].u.memref:	TA_AVB_STATE_SIZE bytes, the lock state as
+ *				a u64 followed by the u64 rollback index of
+ *				each slot
+ */
+#define TA_AVB_CMD_READ_STATE		6
+
+#define TA_AVB_STATE_SIZE	((1 + TA_AVB_MAX_ROLLBACK_LOCATIONS) * 8)
+
 #endif /* __TA_AVB_H */
@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright(C) 2024, D-Robotics Co., Ltd. All rights reserved
+ */
+#ifndef __TA_EFUSE_H
+#define __TA_EFUSE_H
+
+#define PTA_EFUSE_UUID { 0x16c83a2b, 0xaae3, 0x4542, \
+			{ 0x9d, 0xdd, 0x40, 0x46, 0x51, 0xe0, 0x1e, 0xa2 } }
+
+/* Size in bytes of the efuse array behind the PTA */
+#define PTA_EFUSE_SIZE		0x100
+
+/*
+ * Regions the normal world may read, as { offset, size } in bytes: the model
+ * and device IDs, the whole non-secure user region and banks 0 and 13 to 20
+ * of the secure user region. Reads of anything else are denied.
+ */
+#define PTA_EFUSE_READABLE	{ \
+	{ 0x00, 0x04 }, \
+	{ 0x14, 0x04 }, \
+	{ 0x50, 0x38 }, \
+	{ 0x88, 0x04 }, \
+	{ 0xbc, 0x20 }, \
+}
+
+/*
+ * Read efuse words
+ *
+ * in		params[0].a = byte offset
+ * out		params[1].memref = words read, its size is the byte count
+ */
+#define PTA_EFUSE_READ		0
+
+/*
+ * Burn an efuse word, bits which are already set stay set
+ *
+ * in		params[0].a = byte offset
+ * in		params[1].memref = word to burn, typed as an output memref
+ */
+#define PTA_EFUSE_WRITE		1
+
+#endif /* __TA_EFUSE_H */
@@ -20,6 +20,7 @@
  * @testdev: Test device
  * @force_fail_alloc: Force all memory allocs to fail
  * @skip_post_probe: Skip uclass post-probe processing
+ * @force_run: true to also run tests marked with UT_TESTF_MANUAL
  * @expect_str: Temporary string used to hold expected string value
  * @actual_str: Temporary string used to hold actual string value
  */
@@ -32,6 +33,7 @@ struct unit_test_state {
 	struct udevice *testdev;
 	int force_fail_alloc;
 	int skip_post_probe;
+	bool force_run;
 	char expect_str[512];
 	char actual_str[512];
 };
@@ -48,6 +50,8 @@ enum {
 	UT_TESTF_DM		= BIT(6),
 	/* live or flat device tree, but not both in the same executable */
 	UT_TESTF_LIVE_OR_FLAT	= BIT(4),
+	/* slow test such as a benchmark, only run with 'ut -f' */
+	UT_TESTF_MANUAL		= BIT(7),
 };
 
 /**
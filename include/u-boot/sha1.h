@@ -81,6 +81,26 @@ void sha1_csum(const unsigned char *input, unsigned int ilen,
 void sha1_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/**
+ * \brief	   SHA-1 process whole 64-byte blocks
+ *
+ * Architectures may override this with an accelerated version that falls
+ * back to sha1_process_generic() when the CPU lacks the extension.
+ *
+ * \param ctx	   SHA-1 context
+ * \param data	   buffer holding the data
+ * \param blocks   number of 64-byte blocks
+ */
+void sha1_process(sha1_context *ctx, const unsigned char *data,
+		  unsigned int blocks);
+void sha1_process_generic(sha1_context *ctx, const unsigned char *data,
+			  unsigned int blocks);
+
+/**
+ * \brief	   Name of the implementation sha1_process() uses on this CPU
+ */
+const char *sha1_backend_name(void);
+
 /**
  * \brief	   Output = HMAC-SHA-1( input buffer, hmac key )
  *
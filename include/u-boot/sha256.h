@@ -22,4 +22,17 @@ void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/*
+ * sha256_process() hashes whole 64-byte blocks. Architectures may override
+ * it with an accelerated version that falls back to the portable C code in
+ * sha256_process_generic() when the CPU lacks the required extension.
+ */
+void sha256_process(sha256_context *ctx, const unsigned char *data,
+		    unsigned int blocks);
+void sha256_process_generic(sha256_context *ctx, const unsigned char *data,
+			    unsigned int blocks);
+
+/* Name of the implementation sha256_process() uses on this CPU */
+const char *sha256_backend_name(void);
+
 #endif /* _SHA256_H */
@@ -7,6 +7,7 @@
 
 #include <common.h>
 #include <bootm.h>
+#include <deferred.h>
 #include <div64.h>
 #include <dm/device.h>
 #include <dm/root.h>
@@ -15,6 +16,7 @@
 #include <log.h>
 #include <malloc.h>
 #include <pe.h>
+#include <smp_job.h>
 #include <time.h>
 #include <u-boot/crc.h>
 #include <usb.h>
@@ -2170,6 +2172,11 @@ static efi_status_t EFIAPI efi_exit_boot_services(efi_handle_t image_handle,
 			list_del(&evt->link);
 	}
 
+	/* Nothing queued by board code may outlive U-Boot */
+	deferred_flush();
+	/* The OS brings up the secondary CPUs itself */
+	smp_job_park();
+
 	if (!efi_st_keep_devices) {
 		bootm_disable_interrupts();
 		if (IS_ENABLED(CONFIG_USB_DEVICE))
@@ -0,0 +1,580 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Decompress independent LZ4 blocks and zstd frames on all CPUs
+ *
+ * The boot CPU parses the stream into units and publishes them with a
+ * release store to @ready. Each CPU runs a lane which claims published
+ * units from @next until the stream is closed and all units are claimed.
+ * The output offset of a unit is known before it is decompressed: LZ4
+ * blocks are assumed to be full, and zstd frames carry their content size.
+ * This is checked once all units are done.
+ */
+
+#define LOG_CATEGORY	LOGC_BOOT
+
+#include <common.h>
+#include <frame_decomp.h>
+#include <image.h>
+#include <log.h>
+#include <malloc.h>
+#include <smp_job.h>
+#include <asm/unaligned.h>
+#include <linux/errno.h>
+#include <linux/sizes.h>
+#include <linux/zstd.h>
+#include <u-boot/crc.h>
+#include <u-boot/lz4.h>
+
+/* Units beyond one per 64 KiB of output, e.g. for small zstd frames */
+#define FRAME_DECOMP_EXTRA_UNITS	64
+
+/* Piece of the source checksummed by each iteration of the digest job */
+#define FRAME_DECOMP_DIGEST_CHUNK	SZ_256K
+
+#define LZ4F_SKIPPABLE_MAGIC		0x184d2a50
+#define LZ4F_SKIPPABLE_MASK		0xfffffff0
+#define LZ4F_BLOCKUNCOMPRESSED_FLAG	0x80000000U
+
+enum frame_decomp_kind {
+	FRAME_DECOMP_RAW,
+	FRAME_DECOMP_LZ4,
+	FRAME_DECOMP_ZSTD,
+};
+
+/**
+ * struct frame_decomp_unit - A block or frame which decompresses on its own
+ *
+ * @src: Compressed data
+ * @src_len: Length of @src
+ * @dst_off: Offset of the output in the destination buffer
+ * @dst_cap: Space available for the output
+ * @end_off: Where the output of the frame ends, if known and if this is the
+ *	last unit of a frame
+ * @kind: How to decompress it (enum frame_decomp_kind)
+ * @frame_end: This is the last unit of a frame
+ * @out_len: Decompressed length, set by the lane
+ * @ret: 0 if OK, -ve on error, set by the lane
+ */
+struct frame_decomp_unit {
+	const u8 *src;
+	size_t src_len;
+	size_t dst_off;
+	size_t dst_cap;
+	size_t end_off;
+	u8 kind;
+	bool frame_end;
+	size_t out_len;
+	int ret;
+};
+
+/* Last stream decompressed ahead of time, see frame_decomp_lookup() */
+static struct {
+	bool valid;
+	int comp;
+	size_t src_len;
+	u32 src_crc;
+	const void *dst;
+	size_t out_len;
+} frame_decomp_kept;
+
+struct frame_decomp_digest {
+	const u8 *src;
+	size_t src_len;
+	u32 *crcs;
+};
+
+static void frame_decomp_wait(void)
+{
+#if CONFIG_IS_ENABLED(SMP_JOB)
+	arch_smp_job_wait();
+#endif
+}
+
+static void frame_decomp_notify(void)
+{
+#if CONFIG_IS_ENABLED(SMP_JOB)
+	arch_smp_job_notify();
+#endif
+}
+
+static void frame_decomp_digest_chunk(void *ctx, uint idx)
+{
+	struct frame_decomp_digest *dg = ctx;
+	size_t off = (size_t)idx * FRAME_DECOMP_DIGEST_CHUNK;
+
+	dg->crcs[idx] = crc32(0, dg->src + off,
+			      min_t(size_t, dg->src_len - off,
+				    FRAME_DECOMP_DIGEST_CHUNK));
+}
+
+/*
+ * Checksum the compressed data on all CPUs, so that a kept result is only
+ * used for the very same data and not for whatever now sits at the same
+ * address.
+ */
+static int frame_decomp_digest(const void *src, size_t src_len, u32 *crc)
+{
+	struct frame_decomp_digest dg = { .src = src, .src_len = src_len };
+	uint count = DIV_ROUND_UP(src_len, FRAME_DECOMP_DIGEST_CHUNK);
+
+	dg.crcs = malloc(count * sizeof(*dg.crcs));
+	if (!dg.crcs)
+		return -ENOMEM;
+	smp_job_run(frame_decomp_digest_chunk, &dg, count);
+	*crc = crc32(src_len, (u8 *)dg.crcs, count * sizeof(*dg.crcs));
+	free(dg.crcs);
+
+	return 0;
+}
+
+static void frame_decomp_unit(struct frame_decomp *fd,
+			      struct frame_decomp_unit *unit, uint lane)
+{
+	u8 *dst = fd->dst + unit->dst_off;
+	int ret = 0;
+
+	switch (unit->kind) {
+	case FRAME_DECOMP_RAW:
+		memcpy(dst, unit->src, unit->src_len);
+		unit->out_len = unit->src_len;
+		break;
+#if CONFIG_IS_ENABLED(LZ4)
+	case FRAME_DECOMP_LZ4:
+		ret = LZ4_decompress_safe((const char *)unit->src, (char *)dst,
+					  unit->src_len, unit->dst_cap);
+		if (ret < 0) {
+			ret = -EPROTO;
+			break;
+		}
+		unit->out_len = ret;
+		ret = 0;
+		break;
+#endif
+#if CONFIG_IS_ENABLED(ZSTD)
+	case FRAME_DECOMP_ZSTD: {
+		ZSTD_DCtx *dctx;
+		size_t res;
+
+		dctx = ZSTD_initDCtx(fd->workspace[lane], fd->workspace_size);
+		if (!dctx) {
+			ret = -EPERM;
+			break;
+		}
+		res = ZSTD_decompressDCtx(dctx, dst, unit->dst_cap, unit->src,
+					  unit->src_len);
+		if (ZSTD_isError(res)) {
+			ret = -EPROTO;
+			break;
+		}
+		unit->out_len = res;
+		break;
+	}
+#endif
+	default:
+		ret = -EPROTONOSUPPORT;
+	}
+	unit->ret = ret;
+}
+
+static void frame_decomp_lane(void *ctx, uint lane)
+{
+	struct frame_decomp *fd = ctx;
+	uint idx, ready;
+	bool closed;
+
+	for (;;) {
+		/* Once closed, @ready does not change any more */
+		closed = __atomic_load_n(&fd->closed, __ATOMIC_ACQUIRE);
+		ready = __atomic_load_n(&fd->ready, __ATOMIC_ACQUIRE);
+		idx = __atomic_load_n(&fd->next, __ATOMIC_RELAXED);
+		if (idx < ready) {
+			if (__atomic_compare_exchange_n(&fd->next, &idx,
+							idx + 1, false,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				frame_decomp_unit(fd, &fd->units[idx], lane);
+			continue;
+		}
+		if (closed)
+			break;
+		frame_decomp_wait();
+	}
+}
+
+/* Add a unit whose data is all available, then hand it out */
+static int frame_decomp_add(struct frame_decomp *fd, enum frame_decomp_kind kind,
+			    const u8 *src, size_t src_len, size_t expect)
+{
+	struct frame_decomp_unit *unit;
+
+	if (fd->ready == fd->max_units)
+		return -E2BIG;
+	if (fd->dst_pos >= fd->dst_len ||
+	    (kind == FRAME_DECOMP_RAW && src_len > fd->dst_len - fd->dst_pos))
+		return -ENOBUFS;
+
+	unit = &fd->units[fd->ready];
+	unit->src = src;
+	unit->src_len = src_len;
+	unit->dst_off = fd->dst_pos;
+	unit->dst_cap = min(expect, fd->dst_len - fd->dst_pos);
+	unit->kind = kind;
+	fd->dst_pos += expect;
+
+	__atomic_store_n(&fd->ready, fd->ready + 1, __ATOMIC_RELEASE);
+	frame_decomp_notify();
+
+	return 0;
+}
+
+/* Mark the end of a frame whose output ends at @end_off, 0 if unknown */
+static int frame_decomp_end_frame(struct frame_decomp *fd, size_t start,
+				  size_t end_off)
+{
+	struct frame_decomp_unit *unit;
+
+	if (!fd->ready || fd->units[fd->ready - 1].dst_off < start ||
+	    fd->units[fd->ready - 1].frame_end) {
+		/* An empty frame */
+		return end_off && end_off != start ? -EINVAL : 0;
+	}
+
+	unit = &fd->units[fd->ready - 1];
+	unit->end_off = end_off;
+	unit->frame_end = true;
+	if (end_off)
+		fd->dst_pos = end_off;
+	else
+		fd->open_ended = true;
+
+	return 0;
+}
+
+/* Parse the next LZ4 header or block: bytes used, 0 if incomplete */
+static int frame_decomp_lz4(struct frame_decomp *fd, const u8 *p, size_t left)
+{
+	u32 magic, header, size;
+	size_t len;
+	u8 flags, bd;
+	int ret;
+
+	if (left < sizeof(u32))
+		return 0;
+
+	if (!fd->in_frame) {
+		magic = get_unaligned_le32(p);
+		if ((magic & LZ4F_SKIPPABLE_MASK) == LZ4F_SKIPPABLE_MAGIC) {
+			if (left < 8)
+				return 0;
+			len = 8 + get_unaligned_le32(p + 4);
+			return left < len ? 0 : len;
+		}
+		if (magic != LZ4F_MAGIC || fd->open_ended)
+			return -EPROTONOSUPPORT;
+		if (left < 7)
+			return 0;
+
+		flags = p[4];
+		bd = p[5];
+		if ((flags >> 6) != 1 || !(flags & BIT(5)))
+			return -EPROTONOSUPPORT;	/* dependent blocks */
+		if ((flags & 0x03) || (bd & 0x8f))
+			return -EINVAL;
+		len = 7;
+		fd->content_size = 0;
+		if (flags & BIT(3)) {
+			len += sizeof(u64);
+			if (left < len)
+				return 0;
+			fd->content_size = get_unaligned_le64(p + 6);
+		}
+		if (((bd >> 4) & 7) < 4)
+			return -EINVAL;
+		fd->block_csum = flags & BIT(4);
+		fd->content_csum = flags & BIT(2);
+		fd->block_max = SZ_64K << (2 * (((bd >> 4) & 7) - 4));
+		fd->frame_start = fd->dst_pos;
+		fd->in_frame = true;
+
+		return len;
+	}
+
+	header = get_unaligned_le32(p);
+	size = header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+	if (!size) {
+		/* End mark */
+		len = sizeof(u32) + (fd->content_csum ? sizeof(u32) : 0);
+		if (left < len)
+			return 0;
+		ret = frame_decomp_end_frame(fd, fd->frame_start,
+					     fd->content_size ?
+					     fd->frame_start + fd->content_size :
+					     0);
+		if (ret)
+			return ret;
+		fd->in_frame = false;
+
+		return len;
+	}
+
+	if (size > fd->block_max)
+		return -EINVAL;
+	len = sizeof(u32) + size + (fd->block_csum ? sizeof(u32) : 0);
+	if (left < len)
+		return 0;
+
+	if (header & LZ4F_BLOCKUNCOMPRESSED_FLAG)
+		ret = frame_decomp_add(fd, FRAME_DECOMP_RAW, p + sizeof(u32),
+				       size, size);
+	else
+		ret = frame_decomp_add(fd, FRAME_DECOMP_LZ4, p + sizeof(u32),
+				       size, fd->block_max);
+
+	return ret ? ret : len;
+}
+
+/* Parse the next zstd frame: bytes used, 0 if incomplete */
+static int frame_decomp_zstd(struct frame_decomp *fd, const u8 *p, size_t left)
+{
+#if CONFIG_IS_ENABLED(ZSTD)
+	ZSTD_frameParams params;
+	size_t res, len;
+	int ret;
+
+	res = ZSTD_getFrameParams(&params, p, left);
+	if (ZSTD_isError(res))
+		return -EPROTONOSUPPORT;
+	if (res)
+		return 0;
+
+	/* Skippable frame */
+	if (!params.windowSize) {
+		len = ZSTD_skippableHeaderSize + params.frameContentSize;
+		return left < len ? 0 : len;
+	}
+
+	res = ZSTD_findFrameCompressedSize(p, left);
+	if (ZSTD_isError(res))
+		return ZSTD_getErrorCode(res) == ZSTD_error_srcSize_wrong ?
+			0 : -EINVAL;
+	if (fd->open_ended)
+		return -EPROTONOSUPPORT;
+
+	/* Without a content size, this must be the last frame */
+	if (params.frameContentSize) {
+		if (params.frameContentSize > fd->dst_len - fd->dst_pos)
+			return -ENOBUFS;
+		len = params.frameContentSize;
+	} else {
+		len = fd->dst_len - fd->dst_pos;
+	}
+
+	ret = frame_decomp_add(fd, FRAME_DECOMP_ZSTD, p, res, len);
+	if (!ret)
+		ret = frame_decomp_end_frame(fd, fd->units[fd->ready - 1].dst_off,
+					     params.frameContentSize ?
+					     fd->units[fd->ready - 1].dst_off +
+					     params.frameContentSize : 0);
+
+	return ret ? ret : res;
+#else
+	return -EPROTONOSUPPORT;
+#endif
+}
+
+static void frame_decomp_free(struct frame_decomp *fd)
+{
+	uint i;
+
+	for (i = 0; fd->workspace && i < fd->nr_lanes; i++)
+		free(fd->workspace[i]);
+	free(fd->workspace);
+	free(fd->units);
+	fd->workspace = NULL;
+	fd->units = NULL;
+}
+
+int frame_decomp_start(struct frame_decomp *fd, int comp, const void *src,
+		       size_t src_len, void *dst, size_t dst_len, uint flags)
+{
+	uint i;
+
+	memset(fd, '\0', sizeof(*fd));
+	if (!(comp == IH_COMP_LZ4 && CONFIG_IS_ENABLED(LZ4)) &&
+	    !(comp == IH_COMP_ZSTD && CONFIG_IS_ENABLED(ZSTD)))
+		return -EPROTONOSUPPORT;
+
+	/* Units are decompressed out of order */
+	if ((ulong)dst < (ulong)src + src_len && (ulong)src < (ulong)dst + dst_len)
+		return -EPROTONOSUPPORT;
+
+	/* A new stream replaces the result kept from the previous one */
+	if (flags & FRAME_DECOMP_KEEP)
+		memset(&frame_decomp_kept, '\0', sizeof(frame_decomp_kept));
+
+	fd->comp = comp;
+	fd->flags = flags;
+	fd->src = src;
+	fd->src_len = src_len;
+	fd->dst = dst;
+	fd->dst_len = dst_len;
+	fd->max_units = dst_len / SZ_64K + FRAME_DECOMP_EXTRA_UNITS;
+	fd->units = calloc(fd->max_units, sizeof(*fd->units));
+	if (!fd->units)
+		return -ENOMEM;
+
+	fd->nr_lanes = smp_job_nr_cpus();
+#if CONFIG_IS_ENABLED(ZSTD)
+	if (comp == IH_COMP_ZSTD) {
+		/* Lanes must not allocate memory */
+		fd->workspace_size = ZSTD_DCtxWorkspaceBound();
+		fd->workspace = calloc(fd->nr_lanes, sizeof(void *));
+		for (i = 0; fd->workspace && i < fd->nr_lanes; i++) {
+			fd->workspace[i] = malloc(fd->workspace_size);
+			if (!fd->workspace[i])
+				break;
+		}
+		if (!fd->workspace || i < fd->nr_lanes) {
+			frame_decomp_free(fd);
+			return -ENOMEM;
+		}
+	}
+#endif
+
+	/* Otherwise, all lanes run in frame_decomp_finish() */
+	fd->queued = !smp_job_queue(frame_decomp_lane, fd, fd->nr_lanes);
+
+	return 0;
+}
+
+int frame_decomp_feed(struct frame_decomp *fd, size_t avail)
+{
+	int ret;
+
+	avail = min(avail, fd->src_len);
+	while (!fd->ret && fd->parsed < avail) {
+		if (fd->comp == IH_COMP_LZ4)
+			ret = frame_decomp_lz4(fd, fd->src + fd->parsed,
+					       avail - fd->parsed);
+		else
+			ret = frame_decomp_zstd(fd, fd->src + fd->parsed,
+						avail - fd->parsed);
+		if (ret < 0)
+			fd->ret = ret;
+		else if (!ret)
+			break;
+		else
+			fd->parsed += ret;
+	}
+
+	return fd->ret;
+}
+
+/* Check that the units were placed right and get the output length */
+static int frame_decomp_check(struct frame_decomp *fd, size_t *out_len)
+{
+	struct frame_decomp_unit *unit, *next;
+	size_t end = 0;
+	uint i;
+
+	for (i = 0; i < fd->ready; i++) {
+		unit = &fd->units[i];
+		if (unit->ret)
+			return unit->ret;
+		end = unit->dst_off + unit->out_len;
+		if (unit->frame_end) {
+			if (unit->end_off && end != unit->end_off)
+				return -EPROTONOSUPPORT;
+		} else if (i + 1 < fd->ready) {
+			next = &fd->units[i + 1];
+			if (end != next->dst_off)
+				return -EPROTONOSUPPORT;
+		}
+	}
+	*out_len = fd->open_ended ? end : fd->dst_pos;
+
+	return 0;
+}
+
+int frame_decomp_finish(struct frame_decomp *fd, size_t *out_len)
+{
+	size_t len = 0;
+	int ret;
+
+	frame_decomp_feed(fd, fd->src_len);
+	if (!fd->ret && (fd->in_frame || fd->parsed != fd->src_len))
+		fd->ret = -EINVAL;	/* truncated */
+
+	__atomic_store_n(&fd->closed, true, __ATOMIC_RELEASE);
+	frame_decomp_notify();
+	if (fd->queued)
+		smp_job_flush();
+	else
+		smp_job_run(frame_decomp_lane, fd, fd->nr_lanes);
+
+	ret = fd->ret;
+	if (!ret)
+		ret = frame_decomp_check(fd, &len);
+	if (!ret && (fd->flags & FRAME_DECOMP_KEEP) &&
+	    !frame_decomp_digest(fd->src, fd->src_len,
+				 &frame_decomp_kept.src_crc)) {
+		frame_decomp_kept.comp = fd->comp;
+		frame_decomp_kept.src_len = fd->src_len;
+		frame_decomp_kept.dst = fd->dst;
+		frame_decomp_kept.out_len = len;
+		frame_decomp_kept.valid = true;
+	}
+	log_debug("%u units, %zu bytes: %d\n", fd->ready, len, ret);
+
+	frame_decomp_free(fd);
+	*out_len = len;
+
+	return ret;
+}
+
+void frame_decomp_abort(struct frame_decomp *fd)
+{
+	/* Units already published are dropped rather than decompressed */
+	__atomic_store_n(&fd->next, fd->ready, __ATOMIC_RELAXED);
+	__atomic_store_n(&fd->closed, true, __ATOMIC_RELEASE);
+	frame_decomp_notify();
+	if (fd->queued)
+		smp_job_flush();
+	log_debug("aborted after %u units\n", fd->ready);
+
+	frame_decomp_free(fd);
+	if (fd->flags & FRAME_DECOMP_KEEP)
+		memset(&frame_decomp_kept, '\0', sizeof(frame_decomp_kept));
+}
+
+int frame_decomp(int comp, const void *src, size_t src_len, void *dst,
+		 size_t *dst_len)
+{
+	struct frame_decomp fd;
+	int ret;
+
+	ret = frame_decomp_start(&fd, comp, src, src_len, dst, *dst_len, 0);
+	if (ret)
+		return ret;
+
+	return frame_decomp_finish(&fd, dst_len);
+}
+
+bool frame_decomp_lookup(int comp, const void *src, size_t src_len,
+			 const void *dst, size_t dst_len, size_t *out_len)
+{
+	bool found;
+	u32 crc;
+
+	found = frame_decomp_kept.valid && frame_decomp_kept.comp == comp &&
+		frame_decomp_kept.src_len == src_len &&
+		frame_decomp_kept.dst == dst &&
+		frame_decomp_kept.out_len <= dst_len &&
+		!frame_decomp_digest(src, src_len, &crc) &&
+		crc == frame_decomp_kept.src_crc;
+	if (found)
+		*out_len = frame_decomp_kept.out_len;
+	memset(&frame_decomp_kept, '\0', sizeof(frame_decomp_kept));
+
+	return found;
+}
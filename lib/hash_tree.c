@@ -0,0 +1,309 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Block hash trees, hashed on all CPUs
+ *
+ * The layout and padding rules follow avbtool, so that the root digest
+ * matches the one in AVB hashtree descriptors.
+ */
+
+#include <common.h>
+#include <div64.h>
+#include <hash_tree.h>
+#include <malloc.h>
+#include <smp_job.h>
+#include <watchdog.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/string.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <u-boot/sha512.h>
+
+/* Blocks hashed by one job iteration, to keep the shared counter cool */
+#define HASH_TREE_JOB_BLOCKS	32
+
+/* Blocks hashed between two watchdog resets */
+#define HASH_TREE_SEGMENT_BLOCKS	(HASH_TREE_JOB_BLOCKS * 128)
+
+typedef void (*hash_tree_func_t)(const struct hash_tree *tree,
+				 const void *data, uint len, u8 *digest);
+
+struct hash_tree_algo {
+	const char *name;
+	uint digest_size;
+	hash_tree_func_t hash;
+};
+
+static const u8 hash_tree_zeroes[256];
+
+/* Feed the zeroes padding a block of @len bytes */
+#define HASH_TREE_PAD(update, ctx, tree, len) do {			\
+	uint __left = (tree)->block_size - (len);			\
+	uint __chunk;							\
+									\
+	while (__left) {						\
+		__chunk = min_t(uint, __left, sizeof(hash_tree_zeroes)); \
+		update(ctx, hash_tree_zeroes, __chunk);			\
+		__left -= __chunk;					\
+	}								\
+} while (0)
+
+#if CONFIG_IS_ENABLED(SHA1)
+static void hash_tree_sha1(const struct hash_tree *tree, const void *data,
+			   uint len, u8 *digest)
+{
+	sha1_context ctx;
+
+	sha1_starts(&ctx);
+	if (tree->salt_len)
+		sha1_update(&ctx, tree->salt, tree->salt_len);
+	sha1_update(&ctx, data, len);
+	HASH_TREE_PAD(sha1_update, &ctx, tree, len);
+	sha1_finish(&ctx, digest);
+}
+#endif
+
+#if CONFIG_IS_ENABLED(SHA256)
+static void hash_tree_sha256(const struct hash_tree *tree, const void *data,
+			     uint len, u8 *digest)
+{
+	sha256_context ctx;
+
+	sha256_starts(&ctx);
+	if (tree->salt_len)
+		sha256_update(&ctx, tree->salt, tree->salt_len);
+	sha256_update(&ctx, data, len);
+	HASH_TREE_PAD(sha256_update, &ctx, tree, len);
+	sha256_finish(&ctx, digest);
+}
+#endif
+
+#if CONFIG_IS_ENABLED(SHA512)
+static void hash_tree_sha512(const struct hash_tree *tree, const void *data,
+			     uint len, u8 *digest)
+{
+	sha512_context ctx;
+
+	sha512_starts(&ctx);
+	if (tree->salt_len)
+		sha512_update(&ctx, tree->salt, tree->salt_len);
+	sha512_update(&ctx, data, len);
+	HASH_TREE_PAD(sha512_update, &ctx, tree, len);
+	sha512_finish(&ctx, digest);
+}
+#endif
+
+static const struct hash_tree_algo hash_tree_algos[] = {
+#if CONFIG_IS_ENABLED(SHA1)
+	{ "sha1", SHA1_SUM_LEN, hash_tree_sha1 },
+#endif
+#if CONFIG_IS_ENABLED(SHA256)
+	{ "sha256", SHA256_SUM_LEN, hash_tree_sha256 },
+#endif
+#if CONFIG_IS_ENABLED(SHA512)
+	{ "sha512", SHA512_SUM_LEN, hash_tree_sha512 },
+#endif
+};
+
+/* Look up the algorithm and check that the block size makes a tree */
+static const struct hash_tree_algo *hash_tree_algo(const struct hash_tree *tree)
+{
+	const struct hash_tree_algo *algo;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(hash_tree_algos); i++) {
+		algo = &hash_tree_algos[i];
+		if (strcmp(tree->algo, algo->name))
+			continue;
+		if (!is_power_of_2(tree->block_size) ||
+		    tree->block_size <= roundup_pow_of_two(algo->digest_size))
+			return NULL;
+
+		return algo;
+	}
+
+	return NULL;
+}
+
+int hash_tree_digest_size(const struct hash_tree *tree)
+{
+	const struct hash_tree_algo *algo = hash_tree_algo(tree);
+
+	return algo ? algo->digest_size : -EPROTONOSUPPORT;
+}
+
+int hash_tree_entry_size(const struct hash_tree *tree)
+{
+	const struct hash_tree_algo *algo = hash_tree_algo(tree);
+
+	return algo ? roundup_pow_of_two(algo->digest_size) : -EPROTONOSUPPORT;
+}
+
+int hash_tree_hash_block(const struct hash_tree *tree, const void *data,
+			 uint len, u8 *digest)
+{
+	const struct hash_tree_algo *algo = hash_tree_algo(tree);
+
+	if (!algo)
+		return -EPROTONOSUPPORT;
+	if (len > tree->block_size)
+		return -EINVAL;
+	algo->hash(tree, data, len, digest);
+
+	return 0;
+}
+
+u64 hash_tree_level_size(const struct hash_tree *tree, u64 len)
+{
+	int entry = hash_tree_entry_size(tree);
+
+	if (entry < 0)
+		return 0;
+
+	return ALIGN(DIV_ROUND_UP_ULL(len, tree->block_size) * entry,
+		     (u64)tree->block_size);
+}
+
+struct hash_tree_job {
+	const struct hash_tree *tree;
+	hash_tree_func_t hash;
+	const u8 *data;
+	u64 len;
+	u8 *out;
+	uint entry;
+	u64 first;
+	u64 nr_blocks;
+};
+
+static void hash_tree_job(void *ctx, uint idx)
+{
+	struct hash_tree_job *job = ctx;
+	const struct hash_tree *tree = job->tree;
+	u64 blk, end;
+	u64 offset;
+	uint len;
+
+	blk = job->first + (u64)idx * HASH_TREE_JOB_BLOCKS;
+	end = min_t(u64, blk + HASH_TREE_JOB_BLOCKS, job->nr_blocks);
+	for (; blk < end; blk++) {
+		offset = blk * tree->block_size;
+		len = min_t(u64, job->len - offset, tree->block_size);
+		job->hash(tree, job->data + offset, len,
+			  job->out + blk * job->entry);
+	}
+}
+
+int hash_tree_level(const struct hash_tree *tree, const void *data,
+		    u64 len, u8 *out)
+{
+	const struct hash_tree_algo *algo = hash_tree_algo(tree);
+	struct hash_tree_job job;
+	u64 count;
+	uint digest_size, i;
+
+	if (!algo)
+		return -EPROTONOSUPPORT;
+
+	digest_size = algo->digest_size;
+	job.tree = tree;
+	job.hash = algo->hash;
+	job.data = data;
+	job.len = len;
+	job.out = out;
+	job.entry = roundup_pow_of_two(digest_size);
+	job.nr_blocks = DIV_ROUND_UP_ULL(len, tree->block_size);
+
+	for (job.first = 0; job.first < job.nr_blocks;
+	     job.first += HASH_TREE_SEGMENT_BLOCKS) {
+		count = min_t(u64, job.nr_blocks - job.first,
+			      HASH_TREE_SEGMENT_BLOCKS);
+		count = DIV_ROUND_UP_ULL(count, HASH_TREE_JOB_BLOCKS);
+		if (tree->serial) {
+			for (i = 0; i < count; i++)
+				hash_tree_job(&job, i);
+		} else {
+			smp_job_run(hash_tree_job, &job, count);
+		}
+		WATCHDOG_RESET();
+	}
+
+	/* Clear the digest padding and the tail of the last block */
+	if (job.entry != digest_size) {
+		for (count = 0; count < job.nr_blocks; count++)
+			memset(out + count * job.entry + digest_size, '\0',
+			       job.entry - digest_size);
+	}
+	memset(out + job.nr_blocks * job.entry, '\0',
+	       hash_tree_level_size(tree, len) - job.nr_blocks * job.entry);
+
+	return 0;
+}
+
+int hash_tree_layout(const struct hash_tree *tree, u64 image_size,
+		     struct hash_tree_layout *layout)
+{
+	u64 size = image_size;
+	int n;
+
+	if (!hash_tree_algo(tree))
+		return -EPROTONOSUPPORT;
+
+	memset(layout, '\0', sizeof(*layout));
+	while (size > tree->block_size) {
+		if (layout->nr_levels == HASH_TREE_MAX_LEVELS)
+			return -E2BIG;
+		size = hash_tree_level_size(tree, size);
+		layout->size[layout->nr_levels++] = size;
+		layout->tree_size += size;
+	}
+
+	/* The top level comes first */
+	for (n = layout->nr_levels - 2; n >= 0; n--)
+		layout->offset[n] = layout->offset[n + 1] + layout->size[n + 1];
+
+	return 0;
+}
+
+int hash_tree_root(const struct hash_tree *tree, const void *data, u64 len,
+		   u8 *root)
+{
+	const struct hash_tree_algo *algo = hash_tree_algo(tree);
+	u8 *buf[2] = { NULL, NULL };
+	const u8 *src = data;
+	u64 size = len;
+	int ret = 0;
+	int level;
+
+	if (!algo)
+		return -EPROTONOSUPPORT;
+
+	/*
+	 * Each level is much smaller than the one below it, so two buffers
+	 * sized for the first two levels are enough to go up the tree
+	 */
+	for (level = 0; size > tree->block_size; level++) {
+		u8 **out = &buf[level & 1];
+		u64 out_size = hash_tree_level_size(tree, size);
+
+		if (!*out) {
+			*out = malloc(out_size);
+			if (!*out) {
+				ret = -ENOMEM;
+				goto out;
+			}
+		}
+		ret = hash_tree_level(tree, src, size, *out);
+		if (ret)
+			goto out;
+		src = *out;
+		size = out_size;
+	}
+	algo->hash(tree, src, size, root);
+
+out:
+	free(buf[0]);
+	free(buf[1]);
+
+	return ret;
+}
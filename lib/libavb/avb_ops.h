@@ -135,6 +135,21 @@ struct AvbOps {
                                          uint8_t** out_pointer,
                                          size_t* out_num_bytes_preloaded);
 
+  /* Gets the buffer |partition| would be preloaded to by
+   * |get_preloaded_partition|, without reading anything, and saves it
+   * to |out_pointer|. The buffer must be able to hold |num_bytes|.
+   *
+   * This is used by the streaming verification mode, which reads the
+   * partition into this buffer chunk by chunk and hashes every chunk
+   * as soon as it has been read. When this function pointer is not set
+   * (has value NULL), or when |out_pointer| is set to NULL as a result,
+   * the whole partition is loaded before it is hashed.
+   */
+  AvbIOResult (*get_preload_buffer)(AvbOps* ops,
+                                    const char* partition,
+                                    size_t num_bytes,
+                                    uint8_t** out_pointer);
+
   /* Writes |num_bytes| from |bffer| at offset |offset| to partition
    * with name |partition| (NUL-terminated UTF-8 string). If |offset|
    * is negative, its absolute value should be interpreted as the
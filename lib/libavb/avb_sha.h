@@ -21,6 +21,10 @@ extern "C" {
 #include "avb_crypto.h"
 #include "avb_sysdeps.h"
 
+#if CONFIG_IS_ENABLED(SHA256)
+#include <u-boot/sha256.h>
+#endif
+
 /* Block size in bytes of a SHA-256 digest. */
 #define AVB_SHA256_BLOCK_SIZE 64
 
@@ -29,6 +33,14 @@ extern "C" {
 #define AVB_SHA512_BLOCK_SIZE 128
 
 /* Data structure used for SHA-256. */
+#if CONFIG_IS_ENABLED(SHA256)
+/* Backed by U-Boot's SHA-256, which picks the fastest block function the
+ * CPU supports (e.g. ARMv8 Crypto Extensions). */
+typedef struct {
+  sha256_context uctx;
+  uint8_t buf[AVB_SHA256_DIGEST_SIZE]; /* Used for storing the final digest. */
+} AvbSHA256Ctx;
+#else
 typedef struct {
   uint32_t h[8];
   uint64_t tot_len;
@@ -36,6 +48,7 @@ typedef struct {
   uint8_t block[2 * AVB_SHA256_BLOCK_SIZE];
   uint8_t buf[AVB_SHA256_DIGEST_SIZE]; /* Used for storing the final digest. */
 } AvbSHA256Ctx;
+#endif
 
 /* Data structure used for SHA-512. */
 typedef struct {
@@ -10,6 +10,28 @@
 
 #include "avb_sha.h"
 
+#if CONFIG_IS_ENABLED(SHA256)
+void avb_sha256_init(AvbSHA256Ctx* ctx) {
+  sha256_starts(&ctx->uctx);
+}
+
+void avb_sha256_update(AvbSHA256Ctx* ctx, const uint8_t* data, size_t len) {
+  /* sha256_update() takes a 32-bit length. */
+  while (len) {
+    uint32_t chunk = len > CHUNKSZ_SHA256 ? CHUNKSZ_SHA256 : len;
+
+    sha256_update(&ctx->uctx, data, chunk);
+    data += chunk;
+    len -= chunk;
+  }
+}
+
+uint8_t* avb_sha256_final(AvbSHA256Ctx* ctx) {
+  sha256_finish(&ctx->uctx, ctx->buf);
+  return ctx->buf;
+}
+#else
+
 #define SHFR(x, n) (x >> n)
 #define ROTR(x, n) ((x >> n) | (x << ((sizeof(x) << 3) - n)))
 #define ROTL(x, n) ((x << n) | (x >> ((sizeof(x) << 3) - n)))
@@ -373,3 +395,4 @@ uint8_t* avb_sha256_final(AvbSHA256Ctx* ctx) {
 
   return ctx->buf;
 }
+#endif /* CONFIG_IS_ENABLED(SHA256) */
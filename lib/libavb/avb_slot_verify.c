@@ -16,6 +16,13 @@
 #include "avb_version.h"
 #include <log.h>
 #include <malloc.h>
+#ifdef CONFIG_AVB_VERIFY_STREAM
+#include <bootstage.h>
+#include <smp_job.h>
+#include <time.h>
+#include <vsprintf.h>
+#include <linux/kernel.h>
+#endif
 
 /* Maximum number of partitions that can be loaded with avb_slot_verify(). */
 #define MAX_NUMBER_OF_LOADED_PARTITIONS 32
@@ -258,6 +265,194 @@ static AvbSlotVerifyResult initialize_persistent_digest(
   return ret;
 }
 
+#ifdef CONFIG_AVB_VERIFY_STREAM
+/* Hash state shared by stream_hash_partition() and the CPU hashing. */
+typedef struct {
+  bool use_sha512;
+  AvbSHA256Ctx* sha256_ctx;
+  AvbSHA512Ctx* sha512_ctx;
+  const uint8_t* buf;
+  size_t hashed;
+  size_t avail;
+  bool closed;
+  bool queued;
+} StreamHash;
+
+/* Hashes everything up to |avail| which is not hashed yet. */
+static void stream_hash_update(StreamHash* sh, size_t avail) {
+  if (sh->hashed >= avail) {
+    return;
+  }
+  if (sh->use_sha512) {
+    avb_sha512_update(sh->sha512_ctx, sh->buf + sh->hashed,
+                      avail - sh->hashed);
+  } else {
+    avb_sha256_update(sh->sha256_ctx, sh->buf + sh->hashed,
+                      avail - sh->hashed);
+  }
+  sh->hashed = avail;
+}
+
+#if CONFIG_IS_ENABLED(SMP_JOB)
+/* Runs on a secondary CPU, hashing chunks as they are published. */
+static void stream_hash_job(void* ctx, uint idx) {
+  StreamHash* sh = ctx;
+  size_t avail;
+  bool closed;
+
+  for (;;) {
+    /* Once closed, |avail| does not change any more. */
+    closed = __atomic_load_n(&sh->closed, __ATOMIC_ACQUIRE);
+    avail = __atomic_load_n(&sh->avail, __ATOMIC_ACQUIRE);
+    if (sh->hashed < avail) {
+      stream_hash_update(sh, avail);
+    } else if (closed) {
+      break;
+    } else {
+      arch_smp_job_wait();
+    }
+  }
+}
+#endif
+
+/* Makes the first |avail| bytes available to the hash. */
+static void stream_hash_publish(StreamHash* sh, size_t avail) {
+#if CONFIG_IS_ENABLED(SMP_JOB)
+  if (sh->queued) {
+    __atomic_store_n(&sh->avail, avail, __ATOMIC_RELEASE);
+    arch_smp_job_notify();
+    return;
+  }
+#endif
+  stream_hash_update(sh, avail);
+}
+
+/* Waits until everything published is hashed. */
+static void stream_hash_close(StreamHash* sh) {
+#if CONFIG_IS_ENABLED(SMP_JOB)
+  if (sh->queued) {
+    __atomic_store_n(&sh->closed, true, __ATOMIC_RELEASE);
+    arch_smp_job_notify();
+    smp_job_flush();
+  }
+#endif
+}
+
+/* Reads |image_size| bytes of |part_name| into its preload buffer in
+ * CONFIG_AVB_VERIFY_STREAM_CHUNK sized chunks and hashes the first
+ * |size_to_hash| bytes behind the reads: with SMP_JOB, a secondary CPU
+ * hashes each chunk while the next one is read. Otherwise each chunk is
+ * hashed right after it is read, while it is still in the data cache.
+ *
+ * If the partition has no preload buffer, |*out_image_buf| is left as
+ * NULL and the caller falls back to load_full_partition().
+ */
+static AvbSlotVerifyResult stream_hash_partition(AvbOps* ops,
+                                                 const char* part_name,
+                                                 uint64_t image_size,
+                                                 size_t size_to_hash,
+                                                 const uint8_t* salt,
+                                                 size_t salt_len,
+                                                 bool use_sha512,
+                                                 AvbSHA256Ctx* sha256_ctx,
+                                                 AvbSHA512Ctx* sha512_ctx,
+                                                 uint8_t** out_image_buf,
+                                                 bool* out_image_preloaded) {
+  AvbSlotVerifyResult ret = AVB_SLOT_VERIFY_RESULT_OK;
+  StreamHash sh = {
+      .use_sha512 = use_sha512,
+      .sha256_ctx = sha256_ctx,
+      .sha512_ctx = sha512_ctx,
+  };
+  uint8_t* buf = NULL;
+  uint64_t offset = 0;
+  ulong read_us = 0, hash_us = 0, start;
+  size_t chunk, num_read;
+  char* stage_name;
+  AvbIOResult io_ret;
+
+  if (ops->get_preload_buffer == NULL) {
+    return AVB_SLOT_VERIFY_RESULT_OK;
+  }
+  if (image_size != (size_t)(image_size)) {
+    avb_errorv(part_name, ": Partition size too large to load.\n", NULL);
+    return AVB_SLOT_VERIFY_RESULT_ERROR_INVALID_METADATA;
+  }
+  io_ret = ops->get_preload_buffer(ops, part_name, image_size, &buf);
+  if (io_ret != AVB_IO_RESULT_OK || buf == NULL) {
+    return AVB_SLOT_VERIFY_RESULT_OK;
+  }
+
+  if (use_sha512) {
+    avb_sha512_init(sha512_ctx);
+    avb_sha512_update(sha512_ctx, salt, salt_len);
+  } else {
+    avb_sha256_init(sha256_ctx);
+    avb_sha256_update(sha256_ctx, salt, salt_len);
+  }
+  sh.buf = buf;
+#if CONFIG_IS_ENABLED(SMP_JOB)
+  sh.queued = smp_job_nr_cpus() > 1 &&
+              !smp_job_queue(stream_hash_job, &sh, 1);
+#endif
+
+  while (offset < image_size) {
+    chunk = min_t(uint64_t, image_size - offset,
+                  CONFIG_AVB_VERIFY_STREAM_CHUNK);
+
+    start = timer_get_us();
+    bootstage_start(BOOTSTAGE_ID_ACCUM_AVB_READ, "avb_read");
+    io_ret = ops->read_from_partition(
+        ops, part_name, offset, chunk, buf + offset, &num_read);
+    bootstage_accum(BOOTSTAGE_ID_ACCUM_AVB_READ);
+    read_us += timer_get_us() - start;
+    if (io_ret == AVB_IO_RESULT_ERROR_OOM) {
+      ret = AVB_SLOT_VERIFY_RESULT_ERROR_OOM;
+      break;
+    } else if (io_ret != AVB_IO_RESULT_OK) {
+      avb_errorv(part_name, ": Error loading data from partition.\n", NULL);
+      ret = AVB_SLOT_VERIFY_RESULT_ERROR_IO;
+      break;
+    }
+    if (num_read != chunk) {
+      avb_errorv(part_name, ": Read incorrect number of bytes.\n", NULL);
+      ret = AVB_SLOT_VERIFY_RESULT_ERROR_IO;
+      break;
+    }
+    offset += chunk;
+
+    /* When hashed here, this is all of the hashing time. */
+    start = timer_get_us();
+    bootstage_start(BOOTSTAGE_ID_ACCUM_AVB_HASH, "avb_hash");
+    stream_hash_publish(&sh, min_t(uint64_t, offset, size_to_hash));
+    bootstage_accum(BOOTSTAGE_ID_ACCUM_AVB_HASH);
+    hash_us += timer_get_us() - start;
+  }
+
+  /* Otherwise, only the hashing left after the last read is counted. */
+  start = timer_get_us();
+  bootstage_start(BOOTSTAGE_ID_ACCUM_AVB_HASH, "avb_hash");
+  stream_hash_close(&sh);
+  bootstage_accum(BOOTSTAGE_ID_ACCUM_AVB_HASH);
+  hash_us += timer_get_us() - start;
+  if (ret != AVB_SLOT_VERIFY_RESULT_OK) {
+    return ret;
+  }
+
+  avb_debugv(part_name, ": Streamed partition to preload buffer.\n", NULL);
+  stage_name = malloc(64);
+  if (stage_name != NULL) {
+    snprintf(stage_name, 64, "avb %s: read %luus hash %luus", part_name,
+             read_us, hash_us);
+    bootstage_mark_name(BOOTSTAGE_ID_ALLOC, stage_name);
+  }
+
+  *out_image_buf = buf;
+  *out_image_preloaded = true;
+  return AVB_SLOT_VERIFY_RESULT_OK;
+}
+#endif
+
 static AvbSlotVerifyResult load_and_verify_hash_partition(
     AvbOps* ops,
     const char* const* requested_partitions,
@@ -363,11 +558,6 @@ static AvbSlotVerifyResult load_and_verify_hash_partition(
     avb_debugv(part_name, ": Loading entire partition.\n", NULL);
   }
 
-  ret = load_full_partition(
-      ops, part_name, image_size, &image_buf, &image_preloaded);
-  if (ret != AVB_SLOT_VERIFY_RESULT_OK) {
-    goto out;
-  }
   // Although only one of the type might be used, we have to defined the
   // structure here so that they would live outside the 'if/else' scope to be
   // used later.
@@ -379,6 +569,44 @@ static AvbSlotVerifyResult load_and_verify_hash_partition(
   if (image_size_to_hash > image_size) {
     image_size_to_hash = image_size;
   }
+#ifdef CONFIG_AVB_VERIFY_STREAM
+  if (avb_strcmp((const char*)hash_desc.hash_algorithm, "sha256") == 0 ||
+      avb_strcmp((const char*)hash_desc.hash_algorithm, "sha512") == 0) {
+    bool use_sha512 =
+        avb_strcmp((const char*)hash_desc.hash_algorithm, "sha512") == 0;
+
+    ret = stream_hash_partition(ops,
+                                part_name,
+                                image_size,
+                                image_size_to_hash,
+                                desc_salt,
+                                hash_desc.salt_len,
+                                use_sha512,
+                                &sha256_ctx,
+                                &sha512_ctx,
+                                &image_buf,
+                                &image_preloaded);
+    if (ret != AVB_SLOT_VERIFY_RESULT_OK) {
+      goto out;
+    }
+  }
+  if (image_buf != NULL) {
+    if (avb_strcmp((const char*)hash_desc.hash_algorithm, "sha512") == 0) {
+      digest = avb_sha512_final(&sha512_ctx);
+      digest_len = AVB_SHA512_DIGEST_SIZE;
+    } else {
+      digest = avb_sha256_final(&sha256_ctx);
+      digest_len = AVB_SHA256_DIGEST_SIZE;
+    }
+    goto check_digest;
+  }
+#endif
+
+  ret = load_full_partition(
+      ops, part_name, image_size, &image_buf, &image_preloaded);
+  if (ret != AVB_SLOT_VERIFY_RESULT_OK) {
+    goto out;
+  }
   if (avb_strcmp((const char*)hash_desc.hash_algorithm, "sha256") == 0) {
     avb_sha256_init(&sha256_ctx);
     avb_sha256_update(&sha256_ctx, desc_salt, hash_desc.salt_len);
@@ -397,6 +625,9 @@ static AvbSlotVerifyResult load_and_verify_hash_partition(
     goto out;
   }
 
+#ifdef CONFIG_AVB_VERIFY_STREAM
+check_digest:
+#endif
   if (hash_desc.digest_len == 0) {
     /* Expect a match to a persistent digest. */
     avb_debugv(part_name, ": No digest, using persistent digest.\n", NULL);
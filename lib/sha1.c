@@ -221,16 +221,27 @@ static void __maybe_unused sha1_process_one(sha1_context *ctx, const unsigned ch
 	ctx->state[4] += E;
 }
 
+void sha1_process_generic(sha1_context *ctx, const unsigned char *data,
+			  unsigned int blocks)
+{
+	while (blocks--) {
+		sha1_process_one(ctx, data);
+		data += 64;
+	}
+}
+
 __weak void sha1_process(sha1_context *ctx, const unsigned char *data,
 			 unsigned int blocks)
 {
 	if (!blocks)
 		return;
 
-	while (blocks--) {
-		sha1_process_one(ctx, data);
-		data += 64;
-	}
+	sha1_process_generic(ctx, data, blocks);
+}
+
+__weak const char *sha1_backend_name(void)
+{
+	return "generic";
 }
 
 /*
@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Run a loop across all CPUs
+ *
+ * The boot CPU owns all state here except the @ack member of each
+ * mailbox. Publishing a command is a release store to the mailbox @seq,
+ * completing it a release store to @ack, so a job's results are visible
+ * to the boot CPU once smp_job_run() returns.
+ */
+
+#define LOG_CATEGORY LOGC_ARCH
+
+#include <common.h>
+#include <log.h>
+#include <malloc.h>
+#include <smp_job.h>
+#include <time.h>
+#include <watchdog.h>
+#include <asm/global_data.h>
+#include <linux/delay.h>
+#include <linux/errno.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* How long a secondary CPU may take to reach smp_job_worker() */
+#define SMP_JOB_ONLINE_TIMEOUT_MS	100
+
+/* How long a secondary CPU may take to finish its share of a command */
+#define SMP_JOB_DONE_TIMEOUT_MS		5000
+
+#define SMP_JOB_ONLINE		(~0U)
+
+static struct {
+	struct smp_job_cpu *cpus;
+	uint nr_cpus;
+	bool started;
+	bool busy;
+	bool queued;
+	u32 seq;
+
+	smp_job_func_t func;
+	void *ctx;
+	uint count;
+	uint next;
+} smp_job;
+
+/* Run iterations until none are left; only the boot CPU may pass @boot */
+static void smp_job_drain(bool boot)
+{
+	uint idx;
+
+	for (;;) {
+		idx = __atomic_fetch_add(&smp_job.next, 1, __ATOMIC_RELAXED);
+		if (idx >= smp_job.count)
+			break;
+		smp_job.func(smp_job.ctx, idx);
+		if (boot)
+			WATCHDOG_RESET();
+	}
+}
+
+void smp_job_worker(struct smp_job_cpu *cpu)
+{
+	u32 seen = 0;
+	u32 seq, cmd;
+
+	__atomic_store_n(&cpu->ack, SMP_JOB_ONLINE, __ATOMIC_RELEASE);
+	arch_smp_job_notify();
+
+	for (;;) {
+		seq = __atomic_load_n(&cpu->seq, __ATOMIC_ACQUIRE);
+		if (seq == seen) {
+			arch_smp_job_wait();
+			continue;
+		}
+		seen = seq;
+
+		/* The mailbox may be reused as soon as @ack is written */
+		cmd = cpu->cmd;
+		if (cmd == SMP_JOB_CMD_RUN)
+			smp_job_drain(false);
+
+		__atomic_store_n(&cpu->ack, seq, __ATOMIC_RELEASE);
+		arch_smp_job_notify();
+
+		if (cmd == SMP_JOB_CMD_PARK)
+			return;
+	}
+}
+
+/*
+ * Wait on the boot CPU for @cpu to acknowledge @ack. This polls rather than
+ * sleeping in arch_smp_job_wait(): nothing would wake the boot CPU up if
+ * the secondary CPU never answers.
+ */
+static int smp_job_wait_ack(struct smp_job_cpu *cpu, u32 ack, ulong timeout)
+{
+	ulong start = get_timer(0);
+
+	while (__atomic_load_n(&cpu->ack, __ATOMIC_ACQUIRE) != ack) {
+		if (get_timer(start) > timeout)
+			return -ETIMEDOUT;
+		WATCHDOG_RESET();
+		udelay(1);
+	}
+
+	return 0;
+}
+
+/* Post @cmd to every mailbox */
+static void smp_job_post(enum smp_job_cmd cmd)
+{
+	struct smp_job_cpu *cpu;
+	uint i;
+
+	smp_job.seq++;
+	if (!smp_job.seq || smp_job.seq == SMP_JOB_ONLINE)
+		smp_job.seq = 1;
+
+	for (i = 0; i < smp_job.nr_cpus; i++) {
+		cpu = &smp_job.cpus[i];
+		cpu->cmd = cmd;
+		__atomic_store_n(&cpu->seq, smp_job.seq, __ATOMIC_RELEASE);
+	}
+	arch_smp_job_notify();
+}
+
+/*
+ * Help with the posted job, then wait for all CPUs to complete it. A CPU
+ * which does not may still hold an iteration, so the job's results cannot
+ * be trusted and there is no way to carry on.
+ */
+static void smp_job_complete(void)
+{
+	struct smp_job_cpu *cpu;
+	uint i;
+	int ret;
+
+	smp_job_drain(true);
+
+	for (i = 0; i < smp_job.nr_cpus; i++) {
+		cpu = &smp_job.cpus[i];
+		ret = smp_job_wait_ack(cpu, smp_job.seq,
+				       SMP_JOB_DONE_TIMEOUT_MS);
+		if (ret)
+			panic("CPU %u: job not completed (err=%d)\n",
+			      cpu->index, ret);
+	}
+}
+
+static void smp_job_start(void)
+{
+	struct smp_job_cpu *cpu;
+	uint max = CONFIG_SMP_JOB_NR_CPUS - 1;
+	uint i;
+	int ret;
+
+	if (smp_job.started || !(gd->flags & GD_FLG_RELOC))
+		return;
+	smp_job.started = true;
+
+	if (!max)
+		return;
+
+	/*
+	 * The mailboxes are kept across smp_job_park(): a CPU which failed
+	 * to come online in time may still turn up and poll its mailbox.
+	 */
+	if (!smp_job.cpus) {
+		smp_job.cpus = memalign(ARCH_DMA_MINALIGN, max * sizeof(*cpu));
+		if (!smp_job.cpus)
+			return;
+		memset(smp_job.cpus, '\0', max * sizeof(*cpu));
+	}
+
+	/* CPUs are started one at a time so that mailboxes stay packed */
+	for (i = 0; i < max; i++) {
+		cpu = &smp_job.cpus[smp_job.nr_cpus];
+		cpu->index = smp_job.nr_cpus + 1;
+		cpu->seq = 0;
+		cpu->ack = 0;
+
+		ret = arch_smp_job_cpu_on(cpu);
+		if (!ret)
+			ret = smp_job_wait_ack(cpu, SMP_JOB_ONLINE,
+					       SMP_JOB_ONLINE_TIMEOUT_MS);
+		if (ret) {
+			log_warning("CPU %u: cannot start (err=%d)\n",
+				    cpu->index, ret);
+			break;
+		}
+		smp_job.nr_cpus++;
+	}
+	log_debug("%u secondary CPUs running\n", smp_job.nr_cpus);
+}
+
+void smp_job_run(smp_job_func_t func, void *ctx, uint count)
+{
+	uint i;
+
+	if (!count)
+		return;
+
+	if (!smp_job.busy)
+		smp_job_start();
+
+	if (smp_job.busy || !smp_job.nr_cpus || count == 1) {
+		for (i = 0; i < count; i++)
+			func(ctx, i);
+		return;
+	}
+
+	smp_job.busy = true;
+	smp_job.func = func;
+	smp_job.ctx = ctx;
+	smp_job.count = count;
+	smp_job.next = 0;
+	smp_job_post(SMP_JOB_CMD_RUN);
+	smp_job_complete();
+	smp_job.busy = false;
+}
+
+int smp_job_queue(smp_job_func_t func, void *ctx, uint count)
+{
+	if (smp_job.busy)
+		return -EBUSY;
+
+	smp_job_start();
+
+	/* Without secondary CPUs, everything runs in smp_job_flush() */
+	smp_job.busy = true;
+	smp_job.queued = true;
+	smp_job.func = func;
+	smp_job.ctx = ctx;
+	smp_job.count = count;
+	smp_job.next = 0;
+	if (smp_job.nr_cpus && count)
+		smp_job_post(SMP_JOB_CMD_RUN);
+
+	return 0;
+}
+
+void smp_job_flush(void)
+{
+	if (!smp_job.queued)
+		return;
+
+	if (smp_job.nr_cpus && smp_job.count)
+		smp_job_complete();
+	else
+		smp_job_drain(true);
+	smp_job.queued = false;
+	smp_job.busy = false;
+}
+
+uint smp_job_nr_cpus(void)
+{
+	smp_job_start();
+
+	return smp_job.nr_cpus + 1;
+}
+
+void smp_job_park(void)
+{
+	struct smp_job_cpu *cpu;
+	uint i;
+	int ret;
+
+	/* Nothing queued may keep running once U-Boot is left */
+	smp_job_flush();
+	if (!smp_job.started || smp_job.busy)
+		return;
+
+	if (smp_job.nr_cpus) {
+		smp_job_post(SMP_JOB_CMD_PARK);
+		for (i = 0; i < smp_job.nr_cpus; i++) {
+			cpu = &smp_job.cpus[i];
+			/* A CPU which does not answer is left where it is */
+			ret = smp_job_wait_ack(cpu, smp_job.seq,
+					       SMP_JOB_DONE_TIMEOUT_MS);
+			if (!ret)
+				ret = arch_smp_job_cpu_off(cpu);
+			if (ret)
+				log_err("CPU %u: not off (err=%d)\n",
+					cpu->index, ret);
+		}
+	}
+
+	smp_job.nr_cpus = 0;
+	smp_job.started = false;
+}
@@ -53,8 +53,17 @@ int zstd_decompress(struct abuf *in, struct abuf *out)
 			goto do_free;
 		}
 
-		if (in_buf.pos >= abuf_size(in) || !res)
+		if (in_buf.pos >= abuf_size(in))
 			break;
+
+		/* Carry on with the next frame, if any */
+		if (!res) {
+			res = ZSTD_resetDStream(dstream);
+			if (ZSTD_isError(res)) {
+				ret = ZSTD_getErrorCode(res);
+				goto do_free;
+			}
+		}
 	}
 
 	ret = out_buf.pos;
@@ -85,6 +85,7 @@
 #include <bootstage.h>
 #include <command.h>
 #include <console.h>
+#include <deferred.h>
 #include <env.h>
 #include <env_internal.h>
 #include <errno.h>
@@ -560,6 +561,7 @@ restart:
 	 */
 	for (;;) {
 		WATCHDOG_RESET();
+		deferred_poll();
 		if (arp_timeout_check() > 0)
 			time_start = get_timer(0);
 
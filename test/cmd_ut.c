@@ -18,10 +18,16 @@ int cmd_ut_category(const char *name, const char *prefix,
 		    struct unit_test *tests, int n_ents,
 		    int argc, char *const argv[])
 {
+	bool force_run = false;
 	int ret;
 
+	if (argc > 1 && !strcmp(argv[1], "-f")) {
+		force_run = true;
+		argc--;
+		argv++;
+	}
 	ret = ut_run_list(name, prefix, tests, n_ents,
-			  argc > 1 ? argv[1] : NULL);
+			  argc > 1 ? argv[1] : NULL, force_run);
 
 	return ret ? CMD_RET_FAILURE : 0;
 }
@@ -121,6 +127,7 @@ static int do_ut(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 #ifdef CONFIG_SYS_LONGHELP
 static char ut_help_text[] =
 	"all - execute all enabled tests\n"
+	"ut <suite> -f [test-name] - also run manual tests, e.g. benchmarks\n"
 #ifdef CONFIG_SANDBOX
 	"ut bloblist - Test bloblist implementation\n"
 	"ut compression - Test compressors and bootm decompression\n"
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the binary bootstage timeline
+ */
+
+#include <common.h>
+#include <bootstage.h>
+#include <malloc.h>
+#include <asm/byteorder.h>
+#include <test/common.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+static int test_bootstage_timeline(struct unit_test_state *uts)
+{
+	struct bootstage_tl_hdr *hdr;
+	struct bootstage_tl_rec *rec;
+	struct bootstage_tl_io *io;
+	uint rec_count, io_count, str_size;
+	const char *strs;
+	bool found = false;
+	ulong start;
+	int len, i;
+	void *buf;
+
+	start = timer_get_boot_us();
+	bootstage_io("ut", 7, 512, start);
+	bootstage_io("ut", 7, 1024, start);
+
+	len = bootstage_timeline(NULL, 0);
+	ut_assert(len > sizeof(*hdr));
+	buf = malloc(len);
+	ut_assertnonnull(buf);
+
+	/* A short buffer gets the size but no valid timeline */
+	ut_asserteq(len, bootstage_timeline(buf, len - 1));
+	ut_asserteq(len, bootstage_timeline(buf, len));
+
+	hdr = buf;
+	ut_asserteq(BOOTSTAGE_TL_MAGIC, le32_to_cpu(hdr->magic));
+	ut_asserteq(BOOTSTAGE_TL_VERSION, le16_to_cpu(hdr->version));
+	rec_count = le16_to_cpu(hdr->rec_count);
+	io_count = le16_to_cpu(hdr->io_count);
+	str_size = le16_to_cpu(hdr->str_size);
+	ut_assert(rec_count > 0);
+
+	rec = (void *)(hdr + 1);
+	io = (void *)(rec + rec_count);
+	strs = (const char *)(io + io_count);
+	ut_asserteq(len, strs + str_size - (char *)buf);
+
+	/* The reset record is kept although its time is 0 */
+	for (i = 0; i < rec_count; i++) {
+		ut_assert(le16_to_cpu(rec[i].name) < str_size);
+		if (le32_to_cpu(rec[i].id) == BOOTSTAGE_ID_AWAKE) {
+			ut_asserteq_str("reset",
+					strs + le16_to_cpu(rec[i].name));
+			found = true;
+		}
+	}
+	ut_assert(found);
+
+	found = false;
+
+	for (i = 0; i < io_count; i++) {
+		ut_assert(le16_to_cpu(io[i].name) < str_size);
+		if (strcmp("ut7", strs + le16_to_cpu(io[i].name)))
+			continue;
+		ut_asserteq(2, le32_to_cpu(io[i].reads));
+		ut_asserteq(1536, le64_to_cpu(io[i].bytes));
+		found = true;
+	}
+	ut_assert(found);
+	free(buf);
+
+	return 0;
+}
+COMMON_TEST(test_bootstage_timeline, 0);
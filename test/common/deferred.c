@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for deferred work
+ */
+
+#include <common.h>
+#include <deferred.h>
+#include <time.h>
+#include <linux/errno.h>
+#include <test/common.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+struct test_state {
+	char order[8];
+	int count;
+};
+
+/* Record the call, then come back once after 20 ms if priv asks for it */
+static int h_record(struct deferred_work *work)
+{
+	struct test_state *state = work->priv;
+
+	state->order[state->count++] = work->name[0];
+	if (work->name[1] == '+' && !work->step)
+		return 20 * 1000;
+
+	return 0;
+}
+
+static int test_deferred_order(struct unit_test_state *uts)
+{
+	struct deferred_work a, b;
+	struct test_state state = {};
+
+	deferred_init(&a, "a+", h_record, &state);
+	deferred_init(&b, "b", h_record, &state);
+	deferred_schedule(&a, 10 * 1000);
+	deferred_schedule(&b, 5 * 1000);
+
+	/* Nothing is due yet */
+	deferred_poll();
+	ut_asserteq(0, state.count);
+
+	timer_test_add_offset(6);
+	deferred_poll();
+	ut_asserteq(1, state.count);
+	ut_asserteq('b', state.order[0]);
+	ut_assert(!b.pending);
+
+	timer_test_add_offset(5);
+	deferred_poll();
+	ut_asserteq(2, state.count);
+	ut_asserteq('a', state.order[1]);
+	ut_assert(a.pending);
+
+	/* The second call happens 20 ms after the first one */
+	timer_test_add_offset(21);
+	ut_assertok(deferred_wait(&a));
+	ut_asserteq(3, state.count);
+	ut_asserteq(2, a.step);
+	ut_assert(!a.pending);
+
+	return 0;
+}
+COMMON_TEST(test_deferred_order, 0);
+
+static int h_fail(struct deferred_work *work)
+{
+	return -EIO;
+}
+
+static int test_deferred_cancel(struct unit_test_state *uts)
+{
+	struct deferred_work a, b;
+	struct test_state state = {};
+
+	deferred_init(&a, "a", h_record, &state);
+	deferred_init(&b, "b", h_fail, NULL);
+	deferred_schedule(&a, 0);
+	deferred_cancel(&a);
+	deferred_schedule(&b, 0);
+
+	deferred_flush();
+	ut_asserteq(0, state.count);
+	ut_assert(!a.pending);
+	ut_asserteq(-EIO, deferred_wait(&b));
+
+	return 0;
+}
+COMMON_TEST(test_deferred_cancel, 0);
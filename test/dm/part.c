@@ -8,6 +8,7 @@
 #include <mmc.h>
 #include <part.h>
 #include <part_efi.h>
+#include <dm/device-internal.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
@@ -97,3 +98,90 @@ out:
 	return ret;
 }
 DM_TEST(dm_test_part, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+static int dm_test_part_cache(struct unit_test_state *uts)
+{
+	char str_disk_guid[UUID_STR_LEN + 1];
+	struct part_cache_stats stats;
+	struct disk_partition info;
+	struct blk_desc *mmc_dev_desc;
+	char block[512] = {};
+	lbaint_t lba;
+	struct disk_partition parts[2] = {
+		{
+			.start = 48,
+			.size = 1,
+			.name = "test1",
+		},
+		{
+			.start = 49,
+			.size = 1,
+			.name = "test2",
+		},
+	};
+
+	ut_asserteq(1, blk_get_device_by_str("mmc", "1", &mmc_dev_desc));
+	ut_asserteq(sizeof(block), mmc_dev_desc->blksz);
+	if (CONFIG_IS_ENABLED(RANDOM_UUID)) {
+		gen_rand_uuid_str(parts[0].uuid, UUID_STR_FORMAT_STD);
+		gen_rand_uuid_str(parts[1].uuid, UUID_STR_FORMAT_STD);
+		gen_rand_uuid_str(str_disk_guid, UUID_STR_FORMAT_STD);
+	}
+	ut_assertok(gpt_restore(mmc_dev_desc, str_disk_guid, parts,
+				ARRAY_SIZE(parts)));
+
+	/*
+	 * Writing the GPT dropped the cache, the first lookup reads it and
+	 * saves nothing
+	 */
+	ut_asserteq(-ENOENT, part_cache_get_stats(mmc_dev_desc, &stats));
+	ut_asserteq(2, part_get_info_by_name(mmc_dev_desc, "test2", &info));
+	ut_asserteq(49, info.start);
+	ut_assertok(part_cache_get_stats(mmc_dev_desc, &stats));
+	ut_asserteq(2, stats.entries);
+	ut_asserteq(0, stats.hits);
+	ut_asserteq(0, stats.reads_saved);
+
+	/* A miss would have walked both entries and failed on the third */
+	ut_asserteq(-ENOENT, part_get_info_by_name(mmc_dev_desc, "bogus",
+						   &info));
+	ut_assertok(part_get_info(mmc_dev_desc, 1, &info));
+	ut_asserteq_str("test1", (char *)info.name);
+	ut_assertok(part_cache_get_stats(mmc_dev_desc, &stats));
+	ut_asserteq(2, stats.hits);
+	ut_asserteq(4, stats.reads_saved);
+
+	/* Writes outside the GPT keep the cache, rewriting the GPT drops it */
+	ut_asserteq(1, blk_dwrite(mmc_dev_desc, 48, 1, block));
+	ut_assertok(part_cache_get_stats(mmc_dev_desc, &stats));
+	strcpy((char *)parts[0].name, "renamed");
+	ut_assertok(gpt_restore(mmc_dev_desc, str_disk_guid, parts,
+				ARRAY_SIZE(parts)));
+	ut_asserteq(1, part_get_info_by_name(mmc_dev_desc, "renamed", &info));
+	ut_asserteq(-ENOENT, part_get_info_by_name(mmc_dev_desc, "test1",
+						   &info));
+
+	/* A rescan drops it too */
+	part_init(mmc_dev_desc);
+	ut_asserteq(-ENOENT, part_cache_get_stats(mmc_dev_desc, &stats));
+
+	/* On a device smaller than a GPT and its backup, any write does */
+	ut_assertok(part_get_info(mmc_dev_desc, 1, &info));
+	ut_assertok(part_cache_get_stats(mmc_dev_desc, &stats));
+	lba = mmc_dev_desc->lba;
+	mmc_dev_desc->lba = 20;
+	part_cache_write(mmc_dev_desc, 48, 1);
+	mmc_dev_desc->lba = lba;
+	ut_asserteq(-ENOENT, part_cache_get_stats(mmc_dev_desc, &stats));
+
+	/* Removing the device frees it */
+	ut_assertok(part_get_info(mmc_dev_desc, 1, &info));
+	ut_assertok(part_cache_get_stats(mmc_dev_desc, &stats));
+	ut_assertok(device_remove(mmc_dev_desc->bdev, DM_REMOVE_NORMAL));
+	ut_asserteq(-ENOENT, part_cache_get_stats(mmc_dev_desc, &stats));
+
+	return 0;
+}
+DM_TEST(dm_test_part_cache, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
@@ -6,7 +6,10 @@
 #include <common.h>
 #include <dm.h>
 #include <fdtdec.h>
+#include <mapmem.h>
+#include <memalign.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <spi_flash.h>
 #include <asm/state.h>
 #include <asm/test.h>
@@ -14,6 +17,7 @@
 #include <dm/test.h>
 #include <dm/uclass-internal.h>
 #include <dm/util.h>
+#include <linux/sizes.h>
 #include <test/test.h>
 #include <test/ut.h>
 
@@ -201,3 +205,97 @@ static int dm_test_spi_xfer(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_spi_xfer, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(DESIGNWARE_SPI) && CONFIG_IS_ENABLED(DMA_CHANNELS)
+/* DesignWare SSI registers checked by dm_test_spi_dw_mem() */
+#define DW_SPI_CTRLR1		0x04
+#define DW_SPI_RXFLR		0x24
+#define DW_SPI_SR		0x28
+#define  DW_SPI_SR_TF_EMPT	BIT(2)
+#define DW_SPI_DMACR		0x4c
+#define DW_SPI_DMATDLR		0x50
+#define DW_SPI_DMARDLR		0x54
+#define DW_SPI_DR		0x60
+
+/* Test the DesignWare spi-mem data phases, by DMA and by the CPU */
+static int dm_test_spi_dw_mem(struct unit_test_state *uts)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, src, SZ_1K);
+	ALLOC_CACHE_ALIGN_BUFFER(u8, dst, SZ_1K);
+	const int mode = SPI_TX_QUAD | SPI_RX_QUAD;
+	struct spi_slave *slave;
+	struct spi_mem_op op;
+	struct udevice *bus;
+	u32 *regs;
+	int i;
+
+	/*
+	 * The registers are plain RAM, so the controller is never busy and
+	 * the rx FIFO always holds what RXFLR says, the last word in DR.
+	 */
+	sandbox_set_enable_memio(true);
+	regs = map_sysmem(0x2000, 0x100);
+	memset(regs, '\0', 0x100);
+	regs[DW_SPI_SR / 4] = DW_SPI_SR_TF_EMPT;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_SPI, "spi@2000", &bus));
+	ut_assertok(_spi_get_bus_and_cs(dev_seq(bus), 0, 1000000, mode,
+					"spi_generic_drv", "dw_spi_mem", &bus,
+					&slave));
+
+	/* A quad program goes out through the tx channel... */
+	for (i = 0; i < SZ_1K; i++)
+		src[i] = i;
+	op = (struct spi_mem_op)SPI_MEM_OP(SPI_MEM_OP_CMD(0x32, 1),
+					   SPI_MEM_OP_ADDR(2, 0, 1),
+					   SPI_MEM_OP_NO_DUMMY,
+					   SPI_MEM_OP_DATA_OUT(SZ_1K, src, 4));
+	ut_assertok(spi_mem_exec_op(slave, &op));
+	ut_asserteq(SZ_1K - 1, regs[DW_SPI_CTRLR1 / 4]);
+	ut_asserteq(128, regs[DW_SPI_DMATDLR / 4]);
+	ut_asserteq(0, regs[DW_SPI_DMACR / 4]);
+
+	/* ...and the sandbox DMA loops it back to a quad read */
+	memset(dst, '\0', SZ_1K);
+	op = (struct spi_mem_op)SPI_MEM_OP(SPI_MEM_OP_CMD(0x6b, 1),
+					   SPI_MEM_OP_ADDR(3, 0, 1),
+					   SPI_MEM_OP_DUMMY(1, 1),
+					   SPI_MEM_OP_DATA_IN(SZ_1K, dst, 4));
+	ut_assertok(spi_mem_exec_op(slave, &op));
+	ut_asserteq(SZ_1K - 1, regs[DW_SPI_CTRLR1 / 4]);
+	ut_asserteq(127, regs[DW_SPI_DMARDLR / 4]);
+	ut_asserteq(0, regs[DW_SPI_DMACR / 4]);
+	ut_asserteq_mem(src, dst, SZ_1K);
+
+	/*
+	 * Short data phases are polled by the CPU, in 32-bit frames. The
+	 * last one written to DR holds bytes 12 to 15 of a program...
+	 */
+	op = (struct spi_mem_op)SPI_MEM_OP(SPI_MEM_OP_CMD(0x32, 1),
+					   SPI_MEM_OP_ADDR(2, 0, 1),
+					   SPI_MEM_OP_NO_DUMMY,
+					   SPI_MEM_OP_DATA_OUT(16, src, 4));
+	ut_assertok(spi_mem_exec_op(slave, &op));
+	ut_asserteq(16, op.data.nbytes);
+	ut_asserteq(16 / 4 - 1, regs[DW_SPI_CTRLR1 / 4]);
+	ut_asserteq(0x0c0d0e0f, regs[DW_SPI_DR / 4]);
+
+	/* ...and a read returns the address, the last word written to DR */
+	regs[DW_SPI_RXFLR / 4] = 4;
+	op = (struct spi_mem_op)SPI_MEM_OP(SPI_MEM_OP_CMD(0x6b, 1),
+					   SPI_MEM_OP_ADDR(4, 0x11223344, 1),
+					   SPI_MEM_OP_DUMMY(1, 1),
+					   SPI_MEM_OP_DATA_IN(16, dst, 4));
+	ut_assertok(spi_mem_exec_op(slave, &op));
+	ut_asserteq(16, op.data.nbytes);
+	ut_asserteq(16 / 4 - 1, regs[DW_SPI_CTRLR1 / 4]);
+	for (i = 0; i < 16; i += 4)
+		ut_asserteq_mem("\x11\x22\x33\x44", dst + i, 4);
+
+	unmap_sysmem(regs);
+	sandbox_set_enable_memio(false);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_dw_mem, UT_TESTF_SCAN_FDT);
+#endif
@@ -4,15 +4,19 @@
  */
 
 #include <common.h>
+#include <avb_verify.h>
 #include <dm.h>
 #include <log.h>
 #include <malloc.h>
 #include <dm/test.h>
 #include <sandboxtee.h>
+#include <search.h>
 #include <tee.h>
 #include <test/test.h>
 #include <test/ut.h>
+#include <tee/efuse_shadow.h>
 #include <tee/optee_ta_avb.h>
+#include <tee/optee_ta_efuse.h>
 #include <tee/optee_ta_rpc_test.h>
 
 static int open_session(struct udevice *dev, u32 *session,
@@ -48,6 +52,34 @@ static int invoke_func_avb(struct udevice *dev, u32 session)
 	return 0;
 }
 
+static int invoke_func_avb_state(struct udevice *dev, u32 session, u64 *buf)
+{
+	struct tee_param param = { .attr = TEE_PARAM_ATTR_TYPE_MEMREF_OUTPUT };
+	struct tee_invoke_arg arg;
+	struct tee_shm *shm;
+	int rc;
+
+	rc = tee_shm_alloc(dev, TA_AVB_STATE_SIZE, TEE_SHM_ALLOC, &shm);
+	if (rc)
+		return rc;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.session = session;
+	arg.func = TA_AVB_CMD_READ_STATE;
+	param.u.memref.shm = shm;
+	param.u.memref.size = TA_AVB_STATE_SIZE;
+
+	if (tee_invoke_func(dev, &arg, 1, &param) || arg.ret ||
+	    param.u.memref.size != TA_AVB_STATE_SIZE)
+		rc = -1;
+	else
+		memcpy(buf, shm->addr, TA_AVB_STATE_SIZE);
+
+	tee_shm_free(shm);
+
+	return rc;
+}
+
 static int invoke_func_rpc_test(struct udevice *dev, u32 session,
 				u64 op, u64 busnum, u64 chip_addr,
 				u64 xfer_flags, u8 *buf, size_t buf_size)
@@ -109,6 +141,7 @@ static int test_tee(struct unit_test_state *uts, struct test_tee_vars *vars)
 	u32 session = 0;
 	int rc;
 	u8 data[128];
+	u64 avb_state[1 + TA_AVB_MAX_ROLLBACK_LOCATIONS];
 
 	dev = tee_find_device(NULL, match, NULL, &vers);
 	ut_assert(dev);
@@ -122,6 +155,16 @@ static int test_tee(struct unit_test_state *uts, struct test_tee_vars *vars)
 	rc = invoke_func_avb(dev, session);
 	ut_assert(!rc);
 
+	/* The lock state and all rollback indexes in one call */
+	state->ta_avb_lock_state = 1;
+	state->ta_avb_rollback_indexes[3] = 0x100000007ULL;
+	rc = invoke_func_avb_state(dev, session, avb_state);
+	ut_assert(!rc);
+	ut_asserteq_64(1, avb_state[0]);
+	ut_asserteq_64(0, avb_state[1]);
+	ut_asserteq_64(0x100000007ULL, avb_state[1 + 3]);
+	ut_asserteq(0, state->num_shms);
+
 	rc = tee_close_session(dev, session);
 	ut_assert(!rc);
 	ut_assert(!state->session);
@@ -218,3 +261,208 @@ out:
 }
 
 DM_TEST(dm_test_tee, UT_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_TEE_EFUSE_SHADOW
+static int test_tee_efuse_shadow(struct unit_test_state *uts)
+{
+	struct tee_efuse_region {
+		u32 offset;
+		u32 size;
+	} readable[] = PTA_EFUSE_READABLE;
+	struct sandbox_tee_state *state;
+	struct udevice *dev;
+	u32 val, socuid[2];
+	u8 key[16];
+
+	dev = tee_find_device(NULL, match, NULL, NULL);
+	ut_assert(dev);
+	state = dev_get_priv(dev);
+
+	val = 0x12345678;
+	memcpy(state->pta_efuse + 0x00, &val, sizeof(val));
+	val = 0x9abcdef0;
+	memcpy(state->pta_efuse + 0x14, &val, sizeof(val));
+	val = 0x10000000;
+	memcpy(state->pta_efuse + 0x54, &val, sizeof(val));
+
+	/* The first read loads every readable region, in one session */
+	ut_assertok(efuse_shadow_read(0x54, sizeof(val), &val));
+	ut_asserteq(0x10000000, val);
+	ut_asserteq(ARRAY_SIZE(readable), state->pta_efuse_reads);
+	ut_assert(state->session);
+	ut_asserteq(1, state->num_shms);
+
+	/* Later reads are served from RAM */
+	ut_assertok(efuse_shadow_read(0x00, sizeof(socuid[0]), &socuid[0]));
+	ut_assertok(efuse_shadow_read(0x14, sizeof(socuid[1]), &socuid[1]));
+	ut_asserteq(0x12345678, socuid[0]);
+	ut_asserteq(0x9abcdef0, socuid[1]);
+	ut_asserteq(ARRAY_SIZE(readable), state->pta_efuse_reads);
+
+	/* Reads outside the readable regions still go to the PTA */
+	ut_asserteq(TEE_ERROR_ACCESS_DENIED,
+		    efuse_shadow_read(0x04, sizeof(key), key));
+	ut_asserteq(ARRAY_SIZE(readable) + 1, state->pta_efuse_reads);
+	ut_asserteq(-EINVAL, efuse_shadow_read(0xfc, 8, key));
+
+	/* A write drops the mirror, the next read sees the burnt bits */
+	ut_assertok(efuse_shadow_write(0x54, 0x3));
+	ut_asserteq(ARRAY_SIZE(readable) + 1, state->pta_efuse_reads);
+	ut_assertok(efuse_shadow_read(0x54, sizeof(val), &val));
+	ut_asserteq(0x10000003, val);
+	ut_asserteq(2 * ARRAY_SIZE(readable) + 1, state->pta_efuse_reads);
+
+	efuse_shadow_release();
+	ut_assert(!state->session);
+	ut_assert(!state->num_shms);
+
+	return 0;
+}
+
+static int dm_test_tee_efuse_shadow(struct unit_test_state *uts)
+{
+	int rc = test_tee_efuse_shadow(uts);
+
+	/* The session must not outlive the sandbox TEE device */
+	efuse_shadow_release();
+
+	return rc;
+}
+
+DM_TEST(dm_test_tee_efuse_shadow, UT_TESTF_SCAN_FDT);
+#endif
+
+#if defined(CONFIG_AVB_VERIFY) && defined(CONFIG_OPTEE_TA_AVB)
+static int test_tee_avb_ops(struct unit_test_state *uts, bool read_state,
+			    AvbOps **opsp)
+{
+	struct sandbox_tee_state *state;
+	struct env_entry e, *ep;
+	struct udevice *dev;
+	char buf[16];
+	bool unlocked;
+	size_t size;
+	u32 invokes;
+	AvbOps *ops;
+	u64 val;
+
+	dev = tee_find_device(NULL, match, NULL, NULL);
+	ut_assert(dev);
+	state = dev_get_priv(dev);
+	state->ta_avb_no_read_state = !read_state;
+	state->ta_avb_lock_state = 1;
+	state->ta_avb_rollback_indexes[2] = 5;
+
+	ops = avb_ops_alloc("mmc", 0);
+	ut_assertnonnull(ops);
+	*opsp = ops;
+
+	/*
+	 * The first read asks the TA for everything at once; a TA without
+	 * TA_AVB_CMD_READ_STATE is asked one value at a time instead.
+	 */
+	ut_assertok(ops->read_is_device_unlocked(ops, &unlocked));
+	ut_assert(!unlocked);
+	ut_assertok(ops->read_rollback_index(ops, 2, &val));
+	ut_asserteq_64(5, val);
+	invokes = state->ta_avb_invokes;
+	ut_asserteq(read_state ? 1 : 3, invokes);
+
+	/* Later reads are served from the cache */
+	state->ta_avb_lock_state = 0;
+	state->ta_avb_rollback_indexes[2] = 6;
+	ut_assertok(ops->read_is_device_unlocked(ops, &unlocked));
+	ut_assert(!unlocked);
+	ut_assertok(ops->read_rollback_index(ops, 2, &val));
+	ut_asserteq_64(5, val);
+	ut_asserteq(invokes, state->ta_avb_invokes);
+	state->ta_avb_rollback_indexes[2] = 5;
+
+	/* Writes stay in the cache until avb_ops_commit() */
+	ut_assertok(ops->write_rollback_index(ops, 2, 7));
+	ut_assertok(ops->read_rollback_index(ops, 2, &val));
+	ut_asserteq_64(7, val);
+	ut_asserteq_64(5, state->ta_avb_rollback_indexes[2]);
+	ut_asserteq(invokes, state->ta_avb_invokes);
+
+	/* An index is never lowered, not even in the cache */
+	ut_asserteq(AVB_IO_RESULT_ERROR_IO,
+		    ops->write_rollback_index(ops, 2, 6));
+	ut_assertok(ops->read_rollback_index(ops, 2, &val));
+	ut_asserteq_64(7, val);
+
+	ut_assertok(avb_ops_commit(ops));
+	ut_asserteq_64(7, state->ta_avb_rollback_indexes[2]);
+	ut_asserteq(invokes + 1, state->ta_avb_invokes);
+
+	/* Nothing is written twice */
+	ut_assertok(avb_ops_commit(ops));
+	ut_asserteq(invokes + 1, state->ta_avb_invokes);
+
+	/*
+	 * The TA refuses an index below the one it has, the next read asks
+	 * the TA again
+	 */
+	ut_assertok(ops->write_rollback_index(ops, 2, 8));
+	state->ta_avb_rollback_indexes[2] = 9;
+	ut_asserteq(-EIO, avb_ops_commit(ops));
+	ut_asserteq_64(9, state->ta_avb_rollback_indexes[2]);
+	ut_assertok(ops->read_rollback_index(ops, 2, &val));
+	ut_asserteq_64(9, val);
+	ut_asserteq(invokes + 3, state->ta_avb_invokes);
+
+	/* Persistent values are cached until avb_ops_drop_values() */
+	ut_assertok(ops->write_persistent_value(ops, "test", 4,
+						(const u8 *)"old"));
+	invokes = state->ta_avb_invokes;
+	ut_assertok(ops->read_persistent_value(ops, "test", sizeof(buf),
+					       (u8 *)buf, &size));
+	ut_asserteq_str("old", buf);
+	ut_asserteq(invokes, state->ta_avb_invokes);
+
+	/* Written without the AvbOps, as optee_rpmb does */
+	e.key = "test";
+	e.data = "new";
+	ut_assert(hsearch_r(e, ENV_ENTER, &ep, &state->pstorage_htab, 0));
+	ut_assertok(ops->read_persistent_value(ops, "test", sizeof(buf),
+					       (u8 *)buf, &size));
+	ut_asserteq_str("old", buf);
+	avb_ops_drop_values(ops);
+	ut_assertok(ops->read_persistent_value(ops, "test", sizeof(buf),
+					       (u8 *)buf, &size));
+	ut_asserteq_str("new", buf);
+	ut_asserteq(invokes + 1, state->ta_avb_invokes);
+
+	avb_ops_free(ops);
+	*opsp = NULL;
+	ut_assert(!state->session);
+	ut_assert(!state->num_shms);
+
+	return 0;
+}
+
+static int dm_test_tee_avb_ops(struct unit_test_state *uts)
+{
+	AvbOps *ops = NULL;
+	int rc = test_tee_avb_ops(uts, true, &ops);
+
+	/* The session must not outlive the sandbox TEE device */
+	avb_ops_free(ops);
+
+	return rc;
+}
+
+DM_TEST(dm_test_tee_avb_ops, UT_TESTF_SCAN_FDT);
+
+static int dm_test_tee_avb_ops_no_state(struct unit_test_state *uts)
+{
+	AvbOps *ops = NULL;
+	int rc = test_tee_avb_ops(uts, false, &ops);
+
+	avb_ops_free(ops);
+
+	return rc;
+}
+
+DM_TEST(dm_test_tee_avb_ops_no_state, UT_TESTF_SCAN_FDT);
+#endif
@@ -27,15 +27,17 @@ DECLARE_GLOBAL_DATA_PTR;
  *
  * @test_name: Name of single test to run (e.g. "dm_test_fdt_pre_reloc" or just
  *	"fdt_pre_reloc"), or NULL to run all
+ * @force_run: Also run tests marked with UT_TESTF_MANUAL
  * Return: 0 if all tests passed, 1 if not
  */
-static int dm_test_run(const char *test_name)
+static int dm_test_run(const char *test_name, bool force_run)
 {
 	struct unit_test *tests = UNIT_TEST_SUITE_START(dm_test);
 	const int n_ents = UNIT_TEST_SUITE_COUNT(dm_test);
 	int ret;
 
-	ret = ut_run_list("driver model", "dm_test_", tests, n_ents, test_name);
+	ret = ut_run_list("driver model", "dm_test_", tests, n_ents, test_name,
+			  force_run);
 
 	return ret ? CMD_RET_FAILURE : 0;
 }
@@ -43,9 +45,15 @@ static int dm_test_run(const char *test_name)
 int do_ut_dm(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 {
 	const char *test_name = NULL;
+	bool force_run = false;
 
+	if (argc > 1 && !strcmp(argv[1], "-f")) {
+		force_run = true;
+		argc--;
+		argv++;
+	}
 	if (argc > 1)
 		test_name = argv[1];
 
-	return dm_test_run(test_name);
+	return dm_test_run(test_name, force_run);
 }
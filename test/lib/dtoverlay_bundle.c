@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for dtoverlay bundles
+ */
+
+#include <common.h>
+#include <dtoverlay.h>
+#include <malloc.h>
+#include <linux/libfdt.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/sha256.h>
+
+#define FDT_SIZE	SZ_16K
+/* Offset of delta_hash in the bundle header */
+#define BUNDLE_DELTA_HASH	56
+
+static int make_base(struct unit_test_state *uts, void *fdt)
+{
+	char name[16];
+	int node, i;
+
+	ut_assertok(fdt_create_empty_tree(fdt, FDT_SIZE));
+	node = fdt_add_subnode(fdt, 0, "soc");
+	ut_assert(node >= 0);
+	for (i = 0; i < 32; i++) {
+		snprintf(name, sizeof(name), "dev@%x", i * 0x1000);
+		ut_assert(fdt_add_subnode(fdt, node, name) >= 0);
+	}
+	for (i = 0; i < 32; i++) {
+		snprintf(name, sizeof(name), "/soc/dev@%x", i * 0x1000);
+		node = fdt_path_offset(fdt, name);
+		ut_assert(node >= 0);
+		ut_assertok(fdt_setprop_string(fdt, node, "status", "disabled"));
+		ut_assertok(fdt_setprop_u32(fdt, node, "reg", i * 0x1000));
+	}
+
+	return 0;
+}
+
+/* What applying a few overlays and dtparams does */
+static int make_merged(struct unit_test_state *uts, void *fdt)
+{
+	int node;
+
+	node = fdt_path_offset(fdt, "/soc/dev@3000");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_string(fdt, node, "status", "okay"));
+	ut_assertok(fdt_setprop_u32(fdt, node, "clock-frequency", 400000));
+
+	node = fdt_path_offset(fdt, "/soc/dev@1a000");
+	ut_assert(node >= 0);
+	ut_assert(fdt_add_subnode(fdt, node, "sensor@36") >= 0);
+
+	node = fdt_path_offset(fdt, "/soc/dev@1f000");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_delprop(fdt, node, "status"));
+
+	return 0;
+}
+
+static int lib_dtoverlay_bundle(struct unit_test_state *uts)
+{
+	u8 key[SHA256_SUM_LEN], other[SHA256_SUM_LEN];
+	void *base, *merged, *fdt, *bundle;
+	int size;
+
+	base = malloc(FDT_SIZE);
+	merged = malloc(FDT_SIZE);
+	fdt = malloc(FDT_SIZE);
+	ut_assertnonnull(base);
+	ut_assertnonnull(merged);
+	ut_assertnonnull(fdt);
+
+	ut_assertok(make_base(uts, base));
+	memcpy(merged, base, FDT_SIZE);
+	ut_assertok(make_merged(uts, merged));
+
+	memset(key, 0x5a, sizeof(key));
+	ut_assertok(dtoverlay_bundle_make(base, merged, key, &bundle, &size));
+	/* Mostly copies of the base */
+	ut_assert(size < FDT_SIZE / 8);
+
+	memcpy(fdt, base, FDT_SIZE);
+	ut_assertok(dtoverlay_bundle_apply(bundle, size, key, fdt, FDT_SIZE));
+	ut_asserteq_mem(merged, fdt, fdt_totalsize(merged));
+
+	/* Other inputs, the device tree is left alone */
+	memcpy(other, key, sizeof(other));
+	other[0] ^= 1;
+	memcpy(fdt, base, FDT_SIZE);
+	ut_asserteq(-ESTALE, dtoverlay_bundle_apply(bundle, size, other, fdt,
+						    FDT_SIZE));
+	ut_asserteq_mem(base, fdt, fdt_totalsize(base));
+
+	/* A damaged delta is rejected */
+	((u8 *)bundle)[size - 1] ^= 1;
+	ut_asserteq(-EILSEQ, dtoverlay_bundle_apply(bundle, size, key, fdt,
+						    FDT_SIZE));
+	ut_asserteq_mem(base, fdt, fdt_totalsize(base));
+	((u8 *)bundle)[size - 1] ^= 1;
+
+	/* So is a damaged hash of the delta */
+	((u8 *)bundle)[BUNDLE_DELTA_HASH] ^= 1;
+	ut_asserteq(-EILSEQ, dtoverlay_bundle_apply(bundle, size, key, fdt,
+						    FDT_SIZE));
+	ut_asserteq_mem(base, fdt, fdt_totalsize(base));
+	((u8 *)bundle)[BUNDLE_DELTA_HASH] ^= 1;
+	ut_assertok(dtoverlay_bundle_apply(bundle, size, key, fdt, FDT_SIZE));
+	ut_asserteq_mem(merged, fdt, fdt_totalsize(merged));
+
+	memcpy(fdt, base, FDT_SIZE);
+	ut_asserteq(-EINVAL, dtoverlay_bundle_apply(bundle, 8, key, fdt,
+						    FDT_SIZE));
+
+	free(bundle);
+	free(fdt);
+	free(merged);
+	free(base);
+
+	return 0;
+}
+LIB_TEST(lib_dtoverlay_bundle, 0);
+
+/* The base is shrunk before the overlays, so the merged tree is larger */
+static int lib_dtoverlay_bundle_grow(struct unit_test_state *uts)
+{
+	void *base, *merged, *fdt, *bundle;
+	u8 key[SHA256_SUM_LEN];
+	int base_size, size;
+
+	base = malloc(FDT_SIZE);
+	merged = malloc(FDT_SIZE);
+	fdt = malloc(FDT_SIZE);
+	ut_assertnonnull(base);
+	ut_assertnonnull(merged);
+	ut_assertnonnull(fdt);
+
+	ut_assertok(make_base(uts, base));
+	ut_assertok(fdt_pack(base));
+	base_size = fdt_totalsize(base);
+
+	ut_assertok(fdt_open_into(base, merged, FDT_SIZE));
+	ut_assertok(make_merged(uts, merged));
+	ut_assertok(fdt_pack(merged));
+	ut_assert(fdt_totalsize(merged) > base_size);
+
+	memset(key, 0xa5, sizeof(key));
+	ut_assertok(dtoverlay_bundle_make(base, merged, key, &bundle, &size));
+
+	memset(fdt, 0, FDT_SIZE);
+	memcpy(fdt, base, base_size);
+	ut_assertok(dtoverlay_bundle_apply(bundle, size, key, fdt, FDT_SIZE));
+	ut_asserteq(fdt_totalsize(merged), fdt_totalsize(fdt));
+	ut_asserteq_mem(merged, fdt, fdt_totalsize(merged));
+
+	/* No room to grow into, the device tree is left alone */
+	memcpy(fdt, base, base_size);
+	ut_asserteq(-ENOSPC, dtoverlay_bundle_apply(bundle, size, key, fdt,
+						    base_size));
+	ut_asserteq_mem(base, fdt, base_size);
+
+	free(bundle);
+	free(fdt);
+	free(merged);
+	free(base);
+
+	return 0;
+}
+LIB_TEST(lib_dtoverlay_bundle_grow, 0);
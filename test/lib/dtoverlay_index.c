@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Checks and benchmark of the dtoverlay lookup index
+ *
+ * The base tree has as many nodes as the kernel's hobot-x5.dtb and the
+ * overlays target it the way ours do: through __fixups__ on its
+ * __symbols__, or a target-path. The benchmark applies them once walking
+ * the tree for each lookup and once through the index, and checks that
+ * both give the same tree.
+ */
+
+#include <common.h>
+#include <dtoverlay.h>
+#include <malloc.h>
+#include <time.h>
+#include <linux/libfdt.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define BASE_DEVS	1024
+#define BASE_SIZE	SZ_512K
+#define OVERLAYS	32
+#define FRAGMENTS	8
+#define OVERLAY_SIZE	SZ_4K
+
+/* Distinct devices for all fragments of all overlays */
+static int frag_dev(int n, int i)
+{
+	return (n * FRAGMENTS + i) * 7 % BASE_DEVS;
+}
+
+static void dev_path(char *buf, int size, int i)
+{
+	snprintf(buf, size, "/soc/dev@%x", i * 0x1000);
+}
+
+/* Every other device has a phandle, the fixups give the rest one */
+static int make_base(struct unit_test_state *uts, void *fdt)
+{
+	char name[32], path[32];
+	int i;
+
+	ut_assertok(fdt_create(fdt, BASE_SIZE));
+	ut_assertok(fdt_finish_reservemap(fdt));
+	ut_assertok(fdt_begin_node(fdt, ""));
+	ut_assertok(fdt_begin_node(fdt, "soc"));
+	for (i = 0; i < BASE_DEVS; i++) {
+		snprintf(name, sizeof(name), "dev@%x", i * 0x1000);
+		ut_assertok(fdt_begin_node(fdt, name));
+		ut_assertok(fdt_property_u32(fdt, "reg", i * 0x1000));
+		ut_assertok(fdt_property_string(fdt, "status", "disabled"));
+		if (!(i & 1))
+			ut_assertok(fdt_property_u32(fdt, "phandle",
+						     i / 2 + 1));
+		ut_assertok(fdt_end_node(fdt));
+	}
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_begin_node(fdt, "__symbols__"));
+	for (i = 0; i < BASE_DEVS; i++) {
+		snprintf(name, sizeof(name), "dev%d", i);
+		dev_path(path, sizeof(path), i);
+		ut_assertok(fdt_property_string(fdt, name, path));
+	}
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_finish(fdt));
+
+	return 0;
+}
+
+static int make_overlay(struct unit_test_state *uts, void *fdt, int n)
+{
+	char name[32], path[32];
+	int i;
+
+	ut_assertok(fdt_create(fdt, OVERLAY_SIZE));
+	ut_assertok(fdt_finish_reservemap(fdt));
+	ut_assertok(fdt_begin_node(fdt, ""));
+	for (i = 0; i < FRAGMENTS; i++) {
+		snprintf(name, sizeof(name), "fragment@%d", i);
+		ut_assertok(fdt_begin_node(fdt, name));
+		if (i == FRAGMENTS - 1) {
+			dev_path(path, sizeof(path), frag_dev(n, i));
+			ut_assertok(fdt_property_string(fdt, "target-path",
+							path));
+		} else {
+			ut_assertok(fdt_property_u32(fdt, "target",
+						     0xffffffff));
+		}
+		ut_assertok(fdt_begin_node(fdt, "__overlay__"));
+		ut_assertok(fdt_property_string(fdt, "status", "okay"));
+		ut_assertok(fdt_property_u32(fdt, "clock-frequency",
+					     n * 1000 + i));
+		ut_assertok(fdt_begin_node(fdt, "port"));
+		ut_assertok(fdt_property_u32(fdt, "reg", i));
+		ut_assertok(fdt_end_node(fdt));
+		ut_assertok(fdt_end_node(fdt));
+		ut_assertok(fdt_end_node(fdt));
+	}
+	ut_assertok(fdt_begin_node(fdt, "__fixups__"));
+	for (i = 0; i < FRAGMENTS - 1; i++) {
+		snprintf(name, sizeof(name), "dev%d", frag_dev(n, i));
+		snprintf(path, sizeof(path), "/fragment@%d:target:0", i);
+		ut_assertok(fdt_property_string(fdt, name, path));
+	}
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_finish(fdt));
+
+	return 0;
+}
+
+/* Each device can be found by symbol, path and phandle */
+static int check_lookups(struct unit_test_state *uts, DTBLOB_T *dtb)
+{
+	char name[32], path[32];
+	int i, off, phandle;
+
+	for (i = 0; i < BASE_DEVS; i++) {
+		snprintf(name, sizeof(name), "dev%d", i);
+		dev_path(path, sizeof(path), i);
+		off = fdt_path_offset(dtb->fdt, path);
+		ut_assert(off >= 0);
+		ut_asserteq(off, dtoverlay_find_symbol(dtb, name));
+		ut_asserteq(off, dtoverlay_find_node(dtb, path, 0));
+		phandle = fdt_get_phandle(dtb->fdt, off);
+		if (phandle)
+			ut_asserteq(off, dtoverlay_find_phandle(dtb, phandle));
+	}
+
+	return 0;
+}
+
+static int lib_dtoverlay_index(struct unit_test_state *uts)
+{
+	char path[32];
+	DTBLOB_T *dtb;
+	void *fdt;
+	int i, off;
+
+	fdt = malloc(BASE_SIZE);
+	ut_assertnonnull(fdt);
+	ut_assertok(make_base(uts, fdt));
+	dtb = dtoverlay_import_fdt(fdt, BASE_SIZE);
+	ut_assertnonnull(dtb);
+	ut_assertok(check_lookups(uts, dtb));
+
+	/* Edits through dtoverlay move the nodes after them */
+	dev_path(path, sizeof(path), 1);
+	off = dtoverlay_find_node(dtb, path, 0);
+	ut_assert(off >= 0);
+	for (i = 0; i < 100; i++)
+		ut_assertok(dtoverlay_set_property(dtb, off, "pad", path,
+						   i % 32));
+	ut_assert(dtoverlay_create_node(dtb, "/soc/dev@3000/port@0", 0) >= 0);
+	ut_assertok(check_lookups(uts, dtb));
+
+	/* So do edits behind its back */
+	dev_path(path, sizeof(path), 0);
+	off = fdt_path_offset(dtb->fdt, path);
+	ut_assertok(fdt_setprop_string(dtb->fdt, off, "extra", "not indexed"));
+	ut_assertok(check_lookups(uts, dtb));
+
+	/* A phandle added after the index was built */
+	dev_path(path, sizeof(path), 5);
+	off = fdt_path_offset(dtb->fdt, path);
+	ut_assertok(fdt_setprop_u32(dtb->fdt, off, "phandle", 0x2000));
+	ut_asserteq(off, dtoverlay_find_phandle(dtb, 0x2000));
+
+	/* Lookups libfdt resolves other than by full path */
+	ut_asserteq(fdt_path_offset(dtb->fdt, "/soc"),
+		    dtoverlay_find_node(dtb, "/soc/", 0));
+	ut_asserteq(-FDT_ERR_NOTFOUND, dtoverlay_find_node(dtb, "/nope", 0));
+	ut_asserteq(-FDT_ERR_NOTFOUND, dtoverlay_find_symbol(dtb, "nope"));
+
+	ut_assertok(dtoverlay_delete_node(dtb, "/soc/dev@3000/port@0", 0));
+	ut_assertok(check_lookups(uts, dtb));
+
+	dtoverlay_free_dtb(dtb);
+	free(fdt);
+
+	return 0;
+}
+LIB_TEST(lib_dtoverlay_index, 0);
+
+static int apply_overlays(struct unit_test_state *uts, void *fdt,
+			  const void *base, void *const *overlays, ulong *usp)
+{
+	DTBLOB_T *dtb, *overlay_dtb;
+	ulong start;
+	void *buf;
+	int n;
+
+	memcpy(fdt, base, BASE_SIZE);
+
+	start = timer_get_us();
+	dtb = dtoverlay_import_fdt(fdt, BASE_SIZE);
+	ut_assertnonnull(dtb);
+	for (n = 0; n < OVERLAYS; n++) {
+		buf = malloc(OVERLAY_SIZE);
+		ut_assertnonnull(buf);
+		memcpy(buf, overlays[n], OVERLAY_SIZE);
+		overlay_dtb = dtoverlay_import_fdt(buf, OVERLAY_SIZE);
+		ut_assertnonnull(overlay_dtb);
+		overlay_dtb->fdt_is_malloced = 1;
+		ut_assertok(dtoverlay_fixup_overlay(dtb, overlay_dtb));
+		ut_assertok(dtoverlay_merge_overlay(dtb, overlay_dtb));
+		dtoverlay_free_dtb(overlay_dtb);
+	}
+	*usp = timer_get_us() - start;
+
+	ut_assertok(check_lookups(uts, dtb));
+	dtoverlay_free_dtb(dtb);
+
+	return 0;
+}
+
+static int lib_dtoverlay_index_bench(struct unit_test_state *uts)
+{
+	void *overlays[OVERLAYS];
+	void *base, *walked, *indexed;
+	ulong walk_us, index_us;
+	char path[32];
+	int n, off;
+
+	base = malloc(BASE_SIZE);
+	walked = malloc(BASE_SIZE);
+	indexed = malloc(BASE_SIZE);
+	ut_assertnonnull(base);
+	ut_assertnonnull(walked);
+	ut_assertnonnull(indexed);
+	ut_assertok(make_base(uts, base));
+	for (n = 0; n < OVERLAYS; n++) {
+		overlays[n] = malloc(OVERLAY_SIZE);
+		ut_assertnonnull(overlays[n]);
+		ut_assertok(make_overlay(uts, overlays[n], n));
+	}
+
+	dtoverlay_enable_index(0);
+	ut_assertok(apply_overlays(uts, walked, base, overlays, &walk_us));
+	dtoverlay_enable_index(1);
+	ut_assertok(apply_overlays(uts, indexed, base, overlays, &index_us));
+	ut_asserteq_mem(walked, indexed, BASE_SIZE);
+
+	/* The overlays did land */
+	dev_path(path, sizeof(path), frag_dev(OVERLAYS - 1, 0));
+	off = fdt_path_offset(indexed, path);
+	ut_assert(off >= 0);
+	ut_asserteq_str("okay", fdt_getprop(indexed, off, "status", NULL));
+	ut_assert(fdt_subnode_offset(indexed, off, "port") >= 0);
+
+	printf("  %d overlays on %d nodes: %lu us walking, %lu us indexed\n",
+	       OVERLAYS, BASE_DEVS, walk_us, index_us);
+
+	for (n = 0; n < OVERLAYS; n++)
+		free(overlays[n]);
+	free(indexed);
+	free(walked);
+	free(base);
+
+	return 0;
+}
+LIB_TEST(lib_dtoverlay_index_bench, 0);
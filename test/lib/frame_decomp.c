@@ -0,0 +1,330 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for parallel LZ4/zstd decompression
+ *
+ * The streams are built here from raw blocks and runs, which are easy to
+ * encode by hand, rather than shipped as compressed blobs.
+ */
+
+#include <common.h>
+#include <frame_decomp.h>
+#include <image.h>
+#include <malloc.h>
+#include <asm/unaligned.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/lz4.h>
+
+#define LZ4F_MAGIC_LE		0x184d2204
+#define LZ4F_FLG_INDEP		(BIT(6) | BIT(5))
+#define LZ4F_FLG_SIZE		BIT(3)
+#define LZ4F_BD_64K		(4 << 4)
+#define LZ4F_UNCOMPRESSED	0x80000000U
+
+#define ZSTD_MAGIC_LE		0xfd2fb528
+/* Single segment, two-byte content size */
+#define ZSTD_FHD_SIZE16		0x60
+#define ZSTD_BLOCK_RAW		0
+#define ZSTD_BLOCK_RLE		1
+
+#define STREAM_MAX		SZ_256K
+#define OUT_MAX			SZ_1M
+
+static void fill(u8 *buf, ulong len)
+{
+	ulong i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (i % 251) ^ (i >> 16);
+}
+
+/* Encode an LZ4 block of @len bytes of @c: one literal, one match, 5 literals */
+static u8 *lz4_run(u8 *p, uint len, u8 c)
+{
+	uint ml = len - 1 - 5 - 4;
+
+	*p++ = 0x10 | min(ml, 15U);
+	*p++ = c;
+	put_unaligned_le16(1, p);
+	p += 2;
+	if (ml >= 15) {
+		for (ml -= 15; ml >= 255; ml -= 255)
+			*p++ = 255;
+		*p++ = ml;
+	}
+	*p++ = 0x50;
+	memset(p, c, 5);
+
+	return p + 5;
+}
+
+static u8 *lz4_header(u8 *p, u64 content_size)
+{
+	put_unaligned_le32(LZ4F_MAGIC_LE, p);
+	p[4] = LZ4F_FLG_INDEP | (content_size ? LZ4F_FLG_SIZE : 0);
+	p[5] = LZ4F_BD_64K;
+	p += 6;
+	if (content_size) {
+		put_unaligned_le64(content_size, p);
+		p += 8;
+	}
+	*p++ = 0;	/* header checksum, not checked by U-Boot */
+
+	return p;
+}
+
+static u8 *lz4_run_block(u8 *p, uint len, u8 c)
+{
+	u8 *end = lz4_run(p + 4, len, c);
+
+	put_unaligned_le32(end - p - 4, p);
+
+	return end;
+}
+
+static u8 *lz4_raw_block(u8 *p, const u8 *data, uint len)
+{
+	put_unaligned_le32(LZ4F_UNCOMPRESSED | len, p);
+	memcpy(p + 4, data, len);
+
+	return p + 4 + len;
+}
+
+static u8 *lz4_end(u8 *p)
+{
+	put_unaligned_le32(0, p);
+
+	return p + 4;
+}
+
+/*
+ * Frame 1: 64 KiB of 'a', 64 KiB of pattern, 1000 bytes of 'b'
+ * Frame 2: 3000 bytes of 'c'
+ */
+static size_t lz4_stream(u8 *src, u8 *expect, size_t *expect_len)
+{
+	u8 *p = src;
+
+	memset(expect, 'a', SZ_64K);
+	fill(expect + SZ_64K, SZ_64K);
+	memset(expect + SZ_128K, 'b', 1000);
+	memset(expect + SZ_128K + 1000, 'c', 3000);
+	*expect_len = SZ_128K + 4000;
+
+	p = lz4_header(p, SZ_128K + 1000);
+	p = lz4_run_block(p, SZ_64K, 'a');
+	p = lz4_raw_block(p, expect + SZ_64K, SZ_64K);
+	p = lz4_run_block(p, 1000, 'b');
+	p = lz4_end(p);
+	p = lz4_header(p, 3000);
+	p = lz4_run_block(p, 3000, 'c');
+	p = lz4_end(p);
+
+	return p - src;
+}
+
+static u8 *zstd_frame(u8 *p, uint type, const u8 *data, uint len)
+{
+	put_unaligned_le32(ZSTD_MAGIC_LE, p);
+	p[4] = ZSTD_FHD_SIZE16;
+	put_unaligned_le16(len - 256, p + 5);
+	p += 7;
+
+	/* A single, last block */
+	p[0] = (len << 3) | (type << 1) | 1;
+	p[1] = len >> 5;
+	p[2] = len >> 13;
+	p += 3;
+	if (type == ZSTD_BLOCK_RLE) {
+		*p++ = *data;
+	} else {
+		memcpy(p, data, len);
+		p += len;
+	}
+
+	return p;
+}
+
+/* Three frames: 40000 bytes of 'z', 20000 bytes of pattern, 300 of 'y' */
+static size_t zstd_stream(u8 *src, u8 *expect, size_t *expect_len)
+{
+	u8 *p = src;
+
+	memset(expect, 'z', 40000);
+	fill(expect + 40000, 20000);
+	memset(expect + 60000, 'y', 300);
+	*expect_len = 60300;
+
+	p = zstd_frame(p, ZSTD_BLOCK_RLE, expect, 40000);
+	p = zstd_frame(p, ZSTD_BLOCK_RAW, expect + 40000, 20000);
+	p = zstd_frame(p, ZSTD_BLOCK_RLE, expect + 60000, 300);
+
+	return p - src;
+}
+
+struct frame_bufs {
+	u8 *src;
+	u8 *expect;
+	u8 *dst;
+};
+
+static int bufs_alloc(struct unit_test_state *uts, struct frame_bufs *bufs)
+{
+	bufs->src = malloc(STREAM_MAX);
+	bufs->expect = malloc(OUT_MAX);
+	bufs->dst = malloc(OUT_MAX);
+	ut_assertnonnull(bufs->src);
+	ut_assertnonnull(bufs->expect);
+	ut_assertnonnull(bufs->dst);
+
+	return 0;
+}
+
+static void bufs_free(struct frame_bufs *bufs)
+{
+	free(bufs->src);
+	free(bufs->expect);
+	free(bufs->dst);
+}
+
+static int check_decomp(struct unit_test_state *uts, struct frame_bufs *bufs,
+			int comp, size_t src_len, size_t expect_len)
+{
+	size_t len = OUT_MAX;
+
+	memset(bufs->dst, '\0', OUT_MAX);
+	ut_assertok(frame_decomp(comp, bufs->src, src_len, bufs->dst, &len));
+	ut_asserteq(expect_len, len);
+	ut_asserteq_mem(bufs->expect, bufs->dst, expect_len);
+
+	return 0;
+}
+
+static int lib_frame_decomp_lz4(struct unit_test_state *uts)
+{
+	struct frame_bufs bufs;
+	size_t src_len, expect_len, len;
+
+	ut_assertok(bufs_alloc(uts, &bufs));
+	src_len = lz4_stream(bufs.src, bufs.expect, &expect_len);
+	ut_assertok(check_decomp(uts, &bufs, IH_COMP_LZ4, src_len, expect_len));
+
+	/* The first frame alone must match the serial decompressor */
+	src_len = lz4_end(lz4_run_block(lz4_raw_block(lz4_run_block(
+		lz4_header(bufs.src, SZ_128K + 1000), SZ_64K, 'a'),
+		bufs.expect + SZ_64K, SZ_64K), 1000, 'b')) - bufs.src;
+	len = OUT_MAX;
+	ut_assertok(ulz4fn(bufs.src, src_len, bufs.dst, &len));
+	ut_asserteq(SZ_128K + 1000, len);
+	ut_assertok(check_decomp(uts, &bufs, IH_COMP_LZ4, src_len,
+				 SZ_128K + 1000));
+
+	/* Truncated */
+	len = OUT_MAX;
+	ut_asserteq(-EINVAL, frame_decomp(IH_COMP_LZ4, bufs.src, src_len - 2,
+					  bufs.dst, &len));
+
+	/* Dependent blocks are left to the serial decompressor */
+	bufs.src[4] &= ~BIT(5);
+	len = OUT_MAX;
+	ut_asserteq(-EPROTONOSUPPORT, frame_decomp(IH_COMP_LZ4, bufs.src,
+						   src_len, bufs.dst, &len));
+	bufs.src[4] |= BIT(5);
+
+	/* So is in-place decompression */
+	len = OUT_MAX;
+	ut_asserteq(-EPROTONOSUPPORT, frame_decomp(IH_COMP_LZ4, bufs.src,
+						   src_len, bufs.src, &len));
+
+	/* And a block which does not fill the space left for it */
+	src_len = lz4_end(lz4_run_block(lz4_run_block(
+		lz4_header(bufs.src, 0), 1000, 'a'), 1000, 'b')) - bufs.src;
+	len = OUT_MAX;
+	ut_asserteq(-EPROTONOSUPPORT, frame_decomp(IH_COMP_LZ4, bufs.src,
+						   src_len, bufs.dst, &len));
+	bufs_free(&bufs);
+
+	return 0;
+}
+LIB_TEST(lib_frame_decomp_lz4, 0);
+
+#if CONFIG_IS_ENABLED(ZSTD)
+static int lib_frame_decomp_zstd(struct unit_test_state *uts)
+{
+	struct frame_bufs bufs;
+	size_t src_len, expect_len, len;
+
+	ut_assertok(bufs_alloc(uts, &bufs));
+	src_len = zstd_stream(bufs.src, bufs.expect, &expect_len);
+	ut_assertok(check_decomp(uts, &bufs, IH_COMP_ZSTD, src_len,
+				 expect_len));
+
+	/* Output too small */
+	len = 50000;
+	ut_assert(frame_decomp(IH_COMP_ZSTD, bufs.src, src_len, bufs.dst,
+			       &len) < 0);
+	bufs_free(&bufs);
+
+	return 0;
+}
+LIB_TEST(lib_frame_decomp_zstd, 0);
+#endif
+
+/* Feed the stream in small pieces, as a loader would, then look it up */
+static int lib_frame_decomp_stream(struct unit_test_state *uts)
+{
+	struct frame_bufs bufs;
+	struct frame_decomp fd;
+	size_t src_len, expect_len, len, avail;
+
+	ut_assertok(bufs_alloc(uts, &bufs));
+	src_len = lz4_stream(bufs.src, bufs.expect, &expect_len);
+	memset(bufs.dst, '\0', OUT_MAX);
+
+	ut_assertok(frame_decomp_start(&fd, IH_COMP_LZ4, bufs.src, src_len,
+				       bufs.dst, OUT_MAX, FRAME_DECOMP_KEEP));
+	for (avail = 0; avail < src_len; avail += 333)
+		ut_assertok(frame_decomp_feed(&fd, avail));
+	ut_assertok(frame_decomp_finish(&fd, &len));
+	ut_asserteq(expect_len, len);
+	ut_asserteq_mem(bufs.expect, bufs.dst, expect_len);
+
+	/* Only the same source and destination match, only once */
+	ut_assert(!frame_decomp_lookup(IH_COMP_ZSTD, bufs.src, src_len,
+				       bufs.dst, OUT_MAX, &len));
+	ut_assertok(frame_decomp_start(&fd, IH_COMP_LZ4, bufs.src, src_len,
+				       bufs.dst, OUT_MAX, FRAME_DECOMP_KEEP));
+	ut_assertok(frame_decomp_finish(&fd, &len));
+	len = 0;
+	ut_assert(frame_decomp_lookup(IH_COMP_LZ4, bufs.src, src_len,
+				      bufs.dst, OUT_MAX, &len));
+	ut_asserteq(expect_len, len);
+	ut_assert(!frame_decomp_lookup(IH_COMP_LZ4, bufs.src, src_len,
+				       bufs.dst, OUT_MAX, &len));
+
+	/* Other data loaded at the same place does not match */
+	ut_assertok(frame_decomp_start(&fd, IH_COMP_LZ4, bufs.src, src_len,
+				       bufs.dst, OUT_MAX, FRAME_DECOMP_KEEP));
+	ut_assertok(frame_decomp_finish(&fd, &len));
+	bufs.src[src_len - 5] ^= 0xff;
+	ut_assert(!frame_decomp_lookup(IH_COMP_LZ4, bufs.src, src_len,
+				       bufs.dst, OUT_MAX, &len));
+	bufs.src[src_len - 5] ^= 0xff;
+
+	/* An aborted stream drops what the previous one kept */
+	ut_assertok(frame_decomp_start(&fd, IH_COMP_LZ4, bufs.src, src_len,
+				       bufs.dst, OUT_MAX, FRAME_DECOMP_KEEP));
+	ut_assertok(frame_decomp_finish(&fd, &len));
+	ut_assertok(frame_decomp_start(&fd, IH_COMP_LZ4, bufs.src, src_len,
+				       bufs.dst, OUT_MAX, FRAME_DECOMP_KEEP));
+	ut_assertok(frame_decomp_feed(&fd, src_len / 2));
+	frame_decomp_abort(&fd);
+	ut_assert(!frame_decomp_lookup(IH_COMP_LZ4, bufs.src, src_len,
+				       bufs.dst, OUT_MAX, &len));
+	bufs_free(&bufs);
+
+	return 0;
+}
+LIB_TEST(lib_frame_decomp_stream, 0);
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests and benchmark for block hash trees
+ */
+
+#include <common.h>
+#include <hash_tree.h>
+#include <hexdump.h>
+#include <malloc.h>
+#include <smp_job.h>
+#include <time.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/sha256.h>
+
+/* Three levels of 1 KiB blocks, the last data block being partial */
+#define KAT_LEN		(0xa000 + 0x123)
+
+#define BENCH_LEN	SZ_16M
+
+static void fill(u8 *buf, ulong len)
+{
+	ulong i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = i * 31 + (i >> 10);
+}
+
+static int check_root(struct unit_test_state *uts, struct hash_tree *tree,
+		      const u8 *buf, ulong len, const char *expect)
+{
+	u8 root[HASH_TREE_MAX_DIGEST], want[HASH_TREE_MAX_DIGEST];
+	int size = hash_tree_digest_size(tree);
+
+	ut_assert(size > 0);
+	ut_assertok(hex2bin(want, expect, size));
+
+	tree->serial = true;
+	ut_assertok(hash_tree_root(tree, buf, len, root));
+	ut_asserteq_mem(want, root, size);
+
+	tree->serial = false;
+	memset(root, '\0', sizeof(root));
+	ut_assertok(hash_tree_root(tree, buf, len, root));
+	ut_asserteq_mem(want, root, size);
+
+	return 0;
+}
+
+/* Root digests as computed by avbtool */
+static int lib_hash_tree(struct unit_test_state *uts)
+{
+	static const u8 salt[] = "u-boot";
+	struct hash_tree tree = { .block_size = SZ_1K };
+	u8 *buf;
+
+	buf = malloc(KAT_LEN);
+	ut_assertnonnull(buf);
+	fill(buf, KAT_LEN);
+
+	tree.algo = "sha256";
+	tree.salt = salt;
+	tree.salt_len = strlen((char *)salt);
+	ut_assertok(check_root(uts, &tree, buf, KAT_LEN,
+		"2412c10a2aec12b45608203dd518b4c2b70862ccbf6ff4073d6e82f373da77d1"));
+	if (CONFIG_IS_ENABLED(SHA1)) {
+		tree.algo = "sha1";
+		tree.salt = NULL;
+		tree.salt_len = 0;
+		ut_assertok(check_root(uts, &tree, buf, KAT_LEN,
+			"8cda460e99055c059fe0d1c296028b1fe53b52b2"));
+	}
+	free(buf);
+
+	/* A block must hold at least two digests */
+	tree.algo = "sha256";
+	tree.block_size = 32;
+	ut_asserteq(-EPROTONOSUPPORT, hash_tree_digest_size(&tree));
+	tree.algo = "md5";
+	tree.block_size = SZ_4K;
+	ut_asserteq(-EPROTONOSUPPORT, hash_tree_digest_size(&tree));
+
+	return 0;
+}
+LIB_TEST(lib_hash_tree, 0);
+
+/* Level layout of a 1 GiB image, as in an AVB hashtree descriptor */
+static int lib_hash_tree_layout(struct unit_test_state *uts)
+{
+	struct hash_tree tree = { .algo = "sha256", .block_size = SZ_4K };
+	struct hash_tree_layout layout;
+
+	ut_assertok(hash_tree_layout(&tree, SZ_1G, &layout));
+	ut_asserteq(3, layout.nr_levels);
+	ut_asserteq(SZ_8M, layout.size[0]);
+	ut_asserteq(SZ_64K, layout.size[1]);
+	ut_asserteq(SZ_4K, layout.size[2]);
+	ut_asserteq(SZ_64K + SZ_4K, layout.offset[0]);
+	ut_asserteq(SZ_4K, layout.offset[1]);
+	ut_asserteq(0, layout.offset[2]);
+	ut_asserteq(SZ_8M + SZ_64K + SZ_4K, layout.tree_size);
+
+	/* Nothing to hash above a single block */
+	ut_assertok(hash_tree_layout(&tree, SZ_4K, &layout));
+	ut_asserteq(0, layout.nr_levels);
+
+	return 0;
+}
+LIB_TEST(lib_hash_tree_layout, 0);
+
+/* Compare the throughput of serial and parallel hashing, run with 'ut -f' */
+static int lib_hash_tree_bench(struct unit_test_state *uts)
+{
+	struct hash_tree tree = { .algo = "sha256", .block_size = SZ_4K };
+	u8 serial[HASH_TREE_MAX_DIGEST], parallel[HASH_TREE_MAX_DIGEST];
+	ulong start, us_serial, us_parallel;
+	u8 *buf;
+
+	buf = malloc(BENCH_LEN);
+	ut_assertnonnull(buf);
+	fill(buf, BENCH_LEN);
+
+	tree.serial = true;
+	start = timer_get_us();
+	ut_assertok(hash_tree_root(&tree, buf, BENCH_LEN, serial));
+	us_serial = max(timer_get_us() - start, 1UL);
+
+	tree.serial = false;
+	start = timer_get_us();
+	ut_assertok(hash_tree_root(&tree, buf, BENCH_LEN, parallel));
+	us_parallel = max(timer_get_us() - start, 1UL);
+	free(buf);
+
+	ut_asserteq_mem(serial, parallel, SHA256_SUM_LEN);
+	printf("sha256 tree, %u KiB: serial %lu us (%lu MB/s), %u CPU(s) %lu us (%lu MB/s)\n",
+	       BENCH_LEN >> 10, us_serial, BENCH_LEN / us_serial,
+	       smp_job_nr_cpus(), us_parallel, BENCH_LEN / us_parallel);
+
+	return 0;
+}
+LIB_TEST(lib_hash_tree_bench, UT_TESTF_MANUAL);
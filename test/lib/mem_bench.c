@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Large memcpy()/memmove()/memset() checks and throughput benchmark
+ *
+ * The small sizes are covered in string.c; this is about the large copy
+ * paths, e.g. the non-temporal loop of the arm64 memcpy().
+ */
+
+#include <common.h>
+#include <cpu_func.h>
+#include <malloc.h>
+#include <time.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define BENCH_MIN	SZ_4K
+#define BENCH_MAX	SZ_64M
+/* Bytes moved for each size, so that small sizes are timed over many runs */
+#define BENCH_BYTES	SZ_256M
+
+/* Large enough for any CONFIG_ARM64_MEMCPY_NT_THRESHOLD up to 1 MiB */
+#define CHECK_LEN	(SZ_1M + SZ_64K)
+
+static void fill(u8 *buf, ulong len, u8 seed)
+{
+	ulong i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = i * 7 + (i >> 12) + seed;
+}
+
+/* Byte-wise reference, whatever memmove() the architecture provides */
+static void ref_move(u8 *dst, const u8 *src, ulong len)
+{
+	ulong i;
+
+	if (dst < src) {
+		for (i = 0; i < len; i++)
+			dst[i] = src[i];
+	} else {
+		for (i = len; i > 0; i--)
+			dst[i - 1] = src[i - 1];
+	}
+}
+
+struct check_bufs {
+	u8 *orig;
+	u8 *buf;
+	u8 *ref;
+};
+
+static int check_copy(struct unit_test_state *uts, struct check_bufs *bufs,
+		      ulong dst, ulong src, ulong len, bool move)
+{
+	u8 *buf = bufs->buf, *ref = bufs->ref;
+
+	memcpy(buf, bufs->orig, CHECK_LEN * 2);
+	memcpy(ref, bufs->orig, CHECK_LEN * 2);
+	if (move)
+		memmove(buf + dst, buf + src, len);
+	else
+		memcpy(buf + dst, buf + src, len);
+	ref_move(ref + dst, ref + src, len);
+	ut_asserteq_mem(ref, buf, CHECK_LEN * 2);
+
+	return 0;
+}
+
+/* Large copies, fills and moves at various alignments, around thresholds */
+static int lib_memcpy_large(struct unit_test_state *uts)
+{
+	static const ulong sizes[] = {
+		129, SZ_4K + 3, SZ_64K - 1, SZ_256K - 64, SZ_256K + 77,
+		SZ_1M - 5,
+	};
+	static const ulong offs[] = { 0, 1, 15, 33, 64 };
+	struct check_bufs bufs;
+	ulong len, off;
+	int i, j, k;
+
+	bufs.orig = malloc(CHECK_LEN * 2);
+	bufs.buf = malloc(CHECK_LEN * 2);
+	bufs.ref = malloc(CHECK_LEN * 2);
+	ut_assertnonnull(bufs.orig);
+	ut_assertnonnull(bufs.buf);
+	ut_assertnonnull(bufs.ref);
+	fill(bufs.orig, CHECK_LEN * 2, 0);
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		len = sizes[i];
+		for (j = 0; j < ARRAY_SIZE(offs); j++) {
+			/* Apart, both ways round */
+			for (k = 0; k < ARRAY_SIZE(offs); k++) {
+				ut_assertok(check_copy(uts, &bufs, offs[j],
+						       CHECK_LEN + offs[k],
+						       len, false));
+				ut_assertok(check_copy(uts, &bufs,
+						       CHECK_LEN + offs[j],
+						       offs[k], len, false));
+			}
+			/* Overlapping, both ways round */
+			ut_assertok(check_copy(uts, &bufs, offs[j] + 3, 0,
+					       len, true));
+			ut_assertok(check_copy(uts, &bufs, 0, offs[j] + 3,
+					       len, true));
+		}
+
+		off = offs[i % ARRAY_SIZE(offs)];
+		memset(bufs.buf, '\0', CHECK_LEN);
+		memset(bufs.buf + off, 0x5a, len);
+		for (j = 0; j < len; j++)
+			ut_asserteq(0x5a, bufs.buf[off + j]);
+		ut_asserteq(0, bufs.buf[off + len]);
+		if (off)
+			ut_asserteq(0, bufs.buf[off - 1]);
+	}
+	free(bufs.ref);
+	free(bufs.buf);
+	free(bufs.orig);
+
+	return 0;
+}
+LIB_TEST(lib_memcpy_large, 0);
+
+static void print_rate(const char *name, ulong size, ulong bytes, ulong us)
+{
+	ulong mbps = bytes / max(us, 1UL);
+
+	printf("  %-12s %6lu KiB: %2lu.%02lu GB/s\n", name, size >> 10,
+	       mbps / 1000, mbps % 1000 / 10);
+}
+
+/*
+ * Throughput from 4 KiB to 64 MiB, or as much as malloc() gives us. This
+ * takes a while, run it with 'ut lib -f lib_memcpy_bench'
+ */
+static int lib_memcpy_bench(struct unit_test_state *uts)
+{
+	ulong size, bytes, runs, n, start;
+	u8 *src = NULL, *dst = NULL;
+	ulong max_size;
+
+	for (max_size = BENCH_MAX; max_size >= BENCH_MIN; max_size >>= 1) {
+		src = malloc(max_size);
+		dst = malloc(max_size + SZ_4K);
+		if (src && dst)
+			break;
+		free(src);
+		free(dst);
+		src = NULL;
+		dst = NULL;
+	}
+	ut_assertnonnull(src);
+	fill(src, max_size, 1);
+	memset(dst, '\0', max_size);
+
+	for (size = BENCH_MIN; size <= max_size; size <<= 2) {
+		runs = max(BENCH_BYTES / size, 1UL);
+		bytes = runs * size;
+
+		start = timer_get_us();
+		for (n = 0; n < runs; n++)
+			memcpy(dst, src, size);
+		print_rate("memcpy", size, bytes, timer_get_us() - start);
+		ut_asserteq_mem(src, dst, size);
+
+		/* Source and destination a page apart, as in a relocation */
+		start = timer_get_us();
+		for (n = 0; n < runs; n++)
+			memmove(dst + SZ_4K, dst, size);
+		print_rate("memmove", size, bytes, timer_get_us() - start);
+
+		start = timer_get_us();
+		for (n = 0; n < runs; n++)
+			memset(dst, n, size);
+		print_rate("memset", size, bytes, timer_get_us() - start);
+
+		if (IS_ENABLED(CONFIG_HAVE_MEMCPY_FLUSH_DCACHE)) {
+			start = timer_get_us();
+			for (n = 0; n < runs; n++)
+				memcpy_flush_dcache(dst, src, size);
+			print_rate("copy+flush", size, bytes,
+				   timer_get_us() - start);
+			ut_asserteq_mem(src, dst, size);
+		}
+	}
+	if (max_size < BENCH_MAX)
+		printf("  sizes above %lu KiB skipped, out of memory\n",
+		       max_size >> 10);
+	free(dst);
+	free(src);
+
+	return 0;
+}
+LIB_TEST(lib_memcpy_bench, UT_TESTF_MANUAL);
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the SMP job pool
+ */
+
+#include <common.h>
+#include <smp_job.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define NR_ITEMS	1000
+
+struct job_ctx {
+	u32 out[NR_ITEMS];
+	uint nested[4];
+};
+
+static void job_square(void *ctx, uint idx)
+{
+	struct job_ctx *job = ctx;
+
+	job->out[idx] = idx * idx;
+}
+
+static void job_inner(void *ctx, uint idx)
+{
+	uint *count = ctx;
+
+	count[idx]++;
+}
+
+/* A job which runs another job, which must then run in place */
+static void job_outer(void *ctx, uint idx)
+{
+	struct job_ctx *job = ctx;
+
+	if (!idx)
+		smp_job_run(job_inner, job->nested, ARRAY_SIZE(job->nested));
+}
+
+static int lib_smp_job(struct unit_test_state *uts)
+{
+	struct job_ctx job;
+	uint i;
+
+	ut_asserteq(CONFIG_SMP_JOB_NR_CPUS, smp_job_nr_cpus());
+
+	memset(&job, '\0', sizeof(job));
+	smp_job_run(job_square, &job, NR_ITEMS);
+	for (i = 0; i < NR_ITEMS; i++)
+		ut_asserteq(i * i, job.out[i]);
+
+	smp_job_run(job_outer, &job, 8);
+	for (i = 0; i < ARRAY_SIZE(job.nested); i++)
+		ut_asserteq(1, job.nested[i]);
+
+	/* Parking and restarting gives the same results */
+	smp_job_park();
+	memset(&job, '\0', sizeof(job));
+	smp_job_run(job_square, &job, NR_ITEMS);
+	for (i = 0; i < NR_ITEMS; i++)
+		ut_asserteq(i * i, job.out[i]);
+	smp_job_park();
+
+	return 0;
+}
+LIB_TEST(lib_smp_job, 0);
+
+static int lib_smp_job_queue(struct unit_test_state *uts)
+{
+	struct job_ctx job, inner;
+	uint i;
+
+	memset(&job, '\0', sizeof(job));
+	ut_assertok(smp_job_queue(job_square, &job, NR_ITEMS));
+	ut_asserteq(-EBUSY, smp_job_queue(job_square, &job, NR_ITEMS));
+
+	/* The boot CPU may run other jobs in the meantime, in place */
+	memset(&inner, '\0', sizeof(inner));
+	smp_job_run(job_inner, inner.nested, ARRAY_SIZE(inner.nested));
+	for (i = 0; i < ARRAY_SIZE(inner.nested); i++)
+		ut_asserteq(1, inner.nested[i]);
+
+	smp_job_flush();
+	for (i = 0; i < NR_ITEMS; i++)
+		ut_asserteq(i * i, job.out[i]);
+
+	/* Nothing left to complete */
+	smp_job_flush();
+	smp_job_park();
+
+	return 0;
+}
+LIB_TEST(lib_smp_job_queue, 0);
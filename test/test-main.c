@@ -394,6 +394,12 @@ static int ut_run_tests(struct unit_test_state *uts, const char *prefix,
 
 		if (!test_matches(prefix, test_name, select_name))
 			continue;
+		if ((test->flags & UT_TESTF_MANUAL) && !uts->force_run) {
+			printf("Test: %s: skipped, manual test (use -f to run)\n",
+			       test_name);
+			found++;
+			continue;
+		}
 		ret = ut_run_test_live_flat(uts, test, select_name);
 		found++;
 		if (ret == -EAGAIN)
@@ -408,7 +414,8 @@ static int ut_run_tests(struct unit_test_state *uts, const char *prefix,
 }
 
 int ut_run_list(const char *category, const char *prefix,
-		struct unit_test *tests, int count, const char *select_name)
+		struct unit_test *tests, int count, const char *select_name,
+		bool force_run)
 {
 	struct unit_test_state uts = { .fail_count = 0 };
 	bool has_dm_tests = false;
@@ -432,6 +439,7 @@ int ut_run_list(const char *category, const char *prefix,
 		printf("Running %d %s tests\n", count, category);
 
 	uts.of_root = gd_of_root();
+	uts.force_run = force_run;
 	ret = ut_run_tests(&uts, prefix, tests, count, select_name);
 
 	if (ret == -ENOENT)
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0+
+
+"""
+Unpack a streamed ramdump (CONFIG_MEMDUMP_STREAM) into one raw image per
+DRAM bank. See include/memdump.h for the format.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+STREAM_MAGIC = 0x504d4448
+CHUNK_MAGIC = 0x4b4e4843
+MAX_BANKS = 16
+MAX_SKIP = 2
+
+CHUNK_F_DEFLATE = 1 << 0
+CHUNK_F_LOST = 1 << 1
+CHUNK_F_END = 1 << 15
+
+HDR = struct.Struct('<IHHIIIIQQ' + 'QQ' * (MAX_BANKS + MAX_SKIP))
+CHUNK = struct.Struct('<IHHQII32s')
+
+def parse_args():
+    """Parse command line arguments."""
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("dump", type=str,
+        help="ramdump stream, e.g. the ramdump partition or fastboot upload")
+    parser.add_argument("outdir", type=str, help="output directory")
+
+    return parser.parse_args()
+
+def align(f, size):
+    """Skip the padding up to the next multiple of size."""
+    pos = f.tell()
+    if pos % size:
+        f.seek(size - pos % size, os.SEEK_CUR)
+
+def main():
+    args = parse_args()
+
+    with open(args.dump, 'rb') as f:
+        fields = HDR.unpack(f.read(HDR.size))
+        (magic, version, codec, page_size, chunk_size, alignment, nr_banks,
+         total_size, raw_size) = fields[:9]
+        ranges = list(zip(fields[9::2], fields[10::2]))
+        banks = ranges[:nr_banks]
+        if magic != STREAM_MAGIC:
+            sys.exit("%s: not a ramdump stream" % args.dump)
+
+        print("version %d, codec %d, %d banks, %d bytes of memory" %
+              (version, codec, nr_banks, raw_size))
+        if not total_size:
+            print("warning: dump did not complete")
+        for start, size in ranges[MAX_BANKS:]:
+            if size:
+                print("not dumped: 0x%x-0x%x" % (start, start + size))
+
+        os.makedirs(args.outdir, exist_ok=True)
+        outs = []
+        for i, (start, size) in enumerate(banks):
+            name = os.path.join(args.outdir, "DDRCS%d-0x%x.bin" % (i, start))
+            out = open(name, 'wb')
+            out.truncate(size)
+            outs.append(out)
+
+        align(f, alignment)
+        while True:
+            data = f.read(CHUNK.size)
+            if len(data) < CHUNK.size:
+                sys.exit("truncated stream")
+
+            magic, bank, flags, offset, raw_len, data_len, bitmap = \
+                CHUNK.unpack(data)
+            if magic != CHUNK_MAGIC:
+                sys.exit("bad chunk at 0x%x" % (f.tell() - CHUNK.size))
+            if flags & CHUNK_F_END:
+                break
+
+            payload = f.read(data_len)
+            align(f, alignment)
+            if flags & CHUNK_F_LOST:
+                print("bank %d offset 0x%x: chunk lost" % (bank, offset))
+                continue
+            if flags & CHUNK_F_DEFLATE:
+                payload = zlib.decompress(payload, -zlib.MAX_WBITS)
+
+            out = outs[bank]
+            pos = 0
+            for page in range((raw_len + page_size - 1) // page_size):
+                if not bitmap[page // 8] & (1 << (page % 8)):
+                    continue
+                out.seek(offset + page * page_size)
+                out.write(payload[pos:pos + page_size])
+                pos += page_size
+
+        for out in outs:
+            out.close()
+
+if __name__ == "__main__":
+    main()